@@ -0,0 +1,271 @@
+#include "Culling.h"
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CULLING_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+#define ALL_PLANES 0x3F
+#define MAX_TRAVERSAL_DEPTH 64
+
+void extractFrustum(mat4 viewProjection, Frustum* frustum) {
+    glm_frustum_planes(viewProjection, frustum->planes);
+}
+
+// BUILD
+
+typedef struct BuildContext {
+    BVH* bvh;
+    const AABB* bounds;
+    float* centroids; // 3 floats per object
+    unsigned int* order;
+} BuildContext;
+
+static float centroidOf(const BuildContext* context, unsigned int object, int axis) {
+    return context->centroids[object * 3 + axis];
+}
+
+// quickselect with a three-way partition (grids produce long runs of equal centroids), afterwards
+// order[middle] holds the median along axis and the range is split around it
+static void selectMedian(BuildContext* context, int begin, int end, int middle, int axis) {
+    unsigned int* order = context->order;
+    int low = begin, high = end - 1;
+    while (low < high) {
+        float pivot = centroidOf(context, order[low + (high - low) / 2], axis);
+        int less = low, i = low, greater = high;
+        while (i <= greater) {
+            float centroid = centroidOf(context, order[i], axis);
+            unsigned int swap = order[i];
+            if (centroid < pivot) {
+                order[i++] = order[less];
+                order[less++] = swap;
+            }
+            else if (centroid > pivot) {
+                order[i] = order[greater];
+                order[greater--] = swap;
+            }
+            else {
+                i++;
+            }
+        }
+        if (middle < less) high = less - 1;
+        else if (middle > greater) low = greater + 1;
+        else return;
+    }
+}
+
+static unsigned int buildNode(BuildContext* context, unsigned int begin, unsigned int end) {
+    BVH* bvh = context->bvh;
+    unsigned int nodeIndex = bvh->nodeCount++;
+    BVHNode* node = &bvh->nodes[nodeIndex];
+
+    vec3 centroidMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    vec3 centroidMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    glm_vec3_copy(centroidMin, node->min);
+    glm_vec3_copy(centroidMax, node->max);
+    for (unsigned int i = begin; i < end; i++) {
+        unsigned int object = context->order[i];
+        for (int axis = 0; axis < 3; axis++) {
+            float centroid = centroidOf(context, object, axis);
+            if (context->bounds[object].min[axis] < node->min[axis]) node->min[axis] = context->bounds[object].min[axis];
+            if (context->bounds[object].max[axis] > node->max[axis]) node->max[axis] = context->bounds[object].max[axis];
+            if (centroid < centroidMin[axis]) centroidMin[axis] = centroid;
+            if (centroid > centroidMax[axis]) centroidMax[axis] = centroid;
+        }
+    }
+    node->firstObject = begin;
+    node->objectCount = end - begin;
+    node->rightChild = 0;
+
+    if (end - begin <= BVH_LEAF_SIZE) {
+        return nodeIndex;
+    }
+
+    // median split along the axis where the centroids are spread the most
+    int axis = 0;
+    vec3 spread;
+    glm_vec3_sub(centroidMax, centroidMin, spread);
+    if (spread[1] > spread[axis]) axis = 1;
+    if (spread[2] > spread[axis]) axis = 2;
+    unsigned int middle = begin + (end - begin) / 2;
+    selectMedian(context, (int)begin, (int)end, (int)middle, axis);
+
+    buildNode(context, begin, middle);
+    node->rightChild = buildNode(context, middle, end);
+    return nodeIndex;
+}
+
+bool buildBVH(BVH* bvh, const AABB* bounds, unsigned int count) {
+    memset(bvh, 0, sizeof(BVH));
+    if (count == 0) {
+        return true;
+    }
+
+    BuildContext context;
+    context.bvh = bvh;
+    context.bounds = bounds;
+    context.centroids = (float*)malloc(sizeof(float) * 3 * count);
+    context.order = (unsigned int*)malloc(sizeof(unsigned int) * count);
+    bvh->nodes = (BVHNode*)malloc(sizeof(BVHNode) * (2 * count));
+    bvh->objectIndex = context.order;
+    float** arrays[] = { &bvh->centerX, &bvh->centerY, &bvh->centerZ, &bvh->extentX, &bvh->extentY, &bvh->extentZ };
+    bool ok = context.centroids != NULL && context.order != NULL && bvh->nodes != NULL;
+    for (int i = 0; i < 6; i++) {
+        *arrays[i] = (float*)malloc(sizeof(float) * count);
+        ok = ok && *arrays[i] != NULL;
+    }
+    if (!ok) {
+        free(context.centroids);
+        destroyBVH(bvh);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        context.order[i] = i;
+        for (int axis = 0; axis < 3; axis++) {
+            context.centroids[i * 3 + axis] = (bounds[i].min[axis] + bounds[i].max[axis]) * 0.5f;
+        }
+    }
+    bvh->objectCount = count;
+    buildNode(&context, 0, count);
+
+    // bounds in leaf order as center/extent, which is what the plane test wants
+    for (unsigned int i = 0; i < count; i++) {
+        const AABB* box = &bounds[context.order[i]];
+        bvh->centerX[i] = (box->min[0] + box->max[0]) * 0.5f;
+        bvh->centerY[i] = (box->min[1] + box->max[1]) * 0.5f;
+        bvh->centerZ[i] = (box->min[2] + box->max[2]) * 0.5f;
+        bvh->extentX[i] = (box->max[0] - box->min[0]) * 0.5f;
+        bvh->extentY[i] = (box->max[1] - box->min[1]) * 0.5f;
+        bvh->extentZ[i] = (box->max[2] - box->min[2]) * 0.5f;
+    }
+
+    free(context.centroids);
+    return true;
+}
+
+void destroyBVH(BVH* bvh) {
+    free(bvh->nodes);
+    free(bvh->objectIndex);
+    free(bvh->centerX);
+    free(bvh->centerY);
+    free(bvh->centerZ);
+    free(bvh->extentX);
+    free(bvh->extentY);
+    free(bvh->extentZ);
+    memset(bvh, 0, sizeof(BVH));
+}
+
+// CULL
+
+// returns the planes the box still straddles, or -1 when it is fully outside one of them
+static int testBox(const Frustum* frustum, const vec3 min, const vec3 max, int planeMask) {
+    int straddling = 0;
+    for (int p = 0; p < 6; p++) {
+        if (!(planeMask & (1 << p))) continue;
+        const float* plane = frustum->planes[p];
+        float center = plane[3], radius = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            center += plane[axis] * (min[axis] + max[axis]) * 0.5f;
+            radius += fabsf(plane[axis]) * (max[axis] - min[axis]) * 0.5f;
+        }
+        if (center + radius < 0.0f) return -1;
+        if (center - radius < 0.0f) straddling |= 1 << p;
+    }
+    return straddling;
+}
+
+static unsigned int acceptRange(const BVH* bvh, unsigned int first, unsigned int count, unsigned int* visible, unsigned int visibleCount) {
+    memcpy(visible + visibleCount, bvh->objectIndex + first, sizeof(unsigned int) * count);
+    return visibleCount + count;
+}
+
+static unsigned int testLeaf(const BVH* bvh, const Frustum* frustum, const BVHNode* node, int planeMask, unsigned int* visible, unsigned int visibleCount) {
+    unsigned int i = node->firstObject;
+    unsigned int end = node->firstObject + node->objectCount;
+#ifdef CULLING_USE_SSE
+    // four objects per iteration: inside = center.plane + |plane|.extent >= 0 for every remaining plane
+    for (; i + 4 <= end; i += 4) {
+        __m128 cx = _mm_loadu_ps(bvh->centerX + i), cy = _mm_loadu_ps(bvh->centerY + i), cz = _mm_loadu_ps(bvh->centerZ + i);
+        __m128 ex = _mm_loadu_ps(bvh->extentX + i), ey = _mm_loadu_ps(bvh->extentY + i), ez = _mm_loadu_ps(bvh->extentZ + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            if (!(planeMask & (1 << p))) continue;
+            const float* plane = frustum->planes[p];
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane[0])), _mm_mul_ps(cy, _mm_set1_ps(plane[1]))),
+                                         _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane[2])), _mm_set1_ps(plane[3])));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabsf(plane[0]))), _mm_mul_ps(ey, _mm_set1_ps(fabsf(plane[1])))),
+                                       _mm_mul_ps(ez, _mm_set1_ps(fabsf(plane[2]))));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++) {
+            if (mask & (1 << lane)) visible[visibleCount++] = bvh->objectIndex[i + lane];
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            if (!(planeMask & (1 << p))) continue;
+            const float* plane = frustum->planes[p];
+            float distance = plane[0] * bvh->centerX[i] + plane[1] * bvh->centerY[i] + plane[2] * bvh->centerZ[i] + plane[3];
+            float radius = fabsf(plane[0]) * bvh->extentX[i] + fabsf(plane[1]) * bvh->extentY[i] + fabsf(plane[2]) * bvh->extentZ[i];
+            inside = distance + radius >= 0.0f;
+        }
+        if (inside) visible[visibleCount++] = bvh->objectIndex[i];
+    }
+    return visibleCount;
+}
+
+unsigned int cullBVH(const BVH* bvh, const Frustum* frustum, unsigned int* visible, CullStats* stats) {
+    unsigned int visibleCount = 0;
+    unsigned int nodesVisited = 0;
+
+    if (bvh->nodeCount > 0) {
+        // planes a parent is completely inside of are dropped for its whole subtree
+        unsigned int stackNode[MAX_TRAVERSAL_DEPTH];
+        int stackMask[MAX_TRAVERSAL_DEPTH];
+        int top = 0;
+        stackNode[top] = 0;
+        stackMask[top] = ALL_PLANES;
+        top++;
+
+        while (top > 0) {
+            top--;
+            const BVHNode* node = &bvh->nodes[stackNode[top]];
+            int planeMask = testBox(frustum, node->min, node->max, stackMask[top]);
+            nodesVisited++;
+
+            if (planeMask < 0) {
+                continue;
+            }
+            if (planeMask == 0) {
+                visibleCount = acceptRange(bvh, node->firstObject, node->objectCount, visible, visibleCount);
+            }
+            else if (node->rightChild == 0 || top + 2 > MAX_TRAVERSAL_DEPTH) {
+                visibleCount = testLeaf(bvh, frustum, node, planeMask, visible, visibleCount);
+            }
+            else {
+                stackNode[top] = node->rightChild;
+                stackMask[top++] = planeMask;
+                stackNode[top] = (unsigned int)(node - bvh->nodes) + 1;
+                stackMask[top++] = planeMask;
+            }
+        }
+    }
+
+    if (stats != NULL) {
+        stats->visible = visibleCount;
+        stats->culled = bvh->objectCount - visibleCount;
+        stats->nodesVisited = nodesVisited;
+    }
+    return visibleCount;
+}
+
+bool boxInFrustum(const Frustum* frustum, const AABB* box) {
+    return testBox(frustum, box->min, box->max, ALL_PLANES) >= 0;
+}
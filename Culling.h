@@ -0,0 +1,58 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cglm/cglm.h>
+
+#define BVH_LEAF_SIZE 8
+
+typedef struct AABB {
+    vec3 min;
+    vec3 max;
+} AABB;
+
+// planes point inwards: a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+typedef struct Frustum {
+    vec4 planes[6];
+} Frustum;
+
+// every node covers a contiguous run of objects in leaf order, which lets a subtree
+// that is completely inside the frustum be accepted without visiting its children
+typedef struct BVHNode {
+    vec3 min;
+    vec3 max;
+    unsigned int firstObject;
+    unsigned int objectCount;
+    unsigned int rightChild; // 0 for leaves, the left child always directly follows its parent
+} BVHNode;
+
+// static bounding volume hierarchy, object bounds are kept as center/extent arrays in leaf order
+typedef struct BVH {
+    BVHNode* nodes;
+    unsigned int nodeCount;
+    unsigned int objectCount;
+    unsigned int* objectIndex; // leaf order -> caller's object index
+    float* centerX;
+    float* centerY;
+    float* centerZ;
+    float* extentX;
+    float* extentY;
+    float* extentZ;
+} BVH;
+
+typedef struct CullStats {
+    unsigned int visible;
+    unsigned int culled;
+    unsigned int nodesVisited;
+    unsigned int occluded; // of the visible ones, hidden behind nearer geometry (-occlusion, a few frames late)
+} CullStats;
+
+void extractFrustum(mat4 viewProjection, Frustum* frustum);
+bool buildBVH(BVH* bvh, const AABB* bounds, unsigned int count);
+void destroyBVH(BVH* bvh);
+
+// writes the caller's indices of every object touching the frustum into visible, returns how many
+unsigned int cullBVH(const BVH* bvh, const Frustum* frustum, unsigned int* visible, CullStats* stats);
+// single box test for objects that move around too much to live in a static hierarchy
+bool boxInFrustum(const Frustum* frustum, const AABB* box);
+
+#endif
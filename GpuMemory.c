@@ -0,0 +1,253 @@
+#include "GpuMemory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEGABYTE (1024.0 * 1024.0)
+
+GpuMemory gpuMemory = { 0 };
+
+static const char* categoryNames[GPU_MEMORY_CATEGORY_COUNT] = { "textures", "geometry", "streaming", "targets", "compute" };
+
+void initGpuMemory(size_t budget) {
+    gpuMemory.budget = budget;
+}
+
+void shutdownGpuMemory() {
+    free(gpuMemory.resources);
+    free(gpuMemory.slots);
+    memset(&gpuMemory, 0, sizeof(GpuMemory));
+}
+
+// INDEX
+
+static unsigned int hashResource(GpuResourceKind kind, unsigned int name) {
+    // GL hands out small consecutive names, the multiply spreads them over the table
+    return ((name * 4u + (unsigned int)kind) * 2654435761u) & (gpuMemory.slotCount - 1);
+}
+
+// the slot holding the resource, or the empty slot ending its probe run
+static unsigned int findSlot(GpuResourceKind kind, unsigned int name) {
+    unsigned int slot = hashResource(kind, name);
+    while (gpuMemory.slots[slot] != 0) {
+        const GpuResource* resource = &gpuMemory.resources[gpuMemory.slots[slot] - 1];
+        if (resource->name == name && resource->kind == kind) break;
+        slot = (slot + 1) & (gpuMemory.slotCount - 1);
+    }
+    return slot;
+}
+
+static bool growSlots() {
+    unsigned int slotCount = gpuMemory.slotCount > 0 ? gpuMemory.slotCount * 2 : 128;
+    unsigned int* slots = (unsigned int*)calloc(slotCount, sizeof(unsigned int));
+    if (slots == NULL) {
+        return false;
+    }
+    free(gpuMemory.slots);
+    gpuMemory.slots = slots;
+    gpuMemory.slotCount = slotCount;
+    for (unsigned int i = 0; i < gpuMemory.count; i++) {
+        gpuMemory.slots[findSlot(gpuMemory.resources[i].kind, gpuMemory.resources[i].name)] = i + 1;
+    }
+    return true;
+}
+
+// linear probing without tombstones: later entries of the run move back into the hole when they may
+static void clearSlot(unsigned int slot) {
+    unsigned int mask = gpuMemory.slotCount - 1;
+    unsigned int next = slot;
+    while (true) {
+        gpuMemory.slots[slot] = 0;
+        unsigned int home;
+        do {
+            next = (next + 1) & mask;
+            if (gpuMemory.slots[next] == 0) return;
+            const GpuResource* resource = &gpuMemory.resources[gpuMemory.slots[next] - 1];
+            home = hashResource(resource->kind, resource->name);
+            // stays put while its home lies cyclically after the hole, up to where it sits
+        } while (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next));
+        gpuMemory.slots[slot] = gpuMemory.slots[next];
+        slot = next;
+    }
+}
+
+static GpuResource* findResource(GpuResourceKind kind, unsigned int name) {
+    if (gpuMemory.count == 0) {
+        return NULL;
+    }
+    unsigned int index = gpuMemory.slots[findSlot(kind, name)];
+    return index != 0 ? &gpuMemory.resources[index - 1] : NULL;
+}
+
+static void addBytes(const GpuResource* resource) {
+    gpuMemory.total += resource->bytes;
+    gpuMemory.categoryBytes[resource->category] += resource->bytes;
+    gpuMemory.categoryCount[resource->category]++;
+    if (resource->evict != NULL) gpuMemory.evictableBytes += resource->bytes;
+
+    if (gpuMemory.total > gpuMemory.peak) gpuMemory.peak = gpuMemory.total;
+    if (gpuMemory.categoryBytes[resource->category] > gpuMemory.categoryPeak[resource->category]) {
+        gpuMemory.categoryPeak[resource->category] = gpuMemory.categoryBytes[resource->category];
+    }
+}
+
+static void removeBytes(const GpuResource* resource) {
+    gpuMemory.total -= resource->bytes;
+    gpuMemory.categoryBytes[resource->category] -= resource->bytes;
+    gpuMemory.categoryCount[resource->category]--;
+    if (resource->evict != NULL) gpuMemory.evictableBytes -= resource->bytes;
+}
+
+void trackGpuResource(GpuResourceKind kind, unsigned int name, GpuMemoryCategory category, size_t bytes) {
+    if (name == 0) {
+        return;
+    }
+    GpuResource* resource = findResource(kind, name);
+    if (resource != NULL && resource->bytes == bytes && resource->category == category) {
+        resource->lastUsedFrame = gpuMemory.frame;
+        return;
+    }
+    if (resource != NULL) {
+        // reallocated storage, the same GL object
+        removeBytes(resource);
+        resource->category = category;
+        resource->bytes = bytes;
+        resource->lastUsedFrame = gpuMemory.frame;
+        addBytes(resource);
+        return;
+    }
+
+    if (gpuMemory.count == gpuMemory.capacity) {
+        unsigned int capacity = gpuMemory.capacity > 0 ? gpuMemory.capacity * 2 : 64;
+        GpuResource* resources = (GpuResource*)realloc(gpuMemory.resources, sizeof(GpuResource) * capacity);
+        if (resources == NULL) {
+            printf("ERROR::GPU_MEMORY::OUT_OF_MEMORY\n");
+            return;
+        }
+        gpuMemory.resources = resources;
+        gpuMemory.capacity = capacity;
+    }
+    if ((gpuMemory.count + 1) * 2 > gpuMemory.slotCount && !growSlots()) {
+        printf("ERROR::GPU_MEMORY::OUT_OF_MEMORY\n");
+        return;
+    }
+    gpuMemory.slots[findSlot(kind, name)] = gpuMemory.count + 1;
+    resource = &gpuMemory.resources[gpuMemory.count++];
+    memset(resource, 0, sizeof(GpuResource));
+    resource->name = name;
+    resource->kind = kind;
+    resource->category = category;
+    resource->bytes = bytes;
+    resource->lastUsedFrame = gpuMemory.frame;
+    addBytes(resource);
+}
+
+void releaseGpuResource(GpuResourceKind kind, unsigned int name) {
+    if (gpuMemory.count == 0) {
+        return;
+    }
+    unsigned int slot = findSlot(kind, name);
+    if (gpuMemory.slots[slot] == 0) {
+        return;
+    }
+    unsigned int index = gpuMemory.slots[slot] - 1;
+    removeBytes(&gpuMemory.resources[index]);
+    clearSlot(slot);
+
+    // order does not matter, the last one fills the hole and its slot follows it
+    unsigned int last = --gpuMemory.count;
+    if (index != last) {
+        gpuMemory.resources[index] = gpuMemory.resources[last];
+        gpuMemory.slots[findSlot(gpuMemory.resources[index].kind, gpuMemory.resources[index].name)] = index + 1;
+    }
+}
+
+void setGpuResourceEvictable(GpuResourceKind kind, unsigned int name, GpuEvictFunction evict, void* owner) {
+    GpuResource* resource = findResource(kind, name);
+    if (resource == NULL) {
+        return;
+    }
+    removeBytes(resource);
+    resource->evict = evict;
+    resource->owner = owner;
+    addBytes(resource);
+}
+
+void touchGpuResource(GpuResourceKind kind, unsigned int name) {
+    GpuResource* resource = findResource(kind, name);
+    if (resource != NULL) {
+        resource->lastUsedFrame = gpuMemory.frame;
+    }
+}
+
+void beginGpuMemoryFrame() {
+    gpuMemory.frame++;
+    if (gpuMemory.budget == 0) {
+        return;
+    }
+
+    while (gpuMemory.total > gpuMemory.budget) {
+        GpuResource* oldest = NULL;
+        for (unsigned int i = 0; i < gpuMemory.count; i++) {
+            GpuResource* resource = &gpuMemory.resources[i];
+            if (resource->evict == NULL || resource->lastUsedFrame + 1 >= gpuMemory.frame) continue;
+            if (oldest == NULL || resource->lastUsedFrame < oldest->lastUsedFrame) oldest = resource;
+        }
+        if (oldest == NULL) {
+            break;
+        }
+
+        // stop counting it first, the owner's delete may release it again
+        GpuResource evicted = *oldest;
+        releaseGpuResource(evicted.kind, evicted.name);
+        gpuMemory.evictions++;
+        gpuMemory.evictedBytes += evicted.bytes;
+        evicted.evict(evicted.owner, evicted.name);
+    }
+
+    // evictable resources still in use only stay over budget until they fall out of use, what can never be evicted
+    // is reported once per stretch over budget, not every frame of it
+    size_t pinned = gpuMemory.total - gpuMemory.evictableBytes;
+    bool overBudget = pinned > gpuMemory.budget;
+    if (overBudget && !gpuMemory.overBudget) {
+        printf("ERROR::GPU_MEMORY::OVER_BUDGET %.1f MB cannot be evicted, %.1f MB budget\n", pinned / MEGABYTE, gpuMemory.budget / MEGABYTE);
+    }
+    gpuMemory.overBudget = overBudget;
+}
+
+size_t getTextureBytes(int width, int height, int bytesPerTexel, bool mipmapped) {
+    size_t bytes = 0;
+    while (true) {
+        bytes += (size_t)width * height * bytesPerTexel;
+        if (!mipmapped || (width == 1 && height == 1)) break;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return bytes;
+}
+
+const char* getGpuMemoryCategoryName(GpuMemoryCategory category) {
+    return category < GPU_MEMORY_CATEGORY_COUNT ? categoryNames[category] : "unknown";
+}
+
+void formatGpuMemory(char* buffer, size_t size) {
+    if (gpuMemory.budget > 0) {
+        snprintf(buffer, size, "gpu %.1f/%.0f MB", gpuMemory.total / MEGABYTE, gpuMemory.budget / MEGABYTE);
+    }
+    else {
+        snprintf(buffer, size, "gpu %.1f MB", gpuMemory.total / MEGABYTE);
+    }
+}
+
+void printGpuMemory() {
+    printf("GPU MEMORY          current MB    peak MB  objects\n");
+    for (unsigned int c = 0; c < GPU_MEMORY_CATEGORY_COUNT; c++) {
+        printf("  %-16s %10.2f %10.2f %8u\n", categoryNames[c], gpuMemory.categoryBytes[c] / MEGABYTE,
+               gpuMemory.categoryPeak[c] / MEGABYTE, gpuMemory.categoryCount[c]);
+    }
+    printf("  %-16s %10.2f %10.2f %8u\n", "total", gpuMemory.total / MEGABYTE, gpuMemory.peak / MEGABYTE, gpuMemory.count);
+    if (gpuMemory.budget > 0) {
+        printf("  budget %.1f MB, %u evictions freed %.1f MB\n", gpuMemory.budget / MEGABYTE, gpuMemory.evictions,
+               gpuMemory.evictedBytes / MEGABYTE);
+    }
+}
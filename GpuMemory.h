@@ -0,0 +1,85 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// GPU MEMORY BUDGET: EVERY TEXTURE, BUFFER AND RENDERBUFFER IS TRACKED WITH THE BYTES ITS STORAGE TAKES, UNDER ONE OF A
+// FEW CATEGORIES. OWNERS OF ASSETS THAT CAN BE LOADED AGAIN (STREAMED TEXTURES) MARK THEM EVICTABLE AND TOUCH THEM WHEN
+// THEY ARE USED; WHEN THE TOTAL IS OVER BUDGET AT THE START OF A FRAME THE LEAST RECENTLY USED OF THOSE ARE HANDED BACK
+// TO THEIR OWNERS TO DELETE, AND STREAMED IN AGAIN THE NEXT TIME SOMETHING ASKS FOR THEM. SIZES ARE WHAT THE
+// ALLOCATIONS ASKED FOR, THE DRIVER'S PADDING AND ALIGNMENT ARE NOT VISIBLE FROM GL
+
+typedef enum GpuMemoryCategory {
+    GPU_MEMORY_TEXTURES, // sampled images
+    GPU_MEMORY_GEOMETRY, // vertex and index buffers
+    GPU_MEMORY_STREAMING, // rewritten from the CPU every frame or so: rings, upload PBOs, uniform and indirect buffers
+    GPU_MEMORY_TARGETS, // rendered into: framebuffer attachments, depth copies, pyramids
+    GPU_MEMORY_COMPUTE, // written by the GPU itself: transform feedback and cluster buffers
+    GPU_MEMORY_CATEGORY_COUNT
+} GpuMemoryCategory;
+
+typedef enum GpuResourceKind {
+    GPU_TEXTURE,
+    GPU_BUFFER,
+    GPU_RENDERBUFFER
+} GpuResourceKind;
+
+// deletes the GL object and forgets it, the tracker has already stopped counting it
+typedef void (*GpuEvictFunction)(void* owner, unsigned int name);
+
+typedef struct GpuResource {
+    unsigned int name;
+    GpuResourceKind kind;
+    GpuMemoryCategory category;
+    size_t bytes;
+    GpuEvictFunction evict; // NULL unless evictable
+    void* owner;
+    unsigned int lastUsedFrame;
+} GpuResource;
+
+typedef struct GpuMemory {
+    GpuResource* resources; // dense, in no particular order
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int* slots; // open addressing on kind and name, resource index + 1, 0 is empty
+    unsigned int slotCount; // a power of two, at least twice count
+    size_t budget; // bytes, 0 never evicts
+    size_t total;
+    size_t peak;
+    size_t categoryBytes[GPU_MEMORY_CATEGORY_COUNT];
+    size_t categoryPeak[GPU_MEMORY_CATEGORY_COUNT];
+    unsigned int categoryCount[GPU_MEMORY_CATEGORY_COUNT];
+    size_t evictableBytes;
+    unsigned int frame;
+    unsigned int evictions; // since init
+    size_t evictedBytes;
+    bool overBudget; // more than the budget is held by resources that cannot be evicted
+} GpuMemory;
+
+extern GpuMemory gpuMemory;
+
+void initGpuMemory(size_t budget);
+void shutdownGpuMemory();
+// evicts least recently used evictable resources until the total fits the budget again, never one used in the frame
+// that just ended: those would only come straight back
+void beginGpuMemoryFrame();
+
+// after the storage is (re)allocated, a name already tracked takes the new size and category. every call is a hash
+// lookup, cheap enough for buffers respecified each frame
+void trackGpuResource(GpuResourceKind kind, unsigned int name, GpuMemoryCategory category, size_t bytes);
+// before or after the delete, names never tracked are ignored
+void releaseGpuResource(GpuResourceKind kind, unsigned int name);
+void setGpuResourceEvictable(GpuResourceKind kind, unsigned int name, GpuEvictFunction evict, void* owner);
+void touchGpuResource(GpuResourceKind kind, unsigned int name);
+
+// level 0 and, when mipmapped, the whole chain below it
+size_t getTextureBytes(int width, int height, int bytesPerTexel, bool mipmapped);
+
+const char* getGpuMemoryCategoryName(GpuMemoryCategory category);
+// "gpu 123.4/256 MB" for the window title
+void formatGpuMemory(char* buffer, size_t size);
+// current and peak bytes per category
+void printGpuMemory();
+
+#endif
@@ -0,0 +1,342 @@
+#include <glad/glad.h>
+#include "Headless.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef HEADLESS_SUPPORTED
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// CONTEXT
+
+#ifdef HEADLESS_SUPPORTED
+// the surfaceless platform needs no X or Wayland server at all, the default display is the fallback
+static EGLDisplay openDisplay() {
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+                return display;
+            }
+        }
+    }
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+#endif
+
+bool createHeadlessContext(HeadlessContext* headless, unsigned int width, unsigned int height) {
+    memset(headless, 0, sizeof(HeadlessContext));
+    headless->width = width;
+    headless->height = height;
+
+#ifdef HEADLESS_SUPPORTED
+    EGLDisplay display = openDisplay();
+    if (display == EGL_NO_DISPLAY) {
+        printf("ERROR::HEADLESS::NO_EGL_DISPLAY\n");
+        return false;
+    }
+    headless->display = display;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        printf("ERROR::HEADLESS::OPENGL_API_UNAVAILABLE\n");
+        destroyHeadlessContext(headless);
+        return false;
+    }
+
+    // without surfaceless contexts a tiny pbuffer is made current instead, the frames still go to the framebuffer object
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    bool surfaceless = extensions != NULL && strstr(extensions, "EGL_KHR_surfaceless_context") != NULL;
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        printf("ERROR::HEADLESS::NO_EGL_CONFIG\n");
+        destroyHeadlessContext(headless);
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        printf("ERROR::HEADLESS::CONTEXT_CREATION_FAILED 0x%x\n", eglGetError());
+        destroyHeadlessContext(headless);
+        return false;
+    }
+    headless->context = context;
+
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!surfaceless) {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        if (surface == EGL_NO_SURFACE) {
+            printf("ERROR::HEADLESS::PBUFFER_CREATION_FAILED 0x%x\n", eglGetError());
+            destroyHeadlessContext(headless);
+            return false;
+        }
+    }
+    headless->surface = surface;
+
+    if (!eglMakeCurrent(display, surface, surface, context)) {
+        printf("ERROR::HEADLESS::MAKE_CURRENT_FAILED 0x%x\n", eglGetError());
+        destroyHeadlessContext(headless);
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        printf("Failed to initialize GLAD\n");
+        destroyHeadlessContext(headless);
+        return false;
+    }
+
+    // RENDER TARGET
+    glGenRenderbuffers(1, &headless->colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &headless->depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    trackGpuResource(GPU_RENDERBUFFER, headless->colorBuffer, GPU_MEMORY_TARGETS, getTextureBytes(width, height, 4, false));
+    trackGpuResource(GPU_RENDERBUFFER, headless->depthBuffer, GPU_MEMORY_TARGETS, getTextureBytes(width, height, 4, false));
+
+    glGenFramebuffers(1, &headless->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, headless->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless->colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless->depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE\n");
+        destroyHeadlessContext(headless);
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    return true;
+#else
+    printf("ERROR::HEADLESS::NOT_SUPPORTED_ON_THIS_PLATFORM\n");
+    return false;
+#endif
+}
+
+void destroyHeadlessContext(HeadlessContext* headless) {
+#ifdef HEADLESS_SUPPORTED
+    if (headless->display == NULL) {
+        return;
+    }
+    if (headless->framebuffer != 0) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &headless->framebuffer);
+        releaseGpuResource(GPU_RENDERBUFFER, headless->colorBuffer);
+        releaseGpuResource(GPU_RENDERBUFFER, headless->depthBuffer);
+        glDeleteRenderbuffers(1, &headless->colorBuffer);
+        glDeleteRenderbuffers(1, &headless->depthBuffer);
+    }
+    eglMakeCurrent(headless->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (headless->surface != NULL) {
+        eglDestroySurface(headless->display, headless->surface);
+    }
+    if (headless->context != NULL) {
+        eglDestroyContext(headless->display, headless->context);
+    }
+    eglTerminate(headless->display);
+#endif
+    memset(headless, 0, sizeof(HeadlessContext));
+}
+
+// GPU TIMING
+
+void createGpuFrameTimer(GpuFrameTimer* timer) {
+    memset(timer, 0, sizeof(GpuFrameTimer));
+    glGenQueries(GPU_TIMER_FRAMES, timer->queries);
+}
+
+void destroyGpuFrameTimer(GpuFrameTimer* timer) {
+    glDeleteQueries(GPU_TIMER_FRAMES, timer->queries);
+    memset(timer, 0, sizeof(GpuFrameTimer));
+}
+
+static void readQuery(GpuFrameTimer* timer, unsigned int slot, double* gpuMs) {
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(timer->queries[slot], GL_QUERY_RESULT, &elapsed);
+    gpuMs[timer->samples[slot]] = (double)elapsed / 1000000.0;
+    timer->pending[slot] = false;
+}
+
+void beginGpuFrame(GpuFrameTimer* timer, double* gpuMs, unsigned int sample) {
+    unsigned int slot = timer->next;
+    if (timer->pending[slot]) {
+        readQuery(timer, slot, gpuMs); // GPU_TIMER_FRAMES behind, normally long finished
+    }
+    timer->samples[slot] = sample;
+    glBeginQuery(GL_TIME_ELAPSED, timer->queries[slot]);
+}
+
+void endGpuFrame(GpuFrameTimer* timer) {
+    glEndQuery(GL_TIME_ELAPSED);
+    timer->pending[timer->next] = true;
+    timer->next = (timer->next + 1) % GPU_TIMER_FRAMES;
+}
+
+void collectGpuFrames(GpuFrameTimer* timer, double* gpuMs, bool wait) {
+    for (unsigned int slot = 0; slot < GPU_TIMER_FRAMES; slot++) {
+        if (!timer->pending[slot]) {
+            continue;
+        }
+        GLint available = GL_FALSE;
+        if (!wait) {
+            glGetQueryObjectiv(timer->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (wait || available) {
+            readQuery(timer, slot, gpuMs);
+        }
+    }
+}
+
+// REPORTING
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank percentiles
+Percentiles computePercentiles(const double* values, unsigned int count) {
+    Percentiles result = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    double* sorted = (double*)malloc(sizeof(double) * count);
+    if (count == 0 || sorted == NULL) {
+        free(sorted);
+        return result;
+    }
+    memcpy(sorted, values, sizeof(double) * count);
+    qsort(sorted, count, sizeof(double), compareDoubles);
+
+    double sum = 0.0;
+    for (unsigned int i = 0; i < count; i++) {
+        sum += sorted[i];
+    }
+    const double ranks[3] = { 0.50, 0.95, 0.99 };
+    double* outputs[3] = { &result.p50, &result.p95, &result.p99 };
+    for (int i = 0; i < 3; i++) {
+        unsigned int rank = (unsigned int)ceil(ranks[i] * count);
+        *outputs[i] = sorted[rank > 0 ? rank - 1 : 0];
+    }
+    result.mean = sum / count;
+    result.max = sorted[count - 1];
+    free(sorted);
+    return result;
+}
+
+static void writePercentiles(FILE* file, const char* name, const double* values, unsigned int count, bool last) {
+    Percentiles p = computePercentiles(values, count);
+    fprintf(file, "  \"%s\": { \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"mean\": %.4f, \"max\": %.4f }%s\n",
+        name, p.p50, p.p95, p.p99, p.mean, p.max, last ? "" : ",");
+}
+
+static void writeCounterPercentiles(FILE* file, const char* name, const unsigned int* values, unsigned int count, bool last) {
+    double* converted = (double*)malloc(sizeof(double) * (count > 0 ? count : 1));
+    if (converted == NULL) {
+        fprintf(file, "  \"%s\": null%s\n", name, last ? "" : ",");
+        return;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        converted[i] = (double)values[i];
+    }
+    writePercentiles(file, name, converted, count, last);
+    free(converted);
+}
+
+// driver strings are printed as they are apart from characters JSON does not allow unescaped
+static void writeString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text != NULL ? text : ""; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        }
+        else if ((unsigned char)*c >= 0x20) {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+bool writeBenchmarkReport(const BenchmarkReport* report, const char* path) {
+    FILE* file = stdout;
+    if (path != NULL) {
+        file = fopen(path, "w");
+        if (file == NULL) {
+            printf("ERROR::HEADLESS::REPORT_OPEN_FAILED %s\n", path);
+            return false;
+        }
+    }
+
+    fprintf(file, "{\n  \"renderer\": ");
+    writeString(file, report->renderer);
+    fprintf(file, ",\n  \"version\": ");
+    writeString(file, report->version);
+    fprintf(file, ",\n  \"width\": %u,\n  \"height\": %u,\n", report->width, report->height);
+    fprintf(file, "  \"instances\": %u,\n  \"culling\": %s,\n", report->instances, report->culling ? "true" : "false");
+    fprintf(file, "  \"occlusion_culling\": %s,\n", report->occlusion ? "true" : "false");
+    fprintf(file, "  \"state_cache\": %s,\n", report->stateCache ? "true" : "false");
+    fprintf(file, "  \"meshes\": %u,\n  \"multi_draw_indirect\": %s,\n", report->meshes, report->multiDraw ? "true" : "false");
+    fprintf(file, "  \"persistent_mapping\": %s,\n", report->persistentMapping ? "true" : "false");
+    fprintf(file, "  \"vertex_format\": \"%s\",\n  \"vertex_stride\": %u,\n  \"vertex_bytes\": %u,\n",
+        report->vertexFormat, report->vertexStride, report->vertexBytes);
+    fprintf(file, "  \"world_radius\": %d,\n  \"chunks_generated\": %u,\n  \"chunks_meshed\": %u,\n", report->worldRadius,
+        report->chunksGenerated, report->chunksMeshed);
+    fprintf(file, "  \"chunk_mesh_rate\": %.1f,\n  \"chunk_mesh_ms\": %.4f,\n", report->chunkMeshRate, report->chunkMeshMs);
+    fprintf(file, "  \"lod_levels\": %u,\n  \"lod_triangles\": [", report->lodLevels);
+    for (unsigned int l = 0; l < report->lodLevels; l++) {
+        fprintf(file, "%s%.1f", l > 0 ? ", " : "", report->lodTriangles[l]);
+    }
+    fprintf(file, "],\n");
+    const GpuMemory* memory = report->memory;
+    fprintf(file, "  \"gpu_memory\": {\"budget\": %zu, \"bytes\": %zu, \"peak\": %zu, \"evictions\": %u, \"evicted_bytes\": %zu",
+        memory->budget, memory->total, memory->peak, memory->evictions, memory->evictedBytes);
+    for (unsigned int c = 0; c < GPU_MEMORY_CATEGORY_COUNT; c++) {
+        fprintf(file, ",\n    \"%s\": {\"bytes\": %zu, \"peak\": %zu, \"objects\": %u}", getGpuMemoryCategoryName((GpuMemoryCategory)c),
+            memory->categoryBytes[c], memory->categoryPeak[c], memory->categoryCount[c]);
+    }
+    fprintf(file, "},\n");
+    fprintf(file, "  \"frames\": %u,\n  \"warmup_frames\": %u,\n", report->frames, report->warmupFrames);
+    writePercentiles(file, "cpu_frame_ms", report->cpuMs, report->frames, false);
+    if (report->gpuMs != NULL) {
+        writePercentiles(file, "gpu_frame_ms", report->gpuMs, report->frames, false);
+    }
+    else {
+        fprintf(file, "  \"gpu_frame_ms\": null,\n");
+    }
+    writeCounterPercentiles(file, "draw_calls", report->drawCalls, report->frames, false);
+    writeCounterPercentiles(file, "mesh_draws", report->meshDraws, report->frames, false);
+    writeCounterPercentiles(file, "triangles", report->triangles, report->frames, false);
+    writeCounterPercentiles(file, "lod_triangles_saved", report->lodTrianglesSaved, report->frames, false);
+    writeCounterPercentiles(file, "visible_instances", report->visibleInstances, report->frames, false);
+    if (report->occlusion) {
+        writeCounterPercentiles(file, "occluded_instances", report->occludedInstances, report->frames, false);
+    }
+    writeCounterPercentiles(file, "state_changes", report->stateChanges, report->frames, false);
+    writeCounterPercentiles(file, "state_changes_skipped", report->skippedStateChanges, report->frames, true);
+    fprintf(file, "}\n");
+
+    if (file != stdout) {
+        fclose(file);
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdbool.h>
+#include "GpuMemory.h"
+
+// OFFSCREEN RENDERING WITHOUT A WINDOW OR DISPLAY: EGL CONTEXT, FRAMEBUFFER TARGET, GPU FRAME TIMERS AND RESULT REPORTING
+
+// EGL is how a display-less Linux box (Mesa llvmpipe on a build machine) gets a context
+#if !defined(_WIN32) && !defined(__APPLE__)
+#define HEADLESS_SUPPORTED
+#endif
+
+#define GPU_TIMER_FRAMES 4 // frames a timer query stays in flight before its result is read, so reading never stalls
+
+typedef struct HeadlessContext {
+    void* display; // EGLDisplay
+    void* context; // EGLContext
+    void* surface; // EGLSurface, EGL_NO_SURFACE when the driver is surfaceless
+    unsigned int framebuffer;
+    unsigned int colorBuffer;
+    unsigned int depthBuffer;
+    unsigned int width;
+    unsigned int height;
+} HeadlessContext;
+
+typedef struct GpuFrameTimer {
+    unsigned int queries[GPU_TIMER_FRAMES];
+    unsigned int samples[GPU_TIMER_FRAMES]; // which sample each query is measuring
+    bool pending[GPU_TIMER_FRAMES];
+    unsigned int next;
+} GpuFrameTimer;
+
+typedef struct Percentiles {
+    double p50;
+    double p95;
+    double p99;
+    double mean;
+    double max;
+} Percentiles;
+
+// one entry per measured frame in every array
+typedef struct BenchmarkReport {
+    const char* renderer;
+    const char* version;
+    unsigned int width;
+    unsigned int height;
+    unsigned int instances;
+    unsigned int frames;
+    unsigned int warmupFrames;
+    bool culling;
+    unsigned int meshes; // extra arena meshes from -meshes
+    bool multiDraw;
+    bool persistentMapping; // per-frame data through a persistently mapped ring
+    const char* vertexFormat;
+    unsigned int vertexStride; // bytes per vertex
+    unsigned int vertexBytes; // uploaded for all meshes
+    const double* cpuMs;
+    const double* gpuMs; // NULL when the GPU could not be timed
+    const unsigned int* drawCalls;
+    const unsigned int* meshDraws; // meshes drawn, a multi-draw counts one call but many meshes
+    const unsigned int* triangles;
+    const unsigned int* visibleInstances;
+    bool stateCache;
+    const unsigned int* stateChanges; // binds issued
+    const unsigned int* skippedStateChanges; // redundant binds the state cache dropped
+    int worldRadius; // chunks, 0 without -world
+    unsigned int chunksGenerated;
+    unsigned int chunksMeshed; // meshes built, first builds and re-meshes after edits
+    double chunkMeshRate; // chunks per second of wall time with chunk jobs outstanding
+    double chunkMeshMs; // average worker time per chunk mesh
+    unsigned int lodLevels; // levels of detail the -mesh model has, 0 without one
+    const double* lodTriangles; // lodLevels entries, mean triangles per frame drawn from each level
+    const unsigned int* lodTrianglesSaved; // full detail triangles the chosen levels left out
+    bool occlusion; // -occlusion
+    const unsigned int* occludedInstances; // visible to the frustum but hidden by the depth of the frame before
+    const GpuMemory* memory; // tracked GPU memory after the last frame
+} BenchmarkReport;
+
+// creates a GL 3.3 core context with glad loaded and a width x height framebuffer bound as the draw target
+bool createHeadlessContext(HeadlessContext* headless, unsigned int width, unsigned int height);
+void destroyHeadlessContext(HeadlessContext* headless);
+
+void createGpuFrameTimer(GpuFrameTimer* timer);
+void destroyGpuFrameTimer(GpuFrameTimer* timer);
+void beginGpuFrame(GpuFrameTimer* timer, double* gpuMs, unsigned int sample);
+void endGpuFrame(GpuFrameTimer* timer);
+// writes finished results into gpuMs[sample], waits for the ones still running when wait is true
+void collectGpuFrames(GpuFrameTimer* timer, double* gpuMs, bool wait);
+
+Percentiles computePercentiles(const double* values, unsigned int count);
+bool writeBenchmarkReport(const BenchmarkReport* report, const char* path); // path NULL prints to stdout
+
+#endif
@@ -0,0 +1,566 @@
+#include "HiZ.h"
+#include "GpuMemory.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SHADERS
+
+// a triangle covering the viewport, from the vertex index alone
+static const char* fullscreenVertexSource = "#version 330 core\n"
+    "void main()\n"
+    "{\n"
+    "   vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "   gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\0";
+
+// every destination texel takes the farthest of the 2x2 source texels under it. an odd source size leaves a last row
+// or column no 2x2 block reaches, the last destination texel takes it in as well
+static const char* reduceFragmentSource = "#version 330 core\n"
+    "uniform sampler2D source;\n"
+    "out vec4 farthest;\n"
+    "void main()\n"
+    "{\n"
+    "   ivec2 size = textureSize(source, 0);\n"
+    "   ivec2 last = size - 1;\n"
+    "   ivec2 base = ivec2(gl_FragCoord.xy) * 2;\n"
+    "   int spanX = base.x + 3 == size.x ? 3 : 2;\n"
+    "   int spanY = base.y + 3 == size.y ? 3 : 2;\n"
+    "   float depth = 0.0;\n"
+    "   for (int y = 0; y < spanY; y++)\n"
+    "       for (int x = 0; x < spanX; x++)\n"
+    "           depth = max(depth, texelFetch(source, min(base + ivec2(x, y), last), 0).r);\n"
+    "   farthest = vec4(depth);\n"
+    "}\0";
+
+// the bounding box's screen rectangle picks the level where it covers at most 2x2 texels, the instance is hidden when
+// its nearest depth lies behind the farthest depth of all four. boxes reaching behind the camera always pass
+static const char* cullVertexSource = "#version 330 core\n"
+    "layout (location = 0) in mat4 aModel;\n"
+    "out mat4 culledModel;\n"
+    "uniform mat4 viewProjection;\n"
+    "uniform sampler2D pyramid;\n"
+    "uniform vec2 halfScreen;\n"
+    "uniform ivec2 pyramidSize;\n"
+    "uniform int levelCount;\n"
+    "uniform float radius;\n"
+    "uniform int testedCount;\n"
+    "void main()\n"
+    "{\n"
+    "   culledModel = aModel;\n"
+    "   if (gl_VertexID >= testedCount) return;\n"
+    "   vec3 center = aModel[3].xyz;\n"
+    "   vec3 low = vec3(1e30);\n"
+    "   vec3 high = vec3(-1e30);\n"
+    "   for (int i = 0; i < 8; i++) {\n"
+    "       vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);\n"
+    "       vec4 clip = viewProjection * vec4(corner, 1.0);\n"
+    "       if (clip.w <= 0.0) return;\n"
+    "       vec3 ndc = clip.xyz / clip.w;\n"
+    "       low = min(low, ndc);\n"
+    "       high = max(high, ndc);\n"
+    "   }\n"
+    "   if (any(greaterThan(low.xy, vec2(1.0))) || any(lessThan(high.xy, vec2(-1.0)))) return;\n"
+    "   vec2 texelLow = clamp(low.xy * 0.5 + 0.5, 0.0, 1.0) * halfScreen;\n"
+    "   vec2 texelHigh = clamp(high.xy * 0.5 + 0.5, 0.0, 1.0) * halfScreen;\n"
+    "   vec2 span = texelHigh - texelLow;\n"
+    "   int level = int(clamp(ceil(log2(max(max(span.x, span.y), 1.0))), 0.0, float(levelCount - 1)));\n"
+    "   ivec2 last = max(pyramidSize >> level, ivec2(1)) - 1;\n"
+    "   ivec2 a = min(ivec2(texelLow / exp2(float(level))), last);\n"
+    "   ivec2 b = min(ivec2(texelHigh / exp2(float(level))), last);\n"
+    "   float farthest = max(max(texelFetch(pyramid, a, level).r, texelFetch(pyramid, ivec2(b.x, a.y), level).r),\n"
+    "       max(texelFetch(pyramid, ivec2(a.x, b.y), level).r, texelFetch(pyramid, b, level).r));\n"
+    "   if (low.z * 0.5 + 0.5 > farthest) {\n"
+    "       culledModel = mat4(vec4(0.0), vec4(0.0), vec4(0.0), vec4(center, 1.0));\n" // every vertex on one point
+    "   }\n"
+    "}\0";
+
+static const char* countVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec4 aColumn;\n"
+    "out float occluded;\n"
+    "void main()\n"
+    "{\n"
+    "   occluded = aColumn == vec4(0.0) ? 1.0 : 0.0;\n"
+    "}\0";
+
+static const char* countGeometrySource = "#version 330 core\n"
+    "layout (points) in;\n"
+    "layout (points, max_vertices = 1) out;\n"
+    "in float occluded[];\n"
+    "void main()\n"
+    "{\n"
+    "   if (occluded[0] > 0.5) {\n"
+    "       gl_Position = vec4(0.0);\n"
+    "       EmitVertex();\n"
+    "   }\n"
+    "}\0";
+
+static const char* boxVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "uniform mat4 transform;\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = transform * vec4(aPos, 1.0);\n"
+    "}\0";
+
+static const char* boxFragmentSource = "#version 330 core\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "   FragColor = vec4(1.0);\n"
+    "}\0";
+
+static unsigned int compileStage(GLenum type, const char* source) {
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        printf("ERROR::HIZ::SHADER_COMPILATION_FAILED\n%s\n", infoLog);
+    }
+    return shader;
+}
+
+// geometry and fragment sources may be NULL, varying is captured by transform feedback when set
+static unsigned int linkProgram(const char* vertSource, const char* geomSource, const char* fragSource, const char* varying) {
+    unsigned int program = glCreateProgram();
+    const char* sources[3] = { vertSource, geomSource, fragSource };
+    const GLenum types[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+    unsigned int shaders[3] = { 0, 0, 0 };
+    for (int i = 0; i < 3; i++) {
+        if (sources[i] != NULL) {
+            shaders[i] = compileStage(types[i], sources[i]);
+            glAttachShader(program, shaders[i]);
+        }
+    }
+    if (varying != NULL) {
+        glTransformFeedbackVaryings(program, 1, &varying, GL_INTERLEAVED_ATTRIBS);
+    }
+    glLinkProgram(program);
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        printf("ERROR::HIZ::PROGRAM_LINKING_FAILED\n%s\n", infoLog);
+    }
+    for (int i = 0; i < 3; i++) {
+        if (shaders[i] != 0) glDeleteShader(shaders[i]);
+    }
+    return success ? program : 0;
+}
+
+// SETUP
+
+bool createHiZ(HiZ* hiz, unsigned int capacity, unsigned int objectCount) {
+    memset(hiz, 0, sizeof(HiZ));
+    hiz->supported = true;
+    hiz->capacity = capacity;
+    hiz->objectCount = objectCount;
+
+    hiz->reduceProgram = linkProgram(fullscreenVertexSource, NULL, reduceFragmentSource, NULL);
+    hiz->cullProgram = linkProgram(cullVertexSource, NULL, NULL, "culledModel");
+    hiz->countProgram = linkProgram(countVertexSource, countGeometrySource, NULL, NULL);
+    hiz->boxProgram = linkProgram(boxVertexSource, NULL, boxFragmentSource, NULL);
+    if (hiz->reduceProgram == 0 || hiz->cullProgram == 0 || hiz->countProgram == 0 || hiz->boxProgram == 0) {
+        destroyHiZ(hiz);
+        return false;
+    }
+    hiz->reduceSourceLoc = glGetUniformLocation(hiz->reduceProgram, "source");
+    hiz->cullViewProjectionLoc = glGetUniformLocation(hiz->cullProgram, "viewProjection");
+    hiz->cullHalfScreenLoc = glGetUniformLocation(hiz->cullProgram, "halfScreen");
+    hiz->cullPyramidSizeLoc = glGetUniformLocation(hiz->cullProgram, "pyramidSize");
+    hiz->cullLevelCountLoc = glGetUniformLocation(hiz->cullProgram, "levelCount");
+    hiz->cullRadiusLoc = glGetUniformLocation(hiz->cullProgram, "radius");
+    hiz->cullTestedCountLoc = glGetUniformLocation(hiz->cullProgram, "testedCount");
+    hiz->boxTransformLoc = glGetUniformLocation(hiz->boxProgram, "transform");
+    glUseProgram(hiz->reduceProgram);
+    glUniform1i(hiz->reduceSourceLoc, 0);
+    glUseProgram(hiz->cullProgram);
+    glUniform1i(glGetUniformLocation(hiz->cullProgram, "pyramid"), 0);
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &hiz->emptyVertexArray);
+    glGenFramebuffers(1, &hiz->depthFramebuffer);
+    glGenFramebuffers(1, &hiz->pyramidFramebuffer);
+
+    // the tested matrices, and a view of their first columns for the count
+    glGenBuffers(1, &hiz->culledBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, hiz->culledBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(mat4) * (capacity > 0 ? capacity : 1), NULL, GL_DYNAMIC_COPY);
+    trackGpuResource(GPU_BUFFER, hiz->culledBuffer, GPU_MEMORY_COMPUTE, sizeof(mat4) * (capacity > 0 ? capacity : 1));
+    glGenVertexArrays(1, &hiz->cullVertexArray);
+    glGenVertexArrays(1, &hiz->countVertexArray);
+    glBindVertexArray(hiz->countVertexArray);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)0);
+    glBindVertexArray(hiz->cullVertexArray);
+    for (unsigned int c = 0; c < 4; c++) {
+        glEnableVertexAttribArray(c);
+    }
+    glBindVertexArray(0);
+    glGenQueries(HIZ_READBACK_FRAMES, hiz->countQueries);
+
+    // unit box, -1 to 1 on every axis
+    static const float corners[] = {
+        -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   -1.0f, 1.0f, -1.0f,   1.0f, 1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   -1.0f, 1.0f,  1.0f,   1.0f, 1.0f,  1.0f,
+    };
+    static const unsigned char faces[] = {
+        0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,   0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5,
+    };
+    glGenVertexArrays(1, &hiz->boxVertexArray);
+    glGenBuffers(1, &hiz->boxVertexBuffer);
+    glGenBuffers(1, &hiz->boxIndexBuffer);
+    glBindVertexArray(hiz->boxVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, hiz->boxVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, hiz->boxIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+    trackGpuResource(GPU_BUFFER, hiz->boxVertexBuffer, GPU_MEMORY_GEOMETRY, sizeof(corners));
+    trackGpuResource(GPU_BUFFER, hiz->boxIndexBuffer, GPU_MEMORY_GEOMETRY, sizeof(faces));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (objectCount > 0) {
+        hiz->queries = (unsigned int*)malloc(sizeof(unsigned int) * objectCount);
+        hiz->queryIssued = (bool*)calloc(objectCount, sizeof(bool));
+        hiz->objectOccluded = (bool*)calloc(objectCount, sizeof(bool));
+        if (hiz->queries == NULL || hiz->queryIssued == NULL || hiz->objectOccluded == NULL) {
+            destroyHiZ(hiz);
+            return false;
+        }
+        glGenQueries(objectCount, hiz->queries);
+    }
+    return glGetError() == GL_NO_ERROR;
+}
+
+void destroyHiZ(HiZ* hiz) {
+    if (hiz->queries != NULL) {
+        glDeleteQueries(hiz->objectCount, hiz->queries);
+    }
+    free(hiz->queries);
+    free(hiz->queryIssued);
+    free(hiz->objectOccluded);
+    if (hiz->emptyVertexArray != 0) {
+        glDeleteQueries(HIZ_READBACK_FRAMES, hiz->countQueries);
+        glDeleteVertexArrays(1, &hiz->emptyVertexArray);
+        glDeleteVertexArrays(1, &hiz->cullVertexArray);
+        glDeleteVertexArrays(1, &hiz->countVertexArray);
+        glDeleteVertexArrays(1, &hiz->boxVertexArray);
+        releaseGpuResource(GPU_BUFFER, hiz->culledBuffer);
+        releaseGpuResource(GPU_BUFFER, hiz->boxVertexBuffer);
+        releaseGpuResource(GPU_BUFFER, hiz->boxIndexBuffer);
+        releaseGpuResource(GPU_TEXTURE, hiz->depthTexture);
+        releaseGpuResource(GPU_TEXTURE, hiz->pyramid);
+        glDeleteBuffers(1, &hiz->culledBuffer);
+        glDeleteBuffers(1, &hiz->boxVertexBuffer);
+        glDeleteBuffers(1, &hiz->boxIndexBuffer);
+        glDeleteFramebuffers(1, &hiz->depthFramebuffer);
+        glDeleteFramebuffers(1, &hiz->pyramidFramebuffer);
+        glDeleteTextures(1, &hiz->depthTexture);
+        glDeleteTextures(1, &hiz->pyramid);
+    }
+    glDeleteProgram(hiz->reduceProgram);
+    glDeleteProgram(hiz->cullProgram);
+    glDeleteProgram(hiz->countProgram);
+    glDeleteProgram(hiz->boxProgram);
+    memset(hiz, 0, sizeof(HiZ));
+}
+
+// PYRAMID
+
+// internal format of the framebuffer's depth buffer, 0 when it has none. a blit only copies depth between equal formats
+static unsigned int matchDepthFormat(unsigned int framebuffer) {
+    GLenum depth = framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+    GLenum stencil = framebuffer == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+    int type = GL_NONE, depthBits = 0, stencilBits = 0, componentType = GL_NONE;
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, depth, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+    if (type == GL_NONE) {
+        return 0;
+    }
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, depth, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthBits);
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, depth, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &componentType);
+    type = GL_NONE;
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, stencil, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+    if (type != GL_NONE) {
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, stencil, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+    }
+    if (depthBits == 0) {
+        return 0;
+    }
+    if (componentType == GL_FLOAT) {
+        return stencilBits > 0 ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+    }
+    if (stencilBits > 0) {
+        return GL_DEPTH24_STENCIL8;
+    }
+    return depthBits <= 16 ? GL_DEPTH_COMPONENT16 : (depthBits <= 24 ? GL_DEPTH_COMPONENT24 : GL_DEPTH_COMPONENT32);
+}
+
+static void allocatePyramid(HiZ* hiz, unsigned int width, unsigned int height, unsigned int depthFormat) {
+    releaseGpuResource(GPU_TEXTURE, hiz->depthTexture);
+    releaseGpuResource(GPU_TEXTURE, hiz->pyramid);
+    glDeleteTextures(1, &hiz->depthTexture);
+    glDeleteTextures(1, &hiz->pyramid);
+    hiz->width = width;
+    hiz->height = height;
+    hiz->depthFormat = depthFormat;
+    hiz->ready = false;
+
+    bool stencil = depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8;
+    GLenum format = stencil ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT;
+    GLenum type = depthFormat == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8
+        : (depthFormat == GL_DEPTH32F_STENCIL8 ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_FLOAT);
+    glGenTextures(1, &hiz->depthTexture);
+    glBindTexture(GL_TEXTURE_2D, hiz->depthTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    glTexImage2D(GL_TEXTURE_2D, 0, depthFormat, width, height, 0, format, type, NULL);
+    int depthBytes = depthFormat == GL_DEPTH_COMPONENT16 ? 2 : (depthFormat == GL_DEPTH32F_STENCIL8 ? 8 : 4);
+    trackGpuResource(GPU_TEXTURE, hiz->depthTexture, GPU_MEMORY_TARGETS, getTextureBytes(width, height, depthBytes, false));
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hiz->depthFramebuffer);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, hiz->depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+
+    hiz->pyramidWidth = width / 2 > 0 ? width / 2 : 1;
+    hiz->pyramidHeight = height / 2 > 0 ? height / 2 : 1;
+    unsigned int largest = hiz->pyramidWidth > hiz->pyramidHeight ? hiz->pyramidWidth : hiz->pyramidHeight;
+    hiz->levelCount = 1;
+    while ((largest >> hiz->levelCount) > 0 && hiz->levelCount < HIZ_MAX_LEVELS) {
+        hiz->levelCount++;
+    }
+    glGenTextures(1, &hiz->pyramid);
+    glBindTexture(GL_TEXTURE_2D, hiz->pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    size_t pyramidBytes = 0;
+    for (unsigned int level = 0; level < hiz->levelCount; level++) {
+        unsigned int levelWidth = hiz->pyramidWidth >> level, levelHeight = hiz->pyramidHeight >> level;
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelWidth > 0 ? levelWidth : 1, levelHeight > 0 ? levelHeight : 1, 0, GL_RED, GL_FLOAT, NULL);
+        pyramidBytes += getTextureBytes(levelWidth > 0 ? levelWidth : 1, levelHeight > 0 ? levelHeight : 1, sizeof(float), false);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hiz->levelCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    trackGpuResource(GPU_TEXTURE, hiz->pyramid, GPU_MEMORY_TARGETS, pyramidBytes);
+}
+
+void buildHiZ(HiZ* hiz, unsigned int width, unsigned int height) {
+    if (!hiz->supported || width == 0 || height == 0) {
+        return;
+    }
+    int framebuffer = 0;
+    int viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+
+    if (width != hiz->width || height != hiz->height || hiz->depthTexture == 0) {
+        int samples = 0;
+        glGetIntegerv(GL_SAMPLE_BUFFERS, &samples);
+        unsigned int depthFormat = matchDepthFormat(framebuffer);
+        if (depthFormat == 0 || samples > 0) {
+            printf("ERROR::HIZ::DEPTH_BUFFER_NOT_COPYABLE\n");
+            hiz->supported = false;
+            return;
+        }
+        allocatePyramid(hiz, width, height, depthFormat);
+    }
+
+    // copy the depth buffer out, it cannot be sampled where it is. errors still pending came from earlier calls, they
+    // are reported as such rather than blamed on the copy
+    unsigned int error;
+    while ((error = glGetError()) != GL_NO_ERROR) {
+        printf("ERROR::HIZ::EARLIER_GL_ERROR 0x%x\n", error);
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hiz->depthFramebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    error = glGetError();
+    if (error != GL_NO_ERROR) {
+        printf("ERROR::HIZ::DEPTH_COPY_FAILED 0x%x\n", error);
+        hiz->supported = false;
+        hiz->ready = false;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        return;
+    }
+
+    // each level from the one before. only that one is left samplable, as the texture's level 0, so the level being
+    // written is never read
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(hiz->reduceProgram);
+    glBindVertexArray(hiz->emptyVertexArray);
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hiz->pyramidFramebuffer);
+    for (unsigned int level = 0; level < hiz->levelCount; level++) {
+        unsigned int levelWidth = hiz->pyramidWidth >> level, levelHeight = hiz->pyramidHeight >> level;
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hiz->pyramid, level);
+        glViewport(0, 0, levelWidth > 0 ? levelWidth : 1, levelHeight > 0 ? levelHeight : 1);
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, hiz->depthTexture);
+        }
+        else {
+            glBindTexture(GL_TEXTURE_2D, hiz->pyramid);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBindTexture(GL_TEXTURE_2D, hiz->pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hiz->levelCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glEnable(GL_DEPTH_TEST);
+    hiz->ready = true;
+}
+
+// INSTANCES
+
+unsigned int cullInstancesHiZ(HiZ* hiz, unsigned int buffer, size_t offset, unsigned int count, unsigned int testedCount,
+    float radius, mat4 viewProjection) {
+    // the count issued HIZ_READBACK_FRAMES frames ago is long finished
+    unsigned int slot = hiz->frame % HIZ_READBACK_FRAMES;
+    hiz->frame++;
+    if (hiz->countPending[slot]) {
+        int available = 0;
+        glGetQueryObjectiv(hiz->countQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            unsigned int occluded = 0;
+            glGetQueryObjectuiv(hiz->countQueries[slot], GL_QUERY_RESULT, &occluded);
+            hiz->occludedInstances = occluded;
+        }
+        hiz->countPending[slot] = false;
+    }
+    if (!hiz->supported || !hiz->ready || count == 0 || count > hiz->capacity) {
+        hiz->occludedInstances = 0;
+        return 0;
+    }
+
+    glUseProgram(hiz->cullProgram);
+    glUniformMatrix4fv(hiz->cullViewProjectionLoc, 1, GL_FALSE, (const GLfloat*)viewProjection);
+    glUniform2f(hiz->cullHalfScreenLoc, (float)hiz->width * 0.5f, (float)hiz->height * 0.5f);
+    glUniform2i(hiz->cullPyramidSizeLoc, (int)hiz->pyramidWidth, (int)hiz->pyramidHeight);
+    glUniform1i(hiz->cullLevelCountLoc, (int)hiz->levelCount);
+    glUniform1f(hiz->cullRadiusLoc, radius);
+    glUniform1i(hiz->cullTestedCountLoc, (int)testedCount);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hiz->pyramid);
+    glBindVertexArray(hiz->cullVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (unsigned int c = 0; c < 4; c++) {
+        glVertexAttribPointer(c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(offset + c * sizeof(vec4)));
+    }
+
+    // one point per instance, nothing reaches the rasterizer
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, hiz->culledBuffer, 0, sizeof(mat4) * count);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, count);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+    if (testedCount > 0) {
+        glUseProgram(hiz->countProgram);
+        glBindVertexArray(hiz->countVertexArray);
+        glBeginQuery(GL_PRIMITIVES_GENERATED, hiz->countQueries[slot]);
+        glDrawArrays(GL_POINTS, 0, testedCount);
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        hiz->countPending[slot] = true;
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    return hiz->culledBuffer;
+}
+
+// OBJECTS
+
+void beginOcclusionQueries(HiZ* hiz, mat4 viewProjection, vec3 cameraPos, float nearPlane) {
+    glm_mat4_copy(viewProjection, hiz->queryViewProjection);
+    glm_vec3_copy(cameraPos, hiz->queryCameraPos);
+    hiz->queryMargin = nearPlane * 2.0f;
+    // the boxes only test against the depth, they leave no trace
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glUseProgram(hiz->boxProgram);
+    glBindVertexArray(hiz->boxVertexArray);
+}
+
+void queryObjectOcclusion(HiZ* hiz, unsigned int object, const AABB* box) {
+    if (object >= hiz->objectCount) {
+        return;
+    }
+    bool inside = true;
+    for (int axis = 0; axis < 3; axis++) {
+        float position = hiz->queryCameraPos[axis];
+        if (position < box->min[axis] - hiz->queryMargin || position > box->max[axis] + hiz->queryMargin) {
+            inside = false;
+        }
+    }
+    if (inside) {
+        hiz->queryIssued[object] = false;
+        hiz->objectOccluded[object] = false;
+        return;
+    }
+
+    vec3 center, halfSize;
+    glm_vec3_add((float*)box->min, (float*)box->max, center);
+    glm_vec3_scale(center, 0.5f, center);
+    glm_vec3_sub((float*)box->max, (float*)box->min, halfSize);
+    glm_vec3_scale(halfSize, 0.5f, halfSize);
+    mat4 transform;
+    glm_mat4_copy(hiz->queryViewProjection, transform);
+    glm_translate(transform, center);
+    glm_scale(transform, halfSize);
+    glUniformMatrix4fv(hiz->boxTransformLoc, 1, GL_FALSE, (const GLfloat*)transform);
+
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, hiz->queries[object]);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    hiz->queryIssued[object] = true;
+}
+
+void endOcclusionQueries() {
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+unsigned int objectOcclusionQuery(HiZ* hiz, unsigned int object) {
+    if (object >= hiz->objectCount || !hiz->queryIssued[object]) {
+        return 0;
+    }
+    // only for the stats, conditional rendering waits for nothing either
+    int available = 0;
+    glGetQueryObjectiv(hiz->queries[object], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+        unsigned int passed = 0;
+        glGetQueryObjectuiv(hiz->queries[object], GL_QUERY_RESULT, &passed);
+        hiz->objectOccluded[object] = passed == 0;
+    }
+    return hiz->queries[object];
+}
+
+unsigned int countOccludedObjects(HiZ* hiz) {
+    unsigned int occluded = 0;
+    for (unsigned int i = 0; i < hiz->objectCount; i++) {
+        if (hiz->queryIssued[i] && hiz->objectOccluded[i]) occluded++;
+    }
+    return occluded;
+}
@@ -0,0 +1,91 @@
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <cglm/cglm.h>
+#include "Culling.h"
+
+// HIERARCHICAL-Z OCCLUSION CULLING: THE FINISHED FRAME'S DEPTH IS REDUCED INTO A MIP PYRAMID OF FARTHEST DEPTHS AND THE
+// NEXT FRAME TESTS INSTANCE BOUNDS AGAINST IT. GL 3.3 HAS NO COMPUTE SHADERS, SO THE TEST IS A TRANSFORM FEEDBACK PASS
+// OVER THE INSTANCE MATRICES THAT WRITES THEM BACK OUT WITH THE OCCLUDED ONES COLLAPSED TO A POINT. OBJECTS DRAWN ONE
+// AT A TIME USE GL_ANY_SAMPLES_PASSED QUERIES ON THEIR BOUNDING BOX AND CONDITIONAL RENDERING INSTEAD
+
+#define HIZ_READBACK_FRAMES 3 // occluded counts are read back this many frames later, never stalling
+#define HIZ_MAX_LEVELS 16
+
+typedef struct HiZ {
+    bool supported; // false after the depth buffer could not be copied, every test then passes
+    bool ready; // a pyramid from an earlier frame exists
+    unsigned int width; // of the framebuffer the pyramid is built from
+    unsigned int height;
+    unsigned int depthFormat; // internal format matching the depth buffer, a blit needs them equal
+    unsigned int depthTexture;
+    unsigned int depthFramebuffer;
+    unsigned int pyramid; // GL_R32F, level 0 at half resolution
+    unsigned int pyramidWidth;
+    unsigned int pyramidHeight;
+    unsigned int levelCount;
+    unsigned int pyramidFramebuffer;
+    unsigned int emptyVertexArray; // the fullscreen triangle comes from gl_VertexID
+    unsigned int reduceProgram;
+    int reduceSourceLoc;
+    // instance test
+    unsigned int cullProgram;
+    int cullViewProjectionLoc;
+    int cullHalfScreenLoc;
+    int cullPyramidSizeLoc;
+    int cullLevelCountLoc;
+    int cullRadiusLoc;
+    int cullTestedCountLoc;
+    unsigned int cullVertexArray;
+    unsigned int culledBuffer; // the instance matrices after the test, what the draws read
+    unsigned int capacity; // instances
+    // a geometry shader passes on only the collapsed matrices, the points it emits are the occluded count
+    unsigned int countProgram;
+    int countTestedCountLoc;
+    unsigned int countVertexArray;
+    unsigned int countQueries[HIZ_READBACK_FRAMES]; // GL_PRIMITIVES_GENERATED
+    bool countPending[HIZ_READBACK_FRAMES];
+    unsigned int frame;
+    unsigned int occludedInstances; // from the newest count read back
+    // per-object queries
+    unsigned int boxProgram;
+    int boxTransformLoc;
+    unsigned int boxVertexArray;
+    unsigned int boxVertexBuffer;
+    unsigned int boxIndexBuffer;
+    mat4 queryViewProjection; // between beginOcclusionQueries and endOcclusionQueries
+    vec3 queryCameraPos;
+    float queryMargin;
+    unsigned int* queries;
+    bool* queryIssued; // the query holds a result for the object's current box
+    bool* objectOccluded; // newest result read back
+    unsigned int objectCount;
+} HiZ;
+
+// capacity instances can be tested per frame, objectCount objects get a query each
+bool createHiZ(HiZ* hiz, unsigned int capacity, unsigned int objectCount);
+void destroyHiZ(HiZ* hiz);
+
+// copies the bound draw framebuffer's depth and reduces it, after the frame's last depth write
+void buildHiZ(HiZ* hiz, unsigned int width, unsigned int height);
+
+// tests the first testedCount of count mat4 instances at offset in buffer, each bounded by a sphere of radius around
+// its translation, the rest pass through. returns the buffer holding the count tested matrices at offset 0, or 0 when
+// there is no pyramid yet and the caller should draw from its own buffer
+unsigned int cullInstancesHiZ(HiZ* hiz, unsigned int buffer, size_t offset, unsigned int count, unsigned int testedCount,
+    float radius, mat4 viewProjection);
+
+// draws bounding boxes into per-object queries against the finished frame's depth. nearPlane keeps boxes the camera
+// is inside or nearly so out of it, their front faces would be clipped and the query fail however visible they are
+void beginOcclusionQueries(HiZ* hiz, mat4 viewProjection, vec3 cameraPos, float nearPlane);
+void queryObjectOcclusion(HiZ* hiz, unsigned int object, const AABB* box);
+void endOcclusionQueries(); // restores the color and depth writes the boxes turned off
+// the query to render the object conditionally on, 0 to draw it unconditionally
+unsigned int objectOcclusionQuery(HiZ* hiz, unsigned int object);
+// objects whose newest query result said no sample passed
+unsigned int countOccludedObjects(HiZ* hiz);
+
+#endif
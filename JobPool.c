@@ -0,0 +1,203 @@
+#include "JobPool.h"
+#include <stdlib.h>
+
+#define MAX_RANGES 256
+
+typedef struct RangeJob {
+    RangeFunction function;
+    void* data;
+    unsigned int begin;
+    unsigned int end;
+    AtomicInt* remaining;
+} RangeJob;
+
+static bool initQueue(JobQueue* queue, unsigned int capacity) {
+    queue->jobs = (Job*)malloc(sizeof(Job) * capacity);
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    return queue->jobs != NULL;
+}
+
+// caller must hold the pool mutex
+static bool pushJob(JobQueue* queue, JobFunction function, void* data) {
+    if (queue->count == queue->capacity) {
+        unsigned int newCapacity = queue->capacity * 2;
+        Job* jobs = (Job*)malloc(sizeof(Job) * newCapacity);
+        if (jobs == NULL) {
+            return false;
+        }
+        for (unsigned int i = 0; i < queue->count; i++) {
+            jobs[i] = queue->jobs[(queue->head + i) % queue->capacity];
+        }
+        free(queue->jobs);
+        queue->jobs = jobs;
+        queue->capacity = newCapacity;
+        queue->head = 0;
+    }
+    Job* job = &queue->jobs[(queue->head + queue->count) % queue->capacity];
+    job->function = function;
+    job->data = data;
+    queue->count++;
+    return true;
+}
+
+// caller must hold the pool mutex
+static bool popJob(JobQueue* queue, Job* job) {
+    if (queue->count == 0) {
+        return false;
+    }
+    *job = queue->jobs[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    return true;
+}
+
+static int workerMain(void* arg) {
+    JobPool* pool = (JobPool*)arg;
+    lockMutex(&pool->mutex);
+    while (true) {
+        Job job;
+        while (!pool->stopping && !popJob(&pool->ranges, &job) && !popJob(&pool->background, &job)) {
+            waitCondition(&pool->jobAvailable, &pool->mutex);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        unlockMutex(&pool->mutex);
+        job.function(job.data);
+        lockMutex(&pool->mutex);
+        broadcastCondition(&pool->jobFinished);
+    }
+    unlockMutex(&pool->mutex);
+    return 0;
+}
+
+bool createJobPool(JobPool* pool, unsigned int workerCount) {
+    if (workerCount == 0) {
+        unsigned int cores = getProcessorCount();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    pool->stopping = false;
+    pool->workers = (Thread*)malloc(sizeof(Thread) * workerCount);
+    pool->workerCount = 0;
+    bool rangesOk = initQueue(&pool->ranges, 64);
+    bool backgroundOk = initQueue(&pool->background, 64);
+    if (!rangesOk || !backgroundOk || pool->workers == NULL) {
+        free(pool->ranges.jobs);
+        free(pool->background.jobs);
+        free(pool->workers);
+        return false;
+    }
+
+    initMutex(&pool->mutex);
+    initCondition(&pool->jobAvailable);
+    initCondition(&pool->jobFinished);
+
+    for (unsigned int i = 0; i < workerCount; i++) {
+        if (!createThread(&pool->workers[i], workerMain, pool)) {
+            break;
+        }
+        pool->workerCount++;
+    }
+    if (pool->workerCount == 0) {
+        // nothing to join, this only releases the queues and the sync objects
+        destroyJobPool(pool);
+        return false;
+    }
+    return true;
+}
+
+void destroyJobPool(JobPool* pool) {
+    lockMutex(&pool->mutex);
+    pool->stopping = true;
+    broadcastCondition(&pool->jobAvailable);
+    unlockMutex(&pool->mutex);
+
+    for (unsigned int i = 0; i < pool->workerCount; i++) {
+        joinThread(&pool->workers[i]);
+    }
+
+    destroyCondition(&pool->jobAvailable);
+    destroyCondition(&pool->jobFinished);
+    destroyMutex(&pool->mutex);
+    free(pool->workers);
+    free(pool->ranges.jobs);
+    free(pool->background.jobs);
+    pool->workers = NULL;
+    pool->ranges.jobs = NULL;
+    pool->background.jobs = NULL;
+    pool->workerCount = 0;
+}
+
+static void runRangeJob(void* data) {
+    RangeJob* range = (RangeJob*)data;
+    range->function(range->data, range->begin, range->end);
+    atomicAdd(range->remaining, -1);
+}
+
+void parallelFor(JobPool* pool, unsigned int count, unsigned int minRange, RangeFunction function, void* data) {
+    if (count == 0) {
+        return;
+    }
+    if (minRange == 0) {
+        minRange = 1;
+    }
+
+    // a few ranges per thread so uneven ranges still balance out
+    unsigned int rangeCount = pool != NULL ? (pool->workerCount + 1) * 4 : 1;
+    unsigned int maxRanges = count / minRange;
+    if (rangeCount > maxRanges) rangeCount = maxRanges;
+    if (rangeCount > MAX_RANGES) rangeCount = MAX_RANGES;
+    if (rangeCount <= 1) {
+        function(data, 0, count);
+        return;
+    }
+
+    RangeJob ranges[MAX_RANGES];
+    AtomicInt remaining = (long)rangeCount;
+    // the first count % rangeCount ranges take one item more, none is ever empty or below minRange
+    unsigned int rangeSize = count / rangeCount;
+    unsigned int remainder = count % rangeCount;
+
+    lockMutex(&pool->mutex);
+    for (unsigned int i = 0; i < rangeCount; i++) {
+        ranges[i].function = function;
+        ranges[i].data = data;
+        ranges[i].begin = i * rangeSize + (i < remainder ? i : remainder);
+        ranges[i].end = ranges[i].begin + rangeSize + (i < remainder ? 1 : 0);
+        ranges[i].remaining = &remaining;
+        if (!pushJob(&pool->ranges, runRangeJob, &ranges[i])) {
+            // out of queue memory, do this range inline instead
+            unlockMutex(&pool->mutex);
+            runRangeJob(&ranges[i]);
+            lockMutex(&pool->mutex);
+        }
+    }
+    broadcastCondition(&pool->jobAvailable);
+
+    // help out until every range has finished, then wait for stragglers on other threads
+    while (atomicLoad(&remaining) > 0) {
+        Job job;
+        if (popJob(&pool->ranges, &job)) {
+            unlockMutex(&pool->mutex);
+            job.function(job.data);
+            lockMutex(&pool->mutex);
+        }
+        else {
+            waitCondition(&pool->jobFinished, &pool->mutex);
+        }
+    }
+    unlockMutex(&pool->mutex);
+}
+
+bool submitJob(JobPool* pool, JobFunction function, void* data) {
+    lockMutex(&pool->mutex);
+    bool queued = pushJob(&pool->background, function, data);
+    if (queued) {
+        signalCondition(&pool->jobAvailable);
+    }
+    unlockMutex(&pool->mutex);
+    return queued;
+}
@@ -0,0 +1,46 @@
+#ifndef JOBPOOL_H
+#define JOBPOOL_H
+
+#include "Platform.h"
+
+typedef void (*JobFunction)(void* data);
+typedef void (*RangeFunction)(void* data, unsigned int begin, unsigned int end);
+
+typedef struct Job {
+    JobFunction function;
+    void* data;
+} Job;
+
+// growable FIFO ring buffer
+typedef struct JobQueue {
+    Job* jobs;
+    unsigned int capacity;
+    unsigned int head;
+    unsigned int count;
+} JobQueue;
+
+// fixed set of worker threads; parallelFor ranges always run before background jobs, and a thread
+// waiting in parallelFor only helps with ranges so it never gets stuck inside a long background job
+typedef struct JobPool {
+    Thread* workers;
+    unsigned int workerCount;
+    Mutex mutex;
+    Condition jobAvailable;
+    Condition jobFinished;
+    JobQueue ranges;
+    JobQueue background;
+    bool stopping;
+} JobPool;
+
+// workerCount 0 uses one worker per core, minus the calling thread
+bool createJobPool(JobPool* pool, unsigned int workerCount);
+void destroyJobPool(JobPool* pool);
+
+// split [0, count) into ranges of at least minRange items and run them on the pool,
+// the calling thread works on ranges too and returns once all of them are done
+void parallelFor(JobPool* pool, unsigned int count, unsigned int minRange, RangeFunction function, void* data);
+
+// queue a fire-and-forget job (file loads, decoding, ...), returns false if it could not be queued
+bool submitJob(JobPool* pool, JobFunction function, void* data);
+
+#endif
@@ -0,0 +1,448 @@
+#include "Lighting.h"
+#include "Platform.h"
+#include "GpuMemory.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+// the clusters of one workgroup take the lights 64 at a time through shared memory, each light is read once per group
+static const char* assignComputeSource = "#version 430 core\n"
+    "layout (local_size_x = 64) in;\n"
+    "const int tilesX = " TO_STRING(CLUSTER_TILES_X) ";\n"
+    "const int tilesY = " TO_STRING(CLUSTER_TILES_Y) ";\n"
+    "const int slices = " TO_STRING(CLUSTER_SLICES) ";\n"
+    "const int maxLights = " TO_STRING(CLUSTER_MAX_LIGHTS) ";\n"
+    "const int clusterCount = tilesX * tilesY * slices;\n"
+    "layout (std430, binding = 0) readonly buffer Lights { vec4 lightData[]; };\n" // view space center and radius, color
+    "layout (std430, binding = 1) writeonly buffer Clusters { uint clusterData[]; };\n"
+    "layout (std430, binding = 2) buffer Counts { uint assigned; uint dropped; uint occupied; };\n"
+    "uniform int lightCount;\n"
+    "uniform bool countLights;\n"
+    "uniform vec4 frustum;\n" // tan(fov / 2) * aspect, tan(fov / 2), near, far
+    "shared vec4 lights[64];\n"
+    "void main()\n"
+    "{\n"
+    "   int cluster = int(gl_GlobalInvocationID.x);\n"
+    "   int x = cluster % tilesX;\n"
+    "   int y = (cluster / tilesX) % tilesY;\n"
+    "   int z = cluster / (tilesX * tilesY);\n"
+    "   float near = frustum.z * pow(frustum.w / frustum.z, float(z) / float(slices));\n"
+    "   float far = frustum.z * pow(frustum.w / frustum.z, float(z + 1) / float(slices));\n"
+    "   vec2 ndcLow = vec2(x, y) / vec2(tilesX, tilesY) * 2.0 - 1.0;\n"
+    "   vec2 ndcHigh = vec2(x + 1, y + 1) / vec2(tilesX, tilesY) * 2.0 - 1.0;\n"
+    "   vec3 low = vec3(min(ndcLow * near, ndcLow * far) * frustum.xy, -far);\n"
+    "   vec3 high = vec3(max(ndcHigh * near, ndcHigh * far) * frustum.xy, -near);\n"
+    "   int count = 0;\n"
+    "   for (int base = 0; base < lightCount; base += 64) {\n"
+    "       int i = base + int(gl_LocalInvocationIndex);\n"
+    "       lights[gl_LocalInvocationIndex] = i < lightCount ? lightData[2 * i] : vec4(0.0);\n"
+    "       barrier();\n"
+    "       int n = min(64, lightCount - base);\n"
+    "       for (int j = 0; j < n; j++) {\n"
+    "           vec3 offset = clamp(lights[j].xyz, low, high) - lights[j].xyz;\n"
+    "           if (dot(offset, offset) <= lights[j].w * lights[j].w && cluster < clusterCount) {\n"
+    "               if (count < maxLights) clusterData[2 * clusterCount + cluster * maxLights + count] = uint(base + j);\n"
+    "               count++;\n"
+    "           }\n"
+    "       }\n"
+    "       barrier();\n"
+    "   }\n"
+    "   if (cluster < clusterCount) {\n"
+    "       clusterData[2 * cluster] = uint(cluster * maxLights);\n"
+    "       clusterData[2 * cluster + 1] = uint(min(count, maxLights));\n"
+    "       if (countLights && count > 0) {\n"
+    "           atomicAdd(assigned, uint(min(count, maxLights)));\n"
+    "           atomicAdd(dropped, uint(max(count - maxLights, 0)));\n"
+    "           atomicAdd(occupied, 1u);\n"
+    "       }\n"
+    "   }\n"
+    "}\0";
+
+static unsigned int linkComputeProgram(const char* source) {
+    unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        printf("ERROR::LIGHTING::SHADER_COMPILATION_FAILED\n%s\n", infoLog);
+        glDeleteShader(shader);
+        return 0;
+    }
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        printf("ERROR::LIGHTING::PROGRAM_LINKING_FAILED\n%s\n", infoLog);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// SETUP
+
+bool createClusteredLights(ClusteredLights* lighting, unsigned int capacity, JobPool* workers, bool useCompute) {
+    memset(lighting, 0, sizeof(ClusteredLights));
+    lighting->capacity = capacity > 0 ? capacity : 1;
+    lighting->indexCapacity = CLUSTER_COUNT * CLUSTER_MAX_LIGHTS; // the same room the compute path has
+    lighting->workers = workers;
+    lighting->lights = (PointLight*)calloc(lighting->capacity, sizeof(PointLight));
+    lighting->viewLights = (vec4*)alignedAlloc(sizeof(vec4) * lighting->capacity, 16);
+    lighting->lightRanges = (unsigned char*)malloc((size_t)lighting->capacity * 6);
+    lighting->clusterMin = (vec3*)malloc(sizeof(vec3) * CLUSTER_COUNT);
+    lighting->clusterMax = (vec3*)malloc(sizeof(vec3) * CLUSTER_COUNT);
+    lighting->clusterCounts = (unsigned int*)malloc(sizeof(unsigned int) * CLUSTER_COUNT);
+    lighting->clusterOffsets = (unsigned int*)malloc(sizeof(unsigned int) * CLUSTER_COUNT);
+    if (lighting->lights == NULL || lighting->viewLights == NULL || lighting->lightRanges == NULL || lighting->clusterMin == NULL
+        || lighting->clusterMax == NULL || lighting->clusterCounts == NULL || lighting->clusterOffsets == NULL) {
+        destroyClusteredLights(lighting);
+        return false;
+    }
+    glGenTextures(1, &lighting->lightTexture);
+    glGenTextures(1, &lighting->indexTexture);
+
+    lighting->computeSupported = GLAD_GL_VERSION_4_3;
+    if (useCompute && lighting->computeSupported) {
+        lighting->computeProgram = linkComputeProgram(assignComputeSource);
+    }
+    if (lighting->computeProgram != 0) {
+        lighting->useCompute = true;
+        lighting->computeLightCountLoc = glGetUniformLocation(lighting->computeProgram, "lightCount");
+        lighting->computeFrustumLoc = glGetUniformLocation(lighting->computeProgram, "frustum");
+        lighting->computeCountLightsLoc = glGetUniformLocation(lighting->computeProgram, "countLights");
+        GLint alignment = 16;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        lighting->storageAlignment = alignment > 16 ? (size_t)alignment : 16;
+        glGenBuffers(1, &lighting->clusterBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, lighting->clusterBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(unsigned int) * ((size_t)2 * CLUSTER_COUNT + lighting->indexCapacity), NULL, GL_DYNAMIC_COPY);
+        trackGpuResource(GPU_BUFFER, lighting->clusterBuffer, GPU_MEMORY_COMPUTE,
+            sizeof(unsigned int) * ((size_t)2 * CLUSTER_COUNT + lighting->indexCapacity));
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glGenBuffers(1, &lighting->countBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lighting->countBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int) * 3, NULL, GL_DYNAMIC_READ);
+        trackGpuResource(GPU_BUFFER, lighting->countBuffer, GPU_MEMORY_COMPUTE, sizeof(unsigned int) * 3);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glGenTextures(1, &lighting->clusterTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, lighting->clusterTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, lighting->clusterBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    else if (useCompute) {
+        printf("ERROR::LIGHTING::NO_COMPUTE_SHADERS, assigning lights on the CPU\n");
+    }
+    return glGetError() == GL_NO_ERROR;
+}
+
+void destroyClusteredLights(ClusteredLights* lighting) {
+    free(lighting->lights);
+    alignedFree(lighting->viewLights);
+    free(lighting->lightRanges);
+    free(lighting->clusterMin);
+    free(lighting->clusterMax);
+    free(lighting->clusterCounts);
+    free(lighting->clusterOffsets);
+    if (lighting->lightTexture != 0) glDeleteTextures(1, &lighting->lightTexture);
+    if (lighting->indexTexture != 0) glDeleteTextures(1, &lighting->indexTexture);
+    if (lighting->clusterTexture != 0) glDeleteTextures(1, &lighting->clusterTexture);
+    if (lighting->clusterBuffer != 0) {
+        releaseGpuResource(GPU_BUFFER, lighting->clusterBuffer);
+        glDeleteBuffers(1, &lighting->clusterBuffer);
+    }
+    if (lighting->countBuffer != 0) {
+        releaseGpuResource(GPU_BUFFER, lighting->countBuffer);
+        glDeleteBuffers(1, &lighting->countBuffer);
+    }
+    if (lighting->computeProgram != 0) glDeleteProgram(lighting->computeProgram);
+    memset(lighting, 0, sizeof(ClusteredLights));
+}
+
+size_t getClusteredLightsFrameSize(const ClusteredLights* lighting) {
+    return LIGHT_BLOCK_SIZE + 2 * sizeof(vec4) * lighting->capacity
+        + sizeof(unsigned int) * ((size_t)2 * CLUSTER_COUNT + lighting->indexCapacity) + 3 * 256; // + alignment padding
+}
+
+bool attachClusteredLights(ClusteredLights* lighting, const StreamBuffer* stream) {
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (stream->size / sizeof(unsigned int) > (size_t)maxTexels) {
+        printf("ERROR::LIGHTING::STREAM_TOO_LARGE_FOR_BUFFER_TEXTURE %zu > %d texels\n", stream->size / sizeof(unsigned int), maxTexels);
+        return false;
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, lighting->lightTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, stream->buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, lighting->indexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, stream->buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return true;
+}
+
+// CLUSTER BOUNDS
+
+// view space boxes around every cluster, tiles split the screen evenly and slices split depth exponentially so
+// clusters keep roughly the same proportions all the way out
+static void buildClusterBounds(ClusteredLights* lighting, float fov, float aspect, float nearPlane, float farPlane) {
+    lighting->fov = fov;
+    lighting->aspect = aspect;
+    lighting->nearPlane = nearPlane;
+    lighting->farPlane = farPlane;
+    float tanY = tanf(fov * 0.5f);
+    float tanX = tanY * aspect;
+    for (unsigned int z = 0; z < CLUSTER_SLICES; z++) {
+        float near = nearPlane * powf(farPlane / nearPlane, (float)z / CLUSTER_SLICES);
+        float far = nearPlane * powf(farPlane / nearPlane, (float)(z + 1) / CLUSTER_SLICES);
+        for (unsigned int y = 0; y < CLUSTER_TILES_Y; y++) {
+            float lowY = (float)y / CLUSTER_TILES_Y * 2.0f - 1.0f;
+            float highY = (float)(y + 1) / CLUSTER_TILES_Y * 2.0f - 1.0f;
+            for (unsigned int x = 0; x < CLUSTER_TILES_X; x++) {
+                float lowX = (float)x / CLUSTER_TILES_X * 2.0f - 1.0f;
+                float highX = (float)(x + 1) / CLUSTER_TILES_X * 2.0f - 1.0f;
+                unsigned int cluster = x + CLUSTER_TILES_X * (y + CLUSTER_TILES_Y * z);
+                float* low = lighting->clusterMin[cluster];
+                float* high = lighting->clusterMax[cluster];
+                low[0] = fminf(lowX * near, lowX * far) * tanX;
+                low[1] = fminf(lowY * near, lowY * far) * tanY;
+                low[2] = -far;
+                high[0] = fmaxf(highX * near, highX * far) * tanX;
+                high[1] = fmaxf(highY * near, highY * far) * tanY;
+                high[2] = -near;
+            }
+        }
+    }
+}
+
+static bool sphereTouchesCluster(const ClusteredLights* lighting, const float* sphere, unsigned int cluster) {
+    const float* low = lighting->clusterMin[cluster];
+    const float* high = lighting->clusterMax[cluster];
+    float distanceSquared = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float closest = fminf(fmaxf(sphere[axis], low[axis]), high[axis]);
+        distanceSquared += (closest - sphere[axis]) * (closest - sphere[axis]);
+    }
+    return distanceSquared <= sphere[3] * sphere[3];
+}
+
+// CPU ASSIGNMENT
+
+typedef struct LightJob {
+    ClusteredLights* lighting;
+    mat4* view;
+    unsigned int* clusterData; // mapped, a first index and count per cluster followed by the indices
+} LightJob;
+
+static int clampCell(float value, int last) {
+    return value < 0.0f ? 0 : (value > (float)last ? last : (int)value);
+}
+
+// every light into view space, and the range of tiles and slices its bounding box can reach
+static void transformLights(void* data, unsigned int begin, unsigned int end) {
+    LightJob* job = (LightJob*)data;
+    ClusteredLights* lighting = job->lighting;
+    float near = lighting->nearPlane, far = lighting->farPlane;
+    float sliceScale = CLUSTER_SLICES / logf(far / near);
+    float tanY = tanf(lighting->fov * 0.5f);
+    float tanX = tanY * lighting->aspect;
+    for (unsigned int i = begin; i < end; i++) {
+        const PointLight* light = &lighting->lights[i];
+        float* sphere = lighting->viewLights[i];
+        unsigned char* range = &lighting->lightRanges[i * 6];
+        glm_mat4_mulv3(*job->view, (float*)light->position, 1.0f, sphere);
+        sphere[3] = light->radius;
+
+        float depth = -sphere[2], radius = light->radius;
+        range[4] = 1;
+        range[5] = 0;
+        if (radius <= 0.0f || depth + radius < near || depth - radius > far) {
+            continue;
+        }
+        float nearest = fmaxf(depth - radius, near), farthest = fminf(depth + radius, far);
+        // x / depth only grows or shrinks with depth, so the box's extremes are at its nearest or farthest depth
+        float lowX = fminf((sphere[0] - radius) / nearest, (sphere[0] - radius) / farthest) / tanX;
+        float highX = fmaxf((sphere[0] + radius) / nearest, (sphere[0] + radius) / farthest) / tanX;
+        float lowY = fminf((sphere[1] - radius) / nearest, (sphere[1] - radius) / farthest) / tanY;
+        float highY = fmaxf((sphere[1] + radius) / nearest, (sphere[1] + radius) / farthest) / tanY;
+        if (lowX > 1.0f || highX < -1.0f || lowY > 1.0f || highY < -1.0f) {
+            continue;
+        }
+        range[0] = (unsigned char)clampCell((lowX * 0.5f + 0.5f) * CLUSTER_TILES_X, CLUSTER_TILES_X - 1);
+        range[1] = (unsigned char)clampCell((highX * 0.5f + 0.5f) * CLUSTER_TILES_X, CLUSTER_TILES_X - 1);
+        range[2] = (unsigned char)clampCell((lowY * 0.5f + 0.5f) * CLUSTER_TILES_Y, CLUSTER_TILES_Y - 1);
+        range[3] = (unsigned char)clampCell((highY * 0.5f + 0.5f) * CLUSTER_TILES_Y, CLUSTER_TILES_Y - 1);
+        range[4] = (unsigned char)clampCell(logf(nearest / near) * sliceScale, CLUSTER_SLICES - 1);
+        range[5] = (unsigned char)clampCell(logf(farthest / near) * sliceScale, CLUSTER_SLICES - 1);
+    }
+}
+
+// one depth slice at a time, so no two ranges ever touch the same cluster. counts when clusterData is NULL,
+// otherwise writes each cluster's lights up to the count the scan left it, in light order
+static void assignSlices(void* data, unsigned int begin, unsigned int end) {
+    LightJob* job = (LightJob*)data;
+    ClusteredLights* lighting = job->lighting;
+    unsigned int* indices = job->clusterData != NULL ? job->clusterData + 2 * CLUSTER_COUNT : NULL;
+    for (unsigned int z = begin; z < end; z++) {
+        unsigned int sliceStart = z * CLUSTER_TILES_X * CLUSTER_TILES_Y;
+        unsigned int written[CLUSTER_TILES_X * CLUSTER_TILES_Y] = { 0 };
+        if (indices == NULL) {
+            memset(&lighting->clusterCounts[sliceStart], 0, sizeof(unsigned int) * CLUSTER_TILES_X * CLUSTER_TILES_Y);
+        }
+        for (unsigned int i = 0; i < lighting->lightCount; i++) {
+            const unsigned char* range = &lighting->lightRanges[i * 6];
+            if (z < range[4] || z > range[5]) continue;
+            for (unsigned int y = range[2]; y <= range[3]; y++) {
+                for (unsigned int x = range[0]; x <= range[1]; x++) {
+                    unsigned int tile = x + CLUSTER_TILES_X * y;
+                    unsigned int cluster = sliceStart + tile;
+                    if (!sphereTouchesCluster(lighting, lighting->viewLights[i], cluster)) continue;
+                    if (indices == NULL) {
+                        lighting->clusterCounts[cluster]++;
+                    }
+                    else if (written[tile] < lighting->clusterCounts[cluster]) {
+                        indices[lighting->clusterOffsets[cluster] + written[tile]++] = i;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// UPDATE
+
+bool updateClusteredLights(ClusteredLights* lighting, StreamBuffer* stream, mat4 view, float fov, float aspect,
+    float nearPlane, float farPlane, unsigned int width, unsigned int height, vec3 ambient) {
+    double start = getTimeSeconds();
+    if (fov != lighting->fov || aspect != lighting->aspect || nearPlane != lighting->nearPlane || farPlane != lighting->farPlane) {
+        buildClusterBounds(lighting, fov, aspect, nearPlane, farPlane);
+    }
+    unsigned int lightCount = lighting->lightCount < lighting->capacity ? lighting->lightCount : lighting->capacity;
+    lighting->lightCount = lightCount;
+    LightJob job = { lighting, (mat4*)view, NULL };
+    parallelFor(lighting->workers, lightCount, 256, transformLights, &job);
+
+    // view space lights, read by the fragments and by the compute pass
+    size_t lightOffset;
+    size_t lightAlignment = lighting->useCompute ? lighting->storageAlignment : sizeof(vec4);
+    size_t lightBytes = 2 * sizeof(vec4) * (lightCount > 0 ? lightCount : 1);
+    float* lightData = (float*)mapStream(stream, lightBytes, lightAlignment, &lightOffset);
+    if (lightData == NULL) {
+        return false;
+    }
+    for (unsigned int i = 0; i < lightCount; i++) {
+        const PointLight* light = &lighting->lights[i];
+        memcpy(&lightData[i * 8], lighting->viewLights[i], sizeof(vec4));
+        lightData[i * 8 + 4] = light->color[0];
+        lightData[i * 8 + 5] = light->color[1];
+        lightData[i * 8 + 6] = light->color[2];
+        lightData[i * 8 + 7] = light->intensity;
+    }
+    unmapStream(stream);
+
+    size_t clusterOffset = 0;
+    if (lighting->useCompute) {
+        if (lightCount > 0) glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, stream->buffer, lightOffset, lightBytes);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, lighting->clusterBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, lighting->countBuffer);
+        if (lighting->countOnGpu) {
+            const unsigned int zero[3] = { 0, 0, 0 };
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+        }
+        glUseProgram(lighting->computeProgram);
+        glUniform1i(lighting->computeLightCountLoc, (int)lightCount);
+        glUniform1i(lighting->computeCountLightsLoc, lighting->countOnGpu ? 1 : 0);
+        float tanY = tanf(fov * 0.5f);
+        glUniform4f(lighting->computeFrustumLoc, tanY * aspect, tanY, nearPlane, farPlane);
+        glDispatchCompute(CLUSTER_COUNT / 64 + (CLUSTER_COUNT % 64 != 0), 1, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        glUseProgram(0);
+        // known once readClusteredLightCounts fetches them
+        lighting->assignedIndices = lighting->droppedIndices = lighting->occupiedClusters = 0;
+    }
+    else {
+        parallelFor(lighting->workers, CLUSTER_SLICES, 1, assignSlices, &job);
+
+        // packed lists, when the lights do not fit the clusters at the end lose theirs
+        unsigned int total = 0, dropped = 0, occupied = 0;
+        for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+            unsigned int count = lighting->clusterCounts[cluster];
+            unsigned int room = lighting->indexCapacity - total;
+            if (count > room) {
+                dropped += count - room;
+                count = room;
+                lighting->clusterCounts[cluster] = count;
+            }
+            lighting->clusterOffsets[cluster] = total;
+            total += count;
+            occupied += count > 0;
+        }
+        lighting->assignedIndices = total;
+        lighting->droppedIndices = dropped;
+        lighting->occupiedClusters = occupied;
+
+        job.clusterData = (unsigned int*)mapStream(stream, sizeof(unsigned int) * ((size_t)2 * CLUSTER_COUNT + total),
+            sizeof(unsigned int), &clusterOffset);
+        if (job.clusterData == NULL) {
+            return false;
+        }
+        for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+            job.clusterData[2 * cluster] = lighting->clusterOffsets[cluster];
+            job.clusterData[2 * cluster + 1] = lighting->clusterCounts[cluster];
+        }
+        parallelFor(lighting->workers, CLUSTER_SLICES, 1, assignSlices, &job);
+        unmapStream(stream);
+    }
+
+    // tile from the pixel, slice from log depth: slice = log(depth) * slices / log(far / near) - slices * log(near) / log(far / near)
+    size_t blockOffset;
+    float* block = (float*)mapStream(stream, LIGHT_BLOCK_SIZE, stream->uniformAlignment, &blockOffset);
+    if (block == NULL) {
+        return false;
+    }
+    float logRange = logf(farPlane / nearPlane);
+    block[0] = (float)CLUSTER_TILES_X / (float)width;
+    block[1] = (float)CLUSTER_TILES_Y / (float)height;
+    block[2] = CLUSTER_SLICES / logRange;
+    block[3] = -CLUSTER_SLICES * logf(nearPlane) / logRange;
+    block[4] = ambient[0];
+    block[5] = ambient[1];
+    block[6] = ambient[2];
+    block[7] = 0.0f;
+    int* offsets = (int*)&block[8];
+    offsets[0] = (int)(lightOffset / sizeof(vec4)); // first light texel
+    offsets[1] = (int)(clusterOffset / sizeof(unsigned int)); // first cluster texel
+    offsets[2] = (int)lightCount;
+    offsets[3] = 0;
+    unmapStream(stream);
+    glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, stream->buffer, blockOffset, LIGHT_BLOCK_SIZE);
+
+    glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lighting->lightTexture);
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lighting->useCompute ? lighting->clusterTexture : lighting->indexTexture);
+    glActiveTexture(GL_TEXTURE0);
+    lighting->assignMs = (getTimeSeconds() - start) * 1000.0;
+    return true;
+}
+
+void readClusteredLightCounts(ClusteredLights* lighting) {
+    if (!lighting->useCompute || !lighting->countOnGpu) {
+        return;
+    }
+    unsigned int counts[3];
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lighting->countBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), counts);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    lighting->assignedIndices = counts[0];
+    lighting->droppedIndices = counts[1];
+    lighting->occupiedClusters = counts[2];
+}
@@ -0,0 +1,89 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <cglm/cglm.h>
+#include "JobPool.h"
+#include "StreamBuffer.h"
+
+// CLUSTERED FORWARD LIGHTING: THE VIEW FRUSTUM IS CUT INTO SCREEN TILES ACROSS AND EXPONENTIAL DEPTH SLICES DEEP, EVERY
+// FRAME EACH OF THOSE CLUSTERS GETS THE LIST OF POINT LIGHTS WHOSE RANGE REACHES INTO IT. A FRAGMENT FINDS ITS CLUSTER
+// FROM ITS SCREEN POSITION AND DEPTH AND ONLY EVALUATES THOSE LIGHTS
+
+#define CLUSTER_TILES_X 16 // stringified into the lit fragment shaders and the compute shader
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+#define CLUSTER_COUNT (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES)
+#define CLUSTER_MAX_LIGHTS 128 // the compute path gives every cluster a run of this many indices
+#define LIGHT_BLOCK_BINDING 2 // uniform buffer binding point, after Camera and Materials
+#define LIGHT_DATA_UNIT 2 // texture units of the two buffer textures the lit shaders read
+#define CLUSTER_DATA_UNIT 3
+
+// std140 layout of the Lights block: cluster scale, ambient color, texel offsets
+#define LIGHT_BLOCK_SIZE (3 * 4 * sizeof(float))
+
+typedef struct PointLight {
+    vec3 position; // world space
+    float radius; // the light falls off to exactly nothing here
+    vec3 color;
+    float intensity;
+} PointLight;
+
+typedef struct ClusteredLights {
+    unsigned int capacity;
+    unsigned int lightCount; // the first lightCount entries of lights are lit
+    PointLight* lights;
+    unsigned int indexCapacity; // light indices one frame can hold over all clusters
+    JobPool* workers; // NULL assigns on the calling thread
+    // view space cluster bounds, rebuilt when the projection changes
+    float fov;
+    float aspect;
+    float nearPlane;
+    float farPlane;
+    vec3* clusterMin;
+    vec3* clusterMax;
+    // CPU assignment
+    vec4* viewLights; // view space center and radius
+    unsigned char* lightRanges; // per light first and last tile x, tile y and slice, the slices empty when it is out of view
+    unsigned int* clusterCounts;
+    unsigned int* clusterOffsets;
+    // the lit shaders read lights and clusters as buffer textures over the stream buffer, or the compute output
+    unsigned int lightTexture; // GL_RGBA32F, two texels per light
+    unsigned int indexTexture; // GL_R32UI, a first index and count per cluster followed by the indices
+    // GL 4.3: one compute invocation per cluster tests every light, the CPU only uploads them
+    bool computeSupported;
+    bool useCompute;
+    size_t storageAlignment; // GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+    unsigned int computeProgram;
+    int computeLightCountLoc;
+    int computeFrustumLoc;
+    int computeCountLightsLoc;
+    unsigned int clusterBuffer; // written by the compute shader, laid out like the CPU path's cluster data
+    unsigned int clusterTexture; // GL_R32UI over clusterBuffer
+    unsigned int countBuffer; // the compute pass's assigned, dropped and occupied totals when countOnGpu is set
+    bool countOnGpu; // benchmarks only, reading the totals back waits for the pass
+    // last update, the compute path's only after readClusteredLightCounts
+    unsigned int assignedIndices; // light and cluster pairs
+    unsigned int droppedIndices; // pairs left out for lack of room
+    unsigned int occupiedClusters; // clusters with at least one light
+    double assignMs;
+} ClusteredLights;
+
+// capacity lights, useCompute assigns on the GPU when it can
+bool createClusteredLights(ClusteredLights* lighting, unsigned int capacity, JobPool* workers, bool useCompute);
+void destroyClusteredLights(ClusteredLights* lighting);
+// most bytes an update takes from a stream frame
+size_t getClusteredLightsFrameSize(const ClusteredLights* lighting);
+// points the buffer textures at the stream, false when it is larger than a buffer texture may be
+bool attachClusteredLights(ClusteredLights* lighting, const StreamBuffer* stream);
+
+// assigns the lights to the clusters of this projection, uploads lights and clusters through the stream and binds the
+// Lights block and both buffer textures for the draws that follow
+bool updateClusteredLights(ClusteredLights* lighting, StreamBuffer* stream, mat4 view, float fov, float aspect,
+    float nearPlane, float farPlane, unsigned int width, unsigned int height, vec3 ambient);
+// compute path with countOnGpu: waits for the last update's pass and fills in its counts, the CPU path has them already
+void readClusteredLightCounts(ClusteredLights* lighting);
+
+#endif
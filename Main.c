@@ -2,41 +2,196 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "stb/stb_image.h"
 #include <cglm/cglm.h>
+#include "Shader.h"
+#include "JobPool.h"
+#include "Transform.h"
+#include "Culling.h"
+#include "TextureStream.h"
+#include "RenderStats.h"
+#include "Headless.h"
+#include "Profiler.h"
+#include "StateCache.h"
+#include "RenderQueue.h"
+#include "MeshArena.h"
+#include "Simulation.h"
+#include "MeshCache.h"
+#include "VoxelWorld.h"
+#include "Material.h"
+#include "HiZ.h"
+#include "SceneGraph.h"
+#include "Lighting.h"
+#include "Replay.h"
+#include "Particles.h"
+#include "GpuMemory.h"
 
 typedef struct WindowData {
 	GLFWwindow* window;
 	int status;
 } WindowData;
 
+// everything the scene needs between frames, shared by the window loop and the headless benchmark
+typedef struct Renderer {
+    JobPool* workers;
+    Shader orangeShader;
+    Shader yellowShader;
+    Shader RGBShader;
+    Shader textureRGBShader;
+    Shader textureUVShader;
+    Shader textureTransformShader;
+    Shader modelShader;
+    Shader instancedModelShader;
+    Shader modelMaterialShader; // the two above sampling the material array instead of one texture
+    Shader instancedMaterialShader;
+    Shader modelLitShader; // the four above with clustered point lights
+    Shader instancedLitShader;
+    Shader modelMaterialLitShader;
+    Shader instancedMaterialLitShader;
+    MeshArena meshArena;
+    unsigned int cubeMesh;
+    unsigned int planeMesh;
+    StreamBuffer frameData; // camera block and per-instance model matrices, rewritten every frame
+    unsigned int* extraMeshes; // -meshes N distinct meshes, all drawn by one multi-draw
+    mat4* extraMeshModels;
+    vec3 extraMeshCenter;
+    MeshDrawList extraMeshDraws;
+    CachedMesh loadedMesh; // -mesh FILE, vertexArray 0 when there is none
+    unsigned int* loadedMeshLods; // level of detail each copy of it drew last frame
+    SceneGraph sceneGraph; // the plane and the model copies, the cubes all move every frame and stay in instanceTransforms
+    unsigned int planeNode;
+    unsigned int* loadedMeshNodes; // per copy a spinning pivot and the fitted model under it
+    VoxelWorld world; // -world R, chunks NULL when there is none
+    TransformBatch instanceTransforms;
+    TransformBatch visibleTransforms;
+    mat4* instanceModels;
+    BVH instanceBVH;
+    AABB sceneBounds;
+    unsigned int* visibleIndices;
+    TextureStreamer textureStreamer;
+    StreamedTexture* containerTexture;
+    unsigned int texture;
+    MaterialLibrary materials; // -materials N, texture 0 when there is none
+    HiZ hiz; // -occlusion, supported false when off
+    ClusteredLights lighting; // -lights N, capacity 0 when there are none
+    vec4* lightOrbits; // the point each light circles and its phase
+    ParticleSystem particles; // -particles N, capacity 0 when there are none
+    CullStats cullStats; // from the last renderFrame
+    RenderQueue renderQueue;
+    StateCache stateCache;
+} Renderer;
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int setUpShader(const char* vertSource, const char* fragSource);
 WindowData buildWindow();
 unsigned int setUpTexture();
+void parseArguments(int argc, char* argv[]);
+vec3* buildInstancePositions(vec3* basePositions, unsigned int baseCount, unsigned int count);
+void reportCullStats(GLFWwindow* window, const CullStats* stats, float currentFrame);
+bool setUpRenderer(Renderer* renderer, JobPool* workers);
+void renderFrame(Renderer* renderer, const SceneState* scene, unsigned int width, unsigned int height);
+void destroyRenderer(Renderer* renderer);
+void placeBenchmarkCamera(AABB* bounds, float time, SceneState* scene);
+void placeWorldCamera(const VoxelWorld* world, float time, SceneState* scene);
+void editWorld(VoxelWorld* world, const SceneState* scene);
+int runHeadlessBenchmark(JobPool* workers);
+void buildStandardVertexFormat(VertexFormat* format, bool packed);
+unsigned int addStandardMesh(MeshArena* arena, const float* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+bool buildExtraMeshes(Renderer* renderer);
+bool buildMaterials(Renderer* renderer);
+bool buildLights(Renderer* renderer);
+bool buildParticles(Renderer* renderer);
+int runLightBenchmark(JobPool* workers);
+int runReplay(JobPool* workers);
+unsigned int buildPrism(unsigned int sides, float radius, float height, vec3 color, float* vertices, unsigned int* indices, unsigned int* indexCount);
 
 // settings
-const unsigned int SCR_WIDTH = 800;
-const unsigned int SCR_HEIGHT = 600;
-
-// camera
-vec3 cameraPos = { 0.0f, 0.0f, 3.0f };
-vec3 cameraFront = { 0.0f, 0.0f, -1.0f };
+unsigned int SCR_WIDTH = 800; // set with -width W
+unsigned int SCR_HEIGHT = 600; // set with -height H
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+// instancing
+unsigned int instanceCount = 10; // number of cubes drawn by the instanced cube pass, set with -instances N
+float instanceSpacing = 3.0f; // distance between generated cubes, set with -spacing S
+
+// culling
+bool cullingEnabled = true; // -no-cull draws every instance
+bool printCullStats = false; // -cull-stats prints visible/culled counts every frame
+const float CUBE_BOUNDING_RADIUS = 0.8660254f; // half diagonal of a unit cube, bounds it at any rotation
+bool occlusionCullingEnabled = false; // -occlusion also drops what the last frame's depth buffer hides
+
+// textures
+bool synchronousTextures = false; // -sync-textures loads on the main thread with setUpTexture instead of streaming
+size_t textureUploadBudget = DEFAULT_UPLOAD_BUDGET; // -upload-budget KB caps texture bytes uploaded per frame
+bool textureCacheEnabled = true; // -no-texture-cache always decodes the source images
+size_t gpuMemoryBudget = 0; // -gpu-budget MB evicts least recently used streamed textures to stay under it, 0 only counts
+unsigned int materialCount = 0; // -materials N textures the cubes with N variations of the container in one array, still one draw
+
+// shaders
+bool shaderCacheEnabled = true; // -no-shader-cache always compiles from source
+
+// lighting
+unsigned int lightCount = 0; // -lights N lights the scene with N moving point lights through clustered shading, 0 leaves it unlit
+bool lightComputeEnabled = false; // -lights-compute assigns the lights to clusters in a compute shader when GL 4.3 is there
+const float LIGHT_AMBIENT = 0.2f;
+
+// particles
+unsigned int particleCount = 0; // -particles N sprays N particles from fountains on the plane, simulated and drawn on the GPU alone
+const unsigned int PARTICLE_FOUNTAINS = 4;
+const float PARTICLE_LIFETIME = 3.0f;
+
+// draw submission
+bool stateCacheEnabled = true; // -no-state-cache issues every bind, to count what the cache saves
+bool multiDrawEnabled = true; // -no-multi-draw uses one base-vertex draw per mesh even when indirect draws are available
+unsigned int extraMeshCount = 0; // -meshes N adds N distinct procedural meshes above the cube field
+bool persistentMappingEnabled = true; // -no-persistent-map streams per-frame data through orphaning and unsynchronized maps
+bool packedVertices = true; // -float-vertices keeps the 32 byte all-float vertex instead of the 16 byte packed one
+
+// meshes
+const char* meshPath = NULL; // -mesh FILE.obj draws a cooked model next to the plane, cooking it first if needed
+const char* cookMeshPath = NULL; // -cook-mesh FILE.obj writes FILE.obj.cmesh and exits, no window or GL needed
+unsigned int meshCopies = 1; // -mesh-copies N draws the model N times in rows going back from the plane
+float lodErrorPixels = 1.0f; // -lod-error PX, coarsest level that moves the surface less than this on screen, 0 keeps full detail
+
+// voxel world
+int worldRadius = 0; // -world R streams a block world R chunks around the camera, 0 leaves it out
+unsigned int worldEditsPerFrame = 0; // -world-edits N digs N blocks per frame where the camera looks
+const unsigned int WORLD_SEED = 1337;
+const float WORLD_FLIGHT_SPEED = 32.0f; // blocks per second the headless camera flies over the world
+
+// benchmarks
+bool runTransformBenchmark = false; // -bench-transforms: time the transform kernels and exit
+bool runSceneGraphBenchmark = false; // -bench-scene: time dirty scene graph updates against full rebuilds and exit
+bool runLightingBenchmark = false; // -bench-lights: render offscreen with 16 to 4096 clustered point lights and exit
+bool headlessMode = false; // -headless: render offscreen without a window, print frame time statistics and exit
+unsigned int benchmarkFrames = 600; // measured frames in headless mode, set with -frames N
+unsigned int warmupFrames = 60; // frames rendered before measuring, set with -warmup N
+const char* benchmarkOutput = NULL; // -json FILE writes the headless results there instead of stdout
+
+// capture and replay
+const char* capturePath = NULL; // -capture FILE logs the window session's input and frame times for -replay
+const char* replayPath = NULL; // -replay FILE renders a -capture log offscreen on its own clock, reports every frame and exits
+const char* replayStatsPath = NULL; // -replay-stats FILE writes the replay's per-frame timings and counters as CSV
+const char* replayBaselinePath = NULL; // -replay-baseline FILE compares the replay frame by frame with an earlier -replay-stats
+
+// profiling
+bool profilingEnabled = false; // -profile times every render pass, shown in the window title
+const char* tracePath = NULL; // -trace FILE captures frames as a Chrome trace, implies -profile
+unsigned int traceFrames = 300; // frames in the capture, set with -trace-frames N
+
+// camera, moved by the simulation thread, the callbacks only forward input to it
+Simulation simulation;
 vec3 cameraUp = { 0.0f, 1.0f, 0.0f };
 
 bool firstMouse = true;
-float yaw = -90.0f;	// yaw is initialized to -90.0 degrees since a yaw of 0.0 results in a direction vector pointing to the right so we initially rotate a bit to the left.
-float pitch = 0.0f;
 float lastX = 800.0f / 2.0;
 float lastY = 600.0 / 2.0;
-float fov = 45.0f;
-
-// timing
-float deltaTime = 0.0f;	// time between current frame and last frame
-float lastFrame = 0.0f;
 
 //shaders
 const char* vertexShaderSource = "#version 330 core\n" //vert // basic shader
@@ -75,17 +230,93 @@ const char* vertexShaderSource3 = "#version 330 core\n" // vert // projection sh
                                   "out vec3 vertexColor;\n"
                                   "out vec2 TexCoord;\n"
                                   "out vec3 vertexPos;\n"
+                                  "out vec3 viewPos;\n"
                                   "uniform mat4 model;\n"
-                                  "uniform mat4 view;\n"
-                                  "uniform mat4 projection;\n"
+                                  "layout (std140) uniform Camera {\n"
+                                  "   mat4 view;\n"
+                                  "   mat4 projection;\n"
+                                  "};\n"
                                   "void main()\n"
                                   "{\n"
                                   "   vertexColor = aColor; \n"
                                   "   vertexPos = aPos;\n"
                                   "   gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
+                                  "   viewPos = vec3(view * model * vec4(aPos, 1.0));\n"
                                   "   TexCoord = aTexCoord;\n"
                                   "}\n";
 
+const char* vertexShaderSource3Instanced = "#version 330 core\n" // vert // instanced projection shader
+                                           "layout (location = 0) in vec3 aPos;\n"
+                                           "layout (location = 1) in vec3 aColor;\n"
+                                           "layout (location = 2) in vec2 aTexCoord;\n"
+                                           "layout (location = 3) in mat4 aModel;\n" // per-instance, occupies locations 3-6
+                                           "out vec3 vertexColor;\n"
+                                           "out vec2 TexCoord;\n"
+                                           "out vec3 vertexPos;\n"
+                                           "out vec3 viewPos;\n"
+                                           "layout (std140) uniform Camera {\n"
+                                           "   mat4 view;\n"
+                                           "   mat4 projection;\n"
+                                           "};\n"
+                                           "void main()\n"
+                                           "{\n"
+                                           "   vertexColor = aColor; \n"
+                                           "   vertexPos = aPos;\n"
+                                           "   gl_Position = projection * view * aModel * vec4(aPos, 1.0);\n"
+                                           "   viewPos = vec3(view * aModel * vec4(aPos, 1.0));\n"
+                                           "   TexCoord = aTexCoord;\n"
+                                           "}\n";
+
+const char* vertexShaderSource3Material = "#version 330 core\n" // vert // projection shader with a material index
+                                          "layout (location = 0) in vec3 aPos;\n"
+                                          "layout (location = 1) in vec3 aColor;\n"
+                                          "layout (location = 2) in vec2 aTexCoord;\n"
+                                          "layout (location = 7) in float aMaterial;\n" // current value, set per draw
+                                          "out vec3 vertexColor;\n"
+                                          "out vec2 TexCoord;\n"
+                                          "out vec3 vertexPos;\n"
+                                          "flat out int material;\n"
+                                          "out vec3 viewPos;\n"
+                                          "uniform mat4 model;\n"
+                                          "layout (std140) uniform Camera {\n"
+                                          "   mat4 view;\n"
+                                          "   mat4 projection;\n"
+                                          "};\n"
+                                          "void main()\n"
+                                          "{\n"
+                                          "   vertexColor = aColor; \n"
+                                          "   vertexPos = aPos;\n"
+                                          "   gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
+                                          "   viewPos = vec3(view * model * vec4(aPos, 1.0));\n"
+                                          "   TexCoord = aTexCoord;\n"
+                                          "   material = int(aMaterial + 0.5);\n"
+                                          "}\n";
+
+const char* vertexShaderSource3InstancedMaterial = "#version 330 core\n" // vert // instanced projection shader with a material index
+                                                   "layout (location = 0) in vec3 aPos;\n"
+                                                   "layout (location = 1) in vec3 aColor;\n"
+                                                   "layout (location = 2) in vec2 aTexCoord;\n"
+                                                   "layout (location = 3) in mat4 aModel;\n" // per-instance, occupies locations 3-6
+                                                   "layout (location = 7) in float aMaterial;\n" // per-instance
+                                                   "out vec3 vertexColor;\n"
+                                                   "out vec2 TexCoord;\n"
+                                                   "out vec3 vertexPos;\n"
+                                                   "flat out int material;\n"
+                                                   "out vec3 viewPos;\n"
+                                                   "layout (std140) uniform Camera {\n"
+                                                   "   mat4 view;\n"
+                                                   "   mat4 projection;\n"
+                                                   "};\n"
+                                                   "void main()\n"
+                                                   "{\n"
+                                                   "   vertexColor = aColor; \n"
+                                                   "   vertexPos = aPos;\n"
+                                                   "   gl_Position = projection * view * aModel * vec4(aPos, 1.0);\n"
+                                                   "   viewPos = vec3(view * aModel * vec4(aPos, 1.0));\n"
+                                                   "   TexCoord = aTexCoord;\n"
+                                                   "   material = int(aMaterial + 0.5);\n"
+                                                   "}\n";
+
 const char* fragmentShaderSource1 = "#version 330 core\n" //frag // orange shader
                                     "out vec4 FragColor;\n"
                                     "void main()\n"
@@ -148,8 +379,156 @@ const char* fragmentShaderSource7 = "#version 330 core\n" //frag // texture shad
 									"    FragColor = texture(texture1, TexCoord) * vec4(1.0);\n"
 									"}\n";
 
+const char* fragmentShaderSource4Array = "#version 330 core\n" //frag // texture RGB shader, material array
+                                         "out vec4 FragColor;\n"
+                                         "in vec3 vertexColor;\n"
+                                         "in vec2 TexCoord;\n"
+                                         "flat in int material;\n"
+                                         "uniform sampler2DArray materialTextures;\n"
+                                         "layout (std140) uniform Materials {\n"
+                                         "   vec4 materialRects[256];\n" // uv offset, uv scale
+                                         "   vec4 materialLayers[256];\n" // layer, 1 when the texture may repeat
+                                         "};\n"
+                                         "void main()\n"
+                                         "{\n"
+                                         "   vec4 rect = materialRects[material];\n"
+                                         "   vec4 layer = materialLayers[material];\n"
+                                         "   vec2 uv = rect.xy + (layer.y > 0.5 ? TexCoord : clamp(TexCoord, 0.0, 1.0)) * rect.zw;\n"
+                                         "   FragColor = texture(materialTextures, vec3(uv, layer.x)) * vec4(vertexColor, 1.0);\n"
+                                         "}\n\0";
+
+const char* fragmentShaderSource7Array = "#version 330 core\n" //frag // texture shader, material array
+                                         "out vec4 FragColor;\n"
+                                         "in vec2 TexCoord;\n"
+                                         "flat in int material;\n"
+                                         "uniform sampler2DArray materialTextures;\n"
+                                         "layout (std140) uniform Materials {\n"
+                                         "   vec4 materialRects[256];\n"
+                                         "   vec4 materialLayers[256];\n"
+                                         "};\n"
+                                         "void main()\n"
+                                         "{\n"
+                                         "   vec4 rect = materialRects[material];\n"
+                                         "   vec4 layer = materialLayers[material];\n"
+                                         "   vec2 uv = rect.xy + (layer.y > 0.5 ? TexCoord : clamp(TexCoord, 0.0, 1.0)) * rect.zw;\n"
+                                         "   FragColor = texture(materialTextures, vec3(uv, layer.x)) * vec4(1.0);\n"
+                                         "}\n";
+
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+// clustered point lights, shared by the lit fragment shaders. the face normal comes from the screen space derivatives
+// of the view position, the meshes carry none. the grid is CLUSTER_TILES_X/Y by CLUSTER_SLICES from Lighting.h
+#define CLUSTERED_LIGHTING_GLSL "in vec3 viewPos;\n" \
+                                "const int tilesX = " TO_STRING(CLUSTER_TILES_X) ";\n" \
+                                "const int tilesY = " TO_STRING(CLUSTER_TILES_Y) ";\n" \
+                                "const int slices = " TO_STRING(CLUSTER_SLICES) ";\n" \
+                                "uniform samplerBuffer lightData;\n" /* view space center and radius, then color and intensity */ \
+                                "uniform usamplerBuffer clusterData;\n" /* a first index and count per cluster, then the indices */ \
+                                "layout (std140) uniform Lights {\n" \
+                                "   vec4 clusterScale;\n" /* tiles per pixel, slices per log depth, slice offset */ \
+                                "   vec4 ambient;\n" \
+                                "   ivec4 lightOffsets;\n" /* first light texel, first cluster texel, light count */ \
+                                "};\n" \
+                                "vec3 clusteredLight()\n" \
+                                "{\n" \
+                                "   vec3 normal = normalize(cross(dFdx(viewPos), dFdy(viewPos)));\n" \
+                                "   ivec3 cell = ivec3(floor(vec3(gl_FragCoord.xy * clusterScale.xy, log(-viewPos.z) * clusterScale.z + clusterScale.w)));\n" \
+                                "   cell = clamp(cell, ivec3(0), ivec3(tilesX - 1, tilesY - 1, slices - 1));\n" \
+                                "   int cluster = lightOffsets.y + 2 * (cell.x + tilesX * (cell.y + tilesY * cell.z));\n" \
+                                "   int first = lightOffsets.y + 2 * tilesX * tilesY * slices + int(texelFetch(clusterData, cluster).r);\n" \
+                                "   int count = int(texelFetch(clusterData, cluster + 1).r);\n" \
+                                "   vec3 light = ambient.rgb;\n" \
+                                "   for (int i = 0; i < count; i++) {\n" \
+                                "       int index = lightOffsets.x + 2 * int(texelFetch(clusterData, first + i).r);\n" \
+                                "       vec4 sphere = texelFetch(lightData, index);\n" \
+                                "       vec4 color = texelFetch(lightData, index + 1);\n" \
+                                "       vec3 toLight = sphere.xyz - viewPos;\n" \
+                                "       float distance = max(length(toLight), 1e-4);\n" \
+                                "       float window = clamp(1.0 - pow(distance / sphere.w, 4.0), 0.0, 1.0);\n" /* nothing left at the radius */ \
+                                "       float falloff = window * window / (distance * distance + 1.0);\n" \
+                                "       light += color.rgb * color.a * falloff * max(dot(normal, toLight / distance), 0.0);\n" \
+                                "   }\n" \
+                                "   return light;\n" \
+                                "}\n"
+
+const char* fragmentShaderSource4Lit = "#version 330 core\n" //frag // texture RGB shader, clustered point lights
+                                       "out vec4 FragColor;\n"
+                                       "in vec3 vertexColor;\n"
+                                       "in vec2 TexCoord;\n"
+                                       "uniform sampler2D ourTexture;\n"
+                                       CLUSTERED_LIGHTING_GLSL
+                                       "void main()\n"
+                                       "{\n"
+                                       "   FragColor = texture(ourTexture, TexCoord) * vec4(vertexColor * clusteredLight(), 1.0);\n"
+                                       "}\n\0";
+
+const char* fragmentShaderSource4ArrayLit = "#version 330 core\n" //frag // texture RGB shader, material array, clustered point lights
+                                            "out vec4 FragColor;\n"
+                                            "in vec3 vertexColor;\n"
+                                            "in vec2 TexCoord;\n"
+                                            "flat in int material;\n"
+                                            "uniform sampler2DArray materialTextures;\n"
+                                            "layout (std140) uniform Materials {\n"
+                                            "   vec4 materialRects[256];\n"
+                                            "   vec4 materialLayers[256];\n"
+                                            "};\n"
+                                            CLUSTERED_LIGHTING_GLSL
+                                            "void main()\n"
+                                            "{\n"
+                                            "   vec4 rect = materialRects[material];\n"
+                                            "   vec4 layer = materialLayers[material];\n"
+                                            "   vec2 uv = rect.xy + (layer.y > 0.5 ? TexCoord : clamp(TexCoord, 0.0, 1.0)) * rect.zw;\n"
+                                            "   FragColor = texture(materialTextures, vec3(uv, layer.x)) * vec4(vertexColor * clusteredLight(), 1.0);\n"
+                                            "}\n\0";
+
 int main(int argc, char* argv[]){
 
+    double startupTime = getTimeSeconds();
+    bool firstFrame = true;
+    parseArguments(argc, argv);
+    initGpuMemory(gpuMemoryBudget);
+    initTransforms();
+
+    // worker threads for the CPU side stages (transforms, ...), the render loop still works without them
+    JobPool jobPool;
+    JobPool* workers = createJobPool(&jobPool, 0) ? &jobPool : NULL;
+
+    if (cookMeshPath != NULL) {
+        if (workers != NULL) destroyJobPool(workers);
+        return cookMesh(cookMeshPath) ? 0 : -1;
+    }
+
+    if (runTransformBenchmark) {
+        benchmarkTransforms(workers);
+        if (workers != NULL) destroyJobPool(workers);
+        return 0;
+    }
+
+    if (runSceneGraphBenchmark) {
+        benchmarkSceneGraph();
+        if (workers != NULL) destroyJobPool(workers);
+        return 0;
+    }
+
+    if (runLightingBenchmark) {
+        int result = runLightBenchmark(workers);
+        if (workers != NULL) destroyJobPool(workers);
+        return result;
+    }
+
+    if (replayPath != NULL) {
+        int result = runReplay(workers);
+        if (workers != NULL) destroyJobPool(workers);
+        return result;
+    }
+
+    if (headlessMode) {
+        int result = runHeadlessBenchmark(workers);
+        if (workers != NULL) destroyJobPool(workers);
+        return result;
+    }
+
     // SETUP WINDOW
     WindowData windowBuildResult = buildWindow();
 
@@ -166,14 +545,110 @@ int main(int argc, char* argv[]){
         return -1;
     }
 
-    // SET UP SHADERS AND TEXTURES
-    unsigned int orangeShader = setUpShader(vertexShaderSource, fragmentShaderSource1);
-    unsigned int yellowShader = setUpShader(vertexShaderSource, fragmentShaderSource2);
-    unsigned int RGBShader = setUpShader(vertexShaderSource, fragmentShaderSource3);
-    unsigned int textureRGBShader = setUpShader(vertexShaderSource, fragmentShaderSource4);
-    unsigned int textureUVShader = setUpShader(vertexShaderSource, fragmentShaderSource5);
-    unsigned int textureTransformShader = setUpShader(vertexShaderSource2, fragmentShaderSource4);
-    unsigned int modelShader = setUpShader(vertexShaderSource3, fragmentShaderSource4);
+    // SET UP SHADERS, TEXTURES AND SCENE
+    Renderer renderer;
+    if (!setUpRenderer(&renderer, workers)) {
+        return -1;
+    }
+    initProfiler(profilingEnabled);
+    if (tracePath != NULL) {
+        startProfileCapture(tracePath, traceFrames);
+    }
+
+    // game logic ticks at a fixed rate on its own thread, or inline below if that thread could not start.
+    // a capture keeps it inline on a clock starting at 0, that way the log decides which input every tick sees
+    InputCapture capture;
+    bool capturing = capturePath != NULL && beginInputCapture(&capture, capturePath, SIMULATION_HZ, SCR_WIDTH, SCR_HEIGHT);
+    // every frame's time is measured from clockStart, so the first tick is at exactly 0.0 like it is in the replay
+    double clockStart = capturing ? getTimeSeconds() : 0.0;
+    initSimulation(&simulation, SIMULATION_HZ, capturing ? 0.0 : getTimeSeconds());
+    if (!capturing) {
+        startSimulationThread(&simulation);
+    }
+
+    // RENDER LOOP
+    while (!glfwWindowShouldClose(window))
+    {
+        float currentFrame = (float)glfwGetTime();
+
+        beginProfileFrame();
+        processInput(window);
+        double now = getTimeSeconds() - clockStart;
+        if (capturing) {
+            now = captureInputFrame(&capture, &simulation, now);
+        }
+        if (!simulation.threaded) {
+            updateSimulation(&simulation, now);
+        }
+        if (capturing) {
+            finishInputFrame(&capture, &simulation);
+        }
+
+        SceneState scene;
+        sampleSimulation(&simulation, now, &scene);
+        renderFrame(&renderer, &scene, SCR_WIDTH, SCR_HEIGHT);
+        reportCullStats(window, &renderer.cullStats, currentFrame);
+
+        // SWAP BUFFERS AND CHECK FOR USER INPUTS
+        PROFILE_BEGIN("swap");
+        glfwSwapBuffers(window);
+        PROFILE_END();
+        glfwPollEvents();
+        endProfileFrame();
+
+        if (firstFrame) {
+            // compare runs with and without the cooked texture caches on disk for cold vs warm startup
+            printf("STARTUP::FIRST_FRAME %.1f ms\n", (getTimeSeconds() - startupTime) * 1000.0);
+            firstFrame = false;
+        }
+    }
+
+    // DE-ALLOCATE RESOURCES
+    stopSimulationThread(&simulation);
+    if (capturing) {
+        endInputCapture(&capture);
+    }
+    shutdownProfiler();
+    printGpuMemory();
+    destroyRenderer(&renderer);
+    shutdownGpuMemory();
+
+    // CLEAR ALL RESOURCES AND STOP OpenGL
+    if (workers != NULL) destroyJobPool(workers);
+    glfwTerminate();
+    return 0;
+}
+
+// BUILD EVERYTHING THE RENDER LOOP DRAWS, NEEDS A CURRENT CONTEXT WITH GLAD LOADED
+bool setUpRenderer(Renderer* renderer, JobPool* workers) {
+    memset(renderer, 0, sizeof(Renderer));
+    renderer->workers = workers;
+
+    // SET UP SHADERS
+    // programs compile on first use, only the ones the render loop draws with are kicked off now
+    initShaderCache(SHADER_CACHE_DIRECTORY, shaderCacheEnabled);
+    renderer->orangeShader = declareShaderProgram(vertexShaderSource, fragmentShaderSource1);
+    renderer->yellowShader = declareShaderProgram(vertexShaderSource, fragmentShaderSource2);
+    renderer->RGBShader = declareShaderProgram(vertexShaderSource, fragmentShaderSource3);
+    renderer->textureRGBShader = declareShaderProgram(vertexShaderSource, fragmentShaderSource4);
+    renderer->textureUVShader = declareShaderProgram(vertexShaderSource, fragmentShaderSource5);
+    renderer->textureTransformShader = declareShaderProgram(vertexShaderSource2, fragmentShaderSource4);
+    renderer->modelShader = declareShaderProgram(vertexShaderSource3, fragmentShaderSource4);
+    renderer->instancedModelShader = declareShaderProgram(vertexShaderSource3Instanced, fragmentShaderSource4);
+    renderer->modelMaterialShader = declareShaderProgram(vertexShaderSource3Material, fragmentShaderSource4Array);
+    renderer->instancedMaterialShader = declareShaderProgram(vertexShaderSource3InstancedMaterial, fragmentShaderSource4Array);
+    renderer->modelLitShader = declareShaderProgram(vertexShaderSource3, fragmentShaderSource4Lit);
+    renderer->instancedLitShader = declareShaderProgram(vertexShaderSource3Instanced, fragmentShaderSource4Lit);
+    renderer->modelMaterialLitShader = declareShaderProgram(vertexShaderSource3Material, fragmentShaderSource4ArrayLit);
+    renderer->instancedMaterialLitShader = declareShaderProgram(vertexShaderSource3InstancedMaterial, fragmentShaderSource4ArrayLit);
+    if (materialCount > 0) {
+        requestShaderProgram(lightCount > 0 ? &renderer->instancedMaterialLitShader : &renderer->instancedMaterialShader);
+        requestShaderProgram(lightCount > 0 ? &renderer->modelMaterialLitShader : &renderer->modelMaterialShader);
+    }
+    else {
+        requestShaderProgram(lightCount > 0 ? &renderer->instancedLitShader : &renderer->instancedModelShader);
+        requestShaderProgram(lightCount > 0 ? &renderer->modelLitShader : &renderer->modelShader);
+    }
 
     // SET UP VERTEX DATA AND VBOs/VAOs/EBO
 
@@ -271,163 +746,580 @@ int main(int argc, char* argv[]){
         { -1.3f,  1.0f, -1.5f }
     };
 
-    unsigned int VBOs[2], VAOs[2], EBOs[2];
-    glGenVertexArrays(2, VAOs);
-    glGenBuffers(2, VBOs);
-    glGenBuffers(2, EBOs);
+
+    // the first instances use the hand placed positions above, the rest are generated
+    vec3* instancePositions = buildInstancePositions(cubePositions, sizeof(cubePositions) / sizeof(vec3), instanceCount);
+    renderer->instanceModels = (mat4*)alignedAlloc(sizeof(mat4) * instanceCount, 64);
+    if (instancePositions == NULL || renderer->instanceModels == NULL || !createTransformBatch(&renderer->instanceTransforms, instanceCount)) {
+        printf("ERROR::INSTANCES::ALLOCATION_FAILED\n");
+        return false;
+    }
+    for (unsigned int i = 0; i < instanceCount; i++) {
+        setTransform(&renderer->instanceTransforms, i, instancePositions[i], (vec3) { 1.0f, 0.5f, 0.0f }, 0.0f);
+    }
+
+    // the cubes spin in place, so a box around the bounding sphere stays valid and the hierarchy can be static
+    AABB* instanceBounds = (AABB*)malloc(sizeof(AABB) * instanceCount);
+    renderer->visibleIndices = (unsigned int*)malloc(sizeof(unsigned int) * instanceCount);
+    if (instanceBounds == NULL || renderer->visibleIndices == NULL || !createTransformBatch(&renderer->visibleTransforms, instanceCount)) {
+        printf("ERROR::INSTANCES::ALLOCATION_FAILED\n");
+        return false;
+    }
+    glm_vec3_copy(instancePositions[0], renderer->sceneBounds.min);
+    glm_vec3_copy(instancePositions[0], renderer->sceneBounds.max);
+    for (unsigned int i = 0; i < instanceCount; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            instanceBounds[i].min[axis] = instancePositions[i][axis] - CUBE_BOUNDING_RADIUS;
+            instanceBounds[i].max[axis] = instancePositions[i][axis] + CUBE_BOUNDING_RADIUS;
+            renderer->sceneBounds.min[axis] = fminf(renderer->sceneBounds.min[axis], instanceBounds[i].min[axis]);
+            renderer->sceneBounds.max[axis] = fmaxf(renderer->sceneBounds.max[axis], instanceBounds[i].max[axis]);
+        }
+        renderer->visibleIndices[i] = i;
+    }
+    if (!buildBVH(&renderer->instanceBVH, instanceBounds, instanceCount)) {
+        printf("ERROR::CULLING::BVH_BUILD_FAILED\n");
+        cullingEnabled = false;
+    }
+    free(instanceBounds);
+    free(instancePositions);
+
+    initStateCache(&renderer->stateCache, stateCacheEnabled);
+    if (!createRenderQueue(&renderer->renderQueue, 64)) {
+        printf("ERROR::RENDER_QUEUE::ALLOCATION_FAILED\n");
+        return false;
+    }
 
     // SETUP TEXTURES
-    unsigned int texture = setUpTexture();
-    
+    createTextureStreamer(&renderer->textureStreamer, workers, textureUploadBudget, textureCacheEnabled);
+    if (synchronousTextures) {
+        renderer->texture = setUpTexture();
+    }
+    else {
+        renderer->containerTexture = requestTexture(&renderer->textureStreamer, "container.jpg"); // placeholder until streamed in
+    }
+    if (materialCount > 0 && !buildMaterials(renderer)) {
+        return false;
+    }
+
 
     // SETUP RENDERING
-    
-    // CUBE
-    glBindVertexArray(VAOs[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOs[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube1verts), cube1verts, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[0]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // PLANE
-    glBindVertexArray(VAOs[1]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOs[1]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(plane1verts), plane1verts, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(planeIndices), planeIndices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    
+
+    // every mesh shares one VAO and one VBO/EBO pair, the cube and plane index their own vertices from 0
+    VertexFormat vertexFormat;
+    buildStandardVertexFormat(&vertexFormat, packedVertices);
+    if (!createMeshArena(&renderer->meshArena, &vertexFormat, 16384, 65536, multiDrawEnabled)) {
+        return false;
+    }
+    renderer->cubeMesh = addStandardMesh(&renderer->meshArena, cube1verts, 24, cubeIndices, 36);
+    renderer->planeMesh = addStandardMesh(&renderer->meshArena, plane1verts, 4, planeIndices, 6);
+    if (renderer->cubeMesh == INVALID_MESH || renderer->planeMesh == INVALID_MESH) {
+        return false;
+    }
+
+    // the spawn column's surface ends up just under the plane
+    if (worldRadius > 0) {
+        VoxelWorld* world = &renderer->world;
+        VertexFormat voxelFormat;
+        buildVoxelVertexFormat(&voxelFormat, packedVertices);
+        vec3 origin = { 0.0f, -3.0f - (float)getVoxelTerrainHeight(WORLD_SEED, 0, 0), 0.0f };
+        if (!createVoxelWorld(world, workers, &voxelFormat, worldRadius, WORLD_SEED, origin, multiDrawEnabled)) {
+            return false;
+        }
+    }
+
+    // per-frame data: the camera block, then the visible cubes' model matrices followed by one per extra mesh,
+    // then one per drawn chunk, then with -materials a material index per cube and extra mesh
+    if (lightCount > 0 && !buildLights(renderer)) {
+        return false;
+    }
+    size_t frameBytes = CAMERA_BLOCK_SIZE + sizeof(mat4) * (instanceCount + extraMeshCount + renderer->world.meshOffsetCount)
+        + (materialCount > 0 ? sizeof(float) * (instanceCount + extraMeshCount) : 0) + 1024; // + alignment padding
+    if (lightCount > 0) {
+        frameBytes += getClusteredLightsFrameSize(&renderer->lighting); // then the lights, their clusters and the Lights block
+    }
+    if (!createStreamBuffer(&renderer->frameData, frameBytes, persistentMappingEnabled)) {
+        return false;
+    }
+    if (lightCount > 0 && !attachClusteredLights(&renderer->lighting, &renderer->frameData)) {
+        printf("ERROR::LIGHTING::SETUP_FAILED, drawing unlit\n");
+        destroyClusteredLights(&renderer->lighting);
+    }
+    setMeshArenaInstanceBuffer(&renderer->meshArena, renderer->frameData.buffer, 3, 0);
+
+    if (!buildExtraMeshes(renderer)) {
+        return false;
+    }
+
+    // a cooked model is a file map and two buffer uploads, it is only cooked when the cache is missing or stale
+    if (meshPath != NULL) {
+        double loadStart = getTimeSeconds();
+        bool cached = loadCachedMesh(meshPath, &renderer->loadedMesh);
+        if (!cached && cookMesh(meshPath)) {
+            loadCachedMesh(meshPath, &renderer->loadedMesh);
+        }
+        CachedMesh* mesh = &renderer->loadedMesh;
+        if (mesh->vertexArray != 0) {
+            printf("MESH::RESIDENT %s (%s) after %.2f ms, %u vertices, %u triangles, %u vertex shader runs per draw\n", meshPath,
+                cached ? "cache" : "cooked", (getTimeSeconds() - loadStart) * 1000.0, mesh->vertexCount, mesh->lods[0].indexCount / 3, mesh->cacheMisses);
+            renderer->loadedMeshLods = (unsigned int*)calloc(meshCopies, sizeof(unsigned int));
+            if (renderer->loadedMeshLods == NULL) {
+                return false;
+            }
+        }
+    }
+
+    // the plane and every model copy are scene graph nodes, only the ones that move are recomputed each frame
+    bool hasModel = renderer->loadedMesh.vertexArray != 0;
+    if (!createSceneGraph(&renderer->sceneGraph, 1 + (hasModel ? 2 * meshCopies : 0))) {
+        return false;
+    }
+    versor noRotation = GLM_QUAT_IDENTITY_INIT;
+    vec3 unitScale = { 1.0f, 1.0f, 1.0f };
+    renderer->planeNode = addSceneNode(&renderer->sceneGraph, SCENE_NO_PARENT, (vec3) { 0.0f, 0.0f, 0.0f }, noRotation, unitScale);
+    if (hasModel) {
+        renderer->loadedMeshNodes = (unsigned int*)malloc(sizeof(unsigned int) * 2 * meshCopies);
+        if (renderer->loadedMeshNodes == NULL) {
+            return false;
+        }
+        // fit into a 2 unit box around the pivot: scale * (-boundsCenter + dequantize), the stored positions are in [-1, 1]
+        const CachedMesh* mesh = &renderer->loadedMesh;
+        vec3 size, fittedPosition, fittedScale;
+        glm_vec3_sub((float*)mesh->boundsMax, (float*)mesh->boundsMin, size);
+        float scale = 2.0f / fmaxf(fmaxf(size[0], size[1]), fmaxf(size[2], 1e-6f));
+        for (int axis = 0; axis < 3; axis++) {
+            float boundsCenter = (mesh->boundsMin[axis] + mesh->boundsMax[axis]) * 0.5f;
+            fittedPosition[axis] = scale * (mesh->dequantize[3][axis] - boundsCenter);
+            fittedScale[axis] = scale * mesh->dequantize[axis][axis];
+        }
+        for (unsigned int i = 0; i < meshCopies; i++) {
+            vec3 modelCenter = { 3.5f + (float)(i % 8) * 3.0f, 0.0f, -(float)(i / 8) * 3.0f };
+            unsigned int pivot = addSceneNode(&renderer->sceneGraph, SCENE_NO_PARENT, modelCenter, noRotation, unitScale);
+            renderer->loadedMeshNodes[2 * i] = pivot;
+            renderer->loadedMeshNodes[2 * i + 1] = addSceneNode(&renderer->sceneGraph, pivot, fittedPosition, noRotation, fittedScale);
+        }
+    }
+
+    // the instanced cubes and extra meshes go through the depth pyramid, every model copy gets a query
+    if (occlusionCullingEnabled) {
+        unsigned int objects = renderer->loadedMesh.vertexArray != 0 ? meshCopies : 0;
+        if (!createHiZ(&renderer->hiz, instanceCount + extraMeshCount, objects)) {
+            printf("ERROR::HIZ::SETUP_FAILED, drawing without occlusion culling\n");
+            destroyHiZ(&renderer->hiz);
+        }
+    }
+
+    if (particleCount > 0 && !buildParticles(renderer)) {
+        printf("ERROR::PARTICLES::SETUP_FAILED, drawing without particles\n");
+        destroyParticleSystem(&renderer->particles);
+    }
+
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); glLineWidth(2.0f); // Wireframe mode
     //glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); glLineWidth(2.0f); // Fill mode
     glEnable(GL_DEPTH_TEST);
+    return true;
+}
 
-    // RENDER LOOP
-    while (!glfwWindowShouldClose(window))
-    {
-        // per-frame time logic
-        float currentFrame = (float)glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+// DRAW ONE FRAME INTO THE CURRENT FRAMEBUFFER, time DRIVES ALL ANIMATION SO HEADLESS RUNS CAN STEP IT THEMSELVES
+void renderFrame(Renderer* renderer, const SceneState* scene, unsigned int width, unsigned int height) {
+    float time = (float)scene->time;
+    resetRenderStats();
+    beginGpuMemoryFrame(); // evicts before anything this frame binds a texture
+    beginStreamFrame(&renderer->frameData); // waits only if the GPU is STREAM_FRAMES frames behind
+
+    // with -materials every textured draw samples the material array, the cubes and extra meshes pick their layer
+    // per instance and everything else uses material 0 as the attribute's current value, the plane shares the cubes'
+    // vertex array so the submit switches the per-instance array off around it
+    bool useMaterials = renderer->materials.texture != 0;
+
+    // move decoded textures to the GPU within this frame's budget. only a texture drawn with counts as used, under
+    // -materials the streamed container is left for the memory budget to evict
+    PROFILE_BEGIN("texture uploads");
+    updateTextureStreamer(&renderer->textureStreamer);
+    if (renderer->containerTexture != NULL && !useMaterials) {
+        renderer->texture = useStreamedTexture(&renderer->textureStreamer, renderer->containerTexture);
+    }
+    PROFILE_END();
+
+    unsigned int texture = useMaterials ? renderer->materials.texture : renderer->texture;
+    unsigned int textureTarget = useMaterials ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    Shader* modelShader = useMaterials ? &renderer->modelMaterialShader : &renderer->modelShader;
+    Shader* instancedShader = useMaterials ? &renderer->instancedMaterialShader : &renderer->instancedModelShader;
+    ClusteredLights* lighting = renderer->lighting.capacity > 0 ? &renderer->lighting : NULL;
+    if (lighting != NULL) {
+        modelShader = useMaterials ? &renderer->modelMaterialLitShader : &renderer->modelLitShader;
+        instancedShader = useMaterials ? &renderer->instancedMaterialLitShader : &renderer->instancedLitShader;
+    }
 
-        processInput(window);
+    // finished chunk meshes go into the arena within their budget, new jobs are queued around the camera
+    VoxelWorld* world = renderer->world.chunks != NULL ? &renderer->world : NULL;
+    if (world != NULL) {
+        PROFILE_BEGIN("world streaming");
+        editWorld(world, scene);
+        updateVoxelWorld(world, (float*)scene->cameraPos);
+        PROFILE_END();
+    }
+
+    PROFILE_BEGIN("clear");
+    glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    PROFILE_END();
+
+    /*--------------------------------------------------------------------------------------*/
+
+    // SETUP CAMERA/FOV
 
-        glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    PROFILE_BEGIN("camera and culling");
+    // initialize view and projection matrices
+    mat4 view = GLM_MAT4_IDENTITY_INIT; // camera
+    mat4 projection = GLM_MAT4_IDENTITY_INIT; // FOV
 
-        /*--------------------------------------------------------------------------------------*/
+    // do view and projection transforms
+    vec3 cameraPos, cameraDirection;
+    glm_vec3_copy((float*)scene->cameraPos, cameraPos);
+    glm_vec3_add(cameraPos, (float*)scene->cameraFront, cameraDirection);
+    glm_lookat(cameraPos, cameraDirection, cameraUp, view);
+    float farPlane = world != NULL ? fmaxf(FAR_PLANE, (float)((world->viewRadius + 2) * CHUNK_SIZE)) : FAR_PLANE; // the whole world radius stays in view
+    glm_perspective(glm_rad(scene->fov), (float)width / (float)height, NEAR_PLANE, farPlane, projection); // FOV, aspect ratio, near Z, far Z, projection matrix
 
-        // SETUP CAMERA/FOV
+    // upload view and projection once, every program reads them from the Camera block
+    updateCameraBuffer(&renderer->frameData, view, projection);
 
-        // initialize view and projection matrices
-        mat4 view = GLM_MAT4_IDENTITY_INIT; // camera
-        mat4 projection = GLM_MAT4_IDENTITY_INIT; // FOV
+    /*--------------------------------------------------------------------------------------*/
 
-        // do view and projection transforms
-        vec3 cameraDirection;
-        glm_vec3_add(cameraPos, cameraFront, cameraDirection);
-        glm_lookat(cameraPos, cameraDirection, cameraUp, view);
-        glm_perspective(glm_rad(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f, projection); // FOV, aspect ratio, near Z, far Z, projection matrix
+    // FRUSTUM CULLING
 
-        /*--------------------------------------------------------------------------------------*/
+    mat4 viewProjection;
+    glm_mat4_mul(projection, view, viewProjection);
+    Frustum frustum;
+    extractFrustum(viewProjection, &frustum);
 
-        // DRAW TEXTURED CUBE IN PERSPECTIVE
+    CullStats cullStats = { instanceCount, 0, 0, 0 };
+    unsigned int visibleCount = instanceCount; // visibleIndices stays 0..N-1 when culling is off
+    if (cullingEnabled) {
+        visibleCount = cullBVH(&renderer->instanceBVH, &frustum, renderer->visibleIndices, &cullStats);
+    }
+    PROFILE_END();
 
-        // setup cube textures, shaders, VAO, and EBO
-        glBindVertexArray(VAOs[0]);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[0]);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glUseProgram(modelShader);
+    /*--------------------------------------------------------------------------------------*/
 
-        // assign view and projection matrices to shader
-        unsigned int viewLoc1 = glGetUniformLocation(modelShader, "view");
-        unsigned int projectionLoc1 = glGetUniformLocation(modelShader, "projection");
-        glUniformMatrix4fv(viewLoc1, 1, GL_FALSE, (const GLfloat*)view);
-        glUniformMatrix4fv(projectionLoc1, 1, GL_FALSE, (const GLfloat*)projection);
+    // CLUSTERED LIGHTING: EVERY LIGHT CIRCLES ITS OWN POINT, THEN GOES INTO THE CLUSTERS ITS RANGE REACHES
 
-        for (int i = 0; i < (sizeof(cubePositions)/sizeof(vec3)); i++) {
-            // initialize model matrix
-            mat4 model1 = GLM_MAT4_IDENTITY_INIT;
+    if (lighting != NULL) {
+        PROFILE_BEGIN("light clustering");
+        for (unsigned int i = 0; i < lighting->lightCount; i++) {
+            const float* orbit = renderer->lightOrbits[i];
+            float angle = time * 0.7f + orbit[3];
+            lighting->lights[i].position[0] = orbit[0] + cosf(angle) * 0.75f;
+            lighting->lights[i].position[1] = orbit[1] + sinf(angle * 1.3f) * 0.25f;
+            lighting->lights[i].position[2] = orbit[2] + sinf(angle) * 0.75f;
+        }
+        vec3 ambient = { LIGHT_AMBIENT, LIGHT_AMBIENT, LIGHT_AMBIENT };
+        updateClusteredLights(lighting, &renderer->frameData, view, glm_rad(scene->fov), (float)width / (float)height,
+            NEAR_PLANE, farPlane, width, height, ambient);
+        PROFILE_END();
+    }
+
+    /*--------------------------------------------------------------------------------------*/
+
+    // DRAW TEXTURED CUBES IN PERSPECTIVE (INSTANCED)
+
+    // gather and animate only the visible cubes, build their model matrices in one batch, then upload them all at once
+    TransformBatch* instances = &renderer->instanceTransforms;
+    TransformBatch* visible = &renderer->visibleTransforms;
+    PROFILE_BEGIN("transforms");
+    for (unsigned int k = 0; k < visibleCount; k++) {
+        unsigned int i = renderer->visibleIndices[k];
+        visible->positionX[k] = instances->positionX[i];
+        visible->positionY[k] = instances->positionY[i];
+        visible->positionZ[k] = instances->positionZ[i];
+        visible->axisX[k] = instances->axisX[i];
+        visible->axisY[k] = instances->axisY[i];
+        visible->axisZ[k] = instances->axisZ[i];
+        visible->angle[k] = glm_rad(fmodf(time * -10.0f * i, 360.0f));
+    }
+    visible->count = visibleCount;
+    computeTransforms(renderer->workers, visible, renderer->instanceModels);
+    size_t instanceOffset;
+    unsigned int streamedInstances = visibleCount + extraMeshCount;
+    mat4* instanceData = (mat4*)mapStream(&renderer->frameData, sizeof(mat4) * streamedInstances, sizeof(mat4), &instanceOffset);
+    bool instancesReady = instanceData != NULL || streamedInstances == 0;
+    if (instanceData != NULL) {
+        memcpy(instanceData, renderer->instanceModels, sizeof(mat4) * visibleCount);
+        if (extraMeshCount > 0) {
+            memcpy(instanceData + visibleCount, renderer->extraMeshModels, sizeof(mat4) * extraMeshCount); // base instance visibleCount + i
+        }
+        unmapStream(&renderer->frameData);
+        setMeshArenaInstanceBuffer(&renderer->meshArena, renderer->frameData.buffer, 3, instanceOffset);
+    }
+    if (useMaterials && streamedInstances > 0) {
+        // a material index per streamed instance, in the same order, so one draw covers every texture
+        size_t materialOffset;
+        float* materialData = (float*)mapStream(&renderer->frameData, sizeof(float) * streamedInstances, sizeof(float), &materialOffset);
+        instancesReady = instancesReady && materialData != NULL;
+        if (materialData != NULL) {
+            for (unsigned int k = 0; k < visibleCount; k++) {
+                materialData[k] = (float)(renderer->visibleIndices[k] % renderer->materials.materialCount);
+            }
+            for (unsigned int i = 0; i < extraMeshCount; i++) {
+                materialData[visibleCount + i] = (float)(i % renderer->materials.materialCount);
+            }
+            unmapStream(&renderer->frameData);
+            setMeshArenaMaterialBuffer(&renderer->meshArena, renderer->frameData.buffer, MATERIAL_LOCATION, materialOffset);
+        }
+    }
+    PROFILE_END();
+
+    // OCCLUSION CULLING
+
+    // the frustum survivors are tested against last frame's depth pyramid on the GPU, the ones behind it keep their
+    // place in the instance buffer but collapse to a point so the draws below stay as they are. the extra meshes
+    // after them pass through untested
+    HiZ* hiz = renderer->hiz.supported ? &renderer->hiz : NULL;
+    if (hiz != NULL && instanceData != NULL) {
+        PROFILE_BEGIN("occlusion culling");
+        unsigned int culledBuffer = cullInstancesHiZ(hiz, renderer->frameData.buffer, instanceOffset, streamedInstances, visibleCount,
+            CUBE_BOUNDING_RADIUS, viewProjection);
+        if (culledBuffer != 0) {
+            setMeshArenaInstanceBuffer(&renderer->meshArena, culledBuffer, 3, 0);
+        }
+        cullStats.occluded = hiz->occludedInstances;
+        PROFILE_END();
+    }
 
-            // do model matrix transforms
-            glm_translate(model1, cubePositions[i]);
-            glm_rotate(model1, glm_rad((float)glfwGetTime() * -10.0f * i), (vec3) { 1.0f, 0.5f, 0.0f });
+    // all visible cubes in a single call, sorted as one object at the middle of the field
+    if (visibleCount > 0 && instancesReady) {
+        vec3 fieldCenter;
+        glm_vec3_add(renderer->sceneBounds.min, renderer->sceneBounds.max, fieldCenter);
+        glm_vec3_scale(fieldCenter, 0.5f, fieldCenter);
+        Shader* shader = instancedShader;
+        const ArenaMesh* mesh = &renderer->meshArena.meshes[renderer->cubeMesh];
+        uint64_t key = makeSortKey(shader->program, texture, renderer->meshArena.vertexArray, glm_vec3_distance(cameraPos, fieldCenter) / FAR_PLANE);
+        RenderCommand* cubes = pushRenderCommand(&renderer->renderQueue, key);
+        if (cubes != NULL) {
+            cubes->shader = shader;
+            cubes->vertexArray = renderer->meshArena.vertexArray;
+            cubes->texture = texture;
+            cubes->textureTarget = textureTarget;
+            cubes->indexCount = mesh->indexCount;
+            cubes->firstIndex = mesh->firstIndex;
+            cubes->baseVertex = (int)mesh->firstVertex;
+            cubes->instanceCount = visibleCount;
+        }
+    }
 
-            // assign model matrix to shader
-            unsigned int modelLoc1 = glGetUniformLocation(modelShader, "model");
-            glUniformMatrix4fv(modelLoc1, 1, GL_FALSE, (const GLfloat*)model1);
+    // DRAW THE EXTRA MESHES, EVERY ONE DIFFERENT, WITH ONE MULTI-DRAW
 
-            // draw cube
-            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    if (extraMeshCount > 0 && instancesReady) {
+        MeshDrawList* draws = &renderer->extraMeshDraws;
+        clearMeshDrawList(draws);
+        for (unsigned int i = 0; i < extraMeshCount; i++) {
+            addMeshDraw(draws, &renderer->meshArena, renderer->extraMeshes[i], 1, visibleCount + i);
         }
+        Shader* shader = instancedShader;
+        uint64_t key = makeSortKey(shader->program, texture, renderer->meshArena.vertexArray, glm_vec3_distance(cameraPos, renderer->extraMeshCenter) / FAR_PLANE);
+        RenderCommand* extra = pushRenderCommand(&renderer->renderQueue, key);
+        if (extra != NULL) {
+            extra->shader = shader;
+            extra->vertexArray = renderer->meshArena.vertexArray;
+            extra->texture = texture;
+            extra->textureTarget = textureTarget;
+            extra->arena = &renderer->meshArena;
+            extra->drawList = draws;
+        }
+    }
 
-        /*--------------------------------------------------------------------------------------*/
+    // DRAW EVERY CHUNK IN VIEW WITH ONE MULTI-DRAW FROM THE WORLD'S OWN ARENA
+
+    if (world != NULL) {
+        PROFILE_BEGIN("chunk culling");
+        size_t chunkOffset;
+        mat4* chunkModels = (mat4*)mapStream(&renderer->frameData, sizeof(mat4) * world->meshOffsetCount, sizeof(mat4), &chunkOffset);
+        unsigned int chunkCount = 0;
+        if (chunkModels != NULL) {
+            chunkCount = gatherVisibleChunks(world, &frustum, chunkModels);
+            unmapStream(&renderer->frameData);
+            setMeshArenaInstanceBuffer(&world->arena, renderer->frameData.buffer, 3, chunkOffset);
+        }
+        PROFILE_END();
+
+        // sorted as the nearest chunk, they draw front to back among themselves already
+        Shader* shader = instancedShader;
+        uint64_t key = makeSortKey(shader->program, texture, world->arena.vertexArray, 0.0f);
+        RenderCommand* chunks = chunkCount > 0 ? pushRenderCommand(&renderer->renderQueue, key) : NULL;
+        if (chunks != NULL) {
+            chunks->shader = shader;
+            chunks->vertexArray = world->arena.vertexArray;
+            chunks->texture = texture;
+            chunks->textureTarget = textureTarget;
+            chunks->hasMaterial = useMaterials;
+            chunks->arena = &world->arena;
+            chunks->drawList = &world->draws;
+        }
+    }
 
-        // DRAW PLANE IN PERSPECTIVE
+    // DRAW THE LOADED MODEL BESIDE THE PLANE, FIT INTO A 2 UNIT BOX, EVERY COPY AT ITS OWN LEVEL OF DETAIL
 
-        // setup plane textures, shaders, VAO, and EBO
-        glBindVertexArray(VAOs[1]);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[1]);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glUseProgram(modelShader);
+    // the pivots spin, the fitted models under them follow, nothing else in the graph is touched
+    versor spin;
+    glm_quatv(spin, glm_rad(time * 10.0f), (vec3) { 0.0f, 1.0f, 0.0f });
+    SceneGraph* graph = &renderer->sceneGraph;
+    setSceneNodeRotation(graph, renderer->planeNode, spin);
+    const CachedMesh* loaded = &renderer->loadedMesh;
+    for (unsigned int i = 0; loaded->vertexArray != 0 && i < meshCopies; i++) {
+        setSceneNodeRotation(graph, renderer->loadedMeshNodes[2 * i], spin);
+    }
+    updateSceneGraph(graph);
+
+    if (loaded->vertexArray != 0) {
+        vec3 size;
+        glm_vec3_sub((float*)loaded->boundsMax, (float*)loaded->boundsMin, size);
+        float largest = fmaxf(fmaxf(size[0], size[1]), fmaxf(size[2], 1e-6f));
+        float scale = 2.0f / largest;
+        float pixelsPerUnit = (float)height / (2.0f * tanf(glm_rad(scene->fov) * 0.5f)); // on screen size of 1 unit at distance 1
+        unsigned int fullTriangles = loaded->lods[0].indexCount / 3;
+
+        Shader* shader = modelShader;
+        for (unsigned int i = 0; i < meshCopies; i++) {
+            vec3 modelCenter = { 3.5f + (float)(i % 8) * 3.0f, 0.0f, -(float)(i / 8) * 3.0f };
+            float distance = fmaxf(glm_vec3_distance(cameraPos, modelCenter) - 1.7320508f, NEAR_PLANE); // to the fitted box's bounding sphere
+            unsigned int* level = &renderer->loadedMeshLods[i];
+            *level = lodErrorPixels > 0.0f ? selectMeshLod(loaded, scale, distance, pixelsPerUnit, lodErrorPixels, *level) : 0;
+            const MeshLod* lod = &loaded->lods[*level];
+
+            uint64_t key = makeSortKey(shader->program, texture, loaded->vertexArray, glm_vec3_distance(cameraPos, modelCenter) / FAR_PLANE);
+            RenderCommand* model = pushRenderCommand(&renderer->renderQueue, key);
+            if (model == NULL) break;
+            model->shader = shader;
+            model->conditionQuery = hiz != NULL ? objectOcclusionQuery(hiz, i) : 0; // its box against the last frame
+            model->vertexArray = loaded->vertexArray;
+            model->texture = texture;
+            model->textureTarget = textureTarget;
+            model->hasMaterial = useMaterials;
+            model->indexCount = lod->indexCount;
+            model->firstIndex = lod->firstIndex;
+            model->shortIndices = loaded->indexType == GL_UNSIGNED_SHORT;
+            countLodDraw(*level, lod->indexCount / 3, fullTriangles);
+
+            model->hasModel = true;
+            glm_mat4_copy(getSceneNodeWorld(graph, renderer->loadedMeshNodes[2 * i + 1]), model->model);
+        }
+    }
 
-        // initialize model matrix
-        mat4 model2 = GLM_MAT4_IDENTITY_INIT;
+    /*--------------------------------------------------------------------------------------*/
+
+    // DRAW PLANE IN PERSPECTIVE
+
+    vec3 planeCenter = { 0.0f, 0.0f, 0.0f };
+    Shader* shader = modelShader;
+    const ArenaMesh* planeMesh = &renderer->meshArena.meshes[renderer->planeMesh];
+    uint64_t key = makeSortKey(shader->program, texture, renderer->meshArena.vertexArray, glm_vec3_distance(cameraPos, planeCenter) / FAR_PLANE);
+    RenderCommand* plane = pushRenderCommand(&renderer->renderQueue, key);
+    if (plane != NULL) {
+        plane->shader = shader;
+        plane->vertexArray = renderer->meshArena.vertexArray;
+        plane->texture = texture;
+        plane->textureTarget = textureTarget;
+        plane->hasMaterial = useMaterials;
+        plane->materialArray = renderer->meshArena.materialBuffer != 0; // shared with the instanced cubes
+        plane->indexCount = planeMesh->indexCount;
+        plane->firstIndex = planeMesh->firstIndex;
+        plane->baseVertex = (int)planeMesh->firstVertex;
 
         // do model matrix transforms
-        glm_translate(model2, (vec3) { 0.0f, 0.0f, 0.0f });
-        glm_rotate(model2, glm_rad((float)glfwGetTime() * 10.0f), (vec3) { 0.0f, 1.0f, 0.0f });
-        glm_scale(model2, (vec3) { 1.0f, 1.0f, 1.0f });
+        plane->hasModel = true;
+        glm_mat4_copy(getSceneNodeWorld(graph, renderer->planeNode), plane->model);
+    }
 
-        // assign model matrix to shader
-        unsigned int modelLoc2 = glGetUniformLocation(modelShader, "model");
-        glUniformMatrix4fv(modelLoc2, 1, GL_FALSE, (const GLfloat*)model2);
+    /*--------------------------------------------------------------------------------------*/
 
-        // assign view and projection matrices to shader
-        unsigned int viewLoc2 = glGetUniformLocation(modelShader, "view");
-        unsigned int projectionLoc2 = glGetUniformLocation(modelShader, "projection");
-        glUniformMatrix4fv(viewLoc2, 1, GL_FALSE, (const GLfloat*)view);
-        glUniformMatrix4fv(projectionLoc2, 1, GL_FALSE, (const GLfloat*)projection);
+    // SUBMIT: SORTED BY PROGRAM, TEXTURE, VAO, DEPTH, REDUNDANT BINDS SKIPPED BY THE STATE CACHE
 
-        // draw plane
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    PROFILE_BEGIN("draw submission");
+    submitRenderQueue(&renderer->renderQueue, &renderer->stateCache);
+    endStreamFrame(&renderer->frameData);
+    PROFILE_END();
 
-        // SWAP BUFFERS AND CHECK FOR USER INPUTS
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // PARTICLES: THE FOUNTAINS SWAY, EVERY PARTICLE IS STEPPED AND DRAWN ON THE GPU OVER THE FINISHED OPAQUE PASS
+
+    ParticleSystem* particles = &renderer->particles;
+    if (particles->capacity > 0) {
+        PROFILE_BEGIN("particles");
+        for (unsigned int e = 0; e < particles->emitterCount; e++) {
+            float angle = time * 0.9f + (float)e * GLM_PI_2f;
+            particles->emitters[e].velocity[0] = cosf(angle) * 0.8f;
+            particles->emitters[e].velocity[2] = sinf(angle) * 0.8f;
+        }
+        updateParticles(particles, scene->time);
+        drawParticles(particles, view, projection);
+        PROFILE_END();
     }
 
-    // DE-ALLOCATE RESOURCES
-    glDeleteVertexArrays(2, VAOs);
-    glDeleteBuffers(2, VBOs);
-    glDeleteBuffers(2, EBOs);
-    glDeleteProgram(yellowShader);
-    glDeleteProgram(orangeShader);
-    glDeleteProgram(RGBShader);
-    glDeleteProgram(textureRGBShader);
-    glDeleteProgram(textureUVShader);
-    glDeleteProgram(textureTransformShader);
-    glDeleteProgram(modelShader);
+    // OCCLUSION: EVERY MODEL COPY'S BOX INTO ITS QUERY, THEN THE FINISHED DEPTH INTO THE PYRAMID FOR THE NEXT FRAME
+
+    if (hiz != NULL) {
+        PROFILE_BEGIN("occlusion pyramid");
+        if (loaded->vertexArray != 0) {
+            beginOcclusionQueries(hiz, viewProjection, cameraPos, NEAR_PLANE);
+            for (unsigned int i = 0; i < meshCopies; i++) {
+                vec3 modelCenter = { 3.5f + (float)(i % 8) * 3.0f, 0.0f, -(float)(i / 8) * 3.0f };
+                AABB box; // the fitted 2 unit box at any rotation
+                for (int axis = 0; axis < 3; axis++) {
+                    box.min[axis] = modelCenter[axis] - 1.7320508f;
+                    box.max[axis] = modelCenter[axis] + 1.7320508f;
+                }
+                queryObjectOcclusion(hiz, i, &box);
+            }
+            endOcclusionQueries();
+            cullStats.occluded += countOccludedObjects(hiz);
+        }
+        buildHiZ(hiz, width, height);
+        PROFILE_END();
+    }
+    renderer->cullStats = cullStats;
+}
 
-    // CLEAR ALL RESOURCES AND STOP OpenGL
-    glfwTerminate();
-    return 0;
+void destroyRenderer(Renderer* renderer) {
+    destroyVoxelWorld(&renderer->world);
+    destroyHiZ(&renderer->hiz);
+    destroyClusteredLights(&renderer->lighting);
+    free(renderer->lightOrbits);
+    destroyParticleSystem(&renderer->particles);
+    destroyCachedMesh(&renderer->loadedMesh);
+    free(renderer->loadedMeshLods);
+    destroySceneGraph(&renderer->sceneGraph);
+    free(renderer->loadedMeshNodes);
+    destroyMeshDrawList(&renderer->extraMeshDraws);
+    free(renderer->extraMeshes);
+    alignedFree(renderer->extraMeshModels);
+    destroyMeshArena(&renderer->meshArena);
+    destroyStreamBuffer(&renderer->frameData);
+    destroyTransformBatch(&renderer->instanceTransforms);
+    destroyTransformBatch(&renderer->visibleTransforms);
+    destroyBVH(&renderer->instanceBVH);
+    free(renderer->visibleIndices);
+    alignedFree(renderer->instanceModels);
+    deleteShaderProgram(&renderer->yellowShader);
+    deleteShaderProgram(&renderer->orangeShader);
+    deleteShaderProgram(&renderer->RGBShader);
+    deleteShaderProgram(&renderer->textureRGBShader);
+    deleteShaderProgram(&renderer->textureUVShader);
+    deleteShaderProgram(&renderer->textureTransformShader);
+    deleteShaderProgram(&renderer->modelShader);
+    deleteShaderProgram(&renderer->instancedModelShader);
+    deleteShaderProgram(&renderer->modelMaterialShader);
+    deleteShaderProgram(&renderer->instancedMaterialShader);
+    deleteShaderProgram(&renderer->modelLitShader);
+    deleteShaderProgram(&renderer->instancedLitShader);
+    deleteShaderProgram(&renderer->modelMaterialLitShader);
+    deleteShaderProgram(&renderer->instancedMaterialLitShader);
+    destroyMaterialLibrary(&renderer->materials);
+
+    if (synchronousTextures) {
+        releaseGpuResource(GPU_TEXTURE, renderer->texture);
+        glDeleteTextures(1, &renderer->texture);
+    }
+    destroyTextureStreamer(&renderer->textureStreamer);
+    destroyRenderQueue(&renderer->renderQueue);
 }
 
 // CHANGE WINDOW SIZE AND VIEWPORT
@@ -453,36 +1345,12 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     lastX = xpos;
     lastY = ypos;
 
-    float sensitivity = 0.1f; // change this value to your liking
-    xoffset *= sensitivity;
-    yoffset *= sensitivity;
-
-    yaw += xoffset;
-    pitch += yoffset;
-
-    // make sure that when pitch is out of bounds, screen doesn't get flipped
-    if (pitch > 89.0f)
-        pitch = 89.0f;
-    if (pitch < -89.0f)
-        pitch = -89.0f;
-
-    vec3 front;
-    front[0] = (float)cos(glm_rad(yaw)) * (float)cos(glm_rad(pitch));
-    front[1] = (float)sin(glm_rad(pitch));
-    front[2] = (float)sin(glm_rad(yaw)) * (float)cos(glm_rad(pitch));
-    glm_normalize(front);
-    cameraFront[0] = front[0];
-    cameraFront[1] = front[1];
-    cameraFront[2] = front[2];
+    addSimulationLook(&simulation, xoffset, yoffset); // sensitivity and pitch limits are applied by the next tick
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    fov -= (float)yoffset;
-    if (fov < 1.0f)
-        fov = 1.0f;
-    if (fov > 45.0f)
-        fov = 45.0f;
+    addSimulationZoom(&simulation, (float)yoffset);
 }
 
 void processInput(GLFWwindow* window) {
@@ -491,77 +1359,13 @@ void processInput(GLFWwindow* window) {
         glfwSetWindowShouldClose(window, true);
     }
 
-    float cameraSpeed = 2.5f;// *deltaTime;
-    vec3 tempVec; // Temporary vector for intermediate calculations
-
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        glm_vec3_scale(cameraFront, cameraSpeed, tempVec); // Scale cameraFront by cameraSpeed
-        glm_vec3_add(cameraPos, tempVec, cameraPos); // Add to cameraPos
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        glm_vec3_scale(cameraFront, cameraSpeed, tempVec); // Scale cameraFront by cameraSpeed
-        glm_vec3_sub(cameraPos, tempVec, cameraPos); // Subtract from cameraPos
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        vec3 crossProduct;
-        glm_vec3_cross(cameraFront, cameraUp, crossProduct); // Cross product of cameraFront and cameraUp
-        glm_normalize(crossProduct); // Normalize the result
-        glm_vec3_scale(crossProduct, cameraSpeed, tempVec); // Scale by cameraSpeed
-        glm_vec3_sub(cameraPos, tempVec, cameraPos); // Subtract from cameraPos
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        vec3 crossProduct;
-        glm_vec3_cross(cameraFront, cameraUp, crossProduct); // Cross product of cameraFront and cameraUp
-        glm_normalize(crossProduct); // Normalize the result
-        glm_vec3_scale(crossProduct, cameraSpeed, tempVec); // Scale by cameraSpeed
-        glm_vec3_add(cameraPos, tempVec, cameraPos); // Add to cameraPos
-    }
-}
-
-unsigned int setUpShader(const char* vertSource, const char* fragSource) {
-    unsigned int vertexShader;
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertSource, NULL);
-    glCompileShader(vertexShader);
-
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        printf("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", infoLog);
-    }
-
-    unsigned int fragmentShader;
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragSource, NULL);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        printf("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s\n", infoLog);
-    }
-
-    unsigned int shaderProgram;
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", infoLog);
-    }
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
+    // movement happens in the simulation ticks, per second instead of per frame
+    unsigned int keys = 0;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) keys |= SIM_KEY_FORWARD;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) keys |= SIM_KEY_BACK;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) keys |= SIM_KEY_LEFT;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) keys |= SIM_KEY_RIGHT;
+    setSimulationKeys(&simulation, keys);
 }
 
 WindowData buildWindow() {
@@ -604,9 +1408,9 @@ unsigned int setUpTexture(){
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     int width, height, nrChannels;
@@ -615,10 +1419,889 @@ unsigned int setUpTexture(){
     if (data) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        // GL_RGB is padded to four bytes a texel by every driver that matters
+        trackGpuResource(GPU_TEXTURE, texture, GPU_MEMORY_TEXTURES, getTextureBytes(width, height, 4, true));
     }
     else {
         printf("ERROR::TEXTURE::LOAD::FAILED\n");
     }
     stbi_image_free(data);
     return texture;
-}
\ No newline at end of file
+}
+// READ COMMAND LINE OPTIONS
+void parseArguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-instances") == 0 && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count > 0) {
+                instanceCount = (unsigned int)count;
+            }
+            else {
+                printf("ERROR::ARGUMENTS::INVALID_INSTANCE_COUNT\n");
+            }
+        }
+        else if (strcmp(argv[i], "-spacing") == 0 && i + 1 < argc) {
+            float spacing = (float)atof(argv[++i]);
+            if (spacing > 0.0f) {
+                instanceSpacing = spacing;
+            }
+        }
+        else if (strcmp(argv[i], "-no-cull") == 0) {
+            cullingEnabled = false;
+        }
+        else if (strcmp(argv[i], "-cull-stats") == 0) {
+            printCullStats = true;
+        }
+        else if (strcmp(argv[i], "-occlusion") == 0) {
+            occlusionCullingEnabled = true;
+        }
+        else if (strcmp(argv[i], "-lights") == 0 && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count >= 0) {
+                lightCount = (unsigned int)count;
+            }
+        }
+        else if (strcmp(argv[i], "-lights-compute") == 0) {
+            lightComputeEnabled = true;
+        }
+        else if (strcmp(argv[i], "-particles") == 0 && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count >= 0 && count <= 16 * 1024 * 1024) {
+                particleCount = (unsigned int)count;
+            }
+            else {
+                printf("ERROR::ARGUMENTS::INVALID_PARTICLE_COUNT\n");
+            }
+        }
+        else if (strcmp(argv[i], "-sync-textures") == 0) {
+            synchronousTextures = true;
+        }
+        else if (strcmp(argv[i], "-upload-budget") == 0 && i + 1 < argc) {
+            long kilobytes = strtol(argv[++i], NULL, 10);
+            if (kilobytes > 0) {
+                textureUploadBudget = (size_t)kilobytes * 1024;
+            }
+        }
+        else if (strcmp(argv[i], "-gpu-budget") == 0 && i + 1 < argc) {
+            long megabytes = strtol(argv[++i], NULL, 10);
+            if (megabytes >= 0) {
+                gpuMemoryBudget = (size_t)megabytes * 1024 * 1024;
+            }
+            else {
+                printf("ERROR::ARGUMENTS::INVALID_GPU_BUDGET\n");
+            }
+        }
+        else if (strcmp(argv[i], "-materials") == 0 && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count >= 0 && count <= MAX_MATERIALS) {
+                materialCount = (unsigned int)count;
+            }
+            else {
+                printf("ERROR::ARGUMENTS::INVALID_MATERIAL_COUNT\n");
+            }
+        }
+        else if (strcmp(argv[i], "-no-texture-cache") == 0) {
+            textureCacheEnabled = false;
+        }
+        else if (strcmp(argv[i], "-no-shader-cache") == 0) {
+            shaderCacheEnabled = false;
+        }
+        else if (strcmp(argv[i], "-no-state-cache") == 0) {
+            stateCacheEnabled = false;
+        }
+        else if (strcmp(argv[i], "-no-multi-draw") == 0) {
+            multiDrawEnabled = false;
+        }
+        else if (strcmp(argv[i], "-no-persistent-map") == 0) {
+            persistentMappingEnabled = false;
+        }
+        else if (strcmp(argv[i], "-mesh") == 0 && i + 1 < argc) {
+            meshPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-mesh-copies") == 0 && i + 1 < argc) {
+            long copies = strtol(argv[++i], NULL, 10);
+            if (copies > 0 && copies <= 4096) {
+                meshCopies = (unsigned int)copies;
+            }
+            else {
+                printf("ERROR::ARGUMENTS::INVALID_MESH_COPIES\n");
+            }
+        }
+        else if (strcmp(argv[i], "-lod-error") == 0 && i + 1 < argc) {
+            float pixels = strtof(argv[++i], NULL);
+            if (pixels >= 0.0f) {
+                lodErrorPixels = pixels;
+            }
+        }
+        else if (strcmp(argv[i], "-cook-mesh") == 0 && i + 1 < argc) {
+            cookMeshPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-world") == 0 && i + 1 < argc) {
+            long radius = strtol(argv[++i], NULL, 10);
+            if (radius > 0 && radius <= 64) {
+                worldRadius = (int)radius;
+            }
+            else {
+                printf("ERROR::ARGUMENTS::INVALID_WORLD_RADIUS\n");
+            }
+        }
+        else if (strcmp(argv[i], "-world-edits") == 0 && i + 1 < argc) {
+            long edits = strtol(argv[++i], NULL, 10);
+            if (edits >= 0) {
+                worldEditsPerFrame = (unsigned int)edits;
+            }
+        }
+        else if (strcmp(argv[i], "-float-vertices") == 0) {
+            packedVertices = false;
+        }
+        else if (strcmp(argv[i], "-meshes") == 0 && i + 1 < argc) {
+            long count = strtol(argv[++i], NULL, 10);
+            if (count >= 0 && count < MESH_ARENA_MAX_MESHES - 2) {
+                extraMeshCount = (unsigned int)count;
+            }
+        }
+        else if (strcmp(argv[i], "-bench-transforms") == 0) {
+            runTransformBenchmark = true;
+        }
+        else if (strcmp(argv[i], "-bench-scene") == 0) {
+            runSceneGraphBenchmark = true;
+        }
+        else if (strcmp(argv[i], "-bench-lights") == 0) {
+            runLightingBenchmark = true;
+        }
+        else if (strcmp(argv[i], "-headless") == 0) {
+            headlessMode = true;
+        }
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            long frames = strtol(argv[++i], NULL, 10);
+            if (frames > 0) {
+                benchmarkFrames = (unsigned int)frames;
+            }
+        }
+        else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc) {
+            long frames = strtol(argv[++i], NULL, 10);
+            if (frames >= 0) {
+                warmupFrames = (unsigned int)frames;
+            }
+        }
+        else if ((strcmp(argv[i], "-width") == 0 || strcmp(argv[i], "-height") == 0) && i + 1 < argc) {
+            bool width = strcmp(argv[i], "-width") == 0;
+            long size = strtol(argv[++i], NULL, 10);
+            if (size > 0 && size <= 16384) {
+                if (width) SCR_WIDTH = (unsigned int)size;
+                else SCR_HEIGHT = (unsigned int)size;
+            }
+            else {
+                printf("ERROR::ARGUMENTS::INVALID_RESOLUTION\n");
+            }
+        }
+        else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) {
+            benchmarkOutput = argv[++i];
+        }
+        else if (strcmp(argv[i], "-capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-replay-stats") == 0 && i + 1 < argc) {
+            replayStatsPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-replay-baseline") == 0 && i + 1 < argc) {
+            replayBaselinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-profile") == 0) {
+            profilingEnabled = true;
+        }
+        else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+            profilingEnabled = true;
+        }
+        else if (strcmp(argv[i], "-trace-frames") == 0 && i + 1 < argc) {
+            long frames = strtol(argv[++i], NULL, 10);
+            if (frames > 0) {
+                traceFrames = (unsigned int)frames;
+            }
+        }
+        else {
+            printf("WARNING::ARGUMENTS::UNKNOWN_OPTION %s\n", argv[i]);
+        }
+    }
+}
+
+// PLACE INSTANCES: COPY THE BASE POSITIONS, THEN FILL A GRID AROUND THE ORIGIN WITH THE REST
+vec3* buildInstancePositions(vec3* basePositions, unsigned int baseCount, unsigned int count) {
+    vec3* positions = (vec3*)malloc(sizeof(vec3) * count);
+    if (positions == NULL) {
+        return NULL;
+    }
+
+    unsigned int copied = count < baseCount ? count : baseCount;
+    memcpy(positions, basePositions, sizeof(vec3) * copied);
+
+    unsigned int remaining = count - copied;
+    if (remaining == 0) {
+        return positions;
+    }
+
+    const float spacing = instanceSpacing;
+    unsigned int side = (unsigned int)ceil(cbrt((double)remaining));
+    float offset = (side - 1) * spacing * 0.5f;
+    for (unsigned int i = 0; i < remaining; i++) {
+        unsigned int x = i % side;
+        unsigned int y = (i / side) % side;
+        unsigned int z = i / (side * side);
+        positions[copied + i][0] = x * spacing - offset;
+        positions[copied + i][1] = y * spacing - offset;
+        positions[copied + i][2] = -(z * spacing) - 20.0f; // start behind the hand placed cubes
+    }
+    return positions;
+}
+
+// POSITION, COLOR AND TEXTURE COORDINATES, AUTHORED AS 8 FLOATS PER VERTEX
+// packed: half float position, RGBA8 color and unorm16 texture coordinates, 16 bytes instead of 32
+void buildStandardVertexFormat(VertexFormat* format, bool packed) {
+    initVertexFormat(format, packed ? "packed" : "float", 8);
+    addVertexAttribute(format, 0, 3, packed ? ENCODING_HALF : ENCODING_FLOAT, 0, 3);
+    addVertexAttribute(format, 1, packed ? 4 : 3, packed ? ENCODING_UNORM8 : ENCODING_FLOAT, 3, 3);
+    addVertexAttribute(format, 2, 2, packed ? ENCODING_UNORM16 : ENCODING_FLOAT, 6, 2);
+}
+
+// converts 8-float vertices into the arena's format on the way in
+unsigned int addStandardMesh(MeshArena* arena, const float* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount) {
+    void* encoded = malloc((size_t)vertexCount * arena->format.stride);
+    if (encoded == NULL) {
+        printf("ERROR::MESHES::ALLOCATION_FAILED\n");
+        return INVALID_MESH;
+    }
+    encodeVertices(&arena->format, vertices, vertexCount, encoded);
+    unsigned int mesh = addMesh(arena, encoded, vertexCount, indices, indexCount);
+    free(encoded);
+    return mesh;
+}
+
+// CLOSED PRISM AROUND THE Y AXIS, FLAT SIDES AND CAPS, RETURNS THE VERTEX COUNT
+// needs room for sides * 6 + 2 vertices and sides * 12 indices
+unsigned int buildPrism(unsigned int sides, float radius, float height, vec3 color, float* vertices, unsigned int* indices, unsigned int* indexCount) {
+    unsigned int vertexCount = 0;
+    unsigned int count = 0;
+    float halfHeight = height * 0.5f;
+
+#define PRISM_VERTEX(x, y, z, u, v) do { \
+        float* out = &vertices[vertexCount++ * 8]; \
+        out[0] = (x); out[1] = (y); out[2] = (z); \
+        out[3] = color[0]; out[4] = color[1]; out[5] = color[2]; \
+        out[6] = (u); out[7] = (v); \
+    } while (0)
+
+    // sides, four vertices each so the edges stay hard
+    for (unsigned int i = 0; i < sides; i++) {
+        float a0 = 2.0f * GLM_PIf * i / sides;
+        float a1 = 2.0f * GLM_PIf * (i + 1) / sides;
+        unsigned int first = vertexCount;
+        PRISM_VERTEX(cosf(a0) * radius, -halfHeight, sinf(a0) * radius, 0.0f, 0.0f);
+        PRISM_VERTEX(cosf(a1) * radius, -halfHeight, sinf(a1) * radius, 1.0f, 0.0f);
+        PRISM_VERTEX(cosf(a1) * radius, halfHeight, sinf(a1) * radius, 1.0f, 1.0f);
+        PRISM_VERTEX(cosf(a0) * radius, halfHeight, sinf(a0) * radius, 0.0f, 1.0f);
+        indices[count++] = first; indices[count++] = first + 2; indices[count++] = first + 1;
+        indices[count++] = first; indices[count++] = first + 3; indices[count++] = first + 2;
+    }
+
+    // caps as fans around a center vertex
+    for (int cap = 0; cap < 2; cap++) {
+        float y = cap == 0 ? -halfHeight : halfHeight;
+        unsigned int center = vertexCount;
+        PRISM_VERTEX(0.0f, y, 0.0f, 0.5f, 0.5f);
+        for (unsigned int i = 0; i < sides; i++) {
+            float a = 2.0f * GLM_PIf * i / sides;
+            PRISM_VERTEX(cosf(a) * radius, y, sinf(a) * radius, 0.5f + cosf(a) * 0.5f, 0.5f + sinf(a) * 0.5f);
+        }
+        for (unsigned int i = 0; i < sides; i++) {
+            unsigned int next = (i + 1) % sides;
+            indices[count++] = center;
+            indices[count++] = center + 1 + (cap == 0 ? i : next);
+            indices[count++] = center + 1 + (cap == 0 ? next : i);
+        }
+    }
+#undef PRISM_VERTEX
+
+    *indexCount = count;
+    return vertexCount;
+}
+
+// -meshes N: PRISMS WITH DIFFERENT SIDE COUNTS AND PROPORTIONS ON A GRID ABOVE THE CUBE FIELD, EACH ITS OWN MESH IN THE ARENA
+bool buildExtraMeshes(Renderer* renderer) {
+    if (extraMeshCount == 0) {
+        return true; // nothing is allocated, malloc(0) may return NULL and must not read as a failure below
+    }
+    if (!createMeshDrawList(&renderer->extraMeshDraws, extraMeshCount)) {
+        printf("ERROR::MESHES::ALLOCATION_FAILED\n");
+        return false;
+    }
+
+    const unsigned int maxSides = 12;
+    renderer->extraMeshes = (unsigned int*)malloc(sizeof(unsigned int) * extraMeshCount);
+    renderer->extraMeshModels = (mat4*)alignedAlloc(sizeof(mat4) * extraMeshCount, 64);
+    float* vertices = (float*)malloc(sizeof(float) * 8 * (maxSides * 6 + 2));
+    unsigned int* indices = (unsigned int*)malloc(sizeof(unsigned int) * maxSides * 12);
+    if (renderer->extraMeshes == NULL || renderer->extraMeshModels == NULL || vertices == NULL || indices == NULL) {
+        printf("ERROR::MESHES::ALLOCATION_FAILED\n");
+        free(vertices);
+        free(indices);
+        return false;
+    }
+
+    const float spacing = 2.5f;
+    unsigned int side = (unsigned int)ceil(sqrt((double)extraMeshCount));
+    float offset = (side - 1) * spacing * 0.5f;
+    vec3 fieldCenter;
+    glm_vec3_add(renderer->sceneBounds.min, renderer->sceneBounds.max, fieldCenter);
+    glm_vec3_scale(fieldCenter, 0.5f, fieldCenter);
+    renderer->extraMeshCenter[0] = fieldCenter[0];
+    renderer->extraMeshCenter[1] = renderer->sceneBounds.max[1] + 3.0f;
+    renderer->extraMeshCenter[2] = fieldCenter[2];
+
+    for (unsigned int i = 0; i < extraMeshCount; i++) {
+        // cheap deterministic variation, no two neighbours look alike
+        unsigned int hash = i * 2654435761u;
+        unsigned int sides = 3 + hash % (maxSides - 2);
+        float radius = 0.4f + (float)((hash >> 8) % 100) / 250.0f;
+        float height = 0.5f + (float)((hash >> 16) % 100) / 100.0f;
+        vec3 color = { 0.4f + (float)(hash % 7) / 10.0f, 0.4f + (float)((hash >> 4) % 7) / 10.0f, 0.4f + (float)((hash >> 12) % 7) / 10.0f };
+
+        unsigned int indexCount;
+        unsigned int vertexCount = buildPrism(sides, radius, height, color, vertices, indices, &indexCount);
+        renderer->extraMeshes[i] = addStandardMesh(&renderer->meshArena, vertices, vertexCount, indices, indexCount);
+
+        vec3 position = {
+            renderer->extraMeshCenter[0] + (i % side) * spacing - offset,
+            renderer->extraMeshCenter[1],
+            renderer->extraMeshCenter[2] + (i / side) * spacing - offset
+        };
+        glm_mat4_identity(renderer->extraMeshModels[i]);
+        glm_translate(renderer->extraMeshModels[i], position);
+        glm_rotate(renderer->extraMeshModels[i], (float)(hash % 360) * GLM_PIf / 180.0f, (vec3) { 0.0f, 1.0f, 0.0f });
+    }
+    free(vertices);
+    free(indices);
+    printf("MESHES::ARENA %u meshes, %u vertices (%s, %u KB), %u indices\n", renderer->meshArena.meshCount,
+        renderer->meshArena.vertices.used, renderer->meshArena.format.name,
+        renderer->meshArena.vertices.used * renderer->meshArena.format.stride / 1024, renderer->meshArena.indices.used);
+    return true;
+}
+
+// -materials N: THE CONTAINER IMAGE IN N TINTS, EVERY THIRD ONE SHRUNK TO AN ODD SIZE SO IT LANDS IN AN ATLAS LAYER
+bool buildMaterials(Renderer* renderer) {
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(1);
+    unsigned char* source = stbi_load("container.jpg", &width, &height, &channels, 4);
+    if (source == NULL) {
+        printf("ERROR::MATERIAL::SOURCE_LOAD_FAILED container.jpg\n");
+        return false;
+    }
+    unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * 4);
+    if (pixels == NULL || !createMaterialLibrary(&renderer->materials, materialCount)) {
+        printf("ERROR::MATERIAL::ALLOCATION_FAILED\n");
+        stbi_image_free(source);
+        free(pixels);
+        return false;
+    }
+
+    for (unsigned int m = 0; m < materialCount; m++) {
+        // the first keeps the source colors and size
+        float tint[3] = { 1.0f, 1.0f, 1.0f };
+        if (m > 0) {
+            float hue = (float)m * 0.618034f * 6.0f;
+            for (int c = 0; c < 3; c++) {
+                float distance = fabsf(fmodf(hue + 4.0f - 2.0f * c, 6.0f) - 3.0f);
+                tint[c] = 0.35f + 0.65f * fminf(fmaxf(distance - 1.0f, 0.0f), 1.0f);
+            }
+        }
+        int materialWidth = width, materialHeight = height;
+        if (m % 3 == 2) {
+            materialWidth = 96 + (int)(m * 53 % 160);
+            materialHeight = 64 + (int)(m * 37 % 160);
+        }
+        for (int y = 0; y < materialHeight; y++) {
+            const unsigned char* row = &source[(size_t)(y * height / materialHeight) * width * 4];
+            for (int x = 0; x < materialWidth; x++) {
+                const unsigned char* texel = &row[(size_t)(x * width / materialWidth) * 4];
+                unsigned char* pixel = &pixels[((size_t)y * materialWidth + x) * 4];
+                for (int c = 0; c < 3; c++) {
+                    pixel[c] = (unsigned char)(texel[c] * tint[c]);
+                }
+                pixel[3] = 255;
+            }
+        }
+        if (addMaterial(&renderer->materials, pixels, materialWidth, materialHeight) == INVALID_MATERIAL) {
+            break;
+        }
+    }
+    stbi_image_free(source);
+    free(pixels);
+    finishMaterialLibrary(&renderer->materials);
+
+    const MaterialLibrary* materials = &renderer->materials;
+    printf("MATERIALS::READY %u materials in %u array layers (%u atlas), %u KB\n", materials->materialCount, materials->layerCount,
+        materials->atlasLayers, (unsigned int)((size_t)materials->layerCapacity * MATERIAL_LAYER_SIZE * MATERIAL_LAYER_SIZE * 4 * 4 / 3 / 1024));
+    return materials->materialCount > 0;
+}
+
+// SCATTER THE -lights POINT LIGHTS OVER THE CUBE FIELD AND THE PLANE, THE MORE CROWDED THEY ARE THE SHORTER THEIR REACH
+bool buildLights(Renderer* renderer) {
+    renderer->lightOrbits = (vec4*)malloc(sizeof(vec4) * lightCount);
+    if (renderer->lightOrbits == NULL || !createClusteredLights(&renderer->lighting, lightCount, renderer->workers, lightComputeEnabled)) {
+        printf("ERROR::LIGHTING::ALLOCATION_FAILED\n");
+        return false;
+    }
+    vec3 low, size;
+    float volume = 1.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        low[axis] = fminf(renderer->sceneBounds.min[axis], -1.25f) - 1.0f;
+        size[axis] = fmaxf(renderer->sceneBounds.max[axis], 1.25f) + 1.0f - low[axis];
+        volume *= size[axis];
+    }
+    float radius = fminf(fmaxf(2.0f * cbrtf(volume / (float)lightCount), 1.5f), 10.0f);
+
+    // an additive recurrence spreads them evenly however many there are
+    const float spread[3] = { 0.8191725f, 0.6710436f, 0.5497005f };
+    for (unsigned int i = 0; i < lightCount; i++) {
+        PointLight* light = &renderer->lighting.lights[i];
+        float* orbit = renderer->lightOrbits[i];
+        float hue = (float)i * 0.618034f * 6.0f;
+        for (int c = 0; c < 3; c++) {
+            orbit[c] = low[c] + size[c] * fmodf(0.5f + spread[c] * (float)i, 1.0f);
+            float distance = fabsf(fmodf(hue + 4.0f - 2.0f * c, 6.0f) - 3.0f);
+            light->color[c] = 0.25f + 0.75f * fminf(fmaxf(distance - 1.0f, 0.0f), 1.0f);
+        }
+        orbit[3] = (float)i * 2.399963f; // golden angle, neighbours never move in step
+        glm_vec3_copy(orbit, light->position);
+        light->radius = radius;
+        light->intensity = 0.25f * radius * radius; // the same brightness halfway out, whatever the radius
+    }
+    renderer->lighting.lightCount = lightCount;
+    printf("LIGHTING::READY %u point lights of radius %.2f, assigned to %u clusters %s\n", lightCount, radius, CLUSTER_COUNT,
+        renderer->lighting.useCompute ? "in a compute shader" : "on the CPU");
+    return true;
+}
+
+// FOUNTAINS AROUND THE MIDDLE OF THE PLANE, EMITTING JUST SLOWER THAN THE RING COMES AROUND SO EVERY SLOT IS IN USE
+bool buildParticles(Renderer* renderer) {
+    ParticleSystem* particles = &renderer->particles;
+    if (!createParticleSystem(particles, particleCount)) {
+        return false;
+    }
+    particles->groundHeight = -1.0f; // the plane
+    // the light adds up, the more particles the dimmer each one so the fountains look the same at any count
+    float brightness = fminf(1.0f, sqrtf(4096.0f / (float)particleCount));
+    const vec3 colors[4] = { { 1.0f, 0.55f, 0.15f }, { 0.2f, 0.6f, 1.0f }, { 1.0f, 0.25f, 0.5f }, { 0.4f, 1.0f, 0.3f } };
+    for (unsigned int e = 0; e < PARTICLE_FOUNTAINS; e++) {
+        float angle = (float)e * GLM_PI_2f + GLM_PI_4f;
+        ParticleEmitter emitter;
+        glm_vec3_copy((vec3) { cosf(angle) * 0.8f, -0.95f, sinf(angle) * 0.8f }, emitter.position);
+        emitter.radius = 0.05f;
+        glm_vec3_copy((vec3) { 0.0f, 4.5f, 0.0f }, emitter.velocity);
+        emitter.spread = 1.0f;
+        glm_vec3_scale((float*)colors[e % 4], brightness, emitter.color);
+        emitter.lifetime = PARTICLE_LIFETIME;
+        emitter.rate = 0.99f * (float)particleCount / (PARTICLE_LIFETIME * PARTICLE_FOUNTAINS);
+        emitter.size = 0.04f;
+        addParticleEmitter(particles, &emitter);
+    }
+    printf("PARTICLES::READY %u particles from %u fountains, %.1f MB of state on the GPU\n", particleCount, PARTICLE_FOUNTAINS,
+        2.0 * particleCount * PARTICLE_STRIDE / (1024.0 * 1024.0));
+    return true;
+}
+
+// SHOW HOW MUCH THE FRUSTUM CULLING SAVES: IN THE TITLE TWICE A SECOND, ON THE CONSOLE EVERY FRAME WITH -cull-stats
+void reportCullStats(GLFWwindow* window, const CullStats* stats, float currentFrame) {
+    static float lastTitleUpdate = 0.0f;
+    static unsigned int frame = 0;
+    frame++;
+
+    if (printCullStats) {
+        printf("frame %u: visible %u culled %u occluded %u (bvh nodes visited %u) state changes %u (skipped %u) lod triangles saved %u\n", frame,
+            stats->visible, stats->culled, stats->occluded, stats->nodesVisited, renderStats.stateChanges, renderStats.redundantStateChanges, renderStats.lodTrianglesSaved);
+    }
+    if (currentFrame - lastTitleUpdate >= 0.5f) {
+        char title[512];
+        int length = snprintf(title, sizeof(title), "LearnOpenGL | visible %u | culled %u | occluded %u | ", stats->visible, stats->culled, stats->occluded);
+        formatGpuMemory(title + length, sizeof(title) - length);
+        length = (int)strlen(title);
+        if (profiler.active && length > 0 && length < (int)sizeof(title) - 3) {
+            // per-pass CPU/GPU milliseconds
+            strcat(title, " | ");
+            formatProfileSummary(title + length + 3, sizeof(title) - length - 3);
+        }
+        glfwSetWindowTitle(window, title);
+        lastTitleUpdate = currentFrame;
+    }
+}
+
+// SCRIPTED CAMERA: ORBIT THE CUBE FIELD, BOBBING UP AND DOWN, ALWAYS LOOKING AT ITS CENTER, SO EVERY RUN SEES THE SAME FRAMES
+void placeBenchmarkCamera(AABB* bounds, float time, SceneState* scene) {
+    vec3 center, size;
+    glm_vec3_add(bounds->min, bounds->max, center);
+    glm_vec3_scale(center, 0.5f, center);
+    glm_vec3_sub(bounds->max, bounds->min, size);
+    float radius = fmaxf(glm_vec3_norm(size) * 0.4f, 6.0f); // inside big fields, so part of it is always culled
+
+    float angle = time * 0.5f;
+    scene->time = time;
+    scene->cameraPos[0] = center[0] + cosf(angle) * radius;
+    scene->cameraPos[1] = center[1] + sinf(angle * 2.0f) * radius * 0.25f;
+    scene->cameraPos[2] = center[2] + sinf(angle) * radius;
+    glm_vec3_sub(center, scene->cameraPos, scene->cameraFront);
+    glm_normalize(scene->cameraFront);
+    scene->fov = 45.0f;
+}
+
+// FLY ALONG +X ABOVE THE TERRAIN, SO CHUNKS KEEP STREAMING IN AHEAD AND DROPPING OUT BEHIND
+void placeWorldCamera(const VoxelWorld* world, float time, SceneState* scene) {
+    float x = time * WORLD_FLIGHT_SPEED;
+    // average ground over the stretch ahead, rises before the hills arrive without jumping at every column
+    float ground = 0.0f;
+    for (int ahead = 0; ahead < 64; ahead += 8) {
+        ground += (float)getVoxelTerrainHeight(world->seed, (int)x + ahead, 0) / 8.0f;
+    }
+    scene->time = time;
+    scene->cameraPos[0] = world->origin[0] + x;
+    scene->cameraPos[1] = world->origin[1] + ground + 24.0f;
+    scene->cameraPos[2] = world->origin[2];
+    glm_vec3_copy((vec3) { 1.0f, -0.3f, 0.2f }, scene->cameraFront);
+    glm_normalize(scene->cameraFront);
+    scene->fov = 45.0f;
+}
+
+// DIG worldEditsPerFrame BLOCKS ALONG THE VIEW RAY, ONLY THE CHUNKS AN EDIT TOUCHES ARE MESHED AGAIN
+void editWorld(VoxelWorld* world, const SceneState* scene) {
+    for (unsigned int i = 0; i < worldEditsPerFrame; i++) {
+        int hit[3];
+        if (!raycastVoxelWorld(world, (float*)scene->cameraPos, (float*)scene->cameraFront, 128.0f, hit)) {
+            return;
+        }
+        setVoxelBlock(world, hit[0], hit[1], hit[2], BLOCK_AIR);
+    }
+}
+
+// LIGHTING BENCHMARK: THE HEADLESS SCENE LIT BY 16 UP TO 4096 CLUSTERED POINT LIGHTS, ASSIGNED ON THE CPU AND, WHEN
+// GL 4.3 IS THERE, IN A COMPUTE SHADER. EVERY ROW REPLAYS THE SAME FRAMES ON THE SAME CLOCK
+int runLightBenchmark(JobPool* workers) {
+    const unsigned int maxLights = 4096;
+    const unsigned int frames = 60;
+    HeadlessContext headless;
+    if (!createHeadlessContext(&headless, SCR_WIDTH, SCR_HEIGHT)) {
+        return -1;
+    }
+    lightCount = maxLights;
+    lightComputeEnabled = lightComputeEnabled || GLAD_GL_VERSION_4_3;
+    Renderer renderer;
+    if (!setUpRenderer(&renderer, workers)) {
+        destroyHeadlessContext(&headless);
+        return -1;
+    }
+    double* cpuMs = (double*)calloc(frames, sizeof(double));
+    double* gpuMs = (double*)calloc(frames, sizeof(double));
+    if (cpuMs == NULL || gpuMs == NULL || renderer.lighting.capacity == 0) {
+        printf("ERROR::BENCHMARK::SETUP_FAILED\n");
+        free(cpuMs);
+        free(gpuMs);
+        destroyRenderer(&renderer);
+        destroyHeadlessContext(&headless);
+        return -1;
+    }
+    ClusteredLights* lighting = &renderer.lighting;
+    bool hasCompute = lighting->computeProgram != 0;
+    lighting->countOnGpu = true;
+    GpuFrameTimer gpuTimer;
+    createGpuFrameTimer(&gpuTimer);
+
+    printf("LIGHTING BENCHMARK (%ux%u, %u instances, %u frames per row, %u worker threads, %s)\n", SCR_WIDTH, SCR_HEIGHT, instanceCount,
+        frames, workers != NULL ? workers->workerCount : 0, (const char*)glGetString(GL_RENDERER));
+    printf("%8s %8s %10s %10s %10s %14s %10s %10s\n", "lights", "assign", "assign ms", "cpu ms", "gpu ms", "per cluster", "clusters", "dropped");
+    const float frameStep = 1.0f / 60.0f;
+    for (unsigned int count = 16; count <= maxLights; count *= 2) {
+        for (unsigned int mode = 0; mode < (hasCompute ? 2u : 1u); mode++) {
+            lighting->useCompute = mode == 1;
+            lighting->lightCount = count;
+            double assignMs = 0.0;
+            unsigned long long assigned = 0, occupied = 0, dropped = 0;
+            for (unsigned int frame = 0; frame < warmupFrames + frames; frame++) {
+                bool measured = frame >= warmupFrames;
+                unsigned int sample = frame - warmupFrames;
+                double frameStart = getTimeSeconds();
+                if (measured) beginGpuFrame(&gpuTimer, gpuMs, sample);
+                SceneState scene;
+                placeBenchmarkCamera(&renderer.sceneBounds, frame * frameStep, &scene);
+                renderFrame(&renderer, &scene, SCR_WIDTH, SCR_HEIGHT);
+                if (measured) endGpuFrame(&gpuTimer);
+                glFlush();
+                if (measured) {
+                    cpuMs[sample] = (getTimeSeconds() - frameStart) * 1000.0;
+                    readClusteredLightCounts(lighting); // after the timings, it waits for the GPU
+                    assignMs += lighting->assignMs;
+                    assigned += lighting->assignedIndices;
+                    occupied += lighting->occupiedClusters;
+                    dropped += lighting->droppedIndices;
+                    collectGpuFrames(&gpuTimer, gpuMs, false);
+                }
+            }
+            glFinish();
+            collectGpuFrames(&gpuTimer, gpuMs, true);
+            Percentiles cpu = computePercentiles(cpuMs, frames);
+            Percentiles gpu = computePercentiles(gpuMs, frames);
+            printf("%8u %8s %10.3f %10.3f %10.3f %14.2f %10.1f %10.1f\n", count, lighting->useCompute ? "gpu" : "cpu", assignMs / frames,
+                cpu.mean, gpu.mean, occupied > 0 ? (double)assigned / occupied : 0.0, (double)occupied / frames, (double)dropped / frames);
+        }
+    }
+
+    destroyGpuFrameTimer(&gpuTimer);
+    free(cpuMs);
+    free(gpuMs);
+    destroyRenderer(&renderer);
+    destroyHeadlessContext(&headless);
+    return 0;
+}
+
+// HEADLESS BENCHMARK: RENDER A FIXED NUMBER OF FRAMES OFFSCREEN ON A FIXED CLOCK, THEN REPORT FRAME TIME PERCENTILES AS JSON
+int runHeadlessBenchmark(JobPool* workers) {
+    HeadlessContext headless;
+    if (!createHeadlessContext(&headless, SCR_WIDTH, SCR_HEIGHT)) {
+        return -1;
+    }
+
+    Renderer renderer;
+    if (!setUpRenderer(&renderer, workers)) {
+        destroyHeadlessContext(&headless);
+        return -1;
+    }
+
+    double* cpuMs = (double*)calloc(benchmarkFrames, sizeof(double));
+    double* gpuMs = (double*)calloc(benchmarkFrames, sizeof(double));
+    unsigned int* drawCalls = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    unsigned int* meshDraws = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    unsigned int* triangles = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    unsigned int* visibleInstances = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    unsigned int* occludedInstances = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    unsigned int* stateChanges = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    unsigned int* skippedStateChanges = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    unsigned int* lodTrianglesSaved = (unsigned int*)calloc(benchmarkFrames, sizeof(unsigned int));
+    double lodTriangles[RENDER_STATS_LODS] = { 0.0 }; // summed over the measured frames
+    if (cpuMs == NULL || gpuMs == NULL || drawCalls == NULL || meshDraws == NULL || triangles == NULL || visibleInstances == NULL
+        || occludedInstances == NULL || stateChanges == NULL || skippedStateChanges == NULL || lodTrianglesSaved == NULL) {
+        printf("ERROR::HEADLESS::ALLOCATION_FAILED\n");
+        free(cpuMs); free(gpuMs); free(drawCalls); free(meshDraws); free(triangles); free(visibleInstances);
+        free(occludedInstances); free(stateChanges); free(skippedStateChanges); free(lodTrianglesSaved);
+        destroyRenderer(&renderer);
+        destroyHeadlessContext(&headless);
+        return -1;
+    }
+
+    GpuFrameTimer gpuTimer;
+    createGpuFrameTimer(&gpuTimer);
+    initProfiler(profilingEnabled);
+
+    // animation runs on a virtual 60Hz clock so the scene does not depend on how fast frames come out,
+    // warmup frames let shaders finish compiling and textures stream in before anything is measured
+    const float frameStep = 1.0f / 60.0f;
+    unsigned int totalFrames = warmupFrames + benchmarkFrames;
+    for (unsigned int frame = 0; frame < totalFrames; frame++) {
+        float time = frame * frameStep;
+        bool measured = frame >= warmupFrames;
+        unsigned int sample = frame - warmupFrames;
+
+        if (frame == warmupFrames && tracePath != NULL) {
+            startProfileCapture(tracePath, traceFrames);
+        }
+        double frameStart = getTimeSeconds();
+        beginProfileFrame();
+        if (measured) beginGpuFrame(&gpuTimer, gpuMs, sample);
+
+        SceneState scene;
+        if (renderer.world.chunks != NULL) placeWorldCamera(&renderer.world, time, &scene);
+        else placeBenchmarkCamera(&renderer.sceneBounds, time, &scene);
+        renderFrame(&renderer, &scene, SCR_WIDTH, SCR_HEIGHT);
+
+        if (measured) endGpuFrame(&gpuTimer);
+        glFlush(); // stands in for the swap, hands the frame to the driver
+        endProfileFrame();
+        if (measured) {
+            cpuMs[sample] = (getTimeSeconds() - frameStart) * 1000.0;
+            drawCalls[sample] = renderStats.drawCalls;
+            meshDraws[sample] = renderStats.meshDraws;
+            triangles[sample] = renderStats.triangles;
+            visibleInstances[sample] = renderer.cullStats.visible;
+            occludedInstances[sample] = renderer.cullStats.occluded;
+            stateChanges[sample] = renderStats.stateChanges;
+            skippedStateChanges[sample] = renderStats.redundantStateChanges;
+            lodTrianglesSaved[sample] = renderStats.lodTrianglesSaved;
+            for (unsigned int l = 0; l < RENDER_STATS_LODS; l++) {
+                lodTriangles[l] += renderStats.lodTriangles[l];
+            }
+            collectGpuFrames(&gpuTimer, gpuMs, false);
+        }
+    }
+    glFinish();
+    collectGpuFrames(&gpuTimer, gpuMs, true);
+
+    BenchmarkReport report;
+    report.renderer = (const char*)glGetString(GL_RENDERER);
+    report.version = (const char*)glGetString(GL_VERSION);
+    report.width = SCR_WIDTH;
+    report.height = SCR_HEIGHT;
+    report.instances = instanceCount;
+    report.frames = benchmarkFrames;
+    report.warmupFrames = warmupFrames;
+    report.culling = cullingEnabled;
+    report.meshes = extraMeshCount;
+    report.multiDraw = renderer.meshArena.multiDrawIndirect;
+    report.persistentMapping = renderer.frameData.persistent;
+    report.vertexFormat = renderer.meshArena.format.name;
+    report.vertexStride = renderer.meshArena.format.stride;
+    report.vertexBytes = renderer.meshArena.vertices.used * renderer.meshArena.format.stride;
+    report.cpuMs = cpuMs;
+    report.gpuMs = gpuMs;
+    report.drawCalls = drawCalls;
+    report.meshDraws = meshDraws;
+    report.triangles = triangles;
+    report.visibleInstances = visibleInstances;
+    report.occlusion = renderer.hiz.supported;
+    report.occludedInstances = occludedInstances;
+    report.stateCache = stateCacheEnabled;
+    report.stateChanges = stateChanges;
+    report.skippedStateChanges = skippedStateChanges;
+    report.worldRadius = renderer.world.viewRadius;
+    report.chunksGenerated = renderer.world.chunksGenerated;
+    report.chunksMeshed = renderer.world.chunksMeshed;
+    report.chunkMeshRate = getChunkMeshRate(&renderer.world);
+    report.chunkMeshMs = renderer.world.chunksMeshed > 0 ? renderer.world.meshSeconds * 1000.0 / renderer.world.chunksMeshed : 0.0;
+    report.lodLevels = renderer.loadedMesh.lodCount < RENDER_STATS_LODS ? renderer.loadedMesh.lodCount : RENDER_STATS_LODS;
+    for (unsigned int l = 0; l < RENDER_STATS_LODS; l++) {
+        lodTriangles[l] /= benchmarkFrames;
+    }
+    report.lodTriangles = lodTriangles;
+    report.lodTrianglesSaved = lodTrianglesSaved;
+    report.memory = &gpuMemory;
+    bool written = writeBenchmarkReport(&report, benchmarkOutput);
+
+    shutdownProfiler();
+    destroyGpuFrameTimer(&gpuTimer);
+    free(cpuMs);
+    free(gpuMs);
+    free(drawCalls);
+    free(meshDraws);
+    free(triangles);
+    free(visibleInstances);
+    free(occludedInstances);
+    free(stateChanges);
+    free(skippedStateChanges);
+    free(lodTrianglesSaved);
+    destroyRenderer(&renderer);
+    shutdownGpuMemory();
+    destroyHeadlessContext(&headless);
+    return written ? 0 : -1;
+}
+
+// REPLAY A -capture LOG OFFSCREEN: THE SIMULATION TICKS ON THE LOG'S CLOCK AND GETS THE SAME INPUT AT THE SAME TIMES,
+// SO EVERY BUILD RENDERS THE SAME SEQUENCE OF SCENES AND FRAME N OF ONE RUN CAN BE HELD AGAINST FRAME N OF ANOTHER
+int runReplay(JobPool* workers) {
+    Replay replay;
+    if (!loadReplay(&replay, replayPath)) {
+        return -1;
+    }
+    SCR_WIDTH = replay.header.width;
+    SCR_HEIGHT = replay.header.height;
+
+    HeadlessContext headless;
+    if (!createHeadlessContext(&headless, SCR_WIDTH, SCR_HEIGHT)) {
+        destroyReplay(&replay);
+        return -1;
+    }
+    Renderer renderer;
+    ReplayFrameStats* stats = (ReplayFrameStats*)calloc(replay.frameCount, sizeof(ReplayFrameStats));
+    double* cpuMs = (double*)calloc(replay.frameCount, sizeof(double));
+    double* gpuMs = (double*)calloc(replay.frameCount, sizeof(double));
+    if (stats == NULL || cpuMs == NULL || gpuMs == NULL) {
+        printf("ERROR::REPLAY::ALLOCATION_FAILED\n");
+    }
+    if (stats == NULL || cpuMs == NULL || gpuMs == NULL || !setUpRenderer(&renderer, workers)) {
+        free(stats); free(cpuMs); free(gpuMs);
+        destroyHeadlessContext(&headless);
+        destroyReplay(&replay);
+        return -1;
+    }
+
+    GpuFrameTimer gpuTimer;
+    createGpuFrameTimer(&gpuTimer);
+    initProfiler(profilingEnabled);
+    initSimulation(&simulation, replay.header.tickRate, 0.0);
+
+    // warmup frames hold the first scene while shaders compile and textures stream in, then every logged frame is
+    // measured, the first ones are not the capture's first seconds of loading
+    SceneState scene;
+    sampleSimulation(&simulation, 0.0, &scene);
+    for (unsigned int frame = 0; frame < warmupFrames; frame++) {
+        renderFrame(&renderer, &scene, SCR_WIDTH, SCR_HEIGHT);
+        glFlush();
+    }
+    glFinish();
+
+    if (tracePath != NULL) {
+        startProfileCapture(tracePath, traceFrames);
+    }
+    for (unsigned int frame = 0; frame < replay.frameCount; frame++) {
+        double time = replay.frames[frame].time;
+        double frameStart = getTimeSeconds();
+        beginProfileFrame();
+        beginGpuFrame(&gpuTimer, gpuMs, frame);
+
+        applyReplayFrame(&replay, frame, &simulation);
+        updateSimulation(&simulation, time);
+        sampleSimulation(&simulation, time, &scene);
+        renderFrame(&renderer, &scene, SCR_WIDTH, SCR_HEIGHT);
+
+        endGpuFrame(&gpuTimer);
+        glFlush(); // stands in for the swap, hands the frame to the driver
+        endProfileFrame();
+        cpuMs[frame] = (getTimeSeconds() - frameStart) * 1000.0;
+        stats[frame].time = time;
+        stats[frame].cpuMs = cpuMs[frame];
+        stats[frame].drawCalls = renderStats.drawCalls;
+        stats[frame].meshDraws = renderStats.meshDraws;
+        stats[frame].triangles = renderStats.triangles;
+        stats[frame].stateChanges = renderStats.stateChanges;
+        stats[frame].skippedStateChanges = renderStats.redundantStateChanges;
+        collectGpuFrames(&gpuTimer, gpuMs, false);
+    }
+    glFinish();
+    collectGpuFrames(&gpuTimer, gpuMs, true);
+    for (unsigned int frame = 0; frame < replay.frameCount; frame++) {
+        stats[frame].gpuMs = gpuMs[frame];
+    }
+
+    Percentiles cpu = computePercentiles(cpuMs, replay.frameCount);
+    Percentiles gpu = computePercentiles(gpuMs, replay.frameCount);
+    printf("REPLAY::FRAMES %u over %.1f s at %ux%u, %u ticks\n", replay.frameCount, replay.frames[replay.frameCount - 1].time,
+        SCR_WIDTH, SCR_HEIGHT, simulation.tick);
+    printf("REPLAY::CPU_MS mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n", cpu.mean, cpu.p50, cpu.p95, cpu.p99, cpu.max);
+    printf("REPLAY::GPU_MS mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n", gpu.mean, gpu.p50, gpu.p95, gpu.p99, gpu.max);
+    bool ok = true;
+    if (replayStatsPath != NULL) {
+        ok = writeReplayStats(stats, replay.frameCount, replayStatsPath) && ok;
+    }
+    if (replayBaselinePath != NULL) {
+        ok = compareReplayStats(stats, replay.frameCount, replayBaselinePath) && ok;
+    }
+
+    printGpuMemory();
+    shutdownProfiler();
+    destroyGpuFrameTimer(&gpuTimer);
+    free(stats);
+    free(cpuMs);
+    free(gpuMs);
+    destroyRenderer(&renderer);
+    shutdownGpuMemory();
+    destroyHeadlessContext(&headless);
+    destroyReplay(&replay);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,162 @@
+#include "Material.h"
+#include "GpuMemory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool createMaterialLibrary(MaterialLibrary* library, unsigned int layerCapacity) {
+    memset(library, 0, sizeof(MaterialLibrary));
+    library->atlasLayer = -1;
+    library->layerCapacity = layerCapacity > 0 ? layerCapacity : 1;
+
+    glGenTextures(1, &library->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, library->texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, library->layerCapacity, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    // counted with the mip chain the first committed layer generates
+    trackGpuResource(GPU_TEXTURE, library->texture, GPU_MEMORY_TEXTURES,
+        getTextureBytes(MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, 4, true) * library->layerCapacity);
+
+    glGenBuffers(1, &library->uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, library->uniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_SIZE, NULL, GL_STATIC_DRAW);
+    trackGpuResource(GPU_BUFFER, library->uniformBuffer, GPU_MEMORY_STREAMING, MATERIAL_BLOCK_SIZE);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void destroyMaterialLibrary(MaterialLibrary* library) {
+    if (library->texture != 0) {
+        releaseGpuResource(GPU_TEXTURE, library->texture);
+        releaseGpuResource(GPU_BUFFER, library->uniformBuffer);
+        glDeleteTextures(1, &library->texture);
+        glDeleteBuffers(1, &library->uniformBuffer);
+    }
+    memset(library, 0, sizeof(MaterialLibrary));
+}
+
+// ATLAS
+
+// finds room for a padded width x height box in the current atlas layer, opening a new shelf or layer when needed
+static bool packAtlasEntry(MaterialLibrary* library, int width, int height, int* x, int* y) {
+    if (width > MATERIAL_LAYER_SIZE || height > MATERIAL_LAYER_SIZE) {
+        return false;
+    }
+    if (library->atlasLayer >= 0 && library->shelfX + width > MATERIAL_LAYER_SIZE) {
+        library->shelfY += library->shelfHeight;
+        library->shelfX = 0;
+        library->shelfHeight = 0;
+    }
+    if (library->atlasLayer < 0 || library->shelfY + height > MATERIAL_LAYER_SIZE) {
+        if (library->layerCount == library->layerCapacity) {
+            return false;
+        }
+        library->atlasLayer = (int)library->layerCount++;
+        library->atlasLayers++;
+        library->shelfX = library->shelfY = library->shelfHeight = 0;
+    }
+    *x = library->shelfX;
+    *y = library->shelfY;
+    library->shelfX += width;
+    if (height > library->shelfHeight) library->shelfHeight = height;
+    return true;
+}
+
+// the image with its border pixels repeated padding times on every side
+static unsigned char* padImage(const unsigned char* rgba, int width, int height, int padding) {
+    int paddedWidth = width + 2 * padding, paddedHeight = height + 2 * padding;
+    unsigned char* padded = (unsigned char*)malloc((size_t)paddedWidth * paddedHeight * 4);
+    if (padded == NULL) {
+        return NULL;
+    }
+    for (int y = 0; y < paddedHeight; y++) {
+        int sourceY = y - padding < 0 ? 0 : (y - padding >= height ? height - 1 : y - padding);
+        for (int x = 0; x < paddedWidth; x++) {
+            int sourceX = x - padding < 0 ? 0 : (x - padding >= width ? width - 1 : x - padding);
+            memcpy(&padded[((size_t)y * paddedWidth + x) * 4], &rgba[((size_t)sourceY * width + sourceX) * 4], 4);
+        }
+    }
+    return padded;
+}
+
+// MATERIALS
+
+unsigned int addMaterial(MaterialLibrary* library, const unsigned char* rgba, int width, int height) {
+    if (library->materialCount == MAX_MATERIALS) {
+        printf("ERROR::MATERIAL::TOO_MANY_MATERIALS\n");
+        return INVALID_MATERIAL;
+    }
+    Material* material = &library->materials[library->materialCount];
+    material->width = width;
+    material->height = height;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, library->texture);
+
+    if (width == MATERIAL_LAYER_SIZE && height == MATERIAL_LAYER_SIZE) {
+        if (library->layerCount == library->layerCapacity) {
+            printf("ERROR::MATERIAL::OUT_OF_LAYERS\n");
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            return INVALID_MATERIAL;
+        }
+        material->layer = library->layerCount++;
+        material->atlas = false;
+        material->uvOffset[0] = material->uvOffset[1] = 0.0f;
+        material->uvScale[0] = material->uvScale[1] = 1.0f;
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, material->layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    }
+    else {
+        int x, y;
+        unsigned char* padded = padImage(rgba, width, height, MATERIAL_ATLAS_PADDING);
+        if (padded == NULL || !packAtlasEntry(library, width + 2 * MATERIAL_ATLAS_PADDING, height + 2 * MATERIAL_ATLAS_PADDING, &x, &y)) {
+            printf("ERROR::MATERIAL::ATLAS_FULL %dx%d\n", width, height);
+            free(padded);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            return INVALID_MATERIAL;
+        }
+        material->layer = (unsigned int)library->atlasLayer;
+        material->atlas = true;
+        material->uvOffset[0] = (float)(x + MATERIAL_ATLAS_PADDING) / MATERIAL_LAYER_SIZE;
+        material->uvOffset[1] = (float)(y + MATERIAL_ATLAS_PADDING) / MATERIAL_LAYER_SIZE;
+        material->uvScale[0] = (float)width / MATERIAL_LAYER_SIZE;
+        material->uvScale[1] = (float)height / MATERIAL_LAYER_SIZE;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, material->layer, width + 2 * MATERIAL_ATLAS_PADDING,
+            height + 2 * MATERIAL_ATLAS_PADDING, 1, GL_RGBA, GL_UNSIGNED_BYTE, padded);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        free(padded);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return library->materialCount++;
+}
+
+void finishMaterialLibrary(MaterialLibrary* library) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, library->texture);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // unused entries stay zero and sample layer 0
+    float* block = (float*)calloc(2 * MAX_MATERIALS * 4, sizeof(float));
+    if (block == NULL) {
+        return;
+    }
+    for (unsigned int i = 0; i < library->materialCount; i++) {
+        const Material* material = &library->materials[i];
+        float* rect = &block[i * 4];
+        float* params = &block[(MAX_MATERIALS + i) * 4];
+        rect[0] = material->uvOffset[0];
+        rect[1] = material->uvOffset[1];
+        rect[2] = material->uvScale[0];
+        rect[3] = material->uvScale[1];
+        params[0] = (float)material->layer;
+        params[1] = material->atlas ? 0.0f : 1.0f; // whole layers may repeat
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, library->uniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, MATERIAL_BLOCK_SIZE, block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, library->uniformBuffer);
+    free(block);
+}
@@ -0,0 +1,53 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+
+// MATERIAL LIBRARY: EVERY TEXTURE IN ONE GL_TEXTURE_2D_ARRAY SO DRAWS WITH DIFFERENT TEXTURES SHARE A BIND AND A DRAW CALL.
+// layer sized images get a layer of their own, anything else is shelf packed into shared atlas layers. shaders pick
+// the layer and uv rectangle from the Materials block with a material index carried per instance (or per draw)
+
+#define MAX_MATERIALS 256 // matches the array sizes in the material shaders' Materials block
+#define INVALID_MATERIAL 0xFFFFFFFFu
+#define MATERIAL_LAYER_SIZE 512 // width and height of every layer
+#define MATERIAL_ATLAS_PADDING 4 // edge pixels repeated around atlas entries so filtering and mips do not bleed
+#define MATERIAL_BLOCK_BINDING 1 // uniform buffer binding point, next to the Camera block
+#define MATERIAL_LOCATION 7 // vertex attribute holding the material index, after the instanced mat4 at 3-6
+
+// std140 layout of the Materials block: a vec4 array of uv rectangles then a vec4 array of layer parameters
+#define MATERIAL_BLOCK_SIZE (2 * MAX_MATERIALS * 4 * sizeof(float))
+
+typedef struct Material {
+    unsigned int layer;
+    float uvOffset[2]; // where the image sits in its layer
+    float uvScale[2];
+    int width;
+    int height;
+    bool atlas; // shares its layer, texture coordinates are clamped instead of repeating
+} Material;
+
+typedef struct MaterialLibrary {
+    unsigned int texture; // GL_TEXTURE_2D_ARRAY, RGBA8 with mips
+    unsigned int uniformBuffer; // the Materials block
+    unsigned int layerCapacity;
+    unsigned int layerCount;
+    unsigned int atlasLayers; // of layerCount
+    Material materials[MAX_MATERIALS];
+    unsigned int materialCount;
+    // shelf packer for the current atlas layer
+    int atlasLayer; // -1 before the first atlas entry
+    int shelfX;
+    int shelfY;
+    int shelfHeight;
+} MaterialLibrary;
+
+bool createMaterialLibrary(MaterialLibrary* library, unsigned int layerCapacity);
+void destroyMaterialLibrary(MaterialLibrary* library);
+
+// copies an RGBA8 image into the array, returns its material index or INVALID_MATERIAL when it does not fit
+unsigned int addMaterial(MaterialLibrary* library, const unsigned char* rgba, int width, int height);
+// builds the mips and uploads the Materials block, call once after the last addMaterial and before drawing
+void finishMaterialLibrary(MaterialLibrary* library);
+
+#endif
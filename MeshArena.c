@@ -0,0 +1,440 @@
+#include "MeshArena.h"
+#include "RenderStats.h"
+#include "GpuMemory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// RANGE ALLOCATOR
+
+static bool initAllocator(RangeAllocator* allocator, unsigned int capacity) {
+    allocator->blockCapacity = 16;
+    allocator->blocks = (FreeBlock*)malloc(sizeof(FreeBlock) * allocator->blockCapacity);
+    if (allocator->blocks == NULL) {
+        return false;
+    }
+    allocator->blocks[0].offset = 0;
+    allocator->blocks[0].size = capacity;
+    allocator->blockCount = capacity > 0 ? 1 : 0;
+    allocator->capacity = capacity;
+    allocator->used = 0;
+    return true;
+}
+
+// first fit, UINT_MAX when no single block is large enough
+static unsigned int allocateRange(RangeAllocator* allocator, unsigned int size) {
+    for (unsigned int i = 0; i < allocator->blockCount; i++) {
+        FreeBlock* block = &allocator->blocks[i];
+        if (block->size < size) {
+            continue;
+        }
+        unsigned int offset = block->offset;
+        block->offset += size;
+        block->size -= size;
+        if (block->size == 0) {
+            memmove(block, block + 1, sizeof(FreeBlock) * (allocator->blockCount - i - 1));
+            allocator->blockCount--;
+        }
+        allocator->used += size;
+        return offset;
+    }
+    return 0xFFFFFFFFu;
+}
+
+static bool freeRange(RangeAllocator* allocator, unsigned int offset, unsigned int size) {
+    if (size == 0) {
+        return true;
+    }
+    // position among the sorted free blocks
+    unsigned int i = 0;
+    while (i < allocator->blockCount && allocator->blocks[i].offset < offset) {
+        i++;
+    }
+    bool mergePrevious = i > 0 && allocator->blocks[i - 1].offset + allocator->blocks[i - 1].size == offset;
+    bool mergeNext = i < allocator->blockCount && offset + size == allocator->blocks[i].offset;
+    allocator->used -= size;
+
+    if (mergePrevious && mergeNext) {
+        allocator->blocks[i - 1].size += size + allocator->blocks[i].size;
+        memmove(&allocator->blocks[i], &allocator->blocks[i + 1], sizeof(FreeBlock) * (allocator->blockCount - i - 1));
+        allocator->blockCount--;
+        return true;
+    }
+    if (mergePrevious) {
+        allocator->blocks[i - 1].size += size;
+        return true;
+    }
+    if (mergeNext) {
+        allocator->blocks[i].offset = offset;
+        allocator->blocks[i].size += size;
+        return true;
+    }
+
+    if (allocator->blockCount == allocator->blockCapacity) {
+        FreeBlock* blocks = (FreeBlock*)realloc(allocator->blocks, sizeof(FreeBlock) * allocator->blockCapacity * 2);
+        if (blocks == NULL) {
+            allocator->used += size;
+            return false; // the range leaks until the next defragment
+        }
+        allocator->blocks = blocks;
+        allocator->blockCapacity *= 2;
+    }
+    memmove(&allocator->blocks[i + 1], &allocator->blocks[i], sizeof(FreeBlock) * (allocator->blockCount - i));
+    allocator->blocks[i].offset = offset;
+    allocator->blocks[i].size = size;
+    allocator->blockCount++;
+    return true;
+}
+
+// everything before `used` taken, one free block after it
+static void resetAllocator(RangeAllocator* allocator, unsigned int capacity, unsigned int used) {
+    allocator->capacity = capacity;
+    allocator->used = used;
+    allocator->blockCount = 0;
+    if (used < capacity) {
+        allocator->blocks[0].offset = used;
+        allocator->blocks[0].size = capacity - used;
+        allocator->blockCount = 1;
+    }
+}
+
+// BUFFERS
+
+static unsigned int createBuffer(size_t size) {
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    trackGpuResource(GPU_BUFFER, buffer, GPU_MEMORY_GEOMETRY, size);
+    return buffer;
+}
+
+static void attachBuffers(MeshArena* arena) {
+    glBindVertexArray(arena->vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, arena->vertexBuffer);
+    applyVertexFormat(&arena->format);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena->indexBuffer); // recorded in the VAO
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool createMeshArena(MeshArena* arena, const VertexFormat* format, unsigned int vertexCapacity, unsigned int indexCapacity, bool allowMultiDraw) {
+    memset(arena, 0, sizeof(MeshArena));
+    arena->format = *format;
+    arena->freeMesh = INVALID_MESH;
+    arena->baseInstance = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_base_instance;
+    arena->multiDrawIndirect = allowMultiDraw && arena->baseInstance
+        && (GLAD_GL_VERSION_4_3 || (GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_draw_indirect));
+
+    arena->meshCapacity = 64;
+    arena->meshes = (ArenaMesh*)malloc(sizeof(ArenaMesh) * arena->meshCapacity);
+    if (arena->meshes == NULL || !initAllocator(&arena->vertices, vertexCapacity) || !initAllocator(&arena->indices, indexCapacity)) {
+        printf("ERROR::MESH_ARENA::ALLOCATION_FAILED\n");
+        destroyMeshArena(arena);
+        return false;
+    }
+
+    glGenVertexArrays(1, &arena->vertexArray);
+    arena->vertexBuffer = createBuffer((size_t)vertexCapacity * format->stride);
+    arena->indexBuffer = createBuffer((size_t)indexCapacity * sizeof(unsigned int));
+    attachBuffers(arena);
+    return true;
+}
+
+void destroyMeshArena(MeshArena* arena) {
+    if (arena->vertexArray != 0) {
+        glDeleteVertexArrays(1, &arena->vertexArray);
+        releaseGpuResource(GPU_BUFFER, arena->vertexBuffer);
+        releaseGpuResource(GPU_BUFFER, arena->indexBuffer);
+        glDeleteBuffers(1, &arena->vertexBuffer);
+        glDeleteBuffers(1, &arena->indexBuffer);
+    }
+    free(arena->vertices.blocks);
+    free(arena->indices.blocks);
+    free(arena->meshes);
+    memset(arena, 0, sizeof(MeshArena));
+}
+
+void setMeshArenaInstanceBuffer(MeshArena* arena, unsigned int buffer, unsigned int location, size_t offset) {
+    arena->instanceBuffer = buffer;
+    arena->instanceLocation = location;
+    arena->instanceOffset = offset;
+    glBindVertexArray(arena->vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)(offset + i * 4 * sizeof(float)));
+        glEnableVertexAttribArray(location + i);
+        glVertexAttribDivisor(location + i, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void setMeshArenaMaterialBuffer(MeshArena* arena, unsigned int buffer, unsigned int location, size_t offset) {
+    arena->materialBuffer = buffer;
+    arena->materialLocation = location;
+    arena->materialOffset = offset;
+    glBindVertexArray(arena->vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)offset);
+    glEnableVertexAttribArray(location);
+    glVertexAttribDivisor(location, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// COMPACTION
+
+static int compareByVertexOffset(const void* a, const void* b) {
+    const ArenaMesh* x = *(const ArenaMesh* const*)a;
+    const ArenaMesh* y = *(const ArenaMesh* const*)b;
+    return (x->firstVertex > y->firstVertex) - (x->firstVertex < y->firstVertex);
+}
+
+// copies every live mesh, in its current order, to the front of new buffers of the given capacity
+static bool rebuildArena(MeshArena* arena, unsigned int vertexCapacity, unsigned int indexCapacity) {
+    ArenaMesh** live = (ArenaMesh**)malloc(sizeof(ArenaMesh*) * (arena->meshCount > 0 ? arena->meshCount : 1));
+    if (live == NULL) {
+        return false;
+    }
+    unsigned int liveCount = 0;
+    for (unsigned int i = 0; i < arena->meshCount; i++) {
+        if (arena->meshes[i].live) {
+            live[liveCount++] = &arena->meshes[i];
+        }
+    }
+    qsort(live, liveCount, sizeof(ArenaMesh*), compareByVertexOffset);
+
+    unsigned int vertexBuffer = createBuffer((size_t)vertexCapacity * arena->format.stride);
+    unsigned int indexBuffer = createBuffer((size_t)indexCapacity * sizeof(unsigned int));
+    unsigned int vertexEnd = 0, indexEnd = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, arena->vertexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    for (unsigned int i = 0; i < liveCount; i++) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)live[i]->firstVertex * arena->format.stride,
+            (GLintptr)vertexEnd * arena->format.stride, (GLsizeiptr)live[i]->vertexCount * arena->format.stride);
+        live[i]->firstVertex = vertexEnd;
+        vertexEnd += live[i]->vertexCount;
+    }
+    // indices are relative to the mesh's first vertex, so they copy over unchanged
+    glBindBuffer(GL_COPY_READ_BUFFER, arena->indexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    for (unsigned int i = 0; i < liveCount; i++) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)live[i]->firstIndex * sizeof(unsigned int),
+            (GLintptr)indexEnd * sizeof(unsigned int), (GLsizeiptr)live[i]->indexCount * sizeof(unsigned int));
+        live[i]->firstIndex = indexEnd;
+        indexEnd += live[i]->indexCount;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    free(live);
+
+    releaseGpuResource(GPU_BUFFER, arena->vertexBuffer);
+    releaseGpuResource(GPU_BUFFER, arena->indexBuffer);
+    glDeleteBuffers(1, &arena->vertexBuffer);
+    glDeleteBuffers(1, &arena->indexBuffer);
+    arena->vertexBuffer = vertexBuffer;
+    arena->indexBuffer = indexBuffer;
+    attachBuffers(arena);
+    resetAllocator(&arena->vertices, vertexCapacity, vertexEnd);
+    resetAllocator(&arena->indices, indexCapacity, indexEnd);
+    return true;
+}
+
+bool defragmentMeshArena(MeshArena* arena) {
+    return rebuildArena(arena, arena->vertices.capacity, arena->indices.capacity);
+}
+
+// make room for one more mesh: pack the holes together if that is enough, otherwise grow
+static bool reserveSpace(MeshArena* arena, unsigned int vertexCount, unsigned int indexCount) {
+    unsigned int vertexCapacity = arena->vertices.capacity;
+    unsigned int indexCapacity = arena->indices.capacity;
+    while (vertexCapacity - arena->vertices.used < vertexCount) {
+        vertexCapacity = vertexCapacity > 0 ? vertexCapacity * 2 : 1024;
+    }
+    while (indexCapacity - arena->indices.used < indexCount) {
+        indexCapacity = indexCapacity > 0 ? indexCapacity * 2 : 1024;
+    }
+    return rebuildArena(arena, vertexCapacity, indexCapacity);
+}
+
+// MESHES
+
+static unsigned int allocateHandle(MeshArena* arena) {
+    if (arena->freeMesh != INVALID_MESH) {
+        unsigned int handle = arena->freeMesh;
+        arena->freeMesh = arena->meshes[handle].firstVertex; // free handles chain through firstVertex
+        return handle;
+    }
+    if (arena->meshCount == MESH_ARENA_MAX_MESHES) {
+        return INVALID_MESH;
+    }
+    if (arena->meshCount == arena->meshCapacity) {
+        ArenaMesh* meshes = (ArenaMesh*)realloc(arena->meshes, sizeof(ArenaMesh) * arena->meshCapacity * 2);
+        if (meshes == NULL) {
+            return INVALID_MESH;
+        }
+        arena->meshes = meshes;
+        arena->meshCapacity *= 2;
+    }
+    return arena->meshCount++;
+}
+
+unsigned int addMesh(MeshArena* arena, const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount) {
+    unsigned int firstVertex = allocateRange(&arena->vertices, vertexCount);
+    unsigned int firstIndex = allocateRange(&arena->indices, indexCount);
+    if (firstVertex == 0xFFFFFFFFu || firstIndex == 0xFFFFFFFFu) {
+        if (firstVertex != 0xFFFFFFFFu) freeRange(&arena->vertices, firstVertex, vertexCount);
+        if (firstIndex != 0xFFFFFFFFu) freeRange(&arena->indices, firstIndex, indexCount);
+        if (!reserveSpace(arena, vertexCount, indexCount)) {
+            printf("ERROR::MESH_ARENA::OUT_OF_MEMORY\n");
+            return INVALID_MESH;
+        }
+        firstVertex = allocateRange(&arena->vertices, vertexCount);
+        firstIndex = allocateRange(&arena->indices, indexCount);
+    }
+
+    unsigned int handle = allocateHandle(arena);
+    if (handle == INVALID_MESH) {
+        freeRange(&arena->vertices, firstVertex, vertexCount);
+        freeRange(&arena->indices, firstIndex, indexCount);
+        printf("ERROR::MESH_ARENA::TOO_MANY_MESHES\n");
+        return INVALID_MESH;
+    }
+    ArenaMesh* mesh = &arena->meshes[handle];
+    mesh->firstVertex = firstVertex;
+    mesh->vertexCount = vertexCount;
+    mesh->firstIndex = firstIndex;
+    mesh->indexCount = indexCount;
+    mesh->live = true;
+
+    // the copy targets leave the element buffer binding of whatever VAO is bound alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstVertex * arena->format.stride, (GLsizeiptr)vertexCount * arena->format.stride, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(unsigned int), (GLsizeiptr)indexCount * sizeof(unsigned int), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return handle;
+}
+
+void removeMesh(MeshArena* arena, unsigned int handle) {
+    if (handle >= arena->meshCount || !arena->meshes[handle].live) {
+        return;
+    }
+    ArenaMesh* mesh = &arena->meshes[handle];
+    freeRange(&arena->vertices, mesh->firstVertex, mesh->vertexCount);
+    freeRange(&arena->indices, mesh->firstIndex, mesh->indexCount);
+    mesh->live = false;
+    mesh->firstVertex = arena->freeMesh;
+    arena->freeMesh = handle;
+}
+
+// DRAW LISTS
+
+bool createMeshDrawList(MeshDrawList* list, unsigned int capacity) {
+    memset(list, 0, sizeof(MeshDrawList));
+    list->capacity = capacity > 0 ? capacity : 64;
+    list->commands = (DrawElementsIndirectCommand*)malloc(sizeof(DrawElementsIndirectCommand) * list->capacity);
+    if (list->commands == NULL) {
+        return false;
+    }
+    glGenBuffers(1, &list->indirectBuffer);
+    return true;
+}
+
+void destroyMeshDrawList(MeshDrawList* list) {
+    if (list->indirectBuffer != 0) {
+        releaseGpuResource(GPU_BUFFER, list->indirectBuffer);
+        glDeleteBuffers(1, &list->indirectBuffer);
+    }
+    free(list->commands);
+    memset(list, 0, sizeof(MeshDrawList));
+}
+
+void clearMeshDrawList(MeshDrawList* list) {
+    list->count = 0;
+}
+
+void addMeshDraw(MeshDrawList* list, const MeshArena* arena, unsigned int mesh, unsigned int instanceCount, unsigned int baseInstance) {
+    if (mesh >= arena->meshCount || !arena->meshes[mesh].live || instanceCount == 0) {
+        return;
+    }
+    if (list->count == list->capacity) {
+        DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)realloc(list->commands, sizeof(DrawElementsIndirectCommand) * list->capacity * 2);
+        if (commands == NULL) {
+            return;
+        }
+        list->commands = commands;
+        list->capacity *= 2;
+    }
+    const ArenaMesh* source = &arena->meshes[mesh];
+    DrawElementsIndirectCommand* command = &list->commands[list->count++];
+    command->count = source->indexCount;
+    command->instanceCount = instanceCount;
+    command->firstIndex = source->firstIndex;
+    command->baseVertex = (int)source->firstVertex;
+    command->baseInstance = baseInstance;
+}
+
+// without base instances the per-instance attribute is re-pointed instead
+static void offsetInstanceAttributes(const MeshArena* arena, unsigned int baseInstance) {
+    glBindBuffer(GL_ARRAY_BUFFER, arena->instanceBuffer);
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribPointer(arena->instanceLocation + i, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+            (void*)(arena->instanceOffset + (size_t)baseInstance * 16 * sizeof(float) + i * 4 * sizeof(float)));
+    }
+    if (arena->materialBuffer != 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, arena->materialBuffer);
+        glVertexAttribPointer(arena->materialLocation, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+            (void*)(arena->materialOffset + (size_t)baseInstance * sizeof(float)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void drawMeshList(MeshArena* arena, MeshDrawList* list) {
+    if (list->count == 0) {
+        return;
+    }
+    unsigned int triangles = 0, instances = 0;
+    for (unsigned int i = 0; i < list->count; i++) {
+        triangles += list->commands[i].count / 3 * list->commands[i].instanceCount;
+        instances += list->commands[i].instanceCount;
+    }
+
+    if (arena->multiDrawIndirect) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, list->indirectBuffer);
+        size_t bytes = sizeof(DrawElementsIndirectCommand) * list->count;
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, bytes, list->commands, GL_STREAM_DRAW);
+        if (bytes != list->indirectBytes) {
+            trackGpuResource(GPU_BUFFER, list->indirectBuffer, GPU_MEMORY_STREAMING, bytes);
+            list->indirectBytes = bytes;
+        }
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, list->count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        countMultiDrawCall(list->count, triangles, instances);
+        return;
+    }
+
+    // GL 3.3: one base-vertex draw per mesh
+    bool offset = false;
+    for (unsigned int i = 0; i < list->count; i++) {
+        const DrawElementsIndirectCommand* command = &list->commands[i];
+        void* firstIndex = (void*)((size_t)command->firstIndex * sizeof(unsigned int));
+        if (command->baseInstance != 0 && arena->baseInstance) {
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command->count, GL_UNSIGNED_INT, firstIndex,
+                command->instanceCount, command->baseVertex, command->baseInstance);
+        }
+        else {
+            if (arena->instanceBuffer != 0 && (command->baseInstance != 0 || offset)) {
+                offsetInstanceAttributes(arena, command->baseInstance);
+                offset = command->baseInstance != 0;
+            }
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command->count, GL_UNSIGNED_INT, firstIndex, command->instanceCount, command->baseVertex);
+        }
+        countDrawCall(command->count / 3, command->instanceCount);
+    }
+    if (offset) {
+        offsetInstanceAttributes(arena, 0);
+    }
+}
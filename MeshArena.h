@@ -0,0 +1,100 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+#include "VertexFormat.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// SHARED GEOMETRY BUFFERS: EVERY MESH OF ONE VERTEX FORMAT LIVES IN THE SAME VBO/EBO PAIR BEHIND ONE VAO,
+// SO ANY NUMBER OF THEM DRAW WITH A SINGLE glMultiDrawElementsIndirect
+
+#define MESH_ARENA_MAX_MESHES 65536
+#define INVALID_MESH 0xFFFFFFFFu
+
+// free-list over [0, capacity) in elements, free blocks sorted by offset and merged with their neighbours
+typedef struct FreeBlock {
+    unsigned int offset;
+    unsigned int size;
+} FreeBlock;
+
+typedef struct RangeAllocator {
+    FreeBlock* blocks;
+    unsigned int blockCount;
+    unsigned int blockCapacity;
+    unsigned int capacity;
+    unsigned int used;
+} RangeAllocator;
+
+typedef struct ArenaMesh {
+    unsigned int firstVertex;
+    unsigned int vertexCount;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    bool live;
+} ArenaMesh;
+
+// layout fixed by GL for indirect draws
+typedef struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+} DrawElementsIndirectCommand;
+
+// draws collected for one multi-draw, indices in the arena are relative to each mesh's first vertex
+typedef struct MeshDrawList {
+    DrawElementsIndirectCommand* commands;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int indirectBuffer;
+    size_t indirectBytes; // last given to the GPU memory tracker
+} MeshDrawList;
+
+typedef struct MeshArena {
+    unsigned int vertexArray;
+    unsigned int vertexBuffer;
+    unsigned int indexBuffer; // GL_UNSIGNED_INT
+    VertexFormat format; // every vertex in the arena is stored this way
+    RangeAllocator vertices;
+    RangeAllocator indices;
+    ArenaMesh* meshes; // handles index this table, defragmenting moves the data but never the handles
+    unsigned int meshCount;
+    unsigned int meshCapacity;
+    unsigned int freeMesh; // first reusable handle, INVALID_MESH when none
+    // per-instance mat4 at locations instanceLocation..+3, for base instances without GL 4.2
+    unsigned int instanceBuffer;
+    unsigned int instanceLocation;
+    size_t instanceOffset; // bytes, where instance 0 starts in the buffer
+    // optional per-instance float material index, selected by the same base instance
+    unsigned int materialBuffer;
+    unsigned int materialLocation;
+    size_t materialOffset;
+    bool multiDrawIndirect; // GL 4.3 / ARB_multi_draw_indirect, otherwise one base-vertex draw per mesh
+    bool baseInstance; // GL 4.2 / ARB_base_instance
+} MeshArena;
+
+// capacities are starting sizes in vertices and indices, the arena grows when they run out
+bool createMeshArena(MeshArena* arena, const VertexFormat* format, unsigned int vertexCapacity, unsigned int indexCapacity, bool allowMultiDraw);
+void destroyMeshArena(MeshArena* arena);
+// binds a mat4 per-instance attribute to the arena's VAO starting at offset, baseInstance selects into it per draw.
+// cheap enough to call every frame when the matrices move around a stream buffer
+void setMeshArenaInstanceBuffer(MeshArena* arena, unsigned int buffer, unsigned int location, size_t offset);
+// the same for one float per instance, draws without it read the attribute's current value instead
+void setMeshArenaMaterialBuffer(MeshArena* arena, unsigned int buffer, unsigned int location, size_t offset);
+
+// returns the mesh handle or INVALID_MESH, vertices are already in the arena's format and indices relative to them
+unsigned int addMesh(MeshArena* arena, const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+void removeMesh(MeshArena* arena, unsigned int mesh);
+// packs every live mesh to the front of fresh buffers, the free lists become one block each
+bool defragmentMeshArena(MeshArena* arena);
+
+bool createMeshDrawList(MeshDrawList* list, unsigned int capacity);
+void destroyMeshDrawList(MeshDrawList* list);
+void clearMeshDrawList(MeshDrawList* list);
+void addMeshDraw(MeshDrawList* list, const MeshArena* arena, unsigned int mesh, unsigned int instanceCount, unsigned int baseInstance);
+// expects the arena's VAO and the program to be bound already
+void drawMeshList(MeshArena* arena, MeshDrawList* list);
+
+#endif
@@ -0,0 +1,558 @@
+#include "MeshCache.h"
+#include "MeshOptimize.h"
+#include "MeshSimplify.h"
+#include "Platform.h"
+#include "GpuMemory.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DATA_ALIGNMENT 16
+#define SOURCE_STRIDE 8 // floats per parsed vertex: position, color, texture coordinates
+
+void getMeshCachePath(const char* sourcePath, char* cachePath, size_t cachePathSize) {
+    snprintf(cachePath, cachePathSize, "%s%s", sourcePath, MESH_CACHE_EXTENSION);
+}
+
+// OBJ
+
+typedef struct Growable {
+    void* data;
+    size_t count;
+    size_t capacity;
+    size_t elementSize;
+} Growable;
+
+static void* pushElements(Growable* array, size_t count) {
+    if (array->count + count > array->capacity) {
+        size_t capacity = array->capacity > 0 ? array->capacity * 2 : 1024;
+        while (capacity < array->count + count) capacity *= 2;
+        void* data = realloc(array->data, capacity * array->elementSize);
+        if (data == NULL) {
+            return NULL;
+        }
+        array->data = data;
+        array->capacity = capacity;
+    }
+    void* slot = (unsigned char*)array->data + array->count * array->elementSize;
+    array->count += count;
+    return slot;
+}
+
+// position/texture coordinate index pairs -> output vertex, open addressing
+typedef struct VertexMap {
+    uint64_t* keys; // (position + 1) << 32 | (uv + 1), 0 marks an empty slot
+    unsigned int* values;
+    size_t capacity;
+    size_t count;
+} VertexMap;
+
+static size_t hashKey(uint64_t key, size_t capacity) {
+    key *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(key >> 32) & (capacity - 1);
+}
+
+static bool growVertexMap(VertexMap* map) {
+    size_t capacity = map->capacity > 0 ? map->capacity * 2 : 4096;
+    uint64_t* keys = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    unsigned int* values = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    if (keys == NULL || values == NULL) {
+        free(keys);
+        free(values);
+        return false;
+    }
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->keys[i] == 0) continue;
+        size_t slot = hashKey(map->keys[i], capacity);
+        while (keys[slot] != 0) slot = (slot + 1) & (capacity - 1);
+        keys[slot] = map->keys[i];
+        values[slot] = map->values[i];
+    }
+    free(map->keys);
+    free(map->values);
+    map->keys = keys;
+    map->values = values;
+    map->capacity = capacity;
+    return true;
+}
+
+// index of the existing vertex, or of the one the caller must append when *added is set
+static bool findVertex(VertexMap* map, uint64_t key, unsigned int next, unsigned int* index, bool* added) {
+    if ((map->count + 1) * 2 > map->capacity && !growVertexMap(map)) {
+        return false;
+    }
+    size_t slot = hashKey(key, map->capacity);
+    while (map->keys[slot] != 0 && map->keys[slot] != key) {
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    *added = map->keys[slot] == 0;
+    if (*added) {
+        map->keys[slot] = key;
+        map->values[slot] = next;
+        map->count++;
+    }
+    *index = map->values[slot];
+    return true;
+}
+
+// 1-based, negative counts back from the end, 0 when missing or out of range
+static long resolveIndex(long index, size_t count) {
+    if (index < 0) index += (long)count + 1;
+    return index >= 1 && (size_t)index <= count ? index : 0;
+}
+
+static bool parseObj(const char* path, Growable* vertices, Growable* indices) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("ERROR::MESH::SOURCE_OPEN_FAILED %s\n", path);
+        return false;
+    }
+    Growable positions = { NULL, 0, 0, sizeof(float) * 6 };
+    Growable uvs = { NULL, 0, 0, sizeof(float) * 2 };
+    VertexMap map = { NULL, NULL, 0, 0 };
+    char line[4096];
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), file) != NULL) {
+        char* cursor = line;
+        size_t length = strlen(line);
+        if (length == sizeof(line) - 1 && line[length - 1] != '\n' && !feof(file)) {
+            // the rest would be read as a line of its own and a face cut short without a word
+            printf("ERROR::MESH::SOURCE_LINE_TOO_LONG %s\n", path);
+            ok = false;
+            break;
+        }
+        if (line[0] == 'v' && line[1] == ' ') {
+            float* p = (float*)pushElements(&positions, 1);
+            ok = p != NULL;
+            if (ok) {
+                cursor += 2;
+                for (int i = 0; i < 6; i++) {
+                    char* end;
+                    float value = strtof(cursor, &end);
+                    p[i] = end != cursor ? value : 1.0f; // no vertex color means white
+                    cursor = end;
+                }
+            }
+        }
+        else if (line[0] == 'v' && line[1] == 't' && line[2] == ' ') {
+            float* t = (float*)pushElements(&uvs, 1);
+            ok = t != NULL;
+            if (ok) {
+                cursor += 3;
+                t[0] = strtof(cursor, &cursor);
+                t[1] = strtof(cursor, &cursor);
+            }
+        }
+        else if (line[0] == 'f' && line[1] == ' ') {
+            cursor += 2;
+            // polygons of any size become fans around their first corner, a triangle per corner after the second
+            unsigned int cornerCount = 0, firstCorner = 0, previousCorner = 0;
+            while (ok) {
+                char* end;
+                long p = resolveIndex(strtol(cursor, &end, 10), positions.count);
+                if (end == cursor) break;
+                cursor = end;
+                long t = 0;
+                if (*cursor == '/') {
+                    cursor++;
+                    t = resolveIndex(strtol(cursor, &end, 10), uvs.count);
+                    cursor = end;
+                    if (*cursor == '/') {
+                        strtol(cursor + 1, &end, 10); // normals are not used by any shader
+                        cursor = end;
+                    }
+                }
+                if (p == 0) {
+                    ok = false;
+                    break;
+                }
+                unsigned int index;
+                bool added;
+                uint64_t key = ((uint64_t)p << 32) | (uint64_t)t;
+                ok = findVertex(&map, key, (unsigned int)vertices->count, &index, &added);
+                if (ok && added) {
+                    float* v = (float*)pushElements(vertices, 1);
+                    ok = v != NULL;
+                    if (ok) {
+                        memcpy(v, (float*)positions.data + (p - 1) * 6, sizeof(float) * 6);
+                        v[6] = t > 0 ? ((float*)uvs.data)[(t - 1) * 2] : 0.0f;
+                        v[7] = t > 0 ? ((float*)uvs.data)[(t - 1) * 2 + 1] : 0.0f;
+                    }
+                }
+                if (!ok) break;
+                if (cornerCount == 0) firstCorner = index;
+                if (cornerCount >= 2) {
+                    unsigned int* triangle = (unsigned int*)pushElements(indices, 3);
+                    ok = triangle != NULL;
+                    if (ok) {
+                        triangle[0] = firstCorner;
+                        triangle[1] = previousCorner;
+                        triangle[2] = index;
+                    }
+                }
+                previousCorner = index;
+                cornerCount++;
+            }
+        }
+    }
+    fclose(file);
+    free(positions.data);
+    free(uvs.data);
+    free(map.keys);
+    free(map.values);
+    if (!ok || indices->count == 0) {
+        printf("ERROR::MESH::SOURCE_PARSE_FAILED %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// COOK
+
+static bool writePadding(FILE* file, uint64_t* offset) {
+    static const unsigned char zeros[DATA_ALIGNMENT] = { 0 };
+    size_t padding = (size_t)((DATA_ALIGNMENT - (*offset % DATA_ALIGNMENT)) % DATA_ALIGNMENT);
+    *offset += padding;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+static uint64_t alignOffset(uint64_t offset) {
+    return offset + (DATA_ALIGNMENT - (offset % DATA_ALIGNMENT)) % DATA_ALIGNMENT;
+}
+
+// appends ever coarser levels after the full detail indices, each simplified from the full mesh to half the triangles
+// of the one before so its error is measured against what the runtime compares it with
+static bool buildLods(Growable* indexArray, const float* vertices, unsigned int vertexCount, MeshCacheHeader* header) {
+    unsigned int fullCount = header->lods[0].indexCount;
+    float extent = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        float low = vertices[c], high = vertices[c];
+        for (unsigned int v = 1; v < vertexCount; v++) {
+            low = fminf(low, vertices[(size_t)v * SOURCE_STRIDE + c]);
+            high = fmaxf(high, vertices[(size_t)v * SOURCE_STRIDE + c]);
+        }
+        extent = fmaxf(extent, high - low);
+    }
+    unsigned int* simplified = (unsigned int*)malloc(sizeof(unsigned int) * fullCount);
+    unsigned int* clusters = (unsigned int*)malloc(sizeof(unsigned int) * (fullCount / 3));
+    bool ok = simplified != NULL && clusters != NULL;
+    unsigned int previousCount = fullCount;
+    while (ok && header->lodCount < MESH_MAX_LODS) {
+        unsigned int targetCount = previousCount / 6 * 3;
+        if (targetCount / 3 < MESH_LOD_MIN_TRIANGLES) break;
+        float error;
+        unsigned int count = simplifyMesh(simplified, (const unsigned int*)indexArray->data, fullCount, vertices, SOURCE_STRIDE, vertexCount, targetCount, &error);
+        if (count > previousCount * MESH_LOD_MIN_REDUCTION) break; // locked borders or folds stopped it
+        if (error > extent * MESH_LOD_MAX_ERROR) break; // too coarse to be worth drawing at any distance
+        unsigned int clusterCount;
+        ok = optimizeVertexCache(simplified, count, vertexCount, VERTEX_CACHE_SIZE, clusters, &clusterCount);
+        unsigned int* slot = ok ? (unsigned int*)pushElements(indexArray, count) : NULL;
+        ok = slot != NULL;
+        if (ok) {
+            memcpy(slot, simplified, sizeof(unsigned int) * count);
+            MeshCacheLod* lod = &header->lods[header->lodCount];
+            lod->firstIndex = (uint32_t)(indexArray->count - count);
+            lod->indexCount = count;
+            lod->error = fmaxf(error, header->lods[header->lodCount - 1].error); // never claim a coarser level is closer
+            header->lodCount++;
+            previousCount = count;
+        }
+    }
+    free(simplified);
+    free(clusters);
+    return ok;
+}
+
+bool cookMesh(const char* sourcePath) {
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (!getFileInfo(sourcePath, &header.sourceSize, &header.sourceTime)) {
+        printf("ERROR::MESH::SOURCE_NOT_FOUND %s\n", sourcePath);
+        return false;
+    }
+    Growable vertexArray = { NULL, 0, 0, sizeof(float) * SOURCE_STRIDE };
+    Growable indexArray = { NULL, 0, 0, sizeof(unsigned int) };
+    if (!parseObj(sourcePath, &vertexArray, &indexArray)) {
+        free(vertexArray.data);
+        free(indexArray.data);
+        return false;
+    }
+    float* vertices = (float*)vertexArray.data;
+    unsigned int* indices = (unsigned int*)indexArray.data;
+    unsigned int vertexCount = (unsigned int)vertexArray.count;
+    unsigned int indexCount = (unsigned int)indexArray.count;
+
+    // triangle order for the post-transform cache, then clusters against overdraw, then vertices in fetch order
+    header.sourceCacheMisses = countCacheMisses(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE);
+    unsigned int* clusters = (unsigned int*)malloc(sizeof(unsigned int) * (indexCount / 3));
+    unsigned int clusterCount = 0;
+    bool ok = clusters != NULL
+        && optimizeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE, clusters, &clusterCount)
+        && optimizeOverdraw(indices, indexCount, vertices, SOURCE_STRIDE, vertexCount, clusters, clusterCount, OVERDRAW_THRESHOLD);
+    free(clusters);
+
+    // levels of detail reuse the full detail vertices, so fetch order is decided over all of them together
+    header.lodCount = 1;
+    header.lods[0].indexCount = indexCount;
+    ok = ok && buildLods(&indexArray, vertices, vertexCount, &header);
+    indices = (unsigned int*)indexArray.data;
+    indexCount = (unsigned int)indexArray.count;
+    vertexCount = optimizeVertexFetch(vertices, SOURCE_STRIDE, vertexCount, indices, indexCount);
+    for (unsigned int l = 0; l < header.lodCount; l++) {
+        header.lods[l].cacheMisses = countCacheMisses(indices + header.lods[l].firstIndex, header.lods[l].indexCount, vertexCount, VERTEX_CACHE_SIZE);
+    }
+    header.cacheMisses = header.lods[0].cacheMisses;
+
+    // positions go into [-1, 1] across the bounds, texture coordinates stay unorm16 unless they tile
+    bool unitUVs = true;
+    for (int c = 0; c < 3; c++) {
+        header.boundsMin[c] = header.boundsMax[c] = vertices[c];
+    }
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        float* vertex = &vertices[(size_t)v * SOURCE_STRIDE];
+        for (int c = 0; c < 3; c++) {
+            header.boundsMin[c] = fminf(header.boundsMin[c], vertex[c]);
+            header.boundsMax[c] = fmaxf(header.boundsMax[c], vertex[c]);
+        }
+        unitUVs = unitUVs && vertex[6] >= 0.0f && vertex[6] <= 1.0f && vertex[7] >= 0.0f && vertex[7] <= 1.0f;
+    }
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        float* vertex = &vertices[(size_t)v * SOURCE_STRIDE];
+        for (int c = 0; c < 3; c++) {
+            float center = (header.boundsMin[c] + header.boundsMax[c]) * 0.5f;
+            float halfExtent = (header.boundsMax[c] - header.boundsMin[c]) * 0.5f;
+            vertex[c] = halfExtent > 0.0f ? (vertex[c] - center) / halfExtent : 0.0f;
+        }
+    }
+    VertexFormat format;
+    initVertexFormat(&format, "cooked", SOURCE_STRIDE);
+    addVertexAttribute(&format, 0, 3, ENCODING_SNORM16, 0, 3);
+    addVertexAttribute(&format, 1, 4, ENCODING_UNORM8, 3, 3);
+    addVertexAttribute(&format, 2, 2, unitUVs ? ENCODING_UNORM16 : ENCODING_HALF, 6, 2);
+
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.vertexStride = format.stride;
+    header.indexSize = vertexCount <= 65536 ? 2 : 4;
+    header.attributeCount = format.attributeCount;
+    for (unsigned int i = 0; i < format.attributeCount; i++) {
+        header.attributes[i].location = format.attributes[i].location;
+        header.attributes[i].components = format.attributes[i].components;
+        header.attributes[i].encoding = format.attributes[i].encoding;
+        header.attributes[i].offset = format.attributes[i].offset;
+    }
+    size_t vertexBytes = (size_t)vertexCount * format.stride;
+    size_t indexBytes = (size_t)indexCount * header.indexSize;
+    header.vertexOffset = alignOffset(sizeof(MeshCacheHeader));
+    header.indexOffset = alignOffset(header.vertexOffset + vertexBytes);
+
+    void* vertexData = ok ? malloc(vertexBytes) : NULL;
+    void* indexData = ok ? malloc(indexBytes) : NULL;
+    ok = vertexData != NULL && indexData != NULL;
+    if (ok) {
+        encodeVertices(&format, vertices, vertexCount, vertexData);
+        if (header.indexSize == 2) {
+            for (unsigned int i = 0; i < indexCount; i++) {
+                ((uint16_t*)indexData)[i] = (uint16_t)indices[i];
+            }
+        }
+        else {
+            memcpy(indexData, indices, indexBytes);
+        }
+    }
+
+    // write to a temporary file and swap it in so a half written cache is never picked up
+    char cachePath[512], temporaryPath[520];
+    getMeshCachePath(sourcePath, cachePath, sizeof(cachePath));
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", cachePath);
+    FILE* file = ok ? fopen(temporaryPath, "wb") : NULL;
+    if (file != NULL) {
+        uint64_t offset = sizeof(MeshCacheHeader);
+        ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && writePadding(file, &offset) && fwrite(vertexData, 1, vertexBytes, file) == vertexBytes;
+        offset += vertexBytes;
+        ok = ok && writePadding(file, &offset) && fwrite(indexData, 1, indexBytes, file) == indexBytes;
+        ok = fclose(file) == 0 && ok;
+        if (ok) {
+            remove(cachePath);
+            ok = rename(temporaryPath, cachePath) == 0;
+        }
+        if (!ok) {
+            remove(temporaryPath);
+        }
+    }
+    else {
+        ok = false;
+    }
+
+    if (ok) {
+        unsigned int triangles = header.lods[0].indexCount / 3;
+        printf("MESH::COOKED %s: %u vertices, %u triangles, %u-bit indices, %u bytes per vertex, vertex shader runs %u -> %u (ACMR %.3f -> %.3f)\n",
+            cachePath, vertexCount, triangles, header.indexSize * 8, format.stride, header.sourceCacheMisses, header.cacheMisses,
+            (double)header.sourceCacheMisses / triangles, (double)header.cacheMisses / triangles);
+        for (unsigned int l = 0; l < header.lodCount; l++) {
+            const MeshCacheLod* lod = &header.lods[l];
+            printf("MESH::LOD %u: %u triangles, error %.5f, ACMR %.3f\n", l, lod->indexCount / 3, lod->error,
+                (double)lod->cacheMisses / (lod->indexCount / 3));
+        }
+    }
+    else {
+        printf("ERROR::MESH::COOK_FAILED %s\n", cachePath);
+    }
+    free(vertexData);
+    free(indexData);
+    free(vertexArray.data);
+    free(indexArray.data);
+    return ok;
+}
+
+// LOAD
+
+static bool validateCache(const MappedFile* file, const char* sourcePath) {
+    if (file->size < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+    const MeshCacheHeader* header = (const MeshCacheHeader*)file->data;
+    uint64_t sourceSize, sourceTime;
+    if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION) {
+        return false;
+    }
+    if (getFileInfo(sourcePath, &sourceSize, &sourceTime) && (sourceSize != header->sourceSize || sourceTime != header->sourceTime)) {
+        return false; // the source changed since cooking
+    }
+    if ((header->indexSize != 2 && header->indexSize != 4) || header->attributeCount > MAX_VERTEX_ATTRIBUTES || header->indexCount == 0) {
+        return false;
+    }
+    if (header->lodCount == 0 || header->lodCount > MESH_MAX_LODS) {
+        return false;
+    }
+    for (unsigned int l = 0; l < header->lodCount; l++) {
+        if ((uint64_t)header->lods[l].firstIndex + header->lods[l].indexCount > header->indexCount) {
+            return false;
+        }
+    }
+    uint64_t vertexBytes = (uint64_t)header->vertexCount * header->vertexStride;
+    uint64_t indexBytes = (uint64_t)header->indexCount * header->indexSize;
+    if (header->vertexOffset > file->size || vertexBytes > file->size - header->vertexOffset
+        || header->indexOffset > file->size || indexBytes > file->size - header->indexOffset || header->indexOffset % header->indexSize != 0) {
+        return false;
+    }
+
+    // the vertex array is set up from these, every attribute has to lie inside the stride
+    for (unsigned int i = 0; i < header->attributeCount; i++) {
+        const MeshCacheAttribute* attribute = &header->attributes[i];
+        if (attribute->encoding > ENCODING_SNORM16 || attribute->components == 0 || attribute->components > 4 || attribute->offset % 4 != 0
+            || attribute->offset + attribute->components * getEncodingSize((VertexEncoding)attribute->encoding) > header->vertexStride) {
+            printf("ERROR::MESH_CACHE::CORRUPT_ATTRIBUTE %u of %s\n", i, sourcePath);
+            return false;
+        }
+    }
+
+    // an index past the vertices would have the GPU read outside the buffer
+    const unsigned char* indices = (const unsigned char*)file->data + header->indexOffset;
+    for (unsigned int i = 0; i < header->indexCount; i++) {
+        uint32_t index = header->indexSize == 2 ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+        if (index >= header->vertexCount) {
+            printf("ERROR::MESH_CACHE::INDEX_OUT_OF_RANGE %u >= %u vertices in %s\n", index, header->vertexCount, sourcePath);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadCachedMesh(const char* sourcePath, CachedMesh* mesh) {
+    char cachePath[512];
+    getMeshCachePath(sourcePath, cachePath, sizeof(cachePath));
+
+    MappedFile file;
+    if (!mapFile(cachePath, &file)) {
+        return false;
+    }
+    if (!validateCache(&file, sourcePath)) {
+        unmapFile(&file);
+        return false;
+    }
+    const MeshCacheHeader* header = (const MeshCacheHeader*)file.data;
+    const unsigned char* base = (const unsigned char*)file.data;
+
+    VertexFormat format;
+    initVertexFormat(&format, "cooked", 0);
+    for (unsigned int i = 0; i < header->attributeCount; i++) {
+        VertexAttribute* attribute = &format.attributes[i];
+        attribute->location = header->attributes[i].location;
+        attribute->components = header->attributes[i].components;
+        attribute->encoding = (VertexEncoding)header->attributes[i].encoding;
+        attribute->offset = header->attributes[i].offset;
+    }
+    format.attributeCount = header->attributeCount;
+    format.stride = header->vertexStride;
+
+    memset(mesh, 0, sizeof(CachedMesh));
+    mesh->vertexCount = header->vertexCount;
+    mesh->indexCount = header->indexCount;
+    mesh->indexType = header->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    mesh->cacheMisses = header->cacheMisses;
+    mesh->lodCount = header->lodCount;
+    for (unsigned int l = 0; l < header->lodCount; l++) {
+        mesh->lods[l].firstIndex = header->lods[l].firstIndex;
+        mesh->lods[l].indexCount = header->lods[l].indexCount;
+        mesh->lods[l].error = header->lods[l].error;
+    }
+
+    // no parsing and no staging copy, the driver reads the mapped pages directly
+    glGenVertexArrays(1, &mesh->vertexArray);
+    glGenBuffers(1, &mesh->vertexBuffer);
+    glGenBuffers(1, &mesh->indexBuffer);
+    glBindVertexArray(mesh->vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)header->vertexCount * header->vertexStride, base + header->vertexOffset, GL_STATIC_DRAW);
+    applyVertexFormat(&format);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)header->indexCount * header->indexSize, base + header->indexOffset, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    trackGpuResource(GPU_BUFFER, mesh->vertexBuffer, GPU_MEMORY_GEOMETRY, (size_t)header->vertexCount * header->vertexStride);
+    trackGpuResource(GPU_BUFFER, mesh->indexBuffer, GPU_MEMORY_GEOMETRY, (size_t)header->indexCount * header->indexSize);
+
+    vec3 center, halfExtent;
+    for (int c = 0; c < 3; c++) {
+        mesh->boundsMin[c] = header->boundsMin[c];
+        mesh->boundsMax[c] = header->boundsMax[c];
+        center[c] = (header->boundsMin[c] + header->boundsMax[c]) * 0.5f;
+        halfExtent[c] = (header->boundsMax[c] - header->boundsMin[c]) * 0.5f;
+    }
+    glm_mat4_identity(mesh->dequantize);
+    glm_translate(mesh->dequantize, center);
+    glm_scale(mesh->dequantize, halfExtent);
+
+    unmapFile(&file);
+    return true;
+}
+
+void destroyCachedMesh(CachedMesh* mesh) {
+    if (mesh->vertexArray != 0) {
+        glDeleteVertexArrays(1, &mesh->vertexArray);
+        releaseGpuResource(GPU_BUFFER, mesh->vertexBuffer);
+        releaseGpuResource(GPU_BUFFER, mesh->indexBuffer);
+        glDeleteBuffers(1, &mesh->vertexBuffer);
+        glDeleteBuffers(1, &mesh->indexBuffer);
+    }
+    memset(mesh, 0, sizeof(CachedMesh));
+}
+
+// LEVEL OF DETAIL
+
+unsigned int selectMeshLod(const CachedMesh* mesh, float scale, float distance, float pixelsPerUnit, float threshold, unsigned int current) {
+    float pixelsPerError = scale * pixelsPerUnit / fmaxf(distance, 1e-4f);
+    for (unsigned int l = mesh->lodCount - 1; l > 0; l--) {
+        float limit = l > current ? threshold * (1.0f - LOD_HYSTERESIS) : threshold;
+        if (mesh->lods[l].error * pixelsPerError <= limit) {
+            return l;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "VertexFormat.h"
+
+// COOKED MESH CONTAINER (.cmesh)
+// header, then the vertex data and the index data at 16-byte aligned offsets, both exactly as the GL buffers
+// hold them so loading is map + glBufferData. the cooker reads Wavefront OBJ and reorders triangles and
+// vertices for the post-transform cache, overdraw and vertex fetch before writing. every coarser level of detail
+// is a run of its own inside the one index buffer, all of them index the same vertices
+
+#define MESH_CACHE_MAGIC 0x48534D43u // "CMSH"
+#define MESH_CACHE_VERSION 2u
+#define MESH_CACHE_EXTENSION ".cmesh"
+#define MESH_MAX_LODS 8
+#define MESH_LOD_MIN_TRIANGLES 64 // the chain stops before a level would drop below this
+#define MESH_LOD_MIN_REDUCTION 0.9f // or when a level keeps more than this fraction of the previous one's triangles
+#define MESH_LOD_MAX_ERROR 0.05f // or when its error passes this fraction of the model's largest extent
+#define LOD_HYSTERESIS 0.25f // a coarser level is only taken once its error is this far under the threshold
+
+typedef struct MeshCacheAttribute {
+    uint32_t location;
+    uint32_t components;
+    uint32_t encoding; // VertexEncoding
+    uint32_t offset;
+} MeshCacheAttribute;
+
+typedef struct MeshCacheLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error; // how far the surface may have moved from the full detail mesh, in source model units
+    uint32_t cacheMisses;
+} MeshCacheLod;
+
+typedef struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize; // source model size and modification time, a mismatch means the cache is stale
+    uint64_t sourceTime;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexStride;
+    uint32_t indexSize; // 2 whenever the vertex count allows it, otherwise 4
+    uint32_t attributeCount;
+    uint32_t cacheMisses; // vertex shader runs for one draw with a VERTEX_CACHE_SIZE FIFO cache
+    uint32_t sourceCacheMisses; // the same in the order the source file had
+    uint32_t lodCount; // level 0 is the full detail mesh
+    float boundsMin[3]; // positions are stored as snorm16 across these bounds
+    float boundsMax[3];
+    uint64_t vertexOffset; // from the start of the file
+    uint64_t indexOffset;
+    MeshCacheAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+    MeshCacheLod lods[MESH_MAX_LODS];
+} MeshCacheHeader;
+
+typedef struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;
+} MeshLod;
+
+typedef struct CachedMesh {
+    unsigned int vertexArray;
+    unsigned int vertexBuffer;
+    unsigned int indexBuffer;
+    unsigned int indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    unsigned int vertexCount;
+    unsigned int indexCount; // every level together
+    unsigned int cacheMisses;
+    MeshLod lods[MESH_MAX_LODS];
+    unsigned int lodCount;
+    vec3 boundsMin;
+    vec3 boundsMax;
+    mat4 dequantize; // maps the stored [-1, 1] positions back into the bounds, model * dequantize
+} CachedMesh;
+
+void getMeshCachePath(const char* sourcePath, char* cachePath, size_t cachePathSize);
+
+// parses an OBJ (v with optional vertex colors, vt, f with any number of corners), optimizes and writes the cache.
+// needs no GL context, the -cook-mesh command line runs it offline
+bool cookMesh(const char* sourcePath);
+
+// maps a fresh cache file and hands its vertex and index regions straight to glBufferData, returns false (and creates
+// nothing) when there is no usable cache so the caller can cook first: missing, stale, or with an index past the
+// vertices or an attribute outside the stride
+bool loadCachedMesh(const char* sourcePath, CachedMesh* mesh);
+void destroyCachedMesh(CachedMesh* mesh);
+
+// coarsest level whose error, scaled by the model matrix scale and projected at distance, stays under threshold pixels.
+// pixelsPerUnit is what one unit one unit away covers on screen. levels coarser than current must beat the threshold
+// by LOD_HYSTERESIS before they are taken, so an object sitting on a boundary does not pop back and forth
+unsigned int selectMeshLod(const CachedMesh* mesh, float scale, float distance, float pixelsPerUnit, float threshold, unsigned int current);
+
+#endif
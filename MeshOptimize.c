@@ -0,0 +1,270 @@
+#include "MeshOptimize.h"
+#include <cglm/cglm.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+unsigned int countCacheMisses(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize) {
+    // timestamp of each vertex's entry into the FIFO, it is still cached while fewer than cacheSize entered after it
+    unsigned int* entered = (unsigned int*)calloc(vertexCount, sizeof(unsigned int));
+    if (entered == NULL) {
+        return indexCount;
+    }
+    unsigned int misses = 0;
+    for (unsigned int i = 0; i < indexCount; i++) {
+        unsigned int v = indices[i];
+        if (entered[v] == 0 || misses + 1 - entered[v] > cacheSize) {
+            misses++;
+            entered[v] = misses;
+        }
+    }
+    free(entered);
+    return misses;
+}
+
+// TIPSIFY
+
+typedef struct Adjacency {
+    unsigned int* offsets; // vertexCount + 1
+    unsigned int* triangles;
+} Adjacency;
+
+static bool buildAdjacency(Adjacency* adjacency, const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount) {
+    adjacency->offsets = (unsigned int*)calloc(vertexCount + 1, sizeof(unsigned int));
+    adjacency->triangles = (unsigned int*)malloc(sizeof(unsigned int) * (indexCount > 0 ? indexCount : 1));
+    if (adjacency->offsets == NULL || adjacency->triangles == NULL) {
+        return false;
+    }
+    for (unsigned int i = 0; i < indexCount; i++) {
+        adjacency->offsets[indices[i] + 1]++;
+    }
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        adjacency->offsets[v + 1] += adjacency->offsets[v];
+    }
+    unsigned int* fill = (unsigned int*)malloc(sizeof(unsigned int) * (vertexCount > 0 ? vertexCount : 1));
+    if (fill == NULL) {
+        return false;
+    }
+    memcpy(fill, adjacency->offsets, sizeof(unsigned int) * vertexCount);
+    for (unsigned int i = 0; i < indexCount; i++) {
+        adjacency->triangles[fill[indices[i]]++] = i / 3;
+    }
+    free(fill);
+    return true;
+}
+
+bool optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize, unsigned int* clusters, unsigned int* clusterCount) {
+    unsigned int triangleCount = indexCount / 3;
+    *clusterCount = 0;
+    if (triangleCount == 0) {
+        return true;
+    }
+    Adjacency adjacency = { NULL, NULL };
+    unsigned int* live = (unsigned int*)malloc(sizeof(unsigned int) * vertexCount);
+    unsigned int* cacheTime = (unsigned int*)calloc(vertexCount, sizeof(unsigned int));
+    unsigned int* deadEnd = (unsigned int*)malloc(sizeof(unsigned int) * indexCount); // every index is pushed exactly once
+    unsigned int* candidates = (unsigned int*)malloc(sizeof(unsigned int) * indexCount);
+    bool* emitted = (bool*)calloc(triangleCount, sizeof(bool));
+    unsigned int* output = (unsigned int*)malloc(sizeof(unsigned int) * indexCount);
+    bool ok = live != NULL && cacheTime != NULL && deadEnd != NULL && candidates != NULL && emitted != NULL && output != NULL
+        && buildAdjacency(&adjacency, indices, indexCount, vertexCount);
+
+    if (ok) {
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+        }
+        unsigned int deadEndCount = 0, outputCount = 0;
+        unsigned int time = cacheSize + 1;
+        unsigned int cursor = 0;
+        int fanning = -1;
+        bool flushed = true; // the next emitted triangle starts a cluster
+
+        while (true) {
+            if (fanning < 0) {
+                // no cached candidate left: pop dead ends, then scan for any vertex with triangles left
+                while (deadEndCount > 0 && fanning < 0) {
+                    unsigned int v = deadEnd[--deadEndCount];
+                    if (live[v] > 0) fanning = (int)v;
+                }
+                while (fanning < 0 && cursor < vertexCount) {
+                    if (live[cursor] > 0) fanning = (int)cursor;
+                    cursor++;
+                }
+                if (fanning < 0) break;
+                flushed = true;
+            }
+
+            // emit every remaining triangle around the fanning vertex
+            unsigned int candidateCount = 0;
+            for (unsigned int a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++) {
+                unsigned int t = adjacency.triangles[a];
+                if (emitted[t]) continue;
+                if (flushed) {
+                    clusters[(*clusterCount)++] = outputCount / 3;
+                    flushed = false;
+                }
+                for (unsigned int c = 0; c < 3; c++) {
+                    unsigned int v = indices[t * 3 + c];
+                    output[outputCount++] = v;
+                    deadEnd[deadEndCount++] = v;
+                    candidates[candidateCount++] = v;
+                    live[v]--;
+                    if (time - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = time++;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            // next fanning vertex: the one that stays in the cache longest after its own triangles are emitted
+            int best = -1;
+            unsigned int bestPriority = 0;
+            for (unsigned int c = 0; c < candidateCount; c++) {
+                unsigned int v = candidates[c];
+                if (live[v] == 0) continue;
+                unsigned int priority = 0;
+                if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (best < 0 || priority > bestPriority) {
+                    best = (int)v;
+                    bestPriority = priority;
+                }
+            }
+            fanning = best;
+        }
+        memcpy(indices, output, sizeof(unsigned int) * outputCount);
+    }
+
+    free(adjacency.offsets);
+    free(adjacency.triangles);
+    free(live);
+    free(cacheTime);
+    free(deadEnd);
+    free(candidates);
+    free(emitted);
+    free(output);
+    return ok;
+}
+
+// OVERDRAW
+
+typedef struct ClusterOrder {
+    unsigned int cluster;
+    float sortKey;
+} ClusterOrder;
+
+static int compareClusterOrder(const void* a, const void* b) {
+    float x = ((const ClusterOrder*)a)->sortKey;
+    float y = ((const ClusterOrder*)b)->sortKey;
+    return x > y ? -1 : (x < y ? 1 : 0);
+}
+
+bool optimizeOverdraw(unsigned int* indices, unsigned int indexCount, const float* vertices, unsigned int stride, unsigned int vertexCount,
+    const unsigned int* clusters, unsigned int clusterCount, float threshold) {
+    unsigned int triangleCount = indexCount / 3;
+    if (clusterCount < 2) {
+        return true;
+    }
+    ClusterOrder* order = (ClusterOrder*)malloc(sizeof(ClusterOrder) * clusterCount);
+    unsigned int* reordered = (unsigned int*)malloc(sizeof(unsigned int) * indexCount);
+    if (order == NULL || reordered == NULL) {
+        free(order);
+        free(reordered);
+        return false;
+    }
+
+    // area weighted mesh centroid
+    double meshCenter[3] = { 0.0, 0.0, 0.0 }, meshArea = 0.0;
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        const float* p0 = &vertices[(size_t)indices[t * 3] * stride];
+        const float* p1 = &vertices[(size_t)indices[t * 3 + 1] * stride];
+        const float* p2 = &vertices[(size_t)indices[t * 3 + 2] * stride];
+        vec3 e1 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        vec3 e2 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        vec3 n;
+        glm_vec3_cross(e1, e2, n);
+        double area = glm_vec3_norm(n);
+        for (int c = 0; c < 3; c++) {
+            meshCenter[c] += (p0[c] + p1[c] + p2[c]) / 3.0 * area;
+        }
+        meshArea += area;
+    }
+    for (int c = 0; c < 3 && meshArea > 0.0; c++) {
+        meshCenter[c] /= meshArea;
+    }
+
+    // a cluster whose summed normal points away from the center sits on the outside, draw those first
+    for (unsigned int k = 0; k < clusterCount; k++) {
+        unsigned int end = k + 1 < clusterCount ? clusters[k + 1] : triangleCount;
+        double center[3] = { 0.0, 0.0, 0.0 }, normal[3] = { 0.0, 0.0, 0.0 }, area = 0.0;
+        for (unsigned int t = clusters[k]; t < end; t++) {
+            const float* p0 = &vertices[(size_t)indices[t * 3] * stride];
+            const float* p1 = &vertices[(size_t)indices[t * 3 + 1] * stride];
+            const float* p2 = &vertices[(size_t)indices[t * 3 + 2] * stride];
+            vec3 e1 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            vec3 e2 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            vec3 n;
+            glm_vec3_cross(e1, e2, n);
+            double triangleArea = glm_vec3_norm(n);
+            for (int c = 0; c < 3; c++) {
+                center[c] += (p0[c] + p1[c] + p2[c]) / 3.0 * triangleArea;
+                normal[c] += n[c];
+            }
+            area += triangleArea;
+        }
+        double dot = 0.0, length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int c = 0; c < 3 && area > 0.0 && length > 0.0; c++) {
+            dot += (center[c] / area - meshCenter[c]) * normal[c] / length;
+        }
+        order[k].cluster = k;
+        order[k].sortKey = (float)dot;
+    }
+    qsort(order, clusterCount, sizeof(ClusterOrder), compareClusterOrder);
+
+    unsigned int written = 0;
+    for (unsigned int k = 0; k < clusterCount; k++) {
+        unsigned int cluster = order[k].cluster;
+        unsigned int begin = clusters[cluster] * 3;
+        unsigned int end = cluster + 1 < clusterCount ? clusters[cluster + 1] * 3 : indexCount;
+        memcpy(reordered + written, indices + begin, sizeof(unsigned int) * (end - begin));
+        written += end - begin;
+    }
+
+    // keep the new order only if the cache does not suffer too much for it
+    unsigned int before = countCacheMisses(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE);
+    unsigned int after = countCacheMisses(reordered, indexCount, vertexCount, VERTEX_CACHE_SIZE);
+    if (after <= before * threshold) {
+        memcpy(indices, reordered, sizeof(unsigned int) * indexCount);
+    }
+    free(order);
+    free(reordered);
+    return true;
+}
+
+// VERTEX FETCH
+
+unsigned int optimizeVertexFetch(float* vertices, unsigned int stride, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount) {
+    unsigned int* remap = (unsigned int*)malloc(sizeof(unsigned int) * vertexCount);
+    float* reordered = (float*)malloc(sizeof(float) * stride * vertexCount);
+    if (remap == NULL || reordered == NULL) {
+        free(remap);
+        free(reordered);
+        return vertexCount;
+    }
+    memset(remap, 0xFF, sizeof(unsigned int) * vertexCount);
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < indexCount; i++) {
+        unsigned int v = indices[i];
+        if (remap[v] == 0xFFFFFFFFu) {
+            remap[v] = next;
+            memcpy(&reordered[(size_t)next * stride], &vertices[(size_t)v * stride], sizeof(float) * stride);
+            next++;
+        }
+        indices[i] = remap[v];
+    }
+    memcpy(vertices, reordered, sizeof(float) * stride * next);
+    free(remap);
+    free(reordered);
+    return next;
+}
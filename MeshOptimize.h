@@ -0,0 +1,27 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <stdbool.h>
+
+// OFFLINE TRIANGLE AND VERTEX REORDERING FOR THE MESH COOKER: POST-TRANSFORM CACHE LOCALITY (TIPSIFY),
+// FRONT-TO-BACK-ISH CLUSTER ORDER AGAINST OVERDRAW, AND VERTICES STORED IN THE ORDER THEY ARE FETCHED
+
+#define VERTEX_CACHE_SIZE 16 // FIFO entries the optimizer and the statistics assume
+#define OVERDRAW_THRESHOLD 1.05f // cluster reordering may cost at most this much extra cache misses
+
+// vertex shader invocations a FIFO post-transform cache of cacheSize entries would need for the index list
+unsigned int countCacheMisses(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize);
+
+// Tipsify (Sander, Nehab, Barczak 2007) in place. clusters receives the first triangle of every run that
+// starts after a cache flush, it needs room for indexCount / 3 entries
+bool optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize, unsigned int* clusters, unsigned int* clusterCount);
+
+// sorts the clusters so the ones facing away from the mesh center, which tend to hide the rest, draw first.
+// positions are the first three floats of every stride-float vertex
+bool optimizeOverdraw(unsigned int* indices, unsigned int indexCount, const float* vertices, unsigned int stride, unsigned int vertexCount,
+    const unsigned int* clusters, unsigned int clusterCount, float threshold);
+
+// renumbers vertices in first-use order and moves their data to match, unused vertices are dropped. returns the new count
+unsigned int optimizeVertexFetch(float* vertices, unsigned int stride, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
+
+#endif
@@ -0,0 +1,237 @@
+#include "MeshSimplify.h"
+#include <cglm/cglm.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// QUADRICS
+
+// symmetric 4x4 sum of plane outer products, only the upper triangle is kept
+typedef struct Quadric {
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+} Quadric;
+
+static void addPlane(Quadric* q, double a, double b, double c, double d) {
+    q->a2 += a * a; q->ab += a * b; q->ac += a * c; q->ad += a * d;
+    q->b2 += b * b; q->bc += b * c; q->bd += b * d;
+    q->c2 += c * c; q->cd += c * d;
+    q->d2 += d * d;
+}
+
+static void addQuadric(Quadric* q, const Quadric* other) {
+    q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+    q->c2 += other->c2; q->cd += other->cd;
+    q->d2 += other->d2;
+}
+
+// summed squared distance from p to every plane in the quadric
+static double evaluateQuadric(const Quadric* q, const float* p) {
+    double x = p[0], y = p[1], z = p[2];
+    double result = q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x
+        + q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+        + q->c2 * z * z + 2.0 * q->cd * z
+        + q->d2;
+    return result > 0.0 ? result : 0.0;
+}
+
+// COLLAPSES
+
+typedef struct Collapse {
+    unsigned int from;
+    unsigned int to;
+    double cost;
+} Collapse;
+
+static int compareCollapse(const void* a, const void* b) {
+    double x = ((const Collapse*)a)->cost;
+    double y = ((const Collapse*)b)->cost;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static int compareEdge(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint64_t edgeKey(unsigned int a, unsigned int b) {
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+static void triangleNormal(const float* p0, const float* p1, const float* p2, vec3 normal) {
+    vec3 e1 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    vec3 e2 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    glm_vec3_cross(e1, e2, normal);
+}
+
+// moving from onto to must not fold or badly skew any triangle around from that survives the collapse
+static bool collapseKeepsOrientation(const unsigned int* indices, const unsigned int* offsets, const unsigned int* triangles,
+    const float* vertices, unsigned int stride, unsigned int from, unsigned int to) {
+    const float* target = &vertices[(size_t)to * stride];
+    for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++) {
+        const unsigned int* triangle = &indices[triangles[a] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue; // this one disappears
+        const float* before[3];
+        const float* after[3];
+        for (int c = 0; c < 3; c++) {
+            before[c] = &vertices[(size_t)triangle[c] * stride];
+            after[c] = triangle[c] == from ? target : before[c];
+        }
+        vec3 n0, n1;
+        triangleNormal(before[0], before[1], before[2], n0);
+        triangleNormal(after[0], after[1], after[2], n1);
+        float lengths = glm_vec3_norm(n0) * glm_vec3_norm(n1);
+        if (glm_vec3_dot(n0, n1) <= SIMPLIFY_FLIP_LIMIT * lengths) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// SIMPLIFY
+
+unsigned int simplifyMesh(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+    const float* vertices, unsigned int stride, unsigned int vertexCount, unsigned int targetIndexCount, float* error) {
+    *error = 0.0f;
+    if (destination != indices) {
+        memcpy(destination, indices, sizeof(unsigned int) * indexCount);
+    }
+    indices = destination;
+    if (indexCount <= targetIndexCount) {
+        return indexCount;
+    }
+
+    Quadric* quadrics = (Quadric*)calloc(vertexCount, sizeof(Quadric));
+    bool* locked = (bool*)calloc(vertexCount, sizeof(bool));
+    bool* touched = (bool*)malloc(sizeof(bool) * vertexCount);
+    unsigned int* remap = (unsigned int*)malloc(sizeof(unsigned int) * vertexCount);
+    unsigned int* offsets = (unsigned int*)malloc(sizeof(unsigned int) * (vertexCount + 1));
+    unsigned int* triangles = (unsigned int*)malloc(sizeof(unsigned int) * indexCount);
+    uint64_t* edges = (uint64_t*)malloc(sizeof(uint64_t) * indexCount);
+    Collapse* collapses = (Collapse*)malloc(sizeof(Collapse) * indexCount);
+    if (quadrics == NULL || locked == NULL || touched == NULL || remap == NULL || offsets == NULL || triangles == NULL
+        || edges == NULL || collapses == NULL) {
+        free(quadrics); free(locked); free(touched); free(remap); free(offsets); free(triangles); free(edges); free(collapses);
+        return indexCount;
+    }
+
+    // every vertex starts with the planes of the triangles around it
+    for (unsigned int i = 0; i < indexCount; i += 3) {
+        const float* p0 = &vertices[(size_t)indices[i] * stride];
+        vec3 n;
+        triangleNormal(p0, &vertices[(size_t)indices[i + 1] * stride], &vertices[(size_t)indices[i + 2] * stride], n);
+        float length = glm_vec3_norm(n);
+        if (length == 0.0f) continue;
+        glm_vec3_scale(n, 1.0f / length, n);
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        for (int c = 0; c < 3; c++) {
+            addPlane(&quadrics[indices[i + c]], n[0], n[1], n[2], d);
+        }
+    }
+
+    // an edge used by one triangle is a border or a texture seam, one used by three or more is non-manifold.
+    // their vertices stay where they are so outlines and uv islands keep their shape
+    for (unsigned int i = 0; i < indexCount; i += 3) {
+        for (int c = 0; c < 3; c++) {
+            edges[i + c] = edgeKey(indices[i + c], indices[i + (c + 1) % 3]);
+        }
+    }
+    qsort(edges, indexCount, sizeof(uint64_t), compareEdge);
+    for (unsigned int i = 0; i < indexCount;) {
+        unsigned int run = 1;
+        while (i + run < indexCount && edges[i + run] == edges[i]) run++;
+        if (run != 2) {
+            locked[edges[i] >> 32] = true;
+            locked[edges[i] & 0xFFFFFFFFu] = true;
+        }
+        i += run;
+    }
+
+    double worstCost = 0.0;
+    while (indexCount > targetIndexCount) {
+        // triangles around every vertex, rebuilt each pass since collapses rewire them
+        memset(offsets, 0, sizeof(unsigned int) * (vertexCount + 1));
+        for (unsigned int i = 0; i < indexCount; i++) {
+            offsets[indices[i] + 1]++;
+        }
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        memcpy(remap, offsets, sizeof(unsigned int) * vertexCount); // fill cursors for now
+        for (unsigned int i = 0; i < indexCount; i++) {
+            triangles[remap[indices[i]]++] = i / 3;
+        }
+
+        // the cheaper direction of every edge, each edge is seen from both of its triangles and kept once
+        unsigned int collapseCount = 0;
+        for (unsigned int i = 0; i < indexCount; i += 3) {
+            for (int c = 0; c < 3; c++) {
+                unsigned int a = indices[i + c], b = indices[i + (c + 1) % 3];
+                if (a > b) continue;
+                if (locked[a] && locked[b]) continue;
+                Quadric sum = quadrics[a];
+                addQuadric(&sum, &quadrics[b]);
+                double costAB = locked[a] ? INFINITY : evaluateQuadric(&sum, &vertices[(size_t)b * stride]);
+                double costBA = locked[b] ? INFINITY : evaluateQuadric(&sum, &vertices[(size_t)a * stride]);
+                Collapse* collapse = &collapses[collapseCount++];
+                collapse->from = costAB <= costBA ? a : b;
+                collapse->to = costAB <= costBA ? b : a;
+                collapse->cost = costAB <= costBA ? costAB : costBA;
+            }
+        }
+        qsort(collapses, collapseCount, sizeof(Collapse), compareCollapse);
+
+        // a collapse removes about two triangles. only the cheapest half and a bit of the needed edges are considered,
+        // so a pass does not reach deep into expensive collapses while cheap ones open up in the next. collapses that
+        // would fold are not counted, they stay cheap and would otherwise fill the window pass after pass
+        unsigned int needed = (indexCount - targetIndexCount) / 6 + 1;
+        unsigned int considered = needed + needed / 2;
+        unsigned int examined = 0;
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            remap[v] = v;
+            touched[v] = false;
+        }
+        unsigned int performed = 0;
+        for (unsigned int k = 0; k < collapseCount && performed < needed && examined < considered; k++) {
+            const Collapse* collapse = &collapses[k];
+            unsigned int from = collapse->from, to = collapse->to;
+            if (!collapseKeepsOrientation(indices, offsets, triangles, vertices, stride, from, to)) continue;
+            examined++;
+            if (touched[from] || touched[to]) continue;
+            remap[from] = to;
+            addQuadric(&quadrics[to], &quadrics[from]);
+            // everything around from changes shape this pass, leave it for the next
+            for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++) {
+                const unsigned int* triangle = &indices[triangles[a] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+            worstCost = fmax(worstCost, collapse->cost);
+            performed++;
+        }
+        if (performed == 0) {
+            break; // everything left is locked or would fold over
+        }
+
+        // apply the collapses and drop the triangles that became degenerate
+        unsigned int written = 0;
+        for (unsigned int i = 0; i < indexCount; i += 3) {
+            unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a == b || b == c || c == a) continue;
+            destination[written++] = a;
+            destination[written++] = b;
+            destination[written++] = c;
+        }
+        indexCount = written;
+    }
+
+    // the summed squared distances bound the largest single one
+    *error = (float)sqrt(worstCost);
+    free(quadrics); free(locked); free(touched); free(remap); free(offsets); free(triangles); free(edges); free(collapses);
+    return indexCount;
+}
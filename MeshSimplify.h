@@ -0,0 +1,16 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+// OFFLINE EDGE COLLAPSE SIMPLIFICATION WITH QUADRIC ERROR METRICS (GARLAND, HECKBERT 1997) FOR THE MESH COOKER'S LOD CHAIN
+
+#define SIMPLIFY_FLIP_LIMIT 0.25f // a collapse may turn a triangle's normal at most this far, as a cosine
+
+// collapses edges, cheapest first, until the index list is down to targetIndexCount or nothing more can go.
+// collapses only move a vertex onto one of its neighbours so no new vertices appear and the vertex buffer can be
+// shared with the source. vertices on open edges (borders and texture seams) stay put. positions are the first
+// three floats of every stride-float vertex. returns the new index count, error receives a bound on how far the
+// surface moved, in the same units as the positions
+unsigned int simplifyMesh(unsigned int* destination, const unsigned int* indices, unsigned int indexCount,
+    const float* vertices, unsigned int stride, unsigned int vertexCount, unsigned int targetIndexCount, float* error);
+
+#endif
@@ -0,0 +1,351 @@
+#include "Particles.h"
+#include "RenderStats.h"
+#include "GpuMemory.h"
+#include <stdio.h>
+#include <string.h>
+
+// SHADERS
+
+// one vertex per slot. the slots the emitters claimed this frame respawn, the rest fly on, dead ones are copied as
+// they are. a new particle's age is spread over the frame so a batch does not move as one sheet
+static const char* updateVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec4 aPositionAge;\n"
+    "layout (location = 1) in vec4 aVelocityEmitter;\n"
+    "out vec4 positionAge;\n"
+    "out vec4 velocityEmitter;\n"
+    "uniform vec4 emitterPosition[8];\n" // xyz, w the start radius
+    "uniform vec4 emitterVelocity[8];\n" // xyz, w the spread
+    "uniform float emitterLifetime[8];\n"
+    "uniform int batchEnd[8];\n" // slots after the cursor claimed by this emitter and the ones before it
+    "uniform int emitterCount;\n"
+    "uniform int cursor;\n"
+    "uniform int capacity;\n"
+    "uniform uint seed;\n"
+    "uniform float dt;\n"
+    "uniform vec3 gravity;\n"
+    "uniform float drag;\n"
+    "uniform float groundHeight;\n"
+    "uniform float bounce;\n"
+    "uniform bool reset;\n"
+    "uint hash(uint x) {\n"
+    "   x ^= x >> 16; x *= 0x7feb352du;\n"
+    "   x ^= x >> 15; x *= 0x846ca68bu;\n"
+    "   return x ^ (x >> 16);\n"
+    "}\n"
+    "float random(inout uint state) {\n"
+    "   state = hash(state);\n"
+    "   return float(state >> 8) * (1.0 / 16777216.0);\n"
+    "}\n"
+    "vec3 randomDirection(inout uint state) {\n"
+    "   float z = random(state) * 2.0 - 1.0;\n"
+    "   float angle = random(state) * 6.2831853;\n"
+    "   float ring = sqrt(1.0 - z * z);\n"
+    "   return vec3(ring * cos(angle), z, ring * sin(angle));\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "   if (reset) {\n"
+    "       positionAge = vec4(0.0, 0.0, 0.0, 1e30);\n"
+    "       velocityEmitter = vec4(0.0);\n"
+    "       return;\n"
+    "   }\n"
+    "   int ring = gl_VertexID - cursor;\n"
+    "   if (ring < 0) ring += capacity;\n"
+    "   int emitter = -1;\n"
+    "   for (int i = emitterCount - 1; i >= 0; i--) {\n"
+    "       if (ring < batchEnd[i]) emitter = i;\n"
+    "   }\n"
+    "   if (emitter >= 0) {\n"
+    "       uint state = hash(uint(gl_VertexID) ^ seed);\n"
+    "       vec3 start = emitterPosition[emitter].xyz + randomDirection(state) * emitterPosition[emitter].w * pow(random(state), 1.0 / 3.0);\n"
+    "       vec3 velocity = emitterVelocity[emitter].xyz + randomDirection(state) * emitterVelocity[emitter].w * random(state);\n"
+    "       float age = random(state) * dt;\n"
+    "       positionAge = vec4(start + velocity * age, age);\n"
+    "       velocityEmitter = vec4(velocity, float(emitter));\n"
+    "       return;\n"
+    "   }\n"
+    "   positionAge = aPositionAge;\n"
+    "   velocityEmitter = aVelocityEmitter;\n"
+    "   if (aPositionAge.w >= emitterLifetime[int(aVelocityEmitter.w)]) return;\n"
+    "   vec3 velocity = (aVelocityEmitter.xyz + gravity * dt) * max(1.0 - drag * dt, 0.0);\n"
+    "   vec3 position = aPositionAge.xyz + velocity * dt;\n"
+    "   if (position.y < groundHeight && velocity.y < 0.0) {\n"
+    "       position.y = groundHeight;\n"
+    "       velocity *= vec3(bounce, -bounce, bounce);\n"
+    "   }\n"
+    "   positionAge = vec4(position, aPositionAge.w + dt);\n"
+    "   velocityEmitter.xyz = velocity;\n"
+    "}\0";
+
+// the four corners of a quad from the vertex index, spread in view space so it always faces the camera. dead
+// particles go outside the clip volume and never reach the rasterizer
+static const char* drawVertexSource = "#version 330 core\n"
+    "layout (location = 0) in vec4 aPositionAge;\n" // per instance
+    "layout (location = 1) in vec4 aVelocityEmitter;\n"
+    "out vec2 corner;\n"
+    "out vec3 particleColor;\n"
+    "uniform mat4 view;\n"
+    "uniform mat4 projection;\n"
+    "uniform vec4 emitterColor[8];\n" // rgb, w the size
+    "uniform float emitterLifetime[8];\n"
+    "void main()\n"
+    "{\n"
+    "   int emitter = int(aVelocityEmitter.w);\n"
+    "   float life = aPositionAge.w / emitterLifetime[emitter];\n"
+    "   corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;\n"
+    "   particleColor = emitterColor[emitter].rgb * (1.0 - life);\n"
+    "   if (life >= 1.0) {\n"
+    "       gl_Position = vec4(0.0, 0.0, 2.0, 1.0);\n"
+    "       return;\n"
+    "   }\n"
+    "   vec4 center = view * vec4(aPositionAge.xyz, 1.0);\n"
+    "   float halfSize = emitterColor[emitter].w * (0.5 - 0.25 * life);\n"
+    "   gl_Position = projection * vec4(center.xy + corner * halfSize, center.zw);\n"
+    "}\0";
+
+static const char* drawFragmentSource = "#version 330 core\n"
+    "in vec2 corner;\n"
+    "in vec3 particleColor;\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "   float falloff = max(1.0 - dot(corner, corner), 0.0);\n"
+    "   FragColor = vec4(particleColor * falloff * falloff, 1.0);\n"
+    "}\0";
+
+static unsigned int compileStage(GLenum type, const char* source) {
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        printf("ERROR::PARTICLES::SHADER_COMPILATION_FAILED\n%s\n", infoLog);
+    }
+    return shader;
+}
+
+// fragSource may be NULL, the varyings are captured interleaved by transform feedback when there are any
+static unsigned int linkProgram(const char* vertSource, const char* fragSource, const char** varyings, int varyingCount) {
+    unsigned int program = glCreateProgram();
+    unsigned int vertexShader = compileStage(GL_VERTEX_SHADER, vertSource);
+    unsigned int fragmentShader = fragSource != NULL ? compileStage(GL_FRAGMENT_SHADER, fragSource) : 0;
+    glAttachShader(program, vertexShader);
+    if (fragmentShader != 0) glAttachShader(program, fragmentShader);
+    if (varyingCount > 0) {
+        glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+    }
+    glLinkProgram(program);
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        printf("ERROR::PARTICLES::PROGRAM_LINKING_FAILED\n%s\n", infoLog);
+    }
+    glDeleteShader(vertexShader);
+    if (fragmentShader != 0) glDeleteShader(fragmentShader);
+    return success ? program : 0;
+}
+
+// SETUP
+
+static void setStateAttributes(unsigned int divisor) {
+    for (unsigned int a = 0; a < 2; a++) {
+        glEnableVertexAttribArray(a);
+        glVertexAttribPointer(a, 4, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, (void*)(a * sizeof(vec4)));
+        glVertexAttribDivisor(a, divisor);
+    }
+}
+
+// one transform feedback pass from the source buffer into the other one, which becomes the source
+static void runUpdatePass(ParticleSystem* particles) {
+    unsigned int target = particles->source ^ 1;
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(particles->updateVertexArrays[particles->source]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, particles->buffers[target]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, particles->capacity);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    particles->source = target;
+}
+
+bool createParticleSystem(ParticleSystem* particles, unsigned int capacity) {
+    memset(particles, 0, sizeof(ParticleSystem));
+    particles->capacity = capacity;
+    particles->gravity[1] = -9.81f;
+    particles->drag = 0.1f;
+    particles->groundHeight = -1e30f;
+    particles->bounce = 0.5f;
+
+    const char* varyings[2] = { "positionAge", "velocityEmitter" };
+    particles->updateProgram = linkProgram(updateVertexSource, NULL, varyings, 2);
+    particles->drawProgram = linkProgram(drawVertexSource, drawFragmentSource, NULL, 0);
+    if (particles->updateProgram == 0 || particles->drawProgram == 0 || capacity == 0) {
+        destroyParticleSystem(particles);
+        return false;
+    }
+    unsigned int update = particles->updateProgram;
+    particles->updateEmitterPositionLoc = glGetUniformLocation(update, "emitterPosition");
+    particles->updateEmitterVelocityLoc = glGetUniformLocation(update, "emitterVelocity");
+    particles->updateEmitterLifetimeLoc = glGetUniformLocation(update, "emitterLifetime");
+    particles->updateBatchEndLoc = glGetUniformLocation(update, "batchEnd");
+    particles->updateEmitterCountLoc = glGetUniformLocation(update, "emitterCount");
+    particles->updateCursorLoc = glGetUniformLocation(update, "cursor");
+    particles->updateCapacityLoc = glGetUniformLocation(update, "capacity");
+    particles->updateSeedLoc = glGetUniformLocation(update, "seed");
+    particles->updateStepLoc = glGetUniformLocation(update, "dt");
+    particles->updateGravityLoc = glGetUniformLocation(update, "gravity");
+    particles->updateDragLoc = glGetUniformLocation(update, "drag");
+    particles->updateGroundLoc = glGetUniformLocation(update, "groundHeight");
+    particles->updateBounceLoc = glGetUniformLocation(update, "bounce");
+    particles->updateResetLoc = glGetUniformLocation(update, "reset");
+    particles->drawViewLoc = glGetUniformLocation(particles->drawProgram, "view");
+    particles->drawProjectionLoc = glGetUniformLocation(particles->drawProgram, "projection");
+    particles->drawEmitterColorLoc = glGetUniformLocation(particles->drawProgram, "emitterColor");
+    particles->drawEmitterLifetimeLoc = glGetUniformLocation(particles->drawProgram, "emitterLifetime");
+
+    glGenBuffers(2, particles->buffers);
+    glGenVertexArrays(2, particles->updateVertexArrays);
+    glGenVertexArrays(2, particles->drawVertexArrays);
+    for (unsigned int i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, particles->buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * PARTICLE_STRIDE, NULL, GL_DYNAMIC_COPY);
+        trackGpuResource(GPU_BUFFER, particles->buffers[i], GPU_MEMORY_COMPUTE, (size_t)capacity * PARTICLE_STRIDE);
+        glBindVertexArray(particles->updateVertexArrays[i]);
+        setStateAttributes(0);
+        glBindVertexArray(particles->drawVertexArrays[i]);
+        setStateAttributes(1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // the buffers start out undefined, one pass marks every slot dead without the CPU touching them
+    glUseProgram(update);
+    glUniform1i(particles->updateResetLoc, 1);
+    runUpdatePass(particles);
+    glUniform1i(particles->updateResetLoc, 0);
+    glUseProgram(0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void destroyParticleSystem(ParticleSystem* particles) {
+    if (particles->updateProgram != 0) glDeleteProgram(particles->updateProgram);
+    if (particles->drawProgram != 0) glDeleteProgram(particles->drawProgram);
+    if (particles->buffers[0] != 0) {
+        releaseGpuResource(GPU_BUFFER, particles->buffers[0]);
+        releaseGpuResource(GPU_BUFFER, particles->buffers[1]);
+        glDeleteBuffers(2, particles->buffers);
+    }
+    if (particles->updateVertexArrays[0] != 0) glDeleteVertexArrays(2, particles->updateVertexArrays);
+    if (particles->drawVertexArrays[0] != 0) glDeleteVertexArrays(2, particles->drawVertexArrays);
+    memset(particles, 0, sizeof(ParticleSystem));
+}
+
+int addParticleEmitter(ParticleSystem* particles, const ParticleEmitter* emitter) {
+    if (particles->emitterCount == PARTICLE_MAX_EMITTERS) {
+        return -1;
+    }
+    particles->emitters[particles->emitterCount] = *emitter;
+    return (int)particles->emitterCount++;
+}
+
+// FRAME
+
+void updateParticles(ParticleSystem* particles, double time) {
+    if (particles->capacity == 0) {
+        return;
+    }
+    if (!particles->started) {
+        particles->started = true;
+        particles->time = time;
+        return;
+    }
+    float dt = (float)(time - particles->time);
+    particles->time = time;
+    particles->emitted = 0;
+    if (dt <= 0.0f) {
+        return; // a paused clock leaves everything where it is
+    }
+    if (dt > PARTICLE_MAX_STEP) {
+        dt = PARTICLE_MAX_STEP;
+    }
+
+    // every emitter claims a run of slots after the cursor, the runs follow each other around the ring
+    vec4 positions[PARTICLE_MAX_EMITTERS];
+    vec4 velocities[PARTICLE_MAX_EMITTERS];
+    float lifetimes[PARTICLE_MAX_EMITTERS];
+    int batchEnd[PARTICLE_MAX_EMITTERS];
+    unsigned int claimed = 0;
+    for (unsigned int e = 0; e < particles->emitterCount; e++) {
+        const ParticleEmitter* emitter = &particles->emitters[e];
+        float owed = particles->emitCarry[e] + emitter->rate * dt;
+        unsigned int count = (unsigned int)owed;
+        particles->emitCarry[e] = owed - (float)count;
+        if (count > particles->capacity - claimed) {
+            count = particles->capacity - claimed;
+        }
+        claimed += count;
+        batchEnd[e] = (int)claimed;
+        glm_vec4((float*)emitter->position, emitter->radius, positions[e]);
+        glm_vec4((float*)emitter->velocity, emitter->spread, velocities[e]);
+        lifetimes[e] = emitter->lifetime;
+    }
+
+    glUseProgram(particles->updateProgram);
+    glUniform4fv(particles->updateEmitterPositionLoc, particles->emitterCount, (const GLfloat*)positions);
+    glUniform4fv(particles->updateEmitterVelocityLoc, particles->emitterCount, (const GLfloat*)velocities);
+    glUniform1fv(particles->updateEmitterLifetimeLoc, particles->emitterCount, lifetimes);
+    glUniform1iv(particles->updateBatchEndLoc, particles->emitterCount, batchEnd);
+    glUniform1i(particles->updateEmitterCountLoc, (int)particles->emitterCount);
+    glUniform1i(particles->updateCursorLoc, (int)particles->cursor);
+    glUniform1i(particles->updateCapacityLoc, (int)particles->capacity);
+    glUniform1ui(particles->updateSeedLoc, particles->frame * 0x9E3779B9u);
+    glUniform1f(particles->updateStepLoc, dt);
+    glUniform3fv(particles->updateGravityLoc, 1, particles->gravity);
+    glUniform1f(particles->updateDragLoc, particles->drag);
+    glUniform1f(particles->updateGroundLoc, particles->groundHeight);
+    glUniform1f(particles->updateBounceLoc, particles->bounce);
+    runUpdatePass(particles);
+    glUseProgram(0);
+
+    particles->cursor = (particles->cursor + claimed) % particles->capacity;
+    particles->emitted = claimed;
+    particles->frame++;
+}
+
+void drawParticles(ParticleSystem* particles, mat4 view, mat4 projection) {
+    if (particles->capacity == 0 || particles->emitterCount == 0) {
+        return;
+    }
+    vec4 colors[PARTICLE_MAX_EMITTERS];
+    float lifetimes[PARTICLE_MAX_EMITTERS];
+    for (unsigned int e = 0; e < particles->emitterCount; e++) {
+        glm_vec4(particles->emitters[e].color, particles->emitters[e].size, colors[e]);
+        lifetimes[e] = particles->emitters[e].lifetime;
+    }
+
+    glUseProgram(particles->drawProgram);
+    glUniformMatrix4fv(particles->drawViewLoc, 1, GL_FALSE, (const GLfloat*)view);
+    glUniformMatrix4fv(particles->drawProjectionLoc, 1, GL_FALSE, (const GLfloat*)projection);
+    glUniform4fv(particles->drawEmitterColorLoc, particles->emitterCount, (const GLfloat*)colors);
+    glUniform1fv(particles->drawEmitterLifetimeLoc, particles->emitterCount, lifetimes);
+    glBindVertexArray(particles->drawVertexArrays[particles->source]);
+
+    // light adds up, the order they are drawn in does not matter
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDepthMask(GL_FALSE);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, particles->capacity);
+    countDrawCall(2, particles->capacity);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
@@ -0,0 +1,79 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <cglm/cglm.h>
+
+// GPU PARTICLES: THE STATE OF EVERY PARTICLE LIVES IN ONE OF TWO BUFFERS AND NEVER COMES BACK TO THE CPU. EACH FRAME A
+// VERTEX SHADER READS ONE BUFFER, STEPS EVERY PARTICLE AND WRITES THE OTHER THROUGH TRANSFORM FEEDBACK, THEN THEY SWAP.
+// EMISSION IS A RING: THE EMITTERS CLAIM THE NEXT RUN OF SLOTS AFTER A CURSOR AND THE SHADER RESPAWNS WHATEVER IS IN
+// THEM, THE CPU ONLY SETS UNIFORMS. THE DRAW IS ONE INSTANCED CAMERA-FACING QUAD PER SLOT
+
+#define PARTICLE_MAX_EMITTERS 8 // the shaders repeat this
+#define PARTICLE_STRIDE (2 * sizeof(vec4)) // position and age, velocity and emitter
+#define PARTICLE_MAX_STEP 0.1f // a longer frame is stepped as this, a stall does not throw everything through the floor
+
+typedef struct ParticleEmitter {
+    vec3 position;
+    float radius; // particles start anywhere in this sphere around position
+    vec3 velocity; // mean starting velocity
+    float spread; // up to this much more in a random direction
+    vec3 color; // at birth, fading to black over the lifetime
+    float rate; // particles per second
+    float lifetime; // seconds
+    float size; // world units across at birth, half that at the end
+} ParticleEmitter;
+
+typedef struct ParticleSystem {
+    unsigned int capacity; // slots, the ring comes around to a slot again after capacity emitted particles
+    ParticleEmitter emitters[PARTICLE_MAX_EMITTERS]; // may be changed between updates
+    unsigned int emitterCount;
+    vec3 gravity;
+    float drag; // fraction of the velocity lost per second
+    float groundHeight; // particles bounce off this plane
+    float bounce; // fraction of the speed kept by a bounce
+    unsigned int buffers[2]; // the state is read from one and written to the other
+    unsigned int source; // which one holds the current state
+    unsigned int updateVertexArrays[2]; // reading buffers[i] per vertex
+    unsigned int drawVertexArrays[2]; // reading buffers[i] per instance
+    unsigned int updateProgram;
+    int updateEmitterPositionLoc;
+    int updateEmitterVelocityLoc;
+    int updateEmitterLifetimeLoc;
+    int updateBatchEndLoc;
+    int updateEmitterCountLoc;
+    int updateCursorLoc;
+    int updateCapacityLoc;
+    int updateSeedLoc;
+    int updateStepLoc;
+    int updateGravityLoc;
+    int updateDragLoc;
+    int updateGroundLoc;
+    int updateBounceLoc;
+    int updateResetLoc;
+    unsigned int drawProgram;
+    int drawViewLoc;
+    int drawProjectionLoc;
+    int drawEmitterColorLoc;
+    int drawEmitterLifetimeLoc;
+    bool started; // time holds the clock of the last update
+    double time;
+    unsigned int cursor; // next slot to emit into
+    float emitCarry[PARTICLE_MAX_EMITTERS]; // fractions of a particle owed from earlier frames
+    unsigned int frame; // seeds the shader's random numbers
+    unsigned int emitted; // by the last update
+} ParticleSystem;
+
+// capacity * PARTICLE_STRIDE bytes twice, every slot starts out dead
+bool createParticleSystem(ParticleSystem* particles, unsigned int capacity);
+void destroyParticleSystem(ParticleSystem* particles);
+// the new emitter's index, or -1 when all PARTICLE_MAX_EMITTERS are taken
+int addParticleEmitter(ParticleSystem* particles, const ParticleEmitter* emitter);
+
+// steps every particle to time and emits what the emitters owe since the last update, the first call starts the clock
+void updateParticles(ParticleSystem* particles, double time);
+// additive, depth tested against what is drawn already without writing depth
+void drawParticles(ParticleSystem* particles, mat4 view, mat4 projection);
+
+#endif
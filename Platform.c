@@ -0,0 +1,235 @@
+#include "Platform.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+
+#include <malloc.h>
+
+static DWORD WINAPI threadEntry(LPVOID arg) {
+    Thread* thread = (Thread*)arg;
+    return (DWORD)thread->function(thread->arg);
+}
+
+bool createThread(Thread* thread, ThreadFunction function, void* arg) {
+    thread->function = function;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, threadEntry, thread, 0, NULL);
+    return thread->handle != NULL;
+}
+
+void joinThread(Thread* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+void sleepMilliseconds(unsigned int milliseconds) {
+    Sleep(milliseconds);
+}
+
+unsigned int getProcessorCount() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1;
+}
+
+void initMutex(Mutex* mutex) { InitializeSRWLock(mutex); }
+void destroyMutex(Mutex* mutex) { (void)mutex; }
+void lockMutex(Mutex* mutex) { AcquireSRWLockExclusive(mutex); }
+void unlockMutex(Mutex* mutex) { ReleaseSRWLockExclusive(mutex); }
+
+void initCondition(Condition* condition) { InitializeConditionVariable(condition); }
+void destroyCondition(Condition* condition) { (void)condition; }
+void waitCondition(Condition* condition, Mutex* mutex) { SleepConditionVariableSRW(condition, mutex, INFINITE, 0); }
+void signalCondition(Condition* condition) { WakeConditionVariable(condition); }
+void broadcastCondition(Condition* condition) { WakeAllConditionVariable(condition); }
+
+long atomicLoad(AtomicInt* value) { return InterlockedCompareExchange(value, 0, 0); }
+void atomicStore(AtomicInt* value, long newValue) { InterlockedExchange(value, newValue); }
+long atomicAdd(AtomicInt* value, long amount) { return InterlockedAdd(value, amount); }
+long atomicExchange(AtomicInt* value, long newValue) { return InterlockedExchange(value, newValue); }
+bool atomicCompareExchange(AtomicInt* value, long expected, long desired) {
+    return InterlockedCompareExchange(value, desired, expected) == expected;
+}
+
+double getTimeSeconds() {
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+void* alignedAlloc(size_t size, size_t alignment) { return _aligned_malloc(size, alignment); }
+void alignedFree(void* memory) { _aligned_free(memory); }
+
+bool getFileInfo(const char* path, uint64_t* size, uint64_t* modifiedTime) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) {
+        return false;
+    }
+    *size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    uint64_t ticks = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    *modifiedTime = ticks / 10000000ULL; // 100ns ticks to seconds
+    return true;
+}
+
+bool mapFile(const char* path, MappedFile* file) {
+    file->data = NULL;
+    file->size = 0;
+    file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file, &size) || size.QuadPart == 0) {
+        CloseHandle(file->file);
+        return false;
+    }
+    file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->mapping == NULL) {
+        CloseHandle(file->file);
+        return false;
+    }
+    file->data = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (file->data == NULL) {
+        CloseHandle(file->mapping);
+        CloseHandle(file->file);
+        return false;
+    }
+    file->size = (size_t)size.QuadPart;
+    return true;
+}
+
+void unmapFile(MappedFile* file) {
+    if (file->data == NULL) {
+        return;
+    }
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+    CloseHandle(file->file);
+    file->data = NULL;
+    file->size = 0;
+}
+
+bool createDirectory(const char* path) {
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+#else
+
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static void* threadEntry(void* arg) {
+    Thread* thread = (Thread*)arg;
+    thread->function(thread->arg);
+    return NULL;
+}
+
+bool createThread(Thread* thread, ThreadFunction function, void* arg) {
+    thread->function = function;
+    thread->arg = arg;
+    return pthread_create(&thread->handle, NULL, threadEntry, thread) == 0;
+}
+
+void joinThread(Thread* thread) {
+    pthread_join(thread->handle, NULL);
+}
+
+void sleepMilliseconds(unsigned int milliseconds) {
+    struct timespec duration = { milliseconds / 1000, (long)(milliseconds % 1000) * 1000000L };
+    nanosleep(&duration, NULL);
+}
+
+unsigned int getProcessorCount() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+}
+
+void initMutex(Mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void destroyMutex(Mutex* mutex) { pthread_mutex_destroy(mutex); }
+void lockMutex(Mutex* mutex) { pthread_mutex_lock(mutex); }
+void unlockMutex(Mutex* mutex) { pthread_mutex_unlock(mutex); }
+
+void initCondition(Condition* condition) { pthread_cond_init(condition, NULL); }
+void destroyCondition(Condition* condition) { pthread_cond_destroy(condition); }
+void waitCondition(Condition* condition, Mutex* mutex) { pthread_cond_wait(condition, mutex); }
+void signalCondition(Condition* condition) { pthread_cond_signal(condition); }
+void broadcastCondition(Condition* condition) { pthread_cond_broadcast(condition); }
+
+long atomicLoad(AtomicInt* value) { return __atomic_load_n(value, __ATOMIC_SEQ_CST); }
+void atomicStore(AtomicInt* value, long newValue) { __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST); }
+long atomicAdd(AtomicInt* value, long amount) { return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST); }
+long atomicExchange(AtomicInt* value, long newValue) { return __atomic_exchange_n(value, newValue, __ATOMIC_SEQ_CST); }
+bool atomicCompareExchange(AtomicInt* value, long expected, long desired) {
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+double getTimeSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+void* alignedAlloc(size_t size, size_t alignment) {
+    void* memory = NULL;
+    if (posix_memalign(&memory, alignment, size) != 0) {
+        return NULL;
+    }
+    return memory;
+}
+
+void alignedFree(void* memory) { free(memory); }
+
+bool getFileInfo(const char* path, uint64_t* size, uint64_t* modifiedTime) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return false;
+    }
+    *size = (uint64_t)info.st_size;
+    *modifiedTime = (uint64_t)info.st_mtime;
+    return true;
+}
+
+bool mapFile(const char* path, MappedFile* file) {
+    file->data = NULL;
+    file->size = 0;
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+        close(descriptor);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor); // the mapping keeps its own reference
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    file->data = data;
+    file->size = (size_t)info.st_size;
+    return true;
+}
+
+void unmapFile(MappedFile* file) {
+    if (file->data == NULL) {
+        return;
+    }
+    munmap((void*)file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+}
+
+bool createDirectory(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// THIN OS LAYER: THREADS, LOCKS, ATOMICS, CLOCKS, ALIGNED MEMORY AND FILE MAPPING
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+typedef HANDLE ThreadHandle;
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE Condition;
+#else
+#include <pthread.h>
+typedef pthread_t ThreadHandle;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+#endif
+
+typedef int (*ThreadFunction)(void* arg);
+
+// read-only view of a whole file
+typedef struct MappedFile {
+    const void* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
+typedef struct Thread {
+    ThreadHandle handle;
+    ThreadFunction function;
+    void* arg;
+} Thread;
+
+// a long only ever touched through the atomic* functions below: 32 bits on Windows, 64 on LP64 Unix, so values must
+// fit in 32 bits to behave the same everywhere
+typedef volatile long AtomicInt;
+
+bool createThread(Thread* thread, ThreadFunction function, void* arg);
+void joinThread(Thread* thread);
+void sleepMilliseconds(unsigned int milliseconds);
+unsigned int getProcessorCount();
+
+void initMutex(Mutex* mutex);
+void destroyMutex(Mutex* mutex);
+void lockMutex(Mutex* mutex);
+void unlockMutex(Mutex* mutex);
+
+void initCondition(Condition* condition);
+void destroyCondition(Condition* condition);
+void waitCondition(Condition* condition, Mutex* mutex);
+void signalCondition(Condition* condition);
+void broadcastCondition(Condition* condition);
+
+long atomicLoad(AtomicInt* value);
+void atomicStore(AtomicInt* value, long newValue);
+long atomicAdd(AtomicInt* value, long amount); // returns the new value
+long atomicExchange(AtomicInt* value, long newValue); // returns the old value
+bool atomicCompareExchange(AtomicInt* value, long expected, long desired);
+
+// monotonic clock in seconds, independent of GLFW so worker threads and tools can use it
+double getTimeSeconds();
+
+void* alignedAlloc(size_t size, size_t alignment);
+void alignedFree(void* memory);
+
+// size in bytes and last modification time (seconds), false if the file does not exist
+bool getFileInfo(const char* path, uint64_t* size, uint64_t* modifiedTime);
+bool mapFile(const char* path, MappedFile* file);
+void unmapFile(MappedFile* file);
+bool createDirectory(const char* path); // true if it exists afterwards
+
+#endif
@@ -0,0 +1,264 @@
+#include <glad/glad.h>
+#include "Profiler.h"
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUMMARY_SMOOTHING 0.05 // weight of the newest frame in the running averages
+
+Profiler profiler;
+
+// GPU timestamps count nanoseconds from an arbitrary point, line them up with the CPU clock once
+static void calibrateGpuClock() {
+    GLint64 gpuTime = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+    profiler.gpuOffset = getTimeSeconds() - (double)gpuTime / 1e9;
+}
+
+void initProfiler(bool enabled) {
+    memset(&profiler, 0, sizeof(Profiler));
+    if (!enabled) {
+        return;
+    }
+    for (int i = 0; i < PROFILER_FRAME_BUFFERS; i++) {
+        glGenQueries(PROFILER_MAX_ZONES * 2, profiler.frames[i].queries);
+    }
+    calibrateGpuClock();
+    profiler.active = true;
+}
+
+// SUMMARY
+
+static ProfileSummary* findSummary(const char* name, unsigned int depth) {
+    for (unsigned int i = 0; i < profiler.summaryCount; i++) {
+        ProfileSummary* summary = &profiler.summary[i];
+        if (summary->depth == depth && (summary->name == name || strcmp(summary->name, name) == 0)) {
+            return summary;
+        }
+    }
+    if (profiler.summaryCount == PROFILER_MAX_ZONES) {
+        return NULL;
+    }
+    ProfileSummary* summary = &profiler.summary[profiler.summaryCount++];
+    summary->name = name;
+    summary->depth = depth;
+    summary->cpuMs = -1.0; // first sample replaces it instead of blending in from zero
+    summary->gpuMs = -1.0;
+    return summary;
+}
+
+static void accumulate(double* average, double sample) {
+    *average = *average < 0.0 ? sample : *average + (sample - *average) * SUMMARY_SMOOTHING;
+}
+
+void formatProfileSummary(char* buffer, size_t size) {
+    size_t used = 0;
+    buffer[0] = '\0';
+    for (unsigned int i = 0; i < profiler.summaryCount && used < size; i++) {
+        const ProfileSummary* summary = &profiler.summary[i];
+        if (summary->depth > 1) {
+            continue; // the frame and the passes directly inside it
+        }
+        int written = snprintf(buffer + used, size - used, "%s%s %.2f/%.2f ms", used > 0 ? " | " : "", summary->name,
+            summary->cpuMs, summary->gpuMs < 0.0 ? 0.0 : summary->gpuMs);
+        if (written < 0) {
+            break;
+        }
+        used += (size_t)written;
+    }
+}
+
+// CAPTURE
+
+static void addTraceEvent(const char* name, double begin, double end, bool gpu) {
+    if (profiler.traceCount == profiler.traceCapacity) {
+        size_t capacity = profiler.traceCapacity > 0 ? profiler.traceCapacity * 2 : 4096;
+        ProfileTraceEvent* events = (ProfileTraceEvent*)realloc(profiler.trace, capacity * sizeof(ProfileTraceEvent));
+        if (events == NULL) {
+            return;
+        }
+        profiler.trace = events;
+        profiler.traceCapacity = capacity;
+    }
+    ProfileTraceEvent* event = &profiler.trace[profiler.traceCount++];
+    event->name = name;
+    event->begin = (begin - profiler.captureStart) * 1e6;
+    event->duration = (end - begin) * 1e6;
+    event->gpu = gpu;
+}
+
+static void writeProfileTrace() {
+    FILE* file = fopen(profiler.capturePath, "w");
+    if (file == NULL) {
+        printf("ERROR::PROFILER::TRACE_OPEN_FAILED %s\n", profiler.capturePath);
+        return;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU render thread\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    for (size_t i = 0; i < profiler.traceCount; i++) {
+        const ProfileTraceEvent* event = &profiler.trace[i];
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            event->name, event->gpu ? "gpu" : "cpu", event->gpu ? 2 : 1, event->begin, event->duration);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    printf("PROFILER::TRACE_WRITTEN %s (%zu events)\n", profiler.capturePath, profiler.traceCount);
+}
+
+static void finishCapture() {
+    if (profiler.capturePath != NULL) {
+        writeProfileTrace();
+    }
+    free(profiler.trace);
+    profiler.trace = NULL;
+    profiler.traceCount = profiler.traceCapacity = 0;
+    profiler.capturePath = NULL;
+}
+
+void startProfileCapture(const char* path, unsigned int frameCount) {
+    if (!profiler.active || frameCount == 0) {
+        return;
+    }
+    finishCapture();
+    calibrateGpuClock();
+    profiler.capturePath = path;
+    profiler.captureFirstFrame = profiler.frameCount;
+    profiler.captureLastFrame = profiler.frameCount + frameCount - 1;
+    profiler.captureStart = getTimeSeconds();
+}
+
+// READ BACK
+
+// only a frame whose last query already landed is read, anything else would wait on the GPU
+static void resolveFrame(ProfileFrame* frame, bool wait) {
+    if (!frame->pending) {
+        return;
+    }
+    frame->pending = false;
+
+    bool gpuReady = true;
+    if (!wait && frame->zoneCount > 0) {
+        // zone 0 is "frame", endProfileFrame closes it after every other zone so its end timestamp is the last one issued
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame->queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        gpuReady = available == GL_TRUE;
+        if (!gpuReady) {
+            profiler.droppedGpuFrames++;
+        }
+    }
+
+    bool capturing = profiler.capturePath != NULL
+        && frame->index >= profiler.captureFirstFrame && frame->index <= profiler.captureLastFrame;
+    for (unsigned int i = 0; i < frame->zoneCount; i++) {
+        const ProfileZone* zone = &frame->zones[i];
+        ProfileSummary* summary = findSummary(zone->name, zone->depth);
+        if (summary != NULL) {
+            accumulate(&summary->cpuMs, (zone->cpuEnd - zone->cpuBegin) * 1000.0);
+        }
+        if (capturing) {
+            addTraceEvent(zone->name, zone->cpuBegin, zone->cpuEnd, false);
+        }
+        if (!gpuReady) {
+            continue;
+        }
+
+        GLuint64 gpuBegin = 0, gpuEnd = 0;
+        glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT, &gpuBegin);
+        glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &gpuEnd);
+        if (summary != NULL) {
+            accumulate(&summary->gpuMs, (double)(gpuEnd - gpuBegin) / 1e6);
+        }
+        if (capturing) {
+            double begin = (double)gpuBegin / 1e9 + profiler.gpuOffset;
+            double end = (double)gpuEnd / 1e9 + profiler.gpuOffset;
+            addTraceEvent(zone->name, begin, end, true);
+        }
+    }
+    if (capturing && frame->index == profiler.captureLastFrame) {
+        finishCapture();
+    }
+}
+
+// FRAMES AND ZONES
+
+void beginProfileFrame() {
+    if (!profiler.active) {
+        return;
+    }
+    ProfileFrame* frame = &profiler.frames[profiler.current];
+    resolveFrame(frame, false);
+
+    frame->index = profiler.frameCount++;
+    frame->zoneCount = 0;
+    profiler.stackDepth = 0;
+    profiler.inFrame = true;
+    beginProfileZone("frame");
+}
+
+void endProfileFrame() {
+    if (!profiler.active || !profiler.inFrame) {
+        return;
+    }
+    while (profiler.stackDepth > 0) {
+        endProfileZone(); // closes "frame" and anything left open
+    }
+    profiler.inFrame = false;
+    profiler.frames[profiler.current].pending = true;
+    profiler.current = (profiler.current + 1) % PROFILER_FRAME_BUFFERS;
+}
+
+void beginProfileZone(const char* name) {
+    ProfileFrame* frame = &profiler.frames[profiler.current];
+    if (!profiler.inFrame || frame->zoneCount == PROFILER_MAX_ZONES || profiler.stackDepth == PROFILER_MAX_DEPTH) {
+        if (profiler.stackDepth < PROFILER_MAX_DEPTH) {
+            profiler.stack[profiler.stackDepth] = PROFILER_MAX_ZONES; // the matching end skips it too
+        }
+        profiler.stackDepth++; // keeps begin/end balanced
+        return;
+    }
+    unsigned int index = frame->zoneCount++;
+    ProfileZone* zone = &frame->zones[index];
+    zone->name = name;
+    zone->depth = profiler.stackDepth;
+    glQueryCounter(frame->queries[index * 2], GL_TIMESTAMP);
+    zone->cpuBegin = getTimeSeconds();
+    zone->cpuEnd = zone->cpuBegin;
+    profiler.stack[profiler.stackDepth++] = index;
+}
+
+void endProfileZone() {
+    if (profiler.stackDepth == 0) {
+        return;
+    }
+    profiler.stackDepth--;
+    ProfileFrame* frame = &profiler.frames[profiler.current];
+    if (profiler.stackDepth >= PROFILER_MAX_DEPTH) {
+        return;
+    }
+    unsigned int index = profiler.stack[profiler.stackDepth];
+    if (index >= frame->zoneCount) {
+        return; // skipped when it began
+    }
+    frame->zones[index].cpuEnd = getTimeSeconds();
+    glQueryCounter(frame->queries[index * 2 + 1], GL_TIMESTAMP);
+}
+
+void shutdownProfiler() {
+    if (!profiler.active) {
+        return;
+    }
+    for (int i = 0; i < PROFILER_FRAME_BUFFERS; i++) {
+        unsigned int slot = (profiler.current + i) % PROFILER_FRAME_BUFFERS;
+        resolveFrame(&profiler.frames[slot], true);
+    }
+    finishCapture();
+    if (profiler.droppedGpuFrames > 0) {
+        printf("PROFILER::GPU_FRAMES_SKIPPED %u\n", profiler.droppedGpuFrames);
+    }
+    for (int i = 0; i < PROFILER_FRAME_BUFFERS; i++) {
+        glDeleteQueries(PROFILER_MAX_ZONES * 2, profiler.frames[i].queries);
+    }
+    profiler.active = false;
+}
@@ -0,0 +1,93 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// SCOPED CPU/GPU FRAME PROFILER: NAMED ZONES ON THE RENDER THREAD, GPU TIMESTAMPS READ BACK FRAMES LATER, CHROME TRACE EXPORT
+
+// build with PROFILER_ENABLED 0 to compile every PROFILE_BEGIN/PROFILE_END away
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_MAX_ZONES 64 // per frame, zones past this are ignored
+#define PROFILER_MAX_DEPTH 16
+#define PROFILER_FRAME_BUFFERS 2 // frames of GPU queries in flight, a frame is read back when its buffer comes around again
+
+typedef struct ProfileZone {
+    const char* name; // must outlive the profiler, string literals
+    unsigned int depth;
+    double cpuBegin; // seconds
+    double cpuEnd;
+} ProfileZone;
+
+typedef struct ProfileFrame {
+    ProfileZone zones[PROFILER_MAX_ZONES];
+    unsigned int queries[PROFILER_MAX_ZONES * 2]; // GL_TIMESTAMP at the begin and end of every zone
+    unsigned int zoneCount;
+    unsigned int index;
+    bool pending; // recorded but not read back yet
+} ProfileFrame;
+
+// one finished zone in a capture, times in microseconds since the capture started
+typedef struct ProfileTraceEvent {
+    const char* name;
+    double begin;
+    double duration;
+    bool gpu;
+} ProfileTraceEvent;
+
+// running averages per zone name for the on-screen summary
+typedef struct ProfileSummary {
+    const char* name;
+    unsigned int depth;
+    double cpuMs;
+    double gpuMs;
+} ProfileSummary;
+
+typedef struct Profiler {
+    bool active;
+    bool inFrame;
+    ProfileFrame frames[PROFILER_FRAME_BUFFERS];
+    unsigned int current;
+    unsigned int frameCount; // frames begun so far
+    unsigned int stack[PROFILER_MAX_DEPTH];
+    unsigned int stackDepth;
+    double gpuOffset; // add to a GPU timestamp (seconds) to get getTimeSeconds() time
+    unsigned int droppedGpuFrames; // read back too early, their GPU times were skipped instead of waited on
+    ProfileSummary summary[PROFILER_MAX_ZONES];
+    unsigned int summaryCount;
+    ProfileTraceEvent* trace;
+    size_t traceCount;
+    size_t traceCapacity;
+    double captureStart;
+    unsigned int captureFirstFrame;
+    unsigned int captureLastFrame;
+    const char* capturePath; // NULL when not capturing
+} Profiler;
+
+extern Profiler profiler;
+
+// needs a current context, does nothing until enabled
+void initProfiler(bool enabled);
+void shutdownProfiler(); // writes an unfinished capture
+void beginProfileFrame();
+void endProfileFrame();
+void beginProfileZone(const char* name);
+void endProfileZone();
+
+// records the next frameCount frames and writes them to path as Chrome trace JSON (chrome://tracing, Perfetto)
+void startProfileCapture(const char* path, unsigned int frameCount);
+// "name cpu/gpu ms" for the top level zones
+void formatProfileSummary(char* buffer, size_t size);
+
+#if PROFILER_ENABLED
+#define PROFILE_BEGIN(name) do { if (profiler.active) beginProfileZone(name); } while (0)
+#define PROFILE_END() do { if (profiler.active) endProfileZone(); } while (0)
+#else
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+#include "RenderQueue.h"
+#include "RenderStats.h"
+#include "Material.h"
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t makeSortKey(unsigned int program, unsigned int texture, unsigned int vertexArray, float depth) {
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > 1.0f) depth = 1.0f;
+    uint64_t quantizedDepth = (uint64_t)(depth * (float)0xFFFFFF);
+    // names wider than their field only lose some grouping, never correctness
+    return ((uint64_t)(program & 0xFFF) << SORT_KEY_PROGRAM_SHIFT)
+         | ((uint64_t)(texture & 0xFFFF) << SORT_KEY_TEXTURE_SHIFT)
+         | ((uint64_t)(vertexArray & 0xFFF) << SORT_KEY_VERTEX_ARRAY_SHIFT)
+         | quantizedDepth;
+}
+
+bool createRenderQueue(RenderQueue* queue, unsigned int capacity) {
+    memset(queue, 0, sizeof(RenderQueue));
+    if (capacity == 0) {
+        capacity = 64;
+    }
+    queue->commands = (RenderCommand*)malloc(sizeof(RenderCommand) * capacity);
+    queue->order = (RenderSortEntry*)malloc(sizeof(RenderSortEntry) * capacity);
+    if (queue->commands == NULL || queue->order == NULL) {
+        destroyRenderQueue(queue);
+        return false;
+    }
+    queue->capacity = capacity;
+    return true;
+}
+
+void destroyRenderQueue(RenderQueue* queue) {
+    free(queue->commands);
+    free(queue->order);
+    memset(queue, 0, sizeof(RenderQueue));
+}
+
+void clearRenderQueue(RenderQueue* queue) {
+    queue->count = 0;
+}
+
+RenderCommand* pushRenderCommand(RenderQueue* queue, uint64_t key) {
+    if (queue->count == queue->capacity) {
+        unsigned int capacity = queue->capacity > 0 ? queue->capacity * 2 : 64;
+        RenderCommand* commands = (RenderCommand*)realloc(queue->commands, sizeof(RenderCommand) * capacity);
+        if (commands == NULL) {
+            return NULL;
+        }
+        queue->commands = commands;
+        RenderSortEntry* order = (RenderSortEntry*)realloc(queue->order, sizeof(RenderSortEntry) * capacity);
+        if (order == NULL) {
+            return NULL;
+        }
+        queue->order = order;
+        queue->capacity = capacity;
+    }
+    unsigned int index = queue->count++;
+    queue->order[index].key = key;
+    queue->order[index].command = index;
+    RenderCommand* command = &queue->commands[index];
+    memset(command, 0, sizeof(RenderCommand));
+    return command;
+}
+
+static int compareSortEntries(const void* a, const void* b) {
+    const RenderSortEntry* x = (const RenderSortEntry*)a;
+    const RenderSortEntry* y = (const RenderSortEntry*)b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (x->command > y->command) - (x->command < y->command);
+}
+
+void submitRenderQueue(RenderQueue* queue, StateCache* cache) {
+    // only the 16-byte entries move while sorting, the commands stay put
+    qsort(queue->order, queue->count, sizeof(RenderSortEntry), compareSortEntries);
+
+    // texture streaming and shader setup bind things behind the cache's back between submits
+    invalidateStateCache(cache);
+    for (unsigned int i = 0; i < queue->count; i++) {
+        RenderCommand* command = &queue->commands[queue->order[i].command];
+        if (!command->shader->ready) {
+            prepareShaderProgram(command->shader);
+            cache->program = STATE_UNKNOWN; // finishing a link binds the program to set its samplers
+        }
+        cacheUseProgram(cache, command->shader->program);
+        cacheBindTexture(cache, 0, command->textureTarget != 0 ? command->textureTarget : GL_TEXTURE_2D, command->texture);
+        cacheBindVertexArray(cache, command->vertexArray);
+        if (command->hasMaterial) {
+            glVertexAttrib1f(MATERIAL_LOCATION, command->material);
+            // GL ignores the current value while the array is enabled, a plain draw would read its first element
+            if (command->materialArray) glDisableVertexAttribArray(MATERIAL_LOCATION);
+        }
+        if (command->hasModel) {
+            glUniformMatrix4fv(command->shader->modelLoc, 1, GL_FALSE, (const GLfloat*)command->model);
+        }
+
+        // an unfinished query draws anyway, the GPU never waits for it
+        if (command->conditionQuery != 0) {
+            glBeginConditionalRender(command->conditionQuery, GL_QUERY_NO_WAIT);
+        }
+        GLenum indexType = command->shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        void* firstIndex = (void*)((size_t)command->firstIndex * (command->shortIndices ? sizeof(unsigned short) : sizeof(unsigned int)));
+        if (command->drawList != NULL) {
+            drawMeshList(command->arena, command->drawList);
+        }
+        else if (command->instanceCount > 0) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command->indexCount, indexType, firstIndex, command->instanceCount, command->baseVertex);
+            countDrawCall(command->indexCount / 3, command->instanceCount);
+        }
+        else {
+            glDrawElementsBaseVertex(GL_TRIANGLES, command->indexCount, indexType, firstIndex, command->baseVertex);
+            countDrawCall(command->indexCount / 3, 1);
+        }
+        if (command->conditionQuery != 0) {
+            glEndConditionalRender();
+        }
+        if (command->hasMaterial && command->materialArray) {
+            glEnableVertexAttribArray(MATERIAL_LOCATION);
+        }
+    }
+    cacheBindVertexArray(cache, 0);
+    clearRenderQueue(queue);
+}
@@ -0,0 +1,61 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stdint.h>
+#include <cglm/cglm.h>
+#include "Shader.h"
+#include "StateCache.h"
+#include "MeshArena.h"
+
+// DRAWS ARE RECORDED AS COMMANDS, SORTED BY A 64-BIT KEY AND SUBMITTED THROUGH THE STATE CACHE
+
+// key layout, most significant first, so draws sharing a program, then a texture, then a vertex array end up together:
+// | program 12 bits | texture 16 bits | vertex array 12 bits | depth 24 bits (front to back) |
+#define SORT_KEY_PROGRAM_SHIFT 52
+#define SORT_KEY_TEXTURE_SHIFT 36
+#define SORT_KEY_VERTEX_ARRAY_SHIFT 24
+
+typedef struct RenderCommand {
+    Shader* shader;
+    unsigned int vertexArray; // with its element buffer already attached
+    unsigned int texture; // unit 0
+    unsigned int textureTarget; // 0 means GL_TEXTURE_2D
+    unsigned int indexCount; // triangles
+    bool shortIndices; // GL_UNSIGNED_SHORT instead of GL_UNSIGNED_INT
+    unsigned int firstIndex;
+    int baseVertex; // added to every index, for meshes sharing an arena
+    unsigned int instanceCount; // 0 for a plain glDrawElements
+    MeshArena* arena; // with drawList: draw the whole list from this arena instead of the single draw above
+    MeshDrawList* drawList;
+    bool hasMaterial; // set the material attribute's current value first, for vertex arrays that carry none per instance
+    float material;
+    bool materialArray; // the vertex array also has a per-instance material array enabled, it is switched off around this draw
+    unsigned int conditionQuery; // GL_ANY_SAMPLES_PASSED query the draw is conditional on, 0 always draws
+    bool hasModel; // upload model to the shader's "model" uniform first
+    mat4 model;
+} RenderCommand;
+
+typedef struct RenderSortEntry {
+    uint64_t key;
+    unsigned int command; // recording order, keeps equal keys stable
+} RenderSortEntry;
+
+typedef struct RenderQueue {
+    RenderCommand* commands;
+    RenderSortEntry* order;
+    unsigned int count;
+    unsigned int capacity;
+} RenderQueue;
+
+// depth is the view distance divided by the far plane, clamped to [0, 1]
+uint64_t makeSortKey(unsigned int program, unsigned int texture, unsigned int vertexArray, float depth);
+
+bool createRenderQueue(RenderQueue* queue, unsigned int capacity);
+void destroyRenderQueue(RenderQueue* queue);
+void clearRenderQueue(RenderQueue* queue);
+// returns a zeroed command to fill in, NULL if the queue cannot grow
+RenderCommand* pushRenderCommand(RenderQueue* queue, uint64_t key);
+// sorts, draws and clears the queue
+void submitRenderQueue(RenderQueue* queue, StateCache* cache);
+
+#endif
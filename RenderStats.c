@@ -0,0 +1,35 @@
+#include "RenderStats.h"
+
+RenderStats renderStats = { 0 };
+
+void resetRenderStats() {
+    renderStats.drawCalls = 0;
+    renderStats.meshDraws = 0;
+    renderStats.instances = 0;
+    renderStats.triangles = 0;
+    renderStats.stateChanges = 0;
+    renderStats.redundantStateChanges = 0;
+    for (unsigned int l = 0; l < RENDER_STATS_LODS; l++) {
+        renderStats.lodTriangles[l] = 0;
+    }
+    renderStats.lodTrianglesSaved = 0;
+}
+
+void countDrawCall(unsigned int triangles, unsigned int instances) {
+    renderStats.drawCalls++;
+    renderStats.meshDraws++;
+    renderStats.instances += instances;
+    renderStats.triangles += triangles * instances;
+}
+
+void countLodDraw(unsigned int level, unsigned int triangles, unsigned int fullDetailTriangles) {
+    renderStats.lodTriangles[level < RENDER_STATS_LODS ? level : RENDER_STATS_LODS - 1] += triangles;
+    renderStats.lodTrianglesSaved += fullDetailTriangles - triangles;
+}
+
+void countMultiDrawCall(unsigned int draws, unsigned int triangles, unsigned int instances) {
+    renderStats.drawCalls++;
+    renderStats.meshDraws += draws;
+    renderStats.instances += instances;
+    renderStats.triangles += triangles;
+}
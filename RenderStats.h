@@ -0,0 +1,26 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+// PER-FRAME RENDERING COUNTERS, RESET AT THE START OF EVERY FRAME AND BUMPED AT EACH DRAW SITE
+
+#define RENDER_STATS_LODS 8 // levels of detail counted separately, deeper levels are counted with the last
+
+typedef struct RenderStats {
+    unsigned int drawCalls; // API calls, a multi-draw counts once
+    unsigned int meshDraws; // meshes drawn, including every one inside a multi-draw
+    unsigned int instances; // summed over all draw calls, 1 for non-instanced draws
+    unsigned int triangles; // including every instance
+    unsigned int stateChanges; // binds actually issued through the state cache
+    unsigned int redundantStateChanges; // binds the state cache skipped because nothing would change
+    unsigned int lodTriangles[RENDER_STATS_LODS]; // triangles drawn from each level of detail
+    unsigned int lodTrianglesSaved; // full detail triangles the chosen levels did not draw
+} RenderStats;
+
+extern RenderStats renderStats;
+
+void resetRenderStats();
+void countDrawCall(unsigned int triangles, unsigned int instances);
+void countLodDraw(unsigned int level, unsigned int triangles, unsigned int fullDetailTriangles); // alongside the draw's own count
+void countMultiDrawCall(unsigned int draws, unsigned int triangles, unsigned int instances); // triangles already include instances
+
+#endif
@@ -0,0 +1,377 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "Replay.h"
+#include "Headless.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_KEYS 0x0F
+#define FRAME_LOOK 0x10 // lookX and lookY follow the clock
+#define FRAME_ZOOM 0x20
+#define MAX_FRAME_BYTES 32 // flags and four varints of at most 5 bytes each, with room to spare
+
+// VARINTS: 7 bits per byte, low bits first, the top bit set on every byte but the last.
+// signed deltas are zigzagged first so small negative ones stay small
+
+static unsigned int putVarint(unsigned char* out, uint64_t value) {
+    unsigned int length = 0;
+    while (value >= 0x80) {
+        out[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (unsigned char)value;
+    return length;
+}
+
+static unsigned int putSigned(unsigned char* out, long value) {
+    int64_t wide = value;
+    return putVarint(out, ((uint64_t)wide << 1) ^ (uint64_t)(wide >> 63));
+}
+
+static bool getVarint(const unsigned char** cursor, const unsigned char* end, uint64_t* value) {
+    *value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (*cursor == end) {
+            return false;
+        }
+        unsigned char byte = *(*cursor)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool getSigned(const unsigned char** cursor, const unsigned char* end, long* value) {
+    uint64_t zigzag;
+    if (!getVarint(cursor, end, &zigzag)) {
+        return false;
+    }
+    *value = (long)(int64_t)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+    return true;
+}
+
+// CAPTURE
+
+bool beginInputCapture(InputCapture* capture, const char* path, unsigned int tickRate, unsigned int width, unsigned int height) {
+    memset(capture, 0, sizeof(InputCapture));
+    capture->file = fopen(path, "wb");
+    if (capture->file == NULL) {
+        printf("ERROR::REPLAY::CAPTURE_OPEN_FAILED %s\n", path);
+        return false;
+    }
+    capture->header.magic = REPLAY_MAGIC;
+    capture->header.version = REPLAY_VERSION;
+    capture->header.tickRate = tickRate;
+    capture->header.width = width;
+    capture->header.height = height;
+    if (fwrite(&capture->header, sizeof(ReplayHeader), 1, capture->file) != 1) {
+        printf("ERROR::REPLAY::CAPTURE_WRITE_FAILED %s\n", path);
+        fclose(capture->file);
+        capture->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+double captureInputFrame(InputCapture* capture, Simulation* simulation, double now) {
+    // the clock is kept in whole microseconds, the replay drives the simulation with exactly these times
+    uint64_t micros = now > 0.0 ? (uint64_t)llround(now * 1000000.0) : 0;
+    if (micros < capture->micros) {
+        micros = capture->micros;
+    }
+    if (capture->file == NULL) {
+        return micros / 1000000.0;
+    }
+
+    // everything pending except what was logged last frame and the ticks have not taken since
+    unsigned int keys;
+    long lookX, lookY, zoom;
+    peekSimulationInput(simulation, &keys, &lookX, &lookY, &zoom);
+    lookX -= capture->leftLookX;
+    lookY -= capture->leftLookY;
+    zoom -= capture->leftZoom;
+
+    unsigned char record[MAX_FRAME_BYTES];
+    unsigned int length = 1;
+    record[0] = (unsigned char)(keys & FRAME_KEYS);
+    length += putVarint(record + length, micros - capture->micros);
+    if (lookX != 0 || lookY != 0) {
+        record[0] |= FRAME_LOOK;
+        length += putSigned(record + length, lookX);
+        length += putSigned(record + length, lookY);
+    }
+    if (zoom != 0) {
+        record[0] |= FRAME_ZOOM;
+        length += putSigned(record + length, zoom);
+    }
+    if (fwrite(record, 1, length, capture->file) != length) {
+        printf("ERROR::REPLAY::CAPTURE_WRITE_FAILED\n");
+        fclose(capture->file);
+        capture->file = NULL;
+    }
+    capture->micros = micros;
+    capture->header.frameCount++;
+    return micros / 1000000.0;
+}
+
+void finishInputFrame(InputCapture* capture, Simulation* simulation) {
+    unsigned int keys;
+    peekSimulationInput(simulation, &keys, &capture->leftLookX, &capture->leftLookY, &capture->leftZoom);
+}
+
+void endInputCapture(InputCapture* capture) {
+    if (capture->file == NULL) {
+        return;
+    }
+    // a capture cut short still replays, the loader reads frames up to the end of the file
+    if (fseek(capture->file, 0, SEEK_SET) != 0 || fwrite(&capture->header, sizeof(ReplayHeader), 1, capture->file) != 1) {
+        printf("ERROR::REPLAY::CAPTURE_WRITE_FAILED\n");
+    }
+    fclose(capture->file);
+    capture->file = NULL;
+    printf("REPLAY::CAPTURED %u frames, %.1f s\n", capture->header.frameCount, capture->micros / 1000000.0);
+}
+
+// REPLAY
+
+bool loadReplay(Replay* replay, const char* path) {
+    memset(replay, 0, sizeof(Replay));
+    MappedFile file;
+    if (!mapFile(path, &file)) {
+        printf("ERROR::REPLAY::OPEN_FAILED %s\n", path);
+        return false;
+    }
+    if (file.size < sizeof(ReplayHeader)) {
+        printf("ERROR::REPLAY::INVALID_FILE %s\n", path);
+        unmapFile(&file);
+        return false;
+    }
+    memcpy(&replay->header, file.data, sizeof(ReplayHeader));
+    if (replay->header.magic != REPLAY_MAGIC || replay->header.version != REPLAY_VERSION) {
+        printf("ERROR::REPLAY::INVALID_FILE %s\n", path);
+        unmapFile(&file);
+        return false;
+    }
+
+    // every frame takes at least two bytes, that bounds the count without a first pass
+    const unsigned char* cursor = (const unsigned char*)file.data + sizeof(ReplayHeader);
+    const unsigned char* end = (const unsigned char*)file.data + file.size;
+    size_t capacity = (size_t)(end - cursor) / 2 + 1;
+    replay->frames = (ReplayFrame*)malloc(capacity * sizeof(ReplayFrame));
+    if (replay->frames == NULL) {
+        printf("ERROR::REPLAY::ALLOCATION_FAILED\n");
+        unmapFile(&file);
+        return false;
+    }
+
+    uint64_t micros = 0;
+    bool ok = true;
+    while (ok && cursor < end) {
+        ReplayFrame* frame = &replay->frames[replay->frameCount];
+        unsigned char flags = *cursor++;
+        uint64_t step;
+        ok = getVarint(&cursor, end, &step);
+        micros += step;
+        frame->time = micros / 1000000.0;
+        frame->keys = flags & FRAME_KEYS;
+        frame->lookX = 0;
+        frame->lookY = 0;
+        frame->zoom = 0;
+        if (ok && (flags & FRAME_LOOK)) {
+            ok = getSigned(&cursor, end, &frame->lookX) && getSigned(&cursor, end, &frame->lookY);
+        }
+        if (ok && (flags & FRAME_ZOOM)) {
+            ok = getSigned(&cursor, end, &frame->zoom);
+        }
+        if (ok) {
+            replay->frameCount++;
+        }
+    }
+    unmapFile(&file);
+
+    if (!ok) {
+        printf("WARNING::REPLAY::TRUNCATED %s, replaying the first %u frames\n", path, replay->frameCount);
+    }
+    else if (replay->header.frameCount != 0 && replay->header.frameCount != replay->frameCount) {
+        printf("WARNING::REPLAY::FRAME_COUNT_MISMATCH %s has %u frames, the header says %u\n", path, replay->frameCount,
+            replay->header.frameCount);
+    }
+    if (replay->frameCount == 0) {
+        printf("ERROR::REPLAY::NO_FRAMES %s\n", path);
+        destroyReplay(replay);
+        return false;
+    }
+    return true;
+}
+
+void destroyReplay(Replay* replay) {
+    free(replay->frames);
+    memset(replay, 0, sizeof(Replay));
+}
+
+void applyReplayFrame(const Replay* replay, unsigned int frame, Simulation* simulation) {
+    const ReplayFrame* input = &replay->frames[frame];
+    setSimulationKeys(simulation, input->keys);
+    addSimulationInput(simulation, input->lookX, input->lookY, input->zoom);
+}
+
+// REPORTS
+
+#define STATS_COLUMNS "frame,time,cpu_ms,gpu_ms,draw_calls,mesh_draws,triangles,state_changes,skipped_state_changes"
+
+bool writeReplayStats(const ReplayFrameStats* stats, unsigned int count, const char* path) {
+    FILE* file = stdout;
+    if (path != NULL) {
+        file = fopen(path, "w");
+        if (file == NULL) {
+            printf("ERROR::REPLAY::STATS_OPEN_FAILED %s\n", path);
+            return false;
+        }
+    }
+    fprintf(file, STATS_COLUMNS "\n");
+    for (unsigned int i = 0; i < count; i++) {
+        const ReplayFrameStats* frame = &stats[i];
+        fprintf(file, "%u,%.6f,%.4f,%.4f,%u,%u,%u,%u,%u\n", i, frame->time, frame->cpuMs, frame->gpuMs, frame->drawCalls,
+            frame->meshDraws, frame->triangles, frame->stateChanges, frame->skippedStateChanges);
+    }
+    if (file != stdout) {
+        fclose(file);
+    }
+    return true;
+}
+
+static ReplayFrameStats* readReplayStats(const char* path, unsigned int* count) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        printf("ERROR::REPLAY::BASELINE_OPEN_FAILED %s\n", path);
+        return NULL;
+    }
+    char line[512];
+    if (fgets(line, sizeof(line), file) == NULL || strncmp(line, STATS_COLUMNS, strlen(STATS_COLUMNS)) != 0) {
+        printf("ERROR::REPLAY::INVALID_BASELINE %s\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    unsigned int capacity = 1024;
+    ReplayFrameStats* stats = (ReplayFrameStats*)malloc(capacity * sizeof(ReplayFrameStats));
+    *count = 0;
+    while (stats != NULL && fgets(line, sizeof(line), file) != NULL) {
+        ReplayFrameStats frame;
+        unsigned int index;
+        if (sscanf(line, "%u,%lf,%lf,%lf,%u,%u,%u,%u,%u", &index, &frame.time, &frame.cpuMs, &frame.gpuMs, &frame.drawCalls,
+                &frame.meshDraws, &frame.triangles, &frame.stateChanges, &frame.skippedStateChanges) != 9) {
+            continue;
+        }
+        if (*count == capacity) {
+            capacity *= 2;
+            ReplayFrameStats* grown = (ReplayFrameStats*)realloc(stats, capacity * sizeof(ReplayFrameStats));
+            if (grown == NULL) {
+                free(stats);
+                stats = NULL;
+                break;
+            }
+            stats = grown;
+        }
+        stats[(*count)++] = frame;
+    }
+    fclose(file);
+    if (stats == NULL) {
+        printf("ERROR::REPLAY::ALLOCATION_FAILED\n");
+    }
+    return stats;
+}
+
+static void printChange(const char* name, double baseline, double current) {
+    double change = baseline > 0.0 ? (current - baseline) / baseline * 100.0 : 0.0;
+    printf("  %-22s %12.3f %12.3f %+9.1f%%\n", name, baseline, current, change);
+}
+
+static void comparePercentiles(const char* name, const double* baseline, const double* current, unsigned int count) {
+    Percentiles a = computePercentiles(baseline, count);
+    Percentiles b = computePercentiles(current, count);
+    char label[64];
+    snprintf(label, sizeof(label), "%s mean", name);
+    printChange(label, a.mean, b.mean);
+    snprintf(label, sizeof(label), "%s p50", name);
+    printChange(label, a.p50, b.p50);
+    snprintf(label, sizeof(label), "%s p95", name);
+    printChange(label, a.p95, b.p95);
+    snprintf(label, sizeof(label), "%s p99", name);
+    printChange(label, a.p99, b.p99);
+}
+
+bool compareReplayStats(const ReplayFrameStats* stats, unsigned int count, const char* baselinePath) {
+    unsigned int baselineCount;
+    ReplayFrameStats* baseline = readReplayStats(baselinePath, &baselineCount);
+    if (baseline == NULL) {
+        return false;
+    }
+    unsigned int frames = count < baselineCount ? count : baselineCount;
+    if (count != baselineCount) {
+        printf("WARNING::REPLAY::FRAME_COUNT_MISMATCH baseline has %u frames, this run %u, comparing the first %u\n",
+            baselineCount, count, frames);
+    }
+    double* values = (double*)malloc(frames * 4 * sizeof(double) + 1);
+    if (values == NULL || frames == 0) {
+        free(values);
+        free(baseline);
+        return frames == 0;
+    }
+
+    // frames line up by index, the same replay renders the same scene in both runs
+    double* baselineCpu = values;
+    double* currentCpu = values + frames;
+    double* baselineGpu = values + frames * 2;
+    double* currentGpu = values + frames * 3;
+    double baselineDraws = 0.0, currentDraws = 0.0, baselineChanges = 0.0, currentChanges = 0.0;
+    unsigned int differing = 0, firstDiffering = 0;
+    for (unsigned int i = 0; i < frames; i++) {
+        baselineCpu[i] = baseline[i].cpuMs;
+        currentCpu[i] = stats[i].cpuMs;
+        baselineGpu[i] = baseline[i].gpuMs;
+        currentGpu[i] = stats[i].gpuMs;
+        baselineDraws += baseline[i].drawCalls;
+        currentDraws += stats[i].drawCalls;
+        baselineChanges += baseline[i].stateChanges;
+        currentChanges += stats[i].stateChanges;
+        if (baseline[i].drawCalls != stats[i].drawCalls || baseline[i].triangles != stats[i].triangles
+            || baseline[i].stateChanges != stats[i].stateChanges) {
+            if (differing == 0) firstDiffering = i;
+            differing++;
+        }
+    }
+
+    printf("REPLAY::COMPARE against %s, %u frames\n", baselinePath, frames);
+    printf("  %-22s %12s %12s %10s\n", "", "baseline", "this run", "change");
+    comparePercentiles("cpu ms", baselineCpu, currentCpu, frames);
+    comparePercentiles("gpu ms", baselineGpu, currentGpu, frames);
+    printChange("draw calls / frame", baselineDraws / frames, currentDraws / frames);
+    printChange("state changes / frame", baselineChanges / frames, currentChanges / frames);
+    if (differing > 0) {
+        printf("  %u frames draw differently, the first is frame %u\n", differing, firstDiffering);
+    }
+    else {
+        printf("  every frame draws the same calls, triangles and state changes\n");
+    }
+
+    // the frames that lost the most CPU time, by repeatedly taking the largest slowdown left
+    printf("  slowest frames against the baseline (cpu ms):\n");
+    bool* listed = (bool*)calloc(frames, sizeof(bool));
+    for (unsigned int n = 0; listed != NULL && n < REPLAY_COMPARE_WORST && n < frames; n++) {
+        unsigned int worst = frames;
+        for (unsigned int i = 0; i < frames; i++) {
+            if (!listed[i] && (worst == frames || currentCpu[i] - baselineCpu[i] > currentCpu[worst] - baselineCpu[worst])) {
+                worst = i;
+            }
+        }
+        listed[worst] = true;
+        printf("    frame %6u  t=%8.3f s  %8.3f -> %8.3f\n", worst, stats[worst].time, baselineCpu[worst], currentCpu[worst]);
+    }
+    free(listed);
+    free(values);
+    free(baseline);
+    return true;
+}
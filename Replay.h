@@ -0,0 +1,85 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "Simulation.h"
+
+// INPUT CAPTURE AND DETERMINISTIC REPLAY (.crep)
+// a capture logs every frame's clock and the input that arrived during it. a replay hands the simulation the same
+// input at the same virtual times, so it runs the same ticks and every frame renders the same scene no matter how
+// fast the build replaying it is. frames are a flags byte (held keys, which deltas follow) and varints, a 60Hz frame
+// without mouse or scroll input takes 4 bytes
+
+#define REPLAY_MAGIC 0x50455243u // "CREP"
+#define REPLAY_VERSION 1u
+#define REPLAY_COMPARE_WORST 5 // slowest frames the comparison lists
+
+typedef struct ReplayHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t tickRate; // simulation ticks per second
+    uint32_t width; // framebuffer the capture rendered to
+    uint32_t height;
+    uint32_t frameCount; // patched when the capture ends, 0 when it never did
+} ReplayHeader;
+
+// one frame, look and zoom in the simulation's fixed point units
+typedef struct ReplayFrame {
+    double time; // seconds since the capture started, whole microseconds
+    unsigned int keys; // SIM_KEY_* held
+    long lookX; // input added since the frame before
+    long lookY;
+    long zoom;
+} ReplayFrame;
+
+typedef struct InputCapture {
+    FILE* file;
+    ReplayHeader header;
+    uint64_t micros; // clock of the last frame
+    // input the ticks had not taken yet after the last frame, it is still pending but was already logged
+    long leftLookX;
+    long leftLookY;
+    long leftZoom;
+} InputCapture;
+
+typedef struct Replay {
+    ReplayHeader header;
+    ReplayFrame* frames;
+    unsigned int frameCount;
+} Replay;
+
+// what one replayed frame cost, the rows a replay writes and compares
+typedef struct ReplayFrameStats {
+    double time;
+    double cpuMs;
+    double gpuMs;
+    unsigned int drawCalls;
+    unsigned int meshDraws;
+    unsigned int triangles;
+    unsigned int stateChanges;
+    unsigned int skippedStateChanges;
+} ReplayFrameStats;
+
+// the simulation must tick inline on the main thread while capturing, a thread would drain input at times the log
+// cannot reproduce
+bool beginInputCapture(InputCapture* capture, const char* path, unsigned int tickRate, unsigned int width, unsigned int height);
+// before updateSimulation: logs the frame at now seconds since the capture started with the keys held and the input
+// added since the last frame, returns now rounded the way the log stores it, drive the simulation with that
+double captureInputFrame(InputCapture* capture, Simulation* simulation, double now);
+// after updateSimulation: notes what the ticks left pending so the next frame does not log it again
+void finishInputFrame(InputCapture* capture, Simulation* simulation);
+void endInputCapture(InputCapture* capture);
+
+bool loadReplay(Replay* replay, const char* path);
+void destroyReplay(Replay* replay);
+// hands the frame's input to the simulation, then run updateSimulation and sampleSimulation at frames[frame].time
+void applyReplayFrame(const Replay* replay, unsigned int frame, Simulation* simulation);
+
+// one CSV row per frame, path NULL prints to stdout
+bool writeReplayStats(const ReplayFrameStats* stats, unsigned int count, const char* path);
+// reads the writeReplayStats file of an earlier run of the same replay and prints how this one differs frame by frame
+bool compareReplayStats(const ReplayFrameStats* stats, unsigned int count, const char* baselinePath);
+
+#endif
@@ -0,0 +1,337 @@
+#include "SceneGraph.h"
+#include "Platform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool createSceneGraph(SceneGraph* graph, unsigned int capacity) {
+    memset(graph, 0, sizeof(SceneGraph));
+    if (capacity == 0) {
+        capacity = 1;
+    }
+    graph->slotOf = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    graph->parentHandle = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    graph->handleAt = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    graph->parent = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    graph->subtreeSize = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    graph->position = (vec3*)malloc(sizeof(vec3) * capacity);
+    graph->rotation = (versor*)alignedAlloc(sizeof(versor) * capacity, 16);
+    graph->scale = (vec3*)malloc(sizeof(vec3) * capacity);
+    graph->localDirty = (bool*)malloc(sizeof(bool) * capacity);
+    graph->local = (mat4*)alignedAlloc(sizeof(mat4) * capacity, 64);
+    graph->world = (mat4*)alignedAlloc(sizeof(mat4) * capacity, 64);
+    graph->dirty = (unsigned int*)malloc(sizeof(unsigned int) * capacity);
+    if (graph->slotOf == NULL || graph->parentHandle == NULL || graph->handleAt == NULL || graph->parent == NULL
+        || graph->subtreeSize == NULL || graph->position == NULL || graph->rotation == NULL || graph->scale == NULL
+        || graph->localDirty == NULL || graph->local == NULL || graph->world == NULL || graph->dirty == NULL) {
+        destroySceneGraph(graph);
+        return false;
+    }
+    graph->capacity = capacity;
+    return true;
+}
+
+void destroySceneGraph(SceneGraph* graph) {
+    free(graph->slotOf);
+    free(graph->parentHandle);
+    free(graph->handleAt);
+    free(graph->parent);
+    free(graph->subtreeSize);
+    free(graph->position);
+    alignedFree(graph->rotation);
+    free(graph->scale);
+    free(graph->localDirty);
+    alignedFree(graph->local);
+    alignedFree(graph->world);
+    free(graph->dirty);
+    memset(graph, 0, sizeof(SceneGraph));
+}
+
+vec4* getSceneNodeWorld(const SceneGraph* graph, unsigned int node) {
+    return graph->world[graph->slotOf[node]];
+}
+
+// NODES
+
+// a new node goes at the end until the next update puts it under its parent
+unsigned int addSceneNode(SceneGraph* graph, unsigned int parent, vec3 position, versor rotation, vec3 scale) {
+    if (graph->count == graph->capacity || (parent != SCENE_NO_PARENT && parent >= graph->count)) {
+        printf("ERROR::SCENE_GRAPH::CANNOT_ADD_NODE\n");
+        return INVALID_SCENE_NODE;
+    }
+    unsigned int node = graph->count++;
+    graph->slotOf[node] = node;
+    graph->handleAt[node] = node;
+    graph->parentHandle[node] = parent;
+    glm_vec3_copy(position, graph->position[node]);
+    glm_quat_copy(rotation, graph->rotation[node]);
+    glm_vec3_copy(scale, graph->scale[node]);
+    graph->localDirty[node] = true;
+    graph->layoutDirty = true;
+    return node;
+}
+
+static void markDirty(SceneGraph* graph, unsigned int node, unsigned int slot) {
+    if (!graph->localDirty[slot]) {
+        graph->localDirty[slot] = true;
+        graph->dirty[graph->dirtyCount++] = node;
+    }
+}
+
+void setSceneNodeTransform(SceneGraph* graph, unsigned int node, vec3 position, versor rotation, vec3 scale) {
+    unsigned int slot = graph->slotOf[node];
+    glm_vec3_copy(position, graph->position[slot]);
+    glm_quat_copy(rotation, graph->rotation[slot]);
+    glm_vec3_copy(scale, graph->scale[slot]);
+    markDirty(graph, node, slot);
+}
+
+void setSceneNodeRotation(SceneGraph* graph, unsigned int node, versor rotation) {
+    unsigned int slot = graph->slotOf[node];
+    glm_quat_copy(rotation, graph->rotation[slot]);
+    markDirty(graph, node, slot);
+}
+
+// LAYOUT
+
+// moves every per-slot array into depth-first order: each root, then its subtree, children in the order they were added
+static bool rebuildLayout(SceneGraph* graph) {
+    unsigned int count = graph->count;
+    unsigned int* childStart = (unsigned int*)calloc((size_t)count + 1, sizeof(unsigned int));
+    unsigned int* children = (unsigned int*)malloc(sizeof(unsigned int) * (count > 0 ? count : 1));
+    unsigned int* stack = (unsigned int*)malloc(sizeof(unsigned int) * (count > 0 ? count : 1));
+    unsigned int* order = (unsigned int*)malloc(sizeof(unsigned int) * (count > 0 ? count : 1)); // new slot -> old slot
+    void* scratch = alignedAlloc(sizeof(mat4) * (count > 0 ? count : 1), 64);
+    if (childStart == NULL || children == NULL || stack == NULL || order == NULL || scratch == NULL) {
+        free(childStart); free(children); free(stack); free(order); alignedFree(scratch);
+        return false;
+    }
+
+    // children of every handle as one packed list
+    for (unsigned int node = 0; node < count; node++) {
+        if (graph->parentHandle[node] != SCENE_NO_PARENT) childStart[graph->parentHandle[node] + 1]++;
+    }
+    for (unsigned int node = 0; node < count; node++) {
+        childStart[node + 1] += childStart[node];
+    }
+    memcpy(stack, childStart, sizeof(unsigned int) * count); // fill cursors for now
+    for (unsigned int node = 0; node < count; node++) {
+        if (graph->parentHandle[node] != SCENE_NO_PARENT) children[stack[graph->parentHandle[node]]++] = node;
+    }
+
+    // depth-first walk, children pushed in reverse so they come out in order
+    unsigned int written = 0;
+    for (unsigned int root = 0; root < count; root++) {
+        if (graph->parentHandle[root] != SCENE_NO_PARENT) continue;
+        unsigned int top = 0;
+        stack[top++] = root;
+        while (top > 0) {
+            unsigned int node = stack[--top];
+            order[written] = graph->slotOf[node];
+            graph->handleAt[written] = node;
+            written++;
+            for (unsigned int c = childStart[node + 1]; c > childStart[node]; c--) {
+                stack[top++] = children[c - 1];
+            }
+        }
+    }
+    for (unsigned int slot = 0; slot < count; slot++) {
+        graph->slotOf[graph->handleAt[slot]] = slot;
+    }
+    for (unsigned int slot = 0; slot < count; slot++) {
+        unsigned int parent = graph->parentHandle[graph->handleAt[slot]];
+        graph->parent[slot] = parent != SCENE_NO_PARENT ? graph->slotOf[parent] : SCENE_NO_PARENT;
+        graph->subtreeSize[slot] = 1;
+    }
+    // children sit after their parent, so walking backwards finishes every subtree before its root
+    for (unsigned int slot = count; slot-- > 0;) {
+        if (graph->parent[slot] != SCENE_NO_PARENT) graph->subtreeSize[graph->parent[slot]] += graph->subtreeSize[slot];
+    }
+
+    // the local transforms follow their nodes, worlds are all recomputed anyway
+    vec3* positions = (vec3*)scratch;
+    for (unsigned int slot = 0; slot < count; slot++) glm_vec3_copy(graph->position[order[slot]], positions[slot]);
+    memcpy(graph->position, positions, sizeof(vec3) * count);
+    for (unsigned int slot = 0; slot < count; slot++) glm_vec3_copy(graph->scale[order[slot]], positions[slot]);
+    memcpy(graph->scale, positions, sizeof(vec3) * count);
+    versor* rotations = (versor*)scratch;
+    for (unsigned int slot = 0; slot < count; slot++) glm_quat_copy(graph->rotation[order[slot]], rotations[slot]);
+    memcpy(graph->rotation, rotations, sizeof(versor) * count);
+    mat4* locals = (mat4*)scratch;
+    for (unsigned int slot = 0; slot < count; slot++) glm_mat4_copy(graph->local[order[slot]], locals[slot]);
+    memcpy(graph->local, locals, sizeof(mat4) * count);
+    bool* flags = (bool*)stack;
+    for (unsigned int slot = 0; slot < count; slot++) flags[slot] = graph->localDirty[order[slot]];
+    memcpy(graph->localDirty, flags, sizeof(bool) * count);
+
+    free(childStart); free(children); free(stack); free(order); alignedFree(scratch);
+    graph->layoutDirty = false;
+    return true;
+}
+
+// UPDATE
+
+// translate * rotate * scale written out directly, no identity to start from and no matrix products
+static void composeLocal(const vec3 position, versor rotation, const vec3 scale, mat4 local) {
+    glm_quat_mat4(rotation, local);
+    for (int row = 0; row < 3; row++) {
+        local[0][row] *= scale[0];
+        local[1][row] *= scale[1];
+        local[2][row] *= scale[2];
+    }
+    local[3][0] = position[0];
+    local[3][1] = position[1];
+    local[3][2] = position[2];
+}
+
+// recomputes slots [begin, end), parents before children
+static void updateRange(SceneGraph* graph, unsigned int begin, unsigned int end) {
+    for (unsigned int slot = begin; slot < end; slot++) {
+        if (graph->localDirty[slot]) {
+            composeLocal(graph->position[slot], graph->rotation[slot], graph->scale[slot], graph->local[slot]);
+            graph->localDirty[slot] = false;
+        }
+        unsigned int parent = graph->parent[slot];
+        if (parent == SCENE_NO_PARENT) {
+            glm_mat4_copy(graph->local[slot], graph->world[slot]);
+        }
+        else {
+            glm_mat4_mul(graph->world[parent], graph->local[slot], graph->world[slot]);
+        }
+    }
+    graph->updatedNodes += end - begin;
+}
+
+static int compareSlots(const void* a, const void* b) {
+    unsigned int x = *(const unsigned int*)a;
+    unsigned int y = *(const unsigned int*)b;
+    return (x > y) - (x < y);
+}
+
+void updateSceneGraph(SceneGraph* graph) {
+    graph->updatedNodes = 0;
+    if (graph->layoutDirty) {
+        if (!rebuildLayout(graph)) {
+            printf("ERROR::SCENE_GRAPH::ALLOCATION_FAILED\n");
+            return;
+        }
+        updateRange(graph, 0, graph->count);
+        graph->dirtyCount = 0;
+        return;
+    }
+
+    // in slot order a dirty node inside a subtree already being updated comes after its root and is skipped
+    for (unsigned int i = 0; i < graph->dirtyCount; i++) {
+        graph->dirty[i] = graph->slotOf[graph->dirty[i]];
+    }
+    qsort(graph->dirty, graph->dirtyCount, sizeof(unsigned int), compareSlots);
+    unsigned int coveredEnd = 0;
+    for (unsigned int i = 0; i < graph->dirtyCount; i++) {
+        unsigned int slot = graph->dirty[i];
+        if (slot < coveredEnd) continue;
+        coveredEnd = slot + graph->subtreeSize[slot];
+        updateRange(graph, slot, coveredEnd);
+    }
+    graph->dirtyCount = 0;
+}
+
+// BENCHMARK
+
+static unsigned int benchmarkSeed = 4242u;
+
+static unsigned int randomIndex(unsigned int count) {
+    benchmarkSeed = benchmarkSeed * 1664525u + 1013904223u;
+    return (benchmarkSeed >> 8) % count;
+}
+
+// the old way for every node: identity, glm_translate, glm_rotate, glm_scale, then the parent product
+static void rebuildAllWorlds(const SceneGraph* graph, mat4* out) {
+    for (unsigned int slot = 0; slot < graph->count; slot++) {
+        mat4 local = GLM_MAT4_IDENTITY_INIT;
+        glm_translate(local, (float*)graph->position[slot]);
+        glm_quat_rotate(local, (float*)graph->rotation[slot], local);
+        glm_scale(local, (float*)graph->scale[slot]);
+        unsigned int parent = graph->parent[slot];
+        if (parent == SCENE_NO_PARENT) glm_mat4_copy(local, out[slot]);
+        else glm_mat4_mul(out[parent], local, out[slot]);
+    }
+}
+
+void benchmarkSceneGraph(void) {
+    const unsigned int nodeCount = 100000;
+    const unsigned int treeSize = 100; // a root and 99 descendants, each under a random earlier node of its tree
+    const unsigned int animatedCount = nodeCount / 100;
+    const unsigned int frames = 200;
+
+    SceneGraph graph;
+    unsigned int* animated = (unsigned int*)malloc(sizeof(unsigned int) * animatedCount);
+    mat4* reference = (mat4*)alignedAlloc(sizeof(mat4) * nodeCount, 64);
+    if (!createSceneGraph(&graph, nodeCount) || animated == NULL || reference == NULL) {
+        printf("ERROR::BENCHMARK::ALLOCATION_FAILED\n");
+        destroySceneGraph(&graph);
+        free(animated);
+        alignedFree(reference);
+        return;
+    }
+    for (unsigned int node = 0; node < nodeCount; node++) {
+        unsigned int inTree = node % treeSize;
+        unsigned int parent = inTree == 0 ? SCENE_NO_PARENT : node - inTree + randomIndex(inTree);
+        vec3 position = { (float)randomIndex(200) - 100.0f, (float)randomIndex(200) - 100.0f, (float)randomIndex(200) - 100.0f };
+        versor rotation;
+        glm_quatv(rotation, (float)randomIndex(628) * 0.01f, (vec3) { 0.0f, 1.0f, 0.0f });
+        vec3 scale = { 1.0f, 1.0f, 1.0f };
+        if (inTree != 0) glm_vec3_scale(position, 0.01f, position);
+        addSceneNode(&graph, parent, position, rotation, scale);
+    }
+    for (unsigned int i = 0; i < animatedCount; i++) {
+        animated[i] = randomIndex(nodeCount);
+    }
+    double start = getTimeSeconds();
+    updateSceneGraph(&graph);
+    double layoutTime = getTimeSeconds() - start;
+
+    // every frame the same 1% spin a little further
+    double dirtyTime = 0.0, fullTime = 0.0, staticTime = 0.0;
+    unsigned long long updated = 0;
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        for (unsigned int i = 0; i < animatedCount; i++) {
+            versor rotation;
+            glm_quatv(rotation, (float)frame * 0.01f + (float)i, (vec3) { 0.0f, 1.0f, 0.0f });
+            setSceneNodeRotation(&graph, animated[i], rotation);
+        }
+        start = getTimeSeconds();
+        updateSceneGraph(&graph);
+        dirtyTime += getTimeSeconds() - start;
+        updated += graph.updatedNodes;
+
+        start = getTimeSeconds();
+        rebuildAllWorlds(&graph, reference);
+        fullTime += getTimeSeconds() - start;
+
+        start = getTimeSeconds();
+        updateSceneGraph(&graph); // nothing changed since the last one
+        staticTime += getTimeSeconds() - start;
+    }
+
+    float maxError = 0.0f;
+    for (unsigned int slot = 0; slot < nodeCount; slot++) {
+        const float* a = (const float*)reference[slot];
+        const float* b = (const float*)graph.world[slot];
+        for (int k = 0; k < 16; k++) {
+            float error = fabsf(a[k] - b[k]);
+            if (error > maxError) maxError = error;
+        }
+    }
+
+    printf("SCENE GRAPH BENCHMARK (%u nodes in trees of %u, %u animated, %u frames)\n", nodeCount, treeSize, animatedCount, frames);
+    printf("%24s %10.4f ms\n", "first update (layout)", layoutTime * 1000.0);
+    printf("%24s %10.4f ms\n", "full rebuild per frame", fullTime * 1000.0 / frames);
+    printf("%24s %10.4f ms (%llu nodes recomputed per frame)\n", "dirty update per frame", dirtyTime * 1000.0 / frames, updated / frames);
+    printf("%24s %10.4f ms\n", "static frame", staticTime * 1000.0 / frames);
+    printf("%24s %9.1fx, max error %.2e\n", "speedup", fullTime / (dirtyTime > 0.0 ? dirtyTime : 1e-9), maxError);
+
+    destroySceneGraph(&graph);
+    free(animated);
+    alignedFree(reference);
+}
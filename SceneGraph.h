@@ -0,0 +1,51 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <stdbool.h>
+#include <cglm/cglm.h>
+
+// PARENT/CHILD TRANSFORMS IN FLAT ARRAYS, DEPTH-FIRST ORDERED SO EVERY NODE'S SUBTREE IS ONE CONTIGUOUS RUN.
+// AN UPDATE ONLY RECOMPUTES THE SUBTREES OF NODES THAT CHANGED, A GRAPH WHERE NOTHING MOVED COSTS NOTHING
+
+#define SCENE_NO_PARENT 0xFFFFFFFFu
+#define INVALID_SCENE_NODE 0xFFFFFFFFu
+
+// nodes are named by handles that never change, the arrays below are indexed by slot, which moves whenever nodes
+// are added and the order is rebuilt
+typedef struct SceneGraph {
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int* slotOf; // handle -> slot
+    unsigned int* parentHandle; // by handle, SCENE_NO_PARENT for roots
+    unsigned int* handleAt; // slot -> handle
+    unsigned int* parent; // by slot from here on, always a lower slot
+    unsigned int* subtreeSize; // the node and everything below it, slots [slot, slot + subtreeSize)
+    vec3* position; // local translation, rotation and scale
+    versor* rotation;
+    vec3* scale;
+    bool* localDirty;
+    mat4* local; // translate * rotate * scale
+    mat4* world; // parent world * local
+    unsigned int* dirty; // handles changed since the last update, each at most once
+    unsigned int dirtyCount;
+    bool layoutDirty; // nodes were added, the order is rebuilt on the next update
+    unsigned int updatedNodes; // world matrices the last update recomputed
+} SceneGraph;
+
+bool createSceneGraph(SceneGraph* graph, unsigned int capacity);
+void destroySceneGraph(SceneGraph* graph);
+
+// parent is a handle or SCENE_NO_PARENT, returns the new node's handle or INVALID_SCENE_NODE when the graph is full
+unsigned int addSceneNode(SceneGraph* graph, unsigned int parent, vec3 position, versor rotation, vec3 scale);
+void setSceneNodeTransform(SceneGraph* graph, unsigned int node, vec3 position, versor rotation, vec3 scale);
+void setSceneNodeRotation(SceneGraph* graph, unsigned int node, versor rotation);
+
+// recomputes the world matrices of every changed node and everything below it
+void updateSceneGraph(SceneGraph* graph);
+// valid after updateSceneGraph, until the next one
+vec4* getSceneNodeWorld(const SceneGraph* graph, unsigned int node);
+
+// 100k nodes in 1000 trees with 1% of them animated, dirty updates against rebuilding every matrix every frame
+void benchmarkSceneGraph(void);
+
+#endif
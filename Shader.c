@@ -0,0 +1,339 @@
+#include "Shader.h"
+#include "Platform.h"
+#include "Material.h"
+#include "Lighting.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// COMPILE AND LINK A VERTEX/FRAGMENT PAIR
+unsigned int setUpShader(const char* vertSource, const char* fragSource) {
+    unsigned int vertexShader;
+    vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertSource, NULL);
+    glCompileShader(vertexShader);
+
+    int success;
+    char infoLog[512];
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+        printf("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", infoLog);
+    }
+
+    unsigned int fragmentShader;
+    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragSource, NULL);
+    glCompileShader(fragmentShader);
+
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        printf("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s\n", infoLog);
+    }
+
+    unsigned int shaderProgram;
+    shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", infoLog);
+    }
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    return shaderProgram;
+}
+
+// PROGRAM BINARY CACHE
+
+#define SHADER_CACHE_MAGIC 0x4E494253u // "SBIN"
+
+typedef struct ShaderCache {
+    bool binaries;
+    bool parallel;
+    char directory[260];
+    char driver[512]; // vendor, renderer and version, a driver update invalidates every binary
+} ShaderCache;
+
+static ShaderCache shaderCache;
+
+// FNV-1a, seeded so chained calls hash several strings as one
+static uint64_t hashString(uint64_t hash, const char* text) {
+    for (const unsigned char* c = (const unsigned char*)text; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= 0xFF; // separator so ("ab", "c") and ("a", "bc") differ
+    return hash * 1099511628211ULL;
+}
+
+static void getBinaryPath(const Shader* shader, char* path, size_t pathSize) {
+    snprintf(path, pathSize, "%s/%016llx.bin", shaderCache.directory, (unsigned long long)shader->hash);
+}
+
+void initShaderCache(const char* directory, bool useBinaryCache) {
+    memset(&shaderCache, 0, sizeof(shaderCache));
+    snprintf(shaderCache.directory, sizeof(shaderCache.directory), "%s", directory);
+    snprintf(shaderCache.driver, sizeof(shaderCache.driver), "%s|%s|%s",
+             (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+
+    if (useBinaryCache && (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)) {
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        shaderCache.binaries = formats > 0 && createDirectory(directory);
+    }
+
+    // let the driver compile on its own threads, link calls then return before the work is done
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        shaderCache.parallel = true;
+    }
+    else if (GLAD_GL_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        shaderCache.parallel = true;
+    }
+}
+
+static bool loadProgramBinary(Shader* shader) {
+    char path[300];
+    getBinaryPath(shader, path, sizeof(path));
+    MappedFile file;
+    if (!mapFile(path, &file)) {
+        return false;
+    }
+
+    bool linked = false;
+    const uint32_t* header = (const uint32_t*)file.data;
+    if (file.size > sizeof(uint32_t) * 3 && header[0] == SHADER_CACHE_MAGIC && header[2] == file.size - sizeof(uint32_t) * 3) {
+        shader->program = glCreateProgram();
+        glProgramBinary(shader->program, header[1], header + 3, (GLsizei)header[2]);
+        int success = 0;
+        glGetProgramiv(shader->program, GL_LINK_STATUS, &success);
+        linked = success != 0;
+        if (!linked) {
+            // rejected by the driver (format no longer supported), compile from source instead
+            glDeleteProgram(shader->program);
+            shader->program = 0;
+        }
+    }
+    unmapFile(&file);
+    return linked;
+}
+
+static void saveProgramBinary(const Shader* shader) {
+    int length = 0;
+    glGetProgramiv(shader->program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    uint32_t* buffer = (uint32_t*)malloc(sizeof(uint32_t) * 3 + length);
+    if (buffer == NULL) {
+        return;
+    }
+    GLenum format = 0;
+    glGetProgramBinary(shader->program, length, NULL, &format, buffer + 3);
+    buffer[0] = SHADER_CACHE_MAGIC;
+    buffer[1] = format;
+    buffer[2] = (uint32_t)length;
+
+    char path[300];
+    getBinaryPath(shader, path, sizeof(path));
+    FILE* file = fopen(path, "wb");
+    if (file != NULL) {
+        if (fwrite(buffer, 1, sizeof(uint32_t) * 3 + length, file) != sizeof(uint32_t) * 3 + length) {
+            printf("ERROR::SHADER::CACHE_WRITE_FAILED %s\n", path);
+        }
+        fclose(file);
+    }
+    free(buffer);
+}
+
+// LAZY PROGRAMS
+
+Shader declareShaderProgram(const char* vertSource, const char* fragSource) {
+    Shader shader;
+    memset(&shader, 0, sizeof(Shader));
+    shader.modelLoc = shader.transformLoc = shader.viewLoc = shader.projectionLoc = -1;
+    shader.vertSource = vertSource;
+    shader.fragSource = fragSource;
+    return shader;
+}
+
+// resolve everything the render loop needs up front
+static void resolveUniforms(Shader* shader) {
+    shader->modelLoc = glGetUniformLocation(shader->program, "model");
+    shader->transformLoc = glGetUniformLocation(shader->program, "transform");
+    shader->viewLoc = glGetUniformLocation(shader->program, "view");
+    shader->projectionLoc = glGetUniformLocation(shader->program, "projection");
+
+    // attach the Camera block (if the program has one) to the shared binding point
+    unsigned int cameraBlock = glGetUniformBlockIndex(shader->program, "Camera");
+    if (cameraBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader->program, cameraBlock, CAMERA_BLOCK_BINDING);
+    }
+    unsigned int materialBlock = glGetUniformBlockIndex(shader->program, "Materials");
+    if (materialBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader->program, materialBlock, MATERIAL_BLOCK_BINDING);
+    }
+    unsigned int lightBlock = glGetUniformBlockIndex(shader->program, "Lights");
+    if (lightBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader->program, lightBlock, LIGHT_BLOCK_BINDING);
+    }
+
+    // samplers never change unit, so assign them once here instead of every frame
+    glUseProgram(shader->program);
+    int samplerLoc = glGetUniformLocation(shader->program, "ourTexture");
+    if (samplerLoc != -1) glUniform1i(samplerLoc, 0);
+    samplerLoc = glGetUniformLocation(shader->program, "texture1");
+    if (samplerLoc != -1) glUniform1i(samplerLoc, 0);
+    samplerLoc = glGetUniformLocation(shader->program, "texture2");
+    if (samplerLoc != -1) glUniform1i(samplerLoc, 1);
+    samplerLoc = glGetUniformLocation(shader->program, "materialTextures");
+    if (samplerLoc != -1) glUniform1i(samplerLoc, 0);
+    samplerLoc = glGetUniformLocation(shader->program, "lightData");
+    if (samplerLoc != -1) glUniform1i(samplerLoc, LIGHT_DATA_UNIT);
+    samplerLoc = glGetUniformLocation(shader->program, "clusterData");
+    if (samplerLoc != -1) glUniform1i(samplerLoc, CLUSTER_DATA_UNIT);
+    glUseProgram(0);
+}
+
+void requestShaderProgram(Shader* shader) {
+    if (shader->ready || shader->compiling) {
+        return;
+    }
+    shader->hash = hashString(hashString(hashString(14695981039346656037ULL, shader->vertSource), shader->fragSource), shaderCache.driver);
+    if (shaderCache.binaries && loadProgramBinary(shader)) {
+        resolveUniforms(shader);
+        shader->ready = true;
+        return;
+    }
+
+    // issue compile and link back to back without querying anything, with parallel compile
+    // enabled these return immediately and the driver works in the background
+    shader->vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(shader->vertexShader, 1, &shader->vertSource, NULL);
+    glCompileShader(shader->vertexShader);
+    shader->fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(shader->fragmentShader, 1, &shader->fragSource, NULL);
+    glCompileShader(shader->fragmentShader);
+
+    shader->program = glCreateProgram();
+    if (shaderCache.binaries) {
+        glProgramParameteri(shader->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(shader->program, shader->vertexShader);
+    glAttachShader(shader->program, shader->fragmentShader);
+    glLinkProgram(shader->program);
+    shader->compiling = true;
+}
+
+// check the results of a compile started by requestShaderProgram, blocks until the driver is done
+static void finishShaderProgram(Shader* shader) {
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader->vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader->vertexShader, 512, NULL, infoLog);
+        printf("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", infoLog);
+    }
+    glGetShaderiv(shader->fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader->fragmentShader, 512, NULL, infoLog);
+        printf("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s\n", infoLog);
+    }
+    glGetProgramiv(shader->program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shader->program, 512, NULL, infoLog);
+        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", infoLog);
+    }
+    else if (shaderCache.binaries) {
+        saveProgramBinary(shader);
+    }
+
+    glDetachShader(shader->program, shader->vertexShader);
+    glDetachShader(shader->program, shader->fragmentShader);
+    glDeleteShader(shader->vertexShader);
+    glDeleteShader(shader->fragmentShader);
+    shader->vertexShader = shader->fragmentShader = 0;
+    shader->compiling = false;
+
+    resolveUniforms(shader);
+    shader->ready = true;
+}
+
+bool isShaderProgramReady(Shader* shader) {
+    if (shader->ready) {
+        return true;
+    }
+    if (!shader->compiling) {
+        return false;
+    }
+    if (shaderCache.parallel) {
+        int complete = 0;
+        glGetProgramiv(shader->program, GL_COMPLETION_STATUS_KHR, &complete);
+        if (!complete) {
+            return false;
+        }
+    }
+    finishShaderProgram(shader);
+    return true;
+}
+
+void prepareShaderProgram(Shader* shader) {
+    if (!shader->ready) {
+        requestShaderProgram(shader);
+        if (shader->compiling) {
+            finishShaderProgram(shader);
+        }
+    }
+}
+
+void useShaderProgram(Shader* shader) {
+    prepareShaderProgram(shader);
+    glUseProgram(shader->program);
+}
+
+Shader setUpShaderProgram(const char* vertSource, const char* fragSource) {
+    Shader shader = declareShaderProgram(vertSource, fragSource);
+    requestShaderProgram(&shader);
+    if (shader.compiling) {
+        finishShaderProgram(&shader);
+    }
+    return shader;
+}
+
+void deleteShaderProgram(Shader* shader) {
+    if (shader->compiling) {
+        glDeleteShader(shader->vertexShader);
+        glDeleteShader(shader->fragmentShader);
+    }
+    if (shader->program != 0) {
+        glDeleteProgram(shader->program);
+    }
+    shader->program = 0;
+    shader->compiling = false;
+    shader->ready = false;
+}
+
+// CAMERA UNIFORM BLOCK
+
+// called once per frame, every program reading the Camera block sees the new matrices. the block moves
+// through the stream buffer instead of being overwritten in place, so no draw still in flight is waited on
+bool updateCameraBuffer(StreamBuffer* stream, mat4 view, mat4 projection) {
+    size_t offset;
+    unsigned char* block = (unsigned char*)mapStream(stream, CAMERA_BLOCK_SIZE, stream->uniformAlignment, &offset);
+    if (block == NULL) {
+        return false;
+    }
+    memcpy(block, view, sizeof(mat4));
+    memcpy(block + sizeof(mat4), projection, sizeof(mat4));
+    unmapStream(stream);
+    glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, stream->buffer, offset, CAMERA_BLOCK_SIZE);
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+#include <cglm/cglm.h>
+#include <stdint.h>
+#include "StreamBuffer.h"
+
+// uniform buffer binding point shared by every program that declares the Camera block
+#define CAMERA_BLOCK_BINDING 0
+#define SHADER_CACHE_DIRECTORY "shadercache"
+
+// a program is only compiled the first time it is requested or used; once linked it caches
+// the uniform locations resolved at link time (-1 when unused)
+typedef struct Shader {
+    unsigned int program;
+    int modelLoc;
+    int transformLoc;
+    int viewLoc; // only set for programs that do not use the Camera block
+    int projectionLoc;
+    const char* vertSource; // must outlive the Shader, the sources are string literals
+    const char* fragSource;
+    unsigned int vertexShader; // only while a compile is in flight
+    unsigned int fragmentShader;
+    uint64_t hash; // sources + driver, names the program binary in the cache
+    bool compiling;
+    bool ready;
+} Shader;
+
+// std140 layout of the Camera block: two column-major mat4s back to back
+#define CAMERA_BLOCK_SIZE (2 * sizeof(mat4))
+
+// call once after GL is loaded: enables the program binary cache and parallel compiles when available
+void initShaderCache(const char* directory, bool useBinaryCache);
+
+unsigned int setUpShader(const char* vertSource, const char* fragSource);
+Shader setUpShaderProgram(const char* vertSource, const char* fragSource); // compiles right away
+Shader declareShaderProgram(const char* vertSource, const char* fragSource); // compiles on first use
+void requestShaderProgram(Shader* shader); // start compiling (or load the cached binary) without waiting
+bool isShaderProgramReady(Shader* shader); // never blocks
+void prepareShaderProgram(Shader* shader); // finishes the program if needed, leaves the bound program alone
+void useShaderProgram(Shader* shader); // finishes the program if needed, then glUseProgram
+void deleteShaderProgram(Shader* shader);
+
+// writes view and projection into this frame's stream memory and points the Camera block at them
+bool updateCameraBuffer(StreamBuffer* stream, mat4 view, mat4 projection);
+
+#endif
@@ -0,0 +1,197 @@
+#include "Simulation.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CAMERA_SPEED 2.5f // units per second
+#define LOOK_SENSITIVITY 0.1f // degrees per pixel, change this value to your liking
+
+static void updateCameraFront(Simulation* simulation) {
+    vec3 front;
+    front[0] = cosf(glm_rad(simulation->yaw)) * cosf(glm_rad(simulation->pitch));
+    front[1] = sinf(glm_rad(simulation->pitch));
+    front[2] = sinf(glm_rad(simulation->yaw)) * cosf(glm_rad(simulation->pitch));
+    glm_normalize(front);
+    glm_vec3_copy(front, simulation->state.cameraFront);
+}
+
+void initSimulation(Simulation* simulation, unsigned int tickRate, double now) {
+    memset(simulation, 0, sizeof(Simulation));
+    simulation->tickSeconds = 1.0 / (tickRate > 0 ? tickRate : SIMULATION_HZ);
+    simulation->yaw = -90.0f; // a yaw of 0.0 points to the right, so start turned a bit to the left
+    simulation->pitch = 0.0f;
+    simulation->state.cameraPos[2] = 3.0f;
+    simulation->state.fov = 45.0f;
+    updateCameraFront(simulation);
+
+    // every slot starts out as the initial state, the renderer has something to draw before the first tick
+    for (int i = 0; i < 3; i++) {
+        simulation->slots[i].previous = simulation->state;
+        simulation->slots[i].current = simulation->state;
+        simulation->slots[i].tickTime = now;
+    }
+    simulation->front = 0;
+    simulation->middle = 1;
+    simulation->back = 2;
+    simulation->nextTick = now + simulation->tickSeconds;
+}
+
+// TICKS
+
+static long takeInput(AtomicInt* value) {
+    return atomicExchange(value, 0);
+}
+
+// one fixed step, the same input always gives the same result no matter how often it runs per frame
+static void stepSimulation(Simulation* simulation) {
+    SceneState* state = &simulation->state;
+    float dt = (float)simulation->tickSeconds;
+
+    simulation->yaw += (float)takeInput(&simulation->input.lookX) / SIM_INPUT_SCALE * LOOK_SENSITIVITY;
+    simulation->pitch += (float)takeInput(&simulation->input.lookY) / SIM_INPUT_SCALE * LOOK_SENSITIVITY;
+    // make sure that when pitch is out of bounds, screen doesn't get flipped
+    simulation->pitch = fminf(fmaxf(simulation->pitch, -89.0f), 89.0f);
+    updateCameraFront(simulation);
+
+    state->fov -= (float)takeInput(&simulation->input.zoom) / SIM_INPUT_SCALE;
+    state->fov = fminf(fmaxf(state->fov, 1.0f), 45.0f);
+
+    long keys = atomicLoad(&simulation->input.keys);
+    vec3 up = { 0.0f, 1.0f, 0.0f };
+    vec3 right, step;
+    glm_vec3_cross(state->cameraFront, up, right);
+    glm_normalize(right);
+    if (keys & SIM_KEY_FORWARD) {
+        glm_vec3_scale(state->cameraFront, CAMERA_SPEED * dt, step);
+        glm_vec3_add(state->cameraPos, step, state->cameraPos);
+    }
+    if (keys & SIM_KEY_BACK) {
+        glm_vec3_scale(state->cameraFront, CAMERA_SPEED * dt, step);
+        glm_vec3_sub(state->cameraPos, step, state->cameraPos);
+    }
+    if (keys & SIM_KEY_LEFT) {
+        glm_vec3_scale(right, CAMERA_SPEED * dt, step);
+        glm_vec3_sub(state->cameraPos, step, state->cameraPos);
+    }
+    if (keys & SIM_KEY_RIGHT) {
+        glm_vec3_scale(right, CAMERA_SPEED * dt, step);
+        glm_vec3_add(state->cameraPos, step, state->cameraPos);
+    }
+
+    simulation->tick++;
+    state->time = simulation->tick * simulation->tickSeconds;
+}
+
+// fill the back slot, then swap it with the middle one, the old middle becomes the next back slot
+static void publishSnapshot(Simulation* simulation, const SceneState* previous, double tickTime) {
+    SceneSnapshot* snapshot = &simulation->slots[simulation->back];
+    snapshot->previous = *previous;
+    snapshot->current = simulation->state;
+    snapshot->tickTime = tickTime;
+    snapshot->tick = simulation->tick;
+    simulation->back = (unsigned int)atomicExchange(&simulation->middle, (long)simulation->back | SNAPSHOT_FRESH) & ~SNAPSHOT_FRESH;
+}
+
+unsigned int updateSimulation(Simulation* simulation, double now) {
+    unsigned int steps = 0;
+    while (now >= simulation->nextTick) {
+        if (steps == SIMULATION_MAX_CATCH_UP) {
+            // too far behind to catch up, drop the backlog rather than stall on it
+            simulation->droppedTicks += (unsigned int)((now - simulation->nextTick) / simulation->tickSeconds);
+            simulation->nextTick = now + simulation->tickSeconds;
+            break;
+        }
+        SceneState previous = simulation->state;
+        stepSimulation(simulation);
+        publishSnapshot(simulation, &previous, simulation->nextTick);
+        simulation->nextTick += simulation->tickSeconds;
+        steps++;
+    }
+    return steps;
+}
+
+static int simulationMain(void* arg) {
+    Simulation* simulation = (Simulation*)arg;
+    while (atomicLoad(&simulation->running)) {
+        updateSimulation(simulation, getTimeSeconds());
+        double wait = simulation->nextTick - getTimeSeconds();
+        sleepMilliseconds(wait > 0.0 ? (unsigned int)(wait * 1000.0) : 0);
+    }
+    return 0;
+}
+
+bool startSimulationThread(Simulation* simulation) {
+    atomicStore(&simulation->running, 1);
+    simulation->threaded = createThread(&simulation->thread, simulationMain, simulation);
+    if (!simulation->threaded) {
+        atomicStore(&simulation->running, 0);
+        printf("ERROR::SIMULATION::THREAD_CREATION_FAILED\n");
+    }
+    return simulation->threaded;
+}
+
+void stopSimulationThread(Simulation* simulation) {
+    if (!simulation->threaded) {
+        return;
+    }
+    atomicStore(&simulation->running, 0);
+    joinThread(&simulation->thread);
+    simulation->threaded = false;
+    if (simulation->droppedTicks > 0) {
+        printf("SIMULATION::TICKS_DROPPED %u\n", simulation->droppedTicks);
+    }
+}
+
+// RENDER SIDE
+
+static float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+void sampleSimulation(Simulation* simulation, double now, SceneState* scene) {
+    if (atomicLoad(&simulation->middle) & SNAPSHOT_FRESH) {
+        simulation->front = (unsigned int)atomicExchange(&simulation->middle, (long)simulation->front) & ~SNAPSHOT_FRESH;
+    }
+    const SceneSnapshot* snapshot = &simulation->slots[simulation->front];
+
+    // the newest tick is shown one tick late, sliding from the state before it to it as wall time catches up
+    float t = (float)((now - snapshot->tickTime) / simulation->tickSeconds);
+    t = fminf(fmaxf(t, 0.0f), 1.0f);
+    const SceneState* a = &snapshot->previous;
+    const SceneState* b = &snapshot->current;
+    scene->time = a->time + (b->time - a->time) * t;
+    for (int i = 0; i < 3; i++) {
+        scene->cameraPos[i] = lerp(a->cameraPos[i], b->cameraPos[i], t);
+        scene->cameraFront[i] = lerp(a->cameraFront[i], b->cameraFront[i], t);
+    }
+    glm_normalize(scene->cameraFront);
+    scene->fov = lerp(a->fov, b->fov, t);
+}
+
+// INPUT
+
+void setSimulationKeys(Simulation* simulation, unsigned int keys) {
+    atomicStore(&simulation->input.keys, (long)keys);
+}
+
+void addSimulationLook(Simulation* simulation, float xoffset, float yoffset) {
+    atomicAdd(&simulation->input.lookX, lroundf(xoffset * SIM_INPUT_SCALE));
+    atomicAdd(&simulation->input.lookY, lroundf(yoffset * SIM_INPUT_SCALE));
+}
+
+void addSimulationZoom(Simulation* simulation, float offset) {
+    atomicAdd(&simulation->input.zoom, lroundf(offset * SIM_INPUT_SCALE));
+}
+
+void peekSimulationInput(Simulation* simulation, unsigned int* keys, long* lookX, long* lookY, long* zoom) {
+    *keys = (unsigned int)atomicLoad(&simulation->input.keys);
+    *lookX = atomicLoad(&simulation->input.lookX);
+    *lookY = atomicLoad(&simulation->input.lookY);
+    *zoom = atomicLoad(&simulation->input.zoom);
+}
+
+void addSimulationInput(Simulation* simulation, long lookX, long lookY, long zoom) {
+    atomicAdd(&simulation->input.lookX, lookX);
+    atomicAdd(&simulation->input.lookY, lookY);
+    atomicAdd(&simulation->input.zoom, zoom);
+}
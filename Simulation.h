@@ -0,0 +1,87 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cglm/cglm.h>
+#include <stdbool.h>
+#include "Platform.h"
+
+// FIXED-TIMESTEP SIMULATION ON ITS OWN THREAD: EVERY TICK PUBLISHES A SNAPSHOT THROUGH A LOCK-FREE TRIPLE BUFFER,
+// THE RENDER THREAD TAKES THE NEWEST ONE WITHOUT WAITING AND INTERPOLATES INSIDE IT
+
+#define SIMULATION_HZ 60
+#define SIMULATION_MAX_CATCH_UP 5 // ticks run back to back after a stall, time past that is dropped
+#define SNAPSHOT_FRESH 0x4 // set on the shared slot index while the render thread has not taken it
+
+// keys held on the main thread, sampled by every tick
+#define SIM_KEY_FORWARD 0x1
+#define SIM_KEY_BACK 0x2
+#define SIM_KEY_LEFT 0x4
+#define SIM_KEY_RIGHT 0x8
+
+#define SIM_INPUT_SCALE 16.0f // mouse and scroll deltas travel as fixed point integers, 1/16 of a unit
+
+// everything the renderer needs from the game side, animations are pure functions of time
+typedef struct SceneState {
+    double time; // simulation seconds
+    vec3 cameraPos;
+    vec3 cameraFront;
+    float fov;
+} SceneState;
+
+// the state after a tick and the one before it, so a single snapshot is enough to interpolate
+typedef struct SceneSnapshot {
+    SceneState previous;
+    SceneState current;
+    double tickTime; // when the tick was scheduled, on the clock updateSimulation is given
+    unsigned int tick;
+} SceneSnapshot;
+
+// written by the GLFW callbacks, drained by the simulation
+typedef struct SimulationInput {
+    AtomicInt keys;
+    AtomicInt lookX; // fixed point, SIM_INPUT_SCALE
+    AtomicInt lookY;
+    AtomicInt zoom;
+} SimulationInput;
+
+typedef struct Simulation {
+    // triple buffer: the simulation writes slots[back], the renderer reads slots[front], middle is the handoff
+    SceneSnapshot slots[3];
+    AtomicInt middle;
+    unsigned int back; // simulation thread only
+    unsigned int front; // render thread only
+
+    // simulation thread only
+    SceneState state;
+    float yaw;
+    float pitch;
+    unsigned int tick;
+    double tickSeconds;
+    double nextTick;
+    unsigned int droppedTicks;
+
+    SimulationInput input;
+    AtomicInt running;
+    bool threaded;
+    Thread thread;
+} Simulation;
+
+// now is the clock updateSimulation and sampleSimulation will be given, getTimeSeconds() or a virtual one
+void initSimulation(Simulation* simulation, unsigned int tickRate, double now);
+// runs ticks on a thread of its own, false leaves the caller to call updateSimulation itself
+bool startSimulationThread(Simulation* simulation);
+void stopSimulationThread(Simulation* simulation);
+// runs every tick that is due by now, returns how many ran
+unsigned int updateSimulation(Simulation* simulation, double now);
+
+// render thread: never blocks, blends the newest snapshot's two states for the given time
+void sampleSimulation(Simulation* simulation, double now, SceneState* scene);
+
+void setSimulationKeys(Simulation* simulation, unsigned int keys);
+void addSimulationLook(Simulation* simulation, float xoffset, float yoffset);
+void addSimulationZoom(Simulation* simulation, float offset);
+// input not taken by a tick yet, in the fixed point units above, and adding it back that way for a replay
+void peekSimulationInput(Simulation* simulation, unsigned int* keys, long* lookX, long* lookY, long* zoom);
+void addSimulationInput(Simulation* simulation, long lookX, long lookY, long zoom);
+
+#endif
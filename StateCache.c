@@ -0,0 +1,70 @@
+#include <glad/glad.h>
+#include "StateCache.h"
+#include "RenderStats.h"
+#include <string.h>
+
+void initStateCache(StateCache* cache, bool enabled) {
+    cache->enabled = enabled;
+    invalidateStateCache(cache);
+}
+
+void invalidateStateCache(StateCache* cache) {
+    cache->program = STATE_UNKNOWN;
+    cache->vertexArray = STATE_UNKNOWN;
+    cache->activeTexture = STATE_UNKNOWN;
+    memset(cache->textures, 0xFF, sizeof(cache->textures));
+}
+
+// true when the call has to be issued, counts it either way
+static bool changeState(const StateCache* cache, unsigned int* current, unsigned int value) {
+    if (cache->enabled && *current == value) {
+        renderStats.redundantStateChanges++;
+        return false;
+    }
+    *current = value;
+    renderStats.stateChanges++;
+    return true;
+}
+
+static int getTargetSlot(unsigned int target) {
+    switch (target) {
+    case GL_TEXTURE_2D: return 0;
+    case GL_TEXTURE_2D_ARRAY: return 1;
+    case GL_TEXTURE_BUFFER: return 2;
+    default: return -1;
+    }
+}
+
+void cacheUseProgram(StateCache* cache, unsigned int program) {
+    if (changeState(cache, &cache->program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void cacheBindVertexArray(StateCache* cache, unsigned int vertexArray) {
+    if (changeState(cache, &cache->vertexArray, vertexArray)) {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+void cacheBindTexture(StateCache* cache, unsigned int unit, unsigned int target, unsigned int texture) {
+    int slot = getTargetSlot(target);
+    if (slot < 0 || unit >= STATE_CACHE_TEXTURE_UNITS) {
+        // not tracked, bind it and forget what the unit had
+        if (changeState(cache, &cache->activeTexture, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+        glBindTexture(target, texture);
+        renderStats.stateChanges++;
+        return;
+    }
+    if (cache->enabled && cache->textures[unit][slot] == texture) {
+        renderStats.redundantStateChanges += 2; // the active unit switch is not needed either
+        return;
+    }
+    if (changeState(cache, &cache->activeTexture, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    changeState(cache, &cache->textures[unit][slot], texture);
+    glBindTexture(target, texture);
+}
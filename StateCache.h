@@ -0,0 +1,28 @@
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <stdbool.h>
+
+// SHADOW COPY OF THE GL BINDINGS THE RENDER QUEUE TOUCHES, A BIND THAT WOULD CHANGE NOTHING IS NEVER ISSUED
+
+#define STATE_CACHE_TEXTURE_UNITS 16
+#define STATE_CACHE_TEXTURE_TARGETS 3 // GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER
+#define STATE_UNKNOWN 0xFFFFFFFFu // never a valid GL name, forces the next bind through
+
+typedef struct StateCache {
+    bool enabled; // false forwards every call, to measure what the cache saves
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeTexture; // unit index, not GL_TEXTURE0 + n
+    unsigned int textures[STATE_CACHE_TEXTURE_UNITS][STATE_CACHE_TEXTURE_TARGETS];
+} StateCache;
+
+void initStateCache(StateCache* cache, bool enabled);
+// forget everything, for when code outside the cache may have changed the bindings
+void invalidateStateCache(StateCache* cache);
+
+void cacheUseProgram(StateCache* cache, unsigned int program);
+void cacheBindVertexArray(StateCache* cache, unsigned int vertexArray);
+void cacheBindTexture(StateCache* cache, unsigned int unit, unsigned int target, unsigned int texture);
+
+#endif
@@ -0,0 +1,141 @@
+#include "StreamBuffer.h"
+#include "GpuMemory.h"
+#include <stdio.h>
+#include <string.h>
+
+bool createStreamBuffer(StreamBuffer* stream, size_t frameSize, bool allowPersistent) {
+    memset(stream, 0, sizeof(StreamBuffer));
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    stream->uniformAlignment = alignment > 0 ? (size_t)alignment : 256;
+    // room for the padding every aligned allocation may add
+    stream->frameSize = (frameSize + 255) & ~(size_t)255;
+    stream->size = stream->frameSize * STREAM_FRAMES;
+    stream->persistent = allowPersistent && (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage);
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    if (stream->persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, stream->size, NULL, flags);
+        stream->mapping = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, stream->size, flags);
+        if (stream->mapping == NULL) {
+            // immutable storage cannot be respecified, start over with a plain buffer
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &stream->buffer);
+            printf("ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED\n");
+            return createStreamBuffer(stream, frameSize, false);
+        }
+    }
+    else {
+        glBufferData(GL_COPY_WRITE_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    trackGpuResource(GPU_BUFFER, stream->buffer, GPU_MEMORY_STREAMING, stream->size);
+    return true;
+}
+
+void destroyStreamBuffer(StreamBuffer* stream) {
+    if (stream->buffer == 0) {
+        return;
+    }
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        if (stream->fences[i] != NULL) {
+            glDeleteSync(stream->fences[i]);
+        }
+    }
+    if (stream->persistent || stream->mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    releaseGpuResource(GPU_BUFFER, stream->buffer);
+    glDeleteBuffers(1, &stream->buffer);
+    if (stream->stalls > 0 || stream->overflows > 0) {
+        printf("STREAM_BUFFER::STALLS %u OVERFLOWS %u\n", stream->stalls, stream->overflows);
+    }
+    memset(stream, 0, sizeof(StreamBuffer));
+}
+
+// FRAMES
+
+void beginStreamFrame(StreamBuffer* stream) {
+    if (!stream->persistent) {
+        // the ring runs on, orphaning keeps older frames alive. it wraps between frames only, storage orphaned in the
+        // middle of one would take the data already written for it, the camera block among them, along
+        if (stream->head + stream->frameSize > stream->size) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, stream->size, NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            stream->head = 0;
+        }
+        stream->frameStart = stream->head;
+        return;
+    }
+    stream->frame = (stream->frame + 1) % STREAM_FRAMES;
+    GLsync fence = stream->fences[stream->frame];
+    if (fence != NULL) {
+        // normally signalled long ago, STREAM_FRAMES frames have been submitted since
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            stream->stalls++;
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        stream->fences[stream->frame] = NULL;
+    }
+    stream->frameStart = stream->frame * stream->frameSize;
+    stream->head = stream->frameStart;
+}
+
+void endStreamFrame(StreamBuffer* stream) {
+    if (stream->persistent) {
+        stream->fences[stream->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+// ALLOCATION
+
+void* mapStream(StreamBuffer* stream, size_t size, size_t alignment, size_t* offset) {
+    if (size == 0) {
+        return NULL; // nothing to write, not an overflow
+    }
+    size_t start = alignment > 1 ? (stream->head + alignment - 1) / alignment * alignment : stream->head;
+    size_t frameUsed = start + size - stream->frameStart;
+    if (frameUsed > stream->frameSize) {
+        stream->overflows++;
+        return NULL;
+    }
+
+    if (stream->persistent) {
+        stream->head = start + size;
+        *offset = start;
+        return stream->mapping + start;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    // nothing since the last orphan touched this range, so the driver need not wait for anything
+    void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (data == NULL) {
+        printf("ERROR::STREAM_BUFFER::MAP_FAILED\n");
+        return NULL;
+    }
+    stream->mapped = true;
+    stream->head = start + size;
+    *offset = start;
+    return data;
+}
+
+void unmapStream(StreamBuffer* stream) {
+    if (!stream->mapped) {
+        return; // persistent and coherent, the writes are already visible
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    stream->mapped = false;
+}
@@ -0,0 +1,41 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// RING BUFFER FOR DATA WRITTEN ONCE PER FRAME: ONE BUFFER OBJECT SPLIT INTO STREAM_FRAMES REGIONS, THE CPU
+// FILLS ONE WHILE THE GPU STILL READS THE OTHERS, NOTHING IS EVER REWRITTEN WHILE A DRAW MAY BE USING IT
+
+#define STREAM_FRAMES 3 // frames of latency before a region is written again
+
+typedef struct StreamBuffer {
+    unsigned int buffer;
+    size_t frameSize; // most bytes one frame may allocate
+    size_t size; // STREAM_FRAMES * frameSize
+    size_t uniformAlignment; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, for ranges bound as uniform blocks
+    // GL 4.4 / ARB_buffer_storage: mapped once for good, a fence per region says when the GPU is done with it.
+    // otherwise every allocation is mapped unsynchronized and the buffer is orphaned whenever the ring wraps
+    bool persistent;
+    unsigned char* mapping; // whole buffer, persistent only
+    GLsync fences[STREAM_FRAMES];
+    unsigned int frame; // region of the current frame
+    size_t head; // next free byte
+    size_t frameStart;
+    bool mapped; // an unsynchronized range is mapped right now
+    unsigned int stalls; // frames that waited for the GPU to release their region
+    unsigned int overflows; // allocations refused because the frame was full
+} StreamBuffer;
+
+bool createStreamBuffer(StreamBuffer* stream, size_t frameSize, bool allowPersistent);
+void destroyStreamBuffer(StreamBuffer* stream);
+void beginStreamFrame(StreamBuffer* stream);
+void endStreamFrame(StreamBuffer* stream); // after the last draw that reads this frame's data
+
+// reserves size bytes for this frame, returns where to write them and their offset in the buffer, NULL when
+// the frame is out of space or size is 0. every successful map needs an unmapStream before the data is drawn with
+void* mapStream(StreamBuffer* stream, size_t size, size_t alignment, size_t* offset);
+void unmapStream(StreamBuffer* stream);
+
+#endif
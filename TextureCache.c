@@ -0,0 +1,279 @@
+#include "TextureCache.h"
+#include "Platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEVEL_ALIGNMENT 16
+
+void getTextureCachePath(const char* sourcePath, char* cachePath, size_t cachePathSize) {
+    snprintf(cachePath, cachePathSize, "%s%s", sourcePath, TEXTURE_CACHE_EXTENSION);
+}
+
+// COOK
+
+// 2x2 box filter, odd edges reuse the last row/column
+static unsigned char* downsample(const unsigned char* source, int width, int height, int* outWidth, int* outHeight) {
+    int newWidth = width > 1 ? width / 2 : 1;
+    int newHeight = height > 1 ? height / 2 : 1;
+    unsigned char* result = (unsigned char*)malloc((size_t)newWidth * newHeight * 4);
+    if (result == NULL) {
+        return NULL;
+    }
+    for (int y = 0; y < newHeight; y++) {
+        int y0 = y * 2 < height ? y * 2 : height - 1;
+        int y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+        for (int x = 0; x < newWidth; x++) {
+            int x0 = x * 2 < width ? x * 2 : width - 1;
+            int x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            for (int c = 0; c < 4; c++) {
+                int sum = source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c]
+                        + source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c];
+                result[(y * newWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    *outWidth = newWidth;
+    *outHeight = newHeight;
+    return result;
+}
+
+static uint16_t packRGB565(const int color[3]) {
+    return (uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static void unpackRGB565(uint16_t packed, int color[3]) {
+    color[0] = ((packed >> 11) & 31) * 255 / 31;
+    color[1] = ((packed >> 5) & 63) * 255 / 63;
+    color[2] = (packed & 31) * 255 / 31;
+}
+
+// bounding box BC1 encoder: endpoints are the per-channel min and max of the block
+static void compressBlockBC1(const unsigned char* rgba, int width, int height, int blockX, int blockY, unsigned char* out) {
+    int pixels[16][3];
+    int minColor[3] = { 255, 255, 255 }, maxColor[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        int x = blockX * 4 + i % 4;
+        int y = blockY * 4 + i / 4;
+        if (x >= width) x = width - 1;
+        if (y >= height) y = height - 1;
+        for (int c = 0; c < 3; c++) {
+            pixels[i][c] = rgba[(y * width + x) * 4 + c];
+            if (pixels[i][c] < minColor[c]) minColor[c] = pixels[i][c];
+            if (pixels[i][c] > maxColor[c]) maxColor[c] = pixels[i][c];
+        }
+    }
+
+    uint16_t color0 = packRGB565(maxColor);
+    uint16_t color1 = packRGB565(minColor);
+    uint32_t indices = 0;
+    if (color0 < color1) {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+    if (color0 != color1) {
+        // color0 > color1 selects the four color mode: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDistance = 0x7FFFFFFF;
+            for (int p = 0; p < 4; p++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++) {
+                    int difference = pixels[i][c] - palette[p][c];
+                    distance += difference * difference;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    out[0] = (unsigned char)(color0 & 0xFF);
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)(color1 & 0xFF);
+    out[3] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (unsigned char)((indices >> (i * 8)) & 0xFF);
+    }
+}
+
+static unsigned char* compressBC1(const unsigned char* rgba, int width, int height, size_t* size) {
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    *size = (size_t)blocksX * blocksY * 8;
+    unsigned char* blocks = (unsigned char*)malloc(*size);
+    if (blocks == NULL) {
+        return NULL;
+    }
+    for (int y = 0; y < blocksY; y++) {
+        for (int x = 0; x < blocksX; x++) {
+            compressBlockBC1(rgba, width, height, x, y, blocks + ((size_t)y * blocksX + x) * 8);
+        }
+    }
+    return blocks;
+}
+
+static bool writePadding(FILE* file, uint64_t* offset) {
+    static const unsigned char zeros[LEVEL_ALIGNMENT] = { 0 };
+    size_t padding = (size_t)((LEVEL_ALIGNMENT - (*offset % LEVEL_ALIGNMENT)) % LEVEL_ALIGNMENT);
+    *offset += padding;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+
+bool cookTexture(const char* sourcePath, const unsigned char* rgba, int width, int height, bool compress) {
+    TextureCacheHeader header;
+    if (!getFileInfo(sourcePath, &header.sourceSize, &header.sourceTime)) {
+        return false;
+    }
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = compress ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+
+    // build the whole mip chain in memory first so the level table can be written up front
+    unsigned char* mips[TEXTURE_CACHE_MAX_LEVELS] = { (unsigned char*)rgba };
+    unsigned char* levelData[TEXTURE_CACHE_MAX_LEVELS] = { 0 };
+    TextureCacheLevel levels[TEXTURE_CACHE_MAX_LEVELS];
+    int mipWidth = width, mipHeight = height;
+    unsigned int levelCount = 0;
+    bool ok = true;
+    while (ok) {
+        levels[levelCount].width = (uint32_t)mipWidth;
+        levels[levelCount].height = (uint32_t)mipHeight;
+        levelCount++;
+        if ((mipWidth == 1 && mipHeight == 1) || levelCount == TEXTURE_CACHE_MAX_LEVELS) break;
+        mips[levelCount] = downsample(mips[levelCount - 1], mipWidth, mipHeight, &mipWidth, &mipHeight);
+        ok = mips[levelCount] != NULL;
+    }
+    for (unsigned int i = 0; ok && i < levelCount; i++) {
+        size_t size = (size_t)levels[i].width * levels[i].height * 4;
+        levelData[i] = compress ? compressBC1(mips[i], levels[i].width, levels[i].height, &size) : mips[i];
+        levels[i].size = size;
+        ok = levelData[i] != NULL;
+    }
+    header.levelCount = levelCount;
+
+    uint64_t offset = sizeof(TextureCacheHeader) + sizeof(TextureCacheLevel) * levelCount;
+    for (unsigned int i = 0; i < levelCount; i++) {
+        offset += (LEVEL_ALIGNMENT - (offset % LEVEL_ALIGNMENT)) % LEVEL_ALIGNMENT;
+        levels[i].offset = offset;
+        offset += levels[i].size;
+    }
+
+    // write to a temporary file and swap it in so a half written cache is never picked up
+    char cachePath[512], temporaryPath[520];
+    getTextureCachePath(sourcePath, cachePath, sizeof(cachePath));
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", cachePath);
+    FILE* file = ok ? fopen(temporaryPath, "wb") : NULL;
+    if (file != NULL) {
+        offset = sizeof(TextureCacheHeader) + sizeof(TextureCacheLevel) * levelCount;
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(levels, sizeof(TextureCacheLevel), levelCount, file) == levelCount;
+        for (unsigned int i = 0; ok && i < levelCount; i++) {
+            ok = writePadding(file, &offset) && fwrite(levelData[i], 1, (size_t)levels[i].size, file) == levels[i].size;
+            offset += levels[i].size;
+        }
+        ok = fclose(file) == 0 && ok;
+        if (ok) {
+            remove(cachePath);
+            ok = rename(temporaryPath, cachePath) == 0;
+        }
+        if (!ok) {
+            remove(temporaryPath);
+        }
+    }
+    else {
+        ok = false;
+    }
+
+    for (unsigned int i = 0; i < levelCount; i++) {
+        if (compress) free(levelData[i]);
+        if (i > 0) free(mips[i]);
+    }
+    if (!ok) {
+        printf("ERROR::TEXTURE::COOK_FAILED %s\n", cachePath);
+    }
+    return ok;
+}
+
+// LOAD
+
+static bool validateCache(const MappedFile* file, const char* sourcePath) {
+    if (file->size < sizeof(TextureCacheHeader)) {
+        return false;
+    }
+    const TextureCacheHeader* header = (const TextureCacheHeader*)file->data;
+    uint64_t sourceSize, sourceTime;
+    if (header->magic != TEXTURE_CACHE_MAGIC || header->version != TEXTURE_CACHE_VERSION) {
+        return false;
+    }
+    if (getFileInfo(sourcePath, &sourceSize, &sourceTime) && (sourceSize != header->sourceSize || sourceTime != header->sourceTime)) {
+        return false; // the source changed since cooking
+    }
+    if (header->levelCount == 0 || header->levelCount > TEXTURE_CACHE_MAX_LEVELS) {
+        return false;
+    }
+    if (header->format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT && !GLAD_GL_EXT_texture_compression_s3tc) {
+        return false; // cooked on a machine with S3TC, this driver cannot use it
+    }
+    if (header->format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && header->format != GL_RGBA8) {
+        return false;
+    }
+    const TextureCacheLevel* levels = (const TextureCacheLevel*)(header + 1);
+    if (file->size < sizeof(TextureCacheHeader) + sizeof(TextureCacheLevel) * header->levelCount) {
+        return false;
+    }
+    // every level must be exactly the bytes its size needs and lie inside the file, the upload reads that many
+    // straight from the mapping
+    uint32_t width = header->width, height = header->height;
+    for (unsigned int i = 0; i < header->levelCount; i++) {
+        uint64_t expected = header->format == GL_RGBA8 ? (uint64_t)width * height * 4
+            : (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+        if (width == 0 || height == 0 || levels[i].width != width || levels[i].height != height || levels[i].size != expected
+            || levels[i].offset > file->size || levels[i].size > file->size - levels[i].offset) {
+            printf("ERROR::TEXTURE_CACHE::CORRUPT_LEVEL %u of %s\n", i, sourcePath);
+            return false;
+        }
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return true;
+}
+
+bool openCachedTexture(const char* sourcePath, CachedTexture* cached) {
+    char cachePath[512];
+    getTextureCachePath(sourcePath, cachePath, sizeof(cachePath));
+
+    memset(cached, 0, sizeof(CachedTexture));
+    if (!mapFile(cachePath, &cached->file)) {
+        return false;
+    }
+    if (!validateCache(&cached->file, sourcePath)) {
+        unmapFile(&cached->file);
+        return false;
+    }
+    cached->header = (const TextureCacheHeader*)cached->file.data;
+    cached->levels = (const TextureCacheLevel*)(cached->header + 1);
+    return true;
+}
+
+void closeCachedTexture(CachedTexture* cached) {
+    if (cached->header != NULL) {
+        unmapFile(&cached->file);
+    }
+    memset(cached, 0, sizeof(CachedTexture));
+}
+
+const unsigned char* getCachedLevelData(const CachedTexture* cached, unsigned int level) {
+    return (const unsigned char*)cached->file.data + cached->levels[level].offset;
+}
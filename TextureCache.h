@@ -0,0 +1,55 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "Platform.h"
+
+// COOKED TEXTURE CONTAINER (.ctex)
+// header, one level record per mip, then the level data at 16-byte aligned offsets, every level
+// is stored exactly as glTexImage2D/glCompressedTexImage2D wants it so loading is map + upload
+
+#define TEXTURE_CACHE_MAGIC 0x58455443u // "CTEX"
+#define TEXTURE_CACHE_VERSION 1u
+#define TEXTURE_CACHE_EXTENSION ".ctex"
+#define TEXTURE_CACHE_MAX_LEVELS 16
+
+typedef struct TextureCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize; // source image size and modification time, a mismatch means the cache is stale
+    uint64_t sourceTime;
+    uint32_t format; // GL_RGBA8 or GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+} TextureCacheHeader;
+
+typedef struct TextureCacheLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset; // from the start of the file
+    uint64_t size;
+} TextureCacheLevel;
+
+void getTextureCachePath(const char* sourcePath, char* cachePath, size_t cachePathSize);
+
+// writes the full mip chain of an RGBA8 image, BC1 compressed when compress is set (alpha is dropped)
+bool cookTexture(const char* sourcePath, const unsigned char* rgba, int width, int height, bool compress);
+
+// a validated cache file, mapped for as long as its levels are being uploaded
+typedef struct CachedTexture {
+    MappedFile file;
+    const TextureCacheHeader* header; // NULL when closed
+    const TextureCacheLevel* levels;
+} CachedTexture;
+
+// maps a fresh cache file, returns false (and keeps nothing mapped) when there is no usable cache so the caller
+// can decode instead. the upload itself is the caller's, level by level from getCachedLevelData
+bool openCachedTexture(const char* sourcePath, CachedTexture* cached);
+void closeCachedTexture(CachedTexture* cached);
+const unsigned char* getCachedLevelData(const CachedTexture* cached, unsigned int level);
+
+#endif
@@ -0,0 +1,341 @@
+#include "TextureStream.h"
+#include "GpuMemory.h"
+#include "stb/stb_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLACEHOLDER_SIZE 8
+
+static void setTextureParameters() {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// grey checkerboard shown while the real texture streams in
+static unsigned int createPlaceholder() {
+    unsigned char pixels[PLACEHOLDER_SIZE * PLACEHOLDER_SIZE * 4];
+    for (int y = 0; y < PLACEHOLDER_SIZE; y++) {
+        for (int x = 0; x < PLACEHOLDER_SIZE; x++) {
+            unsigned char shade = ((x / 2 + y / 2) % 2) ? 160 : 96;
+            unsigned char* pixel = &pixels[(y * PLACEHOLDER_SIZE + x) * 4];
+            pixel[0] = pixel[1] = pixel[2] = shade;
+            pixel[3] = 255;
+        }
+    }
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    setTextureParameters();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, PLACEHOLDER_SIZE, PLACEHOLDER_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    trackGpuResource(GPU_TEXTURE, texture, GPU_MEMORY_TEXTURES, sizeof(pixels));
+    return texture;
+}
+
+bool createTextureStreamer(TextureStreamer* streamer, JobPool* pool, size_t uploadBudget, bool useCache) {
+    memset(streamer, 0, sizeof(TextureStreamer));
+    streamer->pool = pool;
+    streamer->useCache = useCache;
+    streamer->uploadBudget = uploadBudget > 0 ? uploadBudget : DEFAULT_UPLOAD_BUDGET;
+    streamer->placeholder = createPlaceholder();
+
+    glGenBuffers(UPLOAD_PBO_COUNT, streamer->pbos); // storage is (re)allocated on every upload
+    return true;
+}
+
+static void waitForDecodes(TextureStreamer* streamer) {
+    for (unsigned int i = 0; i < streamer->textureCount; i++) {
+        while (atomicLoad(&streamer->textures[i]->state) == TEXTURE_DECODING) {
+            sleepMilliseconds(1);
+        }
+    }
+}
+
+void destroyTextureStreamer(TextureStreamer* streamer) {
+    // a worker may still be writing into a texture record
+    waitForDecodes(streamer);
+
+    for (unsigned int i = 0; i < streamer->textureCount; i++) {
+        StreamedTexture* texture = streamer->textures[i];
+        if (texture->id != streamer->placeholder) {
+            releaseGpuResource(GPU_TEXTURE, texture->id);
+            glDeleteTextures(1, &texture->id);
+        }
+        if (texture->pending != 0) {
+            releaseGpuResource(GPU_TEXTURE, texture->pending);
+            glDeleteTextures(1, &texture->pending);
+        }
+        stbi_image_free(texture->pixels);
+        closeCachedTexture(&texture->cached);
+        free(texture);
+    }
+    for (unsigned int i = 0; i < UPLOAD_PBO_COUNT; i++) {
+        releaseGpuResource(GPU_BUFFER, streamer->pbos[i]);
+    }
+    glDeleteBuffers(UPLOAD_PBO_COUNT, streamer->pbos);
+    releaseGpuResource(GPU_TEXTURE, streamer->placeholder);
+    glDeleteTextures(1, &streamer->placeholder);
+    memset(streamer, 0, sizeof(TextureStreamer));
+}
+
+// WORKER SIDE
+
+// a fresh cache only needs mapping, anything else is decoded (and cooked for next time)
+static void decodeTexture(void* data) {
+    StreamedTexture* texture = (StreamedTexture*)data;
+    if (texture->readCache) {
+        if (openCachedTexture(texture->path, &texture->cached)) {
+            // already in its final layout, the levels go through the same budgeted uploads as decoded pixels
+            texture->width = (int)texture->cached.header->width;
+            texture->height = (int)texture->cached.header->height;
+            atomicStore(&texture->state, TEXTURE_DECODED);
+            return;
+        }
+        // missing or stale, decode as usual and cook a fresh one
+        texture->cookOnDecode = true;
+    }
+
+    stbi_set_flip_vertically_on_load_thread(1);
+    texture->pixels = stbi_load(texture->path, &texture->width, &texture->height, &texture->channels, 4);
+    if (texture->pixels == NULL) {
+        printf("ERROR::TEXTURE::LOAD::FAILED %s\n", texture->path);
+        atomicStore(&texture->state, TEXTURE_FAILED);
+        return;
+    }
+    if (texture->cookOnDecode) {
+        // images with alpha stay uncompressed, BC1 here is the opaque variant
+        cookTexture(texture->path, texture->pixels, texture->width, texture->height, texture->compressOnCook && texture->channels <= 3);
+    }
+    atomicStore(&texture->state, TEXTURE_DECODED);
+}
+
+// GPU memory hands a least recently used texture back, it shows the placeholder until it is used again
+static void evictTexture(void* owner, unsigned int name) {
+    TextureStreamer* streamer = (TextureStreamer*)owner;
+    for (unsigned int i = 0; i < streamer->textureCount; i++) {
+        StreamedTexture* texture = streamer->textures[i];
+        if (texture->id == name && atomicLoad(&texture->state) == TEXTURE_RESIDENT) {
+            glDeleteTextures(1, &texture->id);
+            texture->id = streamer->placeholder;
+            atomicStore(&texture->state, TEXTURE_EVICTED);
+            printf("TEXTURE::EVICTED %s\n", texture->path);
+            return;
+        }
+    }
+}
+
+static void makeResident(TextureStreamer* streamer, StreamedTexture* texture) {
+    setGpuResourceEvictable(GPU_TEXTURE, texture->id, evictTexture, streamer);
+    atomicStore(&texture->state, TEXTURE_RESIDENT);
+}
+
+// everything touching the file happens on the pool, so streaming in again after an eviction never blocks the frame
+// that asked for it. the texture only turns resident once updateTextureStreamer has uploaded all of it
+static void startStreaming(TextureStreamer* streamer, StreamedTexture* texture) {
+    texture->state = TEXTURE_DECODING;
+    texture->requestTime = getTimeSeconds();
+    texture->readCache = streamer->useCache;
+    texture->cookOnDecode = false;
+    texture->compressOnCook = GLAD_GL_EXT_texture_compression_s3tc != 0;
+
+    if (streamer->pool == NULL || !submitJob(streamer->pool, decodeTexture, texture)) {
+        decodeTexture(texture);
+    }
+}
+
+StreamedTexture* requestTexture(TextureStreamer* streamer, const char* path) {
+    if (streamer->textureCount == MAX_STREAMED_TEXTURES) {
+        printf("ERROR::TEXTURE::TOO_MANY_TEXTURES\n");
+        return NULL;
+    }
+    StreamedTexture* texture = (StreamedTexture*)calloc(1, sizeof(StreamedTexture));
+    if (texture == NULL) {
+        return NULL;
+    }
+    texture->id = streamer->placeholder;
+    snprintf(texture->path, sizeof(texture->path), "%s", path);
+    streamer->textures[streamer->textureCount++] = texture;
+
+    startStreaming(streamer, texture);
+    return texture;
+}
+
+unsigned int useStreamedTexture(TextureStreamer* streamer, StreamedTexture* texture) {
+    long state = atomicLoad(&texture->state);
+    if (state == TEXTURE_RESIDENT) {
+        touchGpuResource(GPU_TEXTURE, texture->id);
+    }
+    else if (state == TEXTURE_EVICTED) {
+        startStreaming(streamer, texture);
+    }
+    return texture->id;
+}
+
+// GL THREAD SIDE
+
+// where the level being uploaded comes from and how it is split into rows
+typedef struct UploadLevel {
+    const unsigned char* data;
+    int width;
+    int height;
+    int rowCount;
+    int rowHeight; // texels per row, 4 for BC1 blocks
+    size_t rowBytes;
+} UploadLevel;
+
+static unsigned int getLevelCount(const StreamedTexture* texture) {
+    return texture->cached.header != NULL ? texture->cached.header->levelCount : 1;
+}
+
+static void getUploadLevel(const StreamedTexture* texture, UploadLevel* level) {
+    if (texture->cached.header == NULL) {
+        level->data = texture->pixels;
+        level->width = texture->width;
+        level->height = texture->height;
+        level->rowHeight = 1;
+        level->rowBytes = (size_t)texture->width * 4;
+    }
+    else {
+        const TextureCacheLevel* cached = &texture->cached.levels[texture->uploadedLevels];
+        level->data = getCachedLevelData(&texture->cached, texture->uploadedLevels);
+        level->width = (int)cached->width;
+        level->height = (int)cached->height;
+        if (texture->cached.header->format == GL_RGBA8) {
+            level->rowHeight = 1;
+            level->rowBytes = (size_t)cached->width * 4;
+        }
+        else {
+            level->rowHeight = 4;
+            level->rowBytes = (size_t)((cached->width + 3) / 4) * 8;
+        }
+    }
+    level->rowCount = (level->height + level->rowHeight - 1) / level->rowHeight;
+}
+
+// storage for every level up front, filled over the next frames
+static void allocateTexture(StreamedTexture* texture) {
+    glGenTextures(1, &texture->pending);
+    glBindTexture(GL_TEXTURE_2D, texture->pending);
+    setTextureParameters();
+    if (texture->cached.header == NULL) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texture->width, texture->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        trackGpuResource(GPU_TEXTURE, texture->pending, GPU_MEMORY_TEXTURES, getTextureBytes(texture->width, texture->height, 4, false));
+    }
+    else {
+        const TextureCacheHeader* header = texture->cached.header;
+        const TextureCacheLevel* levels = texture->cached.levels;
+        size_t bytes = 0;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)header->levelCount - 1);
+        for (unsigned int i = 0; i < header->levelCount; i++) {
+            bytes += (size_t)levels[i].size;
+            if (header->format == GL_RGBA8) {
+                glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, levels[i].width, levels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            }
+            else {
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, header->format, levels[i].width, levels[i].height, 0, (GLsizei)levels[i].size, NULL);
+            }
+        }
+        trackGpuResource(GPU_TEXTURE, texture->pending, GPU_MEMORY_TEXTURES, bytes);
+    }
+    texture->uploadedLevels = 0;
+    texture->uploadedRows = 0;
+}
+
+// copy as many rows as the remaining budget allows through the next PBO, returns false when out of budget
+static bool uploadRows(TextureStreamer* streamer, StreamedTexture* texture) {
+    if (streamer->uploadedThisFrame >= streamer->uploadBudget) {
+        return false; // an oversized single row may have overshot it already
+    }
+    UploadLevel level;
+    getUploadLevel(texture, &level);
+    size_t remainingBudget = streamer->uploadBudget - streamer->uploadedThisFrame;
+    int rows = (int)(remainingBudget / level.rowBytes);
+    if (rows == 0) {
+        // a single row wider than the whole budget still has to make progress
+        if (streamer->uploadedThisFrame > 0) return false;
+        rows = 1;
+    }
+    if (rows > level.rowCount - texture->uploadedRows) {
+        rows = level.rowCount - texture->uploadedRows;
+    }
+    size_t bytes = level.rowBytes * rows;
+    int y = texture->uploadedRows * level.rowHeight;
+    int height = rows * level.rowHeight < level.height - y ? rows * level.rowHeight : level.height - y;
+
+    unsigned int pbo = streamer->pbos[streamer->nextPbo];
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    streamer->nextPbo = (streamer->nextPbo + 1) % UPLOAD_PBO_COUNT;
+    size_t bufferSize = bytes > streamer->uploadBudget ? bytes : streamer->uploadBudget;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, GL_STREAM_DRAW); // orphan, never wait on the last copy
+    trackGpuResource(GPU_BUFFER, pbo, GPU_MEMORY_STREAMING, bufferSize);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped != NULL) {
+        memcpy(mapped, level.data + level.rowBytes * texture->uploadedRows, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindTexture(GL_TEXTURE_2D, texture->pending);
+        if (level.rowHeight == 1) {
+            glTexSubImage2D(GL_TEXTURE_2D, texture->uploadedLevels, 0, y, level.width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        }
+        else {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, texture->uploadedLevels, 0, y, level.width, height, texture->cached.header->format,
+                                      (GLsizei)bytes, (void*)0);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    texture->uploadedRows += rows;
+    if (texture->uploadedRows == level.rowCount) {
+        texture->uploadedLevels++;
+        texture->uploadedRows = 0;
+    }
+    streamer->uploadedThisFrame += bytes;
+    return true;
+}
+
+void updateTextureStreamer(TextureStreamer* streamer) {
+    streamer->uploadedThisFrame = 0;
+
+    for (unsigned int i = 0; i < streamer->textureCount && streamer->uploadedThisFrame < streamer->uploadBudget; i++) {
+        StreamedTexture* texture = streamer->textures[i];
+        long state = atomicLoad(&texture->state);
+
+        if (state == TEXTURE_DECODED) {
+            allocateTexture(texture);
+            atomicStore(&texture->state, TEXTURE_UPLOADING);
+            state = TEXTURE_UPLOADING;
+        }
+        if (state != TEXTURE_UPLOADING) {
+            continue;
+        }
+
+        unsigned int levelCount = getLevelCount(texture);
+        while (texture->uploadedLevels < levelCount && uploadRows(streamer, texture)) {
+        }
+        if (texture->uploadedLevels < levelCount) {
+            continue;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, texture->pending);
+        bool fromCache = texture->cached.header != NULL;
+        if (fromCache) {
+            closeCachedTexture(&texture->cached);
+        }
+        else {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            trackGpuResource(GPU_TEXTURE, texture->pending, GPU_MEMORY_TEXTURES, getTextureBytes(texture->width, texture->height, 4, true));
+            stbi_image_free(texture->pixels);
+            texture->pixels = NULL;
+        }
+        texture->id = texture->pending;
+        texture->pending = 0;
+        makeResident(streamer, texture);
+        printf("TEXTURE::RESIDENT %s (%s %dx%d) after %.1f ms\n", texture->path, fromCache ? "cache" : "decoded", texture->width,
+               texture->height, (getTimeSeconds() - texture->requestTime) * 1000.0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
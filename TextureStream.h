@@ -0,0 +1,68 @@
+#ifndef TEXTURESTREAM_H
+#define TEXTURESTREAM_H
+
+#include <glad/glad.h>
+#include <stddef.h>
+#include "JobPool.h"
+#include "TextureCache.h"
+
+#define MAX_STREAMED_TEXTURES 256
+#define TEXTURE_PATH_LENGTH 260
+#define UPLOAD_PBO_COUNT 3 // one being filled while the driver still reads the previous two
+#define DEFAULT_UPLOAD_BUDGET (2 * 1024 * 1024) // bytes uploaded per frame
+
+typedef enum TextureState {
+    TEXTURE_DECODING,
+    TEXTURE_DECODED,
+    TEXTURE_UPLOADING,
+    TEXTURE_RESIDENT,
+    TEXTURE_FAILED,
+    TEXTURE_EVICTED // deleted to stay in the GPU memory budget, useStreamedTexture streams it in again
+} TextureState;
+
+// bind `id` when drawing: it names the shared placeholder until the real image is fully uploaded
+typedef struct StreamedTexture {
+    unsigned int id;
+    unsigned int pending; // texture receiving the uploads, swapped into id once complete
+    char path[TEXTURE_PATH_LENGTH];
+    AtomicInt state; // TextureState, written by the decode worker and read by the GL thread
+    unsigned char* pixels; // RGBA8, owned by the streamer until upload finishes
+    CachedTexture cached; // instead of pixels when a fresh .ctex was found, mapped until upload finishes
+    int width;
+    int height;
+    unsigned int uploadedLevels; // the decoded image is one level, mipmapped once it is complete
+    int uploadedRows; // of the level being uploaded, BC1 counts rows of 4x4 blocks
+    int channels; // of the source image, before expanding to RGBA
+    bool readCache; // try a .ctex before decoding
+    bool cookOnDecode; // write a .ctex cache from the decoded pixels
+    bool compressOnCook;
+    double requestTime;
+} StreamedTexture;
+
+typedef struct TextureStreamer {
+    JobPool* pool; // NULL decodes on the calling thread
+    unsigned int placeholder;
+    StreamedTexture* textures[MAX_STREAMED_TEXTURES];
+    unsigned int textureCount;
+    unsigned int pbos[UPLOAD_PBO_COUNT];
+    unsigned int nextPbo;
+    size_t uploadBudget;
+    size_t uploadedThisFrame;
+    bool useCache; // load from / cook into the TextureCache containers
+} TextureStreamer;
+
+bool createTextureStreamer(TextureStreamer* streamer, JobPool* pool, size_t uploadBudget, bool useCache);
+void destroyTextureStreamer(TextureStreamer* streamer);
+
+// returns immediately: mapping a fresh cooked cache, or else decoding (and cooking), happens on the pool and the
+// upload is left to updateTextureStreamer
+StreamedTexture* requestTexture(TextureStreamer* streamer, const char* path);
+
+// GL thread, every frame the texture is drawn with: keeps it off the GPU memory eviction list and starts streaming
+// it again if it was evicted, returns the id to bind
+unsigned int useStreamedTexture(TextureStreamer* streamer, StreamedTexture* texture);
+
+// GL thread, once per frame: moves decoded images and cached levels to the GPU, at most uploadBudget bytes per call
+void updateTextureStreamer(TextureStreamer* streamer);
+
+#endif
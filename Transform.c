@@ -0,0 +1,362 @@
+#include "Transform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TRANSFORM_USE_SSE 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TRANSFORM_USE_AVX 1
+#define AVX_TARGET
+#elif defined(__GNUC__) || defined(__clang__)
+#define TRANSFORM_USE_AVX 1
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+#endif
+
+// sine/cosine polynomial coefficients (cephes sinf/cosf), valid on [-pi/4, pi/4]
+#define SIN_C1 -1.6666654611e-1f
+#define SIN_C2  8.3321608736e-3f
+#define SIN_C3 -1.9515295891e-4f
+#define COS_C1  4.166664568298827e-2f
+#define COS_C2 -1.388731625493765e-3f
+#define COS_C3  2.443315711809948e-5f
+// pi/2 split in three so the range reduction keeps its precision
+#define PIO2_1 1.5703125f
+#define PIO2_2 4.837512969970703125e-4f
+#define PIO2_3 7.54978995489188216e-8f
+#define TWO_OVER_PI 0.636619772367581343f
+
+bool createTransformBatch(TransformBatch* batch, unsigned int capacity) {
+    // round up so the SIMD loops can read a full vector past the last transform
+    unsigned int padded = (capacity + 7) & ~7u;
+    float** arrays[] = { &batch->positionX, &batch->positionY, &batch->positionZ,
+                         &batch->axisX, &batch->axisY, &batch->axisZ, &batch->angle };
+    bool ok = true;
+    for (int i = 0; i < 7; i++) {
+        *arrays[i] = (float*)alignedAlloc(sizeof(float) * (padded > 0 ? padded : 8), 32);
+        ok = ok && *arrays[i] != NULL;
+    }
+    batch->count = 0;
+    batch->capacity = capacity;
+    if (!ok) {
+        destroyTransformBatch(batch);
+        return false;
+    }
+    return true;
+}
+
+void destroyTransformBatch(TransformBatch* batch) {
+    alignedFree(batch->positionX);
+    alignedFree(batch->positionY);
+    alignedFree(batch->positionZ);
+    alignedFree(batch->axisX);
+    alignedFree(batch->axisY);
+    alignedFree(batch->axisZ);
+    alignedFree(batch->angle);
+    batch->positionX = batch->positionY = batch->positionZ = NULL;
+    batch->axisX = batch->axisY = batch->axisZ = batch->angle = NULL;
+    batch->count = 0;
+    batch->capacity = 0;
+}
+
+void setTransform(TransformBatch* batch, unsigned int index, vec3 position, vec3 axis, float angle) {
+    vec3 axisNormalized;
+    glm_vec3_normalize_to(axis, axisNormalized);
+    batch->positionX[index] = position[0];
+    batch->positionY[index] = position[1];
+    batch->positionZ[index] = position[2];
+    batch->axisX[index] = axisNormalized[0];
+    batch->axisY[index] = axisNormalized[1];
+    batch->axisZ[index] = axisNormalized[2];
+    batch->angle[index] = angle;
+    if (index >= batch->count) {
+        batch->count = index + 1;
+    }
+}
+
+void computeTransformsScalar(const TransformBatch* batch, unsigned int begin, unsigned int end, mat4* out) {
+    for (unsigned int i = begin; i < end; i++) {
+        vec3 position = { batch->positionX[i], batch->positionY[i], batch->positionZ[i] };
+        vec3 axis = { batch->axisX[i], batch->axisY[i], batch->axisZ[i] };
+        glm_mat4_identity(out[i]);
+        glm_translate(out[i], position);
+        glm_rotate(out[i], batch->angle[i], axis);
+    }
+}
+
+#ifdef TRANSFORM_USE_SSE
+
+static void sinCos4(__m128 x, __m128* sinOut, __m128* cosOut) {
+    // reduce to r in [-pi/4, pi/4] and quadrant q so that x = r + q * pi/2
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+    __m128 j = _mm_cvtepi32_ps(q);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(PIO2_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PIO2_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PIO2_3)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 sinPoly = _mm_add_ps(_mm_set1_ps(SIN_C2), _mm_mul_ps(r2, _mm_set1_ps(SIN_C3)));
+    sinPoly = _mm_add_ps(_mm_set1_ps(SIN_C1), _mm_mul_ps(r2, sinPoly));
+    __m128 sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinPoly));
+
+    __m128 cosPoly = _mm_add_ps(_mm_set1_ps(COS_C2), _mm_mul_ps(r2, _mm_set1_ps(COS_C3)));
+    cosPoly = _mm_add_ps(_mm_set1_ps(COS_C1), _mm_mul_ps(r2, cosPoly));
+    __m128 cosR = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly));
+
+    // odd quadrants swap sine and cosine, quadrants 2-3 negate sine and 1-2 negate cosine
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sinV = _mm_or_ps(_mm_and_ps(swap, cosR), _mm_andnot_ps(swap, sinR));
+    __m128 cosV = _mm_or_ps(_mm_and_ps(swap, sinR), _mm_andnot_ps(swap, cosR));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    *sinOut = _mm_xor_ps(sinV, sinSign);
+    *cosOut = _mm_xor_ps(cosV, cosSign);
+}
+
+// the four lanes of x/y/z/w become column `column` of four consecutive matrices
+static void storeColumn4(mat4* out, int column, __m128 x, __m128 y, __m128 z, __m128 w) {
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_store_ps(out[0][column], x);
+    _mm_store_ps(out[1][column], y);
+    _mm_store_ps(out[2][column], z);
+    _mm_store_ps(out[3][column], w);
+}
+
+static unsigned int computeTransformsSSE(const TransformBatch* batch, unsigned int begin, unsigned int end, mat4* out) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    unsigned int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 ax = _mm_loadu_ps(batch->axisX + i);
+        __m128 ay = _mm_loadu_ps(batch->axisY + i);
+        __m128 az = _mm_loadu_ps(batch->axisZ + i);
+        __m128 s, c;
+        sinCos4(_mm_loadu_ps(batch->angle + i), &s, &c);
+        __m128 t = _mm_sub_ps(one, c);
+
+        __m128 tx = _mm_mul_ps(t, ax);
+        __m128 ty = _mm_mul_ps(t, ay);
+        __m128 tz = _mm_mul_ps(t, az);
+        __m128 sx = _mm_mul_ps(s, ax);
+        __m128 sy = _mm_mul_ps(s, ay);
+        __m128 sz = _mm_mul_ps(s, az);
+        __m128 txy = _mm_mul_ps(tx, ay);
+        __m128 txz = _mm_mul_ps(tx, az);
+        __m128 tyz = _mm_mul_ps(ty, az);
+
+        storeColumn4(out + i, 0, _mm_add_ps(_mm_mul_ps(tx, ax), c), _mm_add_ps(txy, sz), _mm_sub_ps(txz, sy), zero);
+        storeColumn4(out + i, 1, _mm_sub_ps(txy, sz), _mm_add_ps(_mm_mul_ps(ty, ay), c), _mm_add_ps(tyz, sx), zero);
+        storeColumn4(out + i, 2, _mm_add_ps(txz, sy), _mm_sub_ps(tyz, sx), _mm_add_ps(_mm_mul_ps(tz, az), c), zero);
+        storeColumn4(out + i, 3, _mm_loadu_ps(batch->positionX + i), _mm_loadu_ps(batch->positionY + i), _mm_loadu_ps(batch->positionZ + i), one);
+    }
+    return i;
+}
+
+#endif
+
+#ifdef TRANSFORM_USE_AVX
+
+static bool useAVX = false; // set once by initTransforms, before any worker reads it
+
+static bool cpuHasAVX() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    return osSavesYmm && avx && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+AVX_TARGET static void sinCos8(__m256 x, __m256* sinOut, __m256* cosOut) {
+    // same reduction as sinCos4, but the quadrant logic stays in float since AVX lacks 256-bit integer ops
+    __m256 j = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_1)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_2)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_3)));
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 sinPoly = _mm256_add_ps(_mm256_set1_ps(SIN_C2), _mm256_mul_ps(r2, _mm256_set1_ps(SIN_C3)));
+    sinPoly = _mm256_add_ps(_mm256_set1_ps(SIN_C1), _mm256_mul_ps(r2, sinPoly));
+    __m256 sinR = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sinPoly));
+
+    __m256 cosPoly = _mm256_add_ps(_mm256_set1_ps(COS_C2), _mm256_mul_ps(r2, _mm256_set1_ps(COS_C3)));
+    cosPoly = _mm256_add_ps(_mm256_set1_ps(COS_C1), _mm256_mul_ps(r2, cosPoly));
+    __m256 cosR = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)), _mm256_mul_ps(_mm256_mul_ps(r2, r2), cosPoly));
+
+    // q = j mod 4 in [0, 4)
+    __m256 q = _mm256_sub_ps(j, _mm256_mul_ps(_mm256_set1_ps(4.0f), _mm256_floor_ps(_mm256_mul_ps(j, _mm256_set1_ps(0.25f)))));
+    __m256 odd = _mm256_sub_ps(q, _mm256_mul_ps(_mm256_set1_ps(2.0f), _mm256_floor_ps(_mm256_mul_ps(q, _mm256_set1_ps(0.5f)))));
+    __m256 swap = _mm256_cmp_ps(odd, _mm256_set1_ps(1.0f), _CMP_EQ_OQ);
+    __m256 sinNegate = _mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_GE_OQ);
+    __m256 cosNegate = _mm256_and_ps(_mm256_cmp_ps(q, _mm256_set1_ps(1.0f), _CMP_GE_OQ), _mm256_cmp_ps(q, _mm256_set1_ps(3.0f), _CMP_LT_OQ));
+    __m256 signBit = _mm256_set1_ps(-0.0f);
+
+    __m256 sinV = _mm256_blendv_ps(sinR, cosR, swap);
+    __m256 cosV = _mm256_blendv_ps(cosR, sinR, swap);
+    *sinOut = _mm256_xor_ps(sinV, _mm256_and_ps(sinNegate, signBit));
+    *cosOut = _mm256_xor_ps(cosV, _mm256_and_ps(cosNegate, signBit));
+}
+
+// the eight lanes of x/y/z/w become column `column` of eight consecutive matrices
+AVX_TARGET static void storeColumn8(mat4* out, int column, __m256 x, __m256 y, __m256 z, __m256 w) {
+    __m256 t0 = _mm256_unpacklo_ps(x, y);
+    __m256 t1 = _mm256_unpackhi_ps(x, y);
+    __m256 t2 = _mm256_unpacklo_ps(z, w);
+    __m256 t3 = _mm256_unpackhi_ps(z, w);
+    __m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)); // matrices 0 and 4
+    __m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)); // matrices 1 and 5
+    __m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)); // matrices 2 and 6
+    __m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)); // matrices 3 and 7
+    _mm_store_ps(out[0][column], _mm256_castps256_ps128(r0));
+    _mm_store_ps(out[1][column], _mm256_castps256_ps128(r1));
+    _mm_store_ps(out[2][column], _mm256_castps256_ps128(r2));
+    _mm_store_ps(out[3][column], _mm256_castps256_ps128(r3));
+    _mm_store_ps(out[4][column], _mm256_extractf128_ps(r0, 1));
+    _mm_store_ps(out[5][column], _mm256_extractf128_ps(r1, 1));
+    _mm_store_ps(out[6][column], _mm256_extractf128_ps(r2, 1));
+    _mm_store_ps(out[7][column], _mm256_extractf128_ps(r3, 1));
+}
+
+AVX_TARGET static unsigned int computeTransformsAVX(const TransformBatch* batch, unsigned int begin, unsigned int end, mat4* out) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    unsigned int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 ax = _mm256_loadu_ps(batch->axisX + i);
+        __m256 ay = _mm256_loadu_ps(batch->axisY + i);
+        __m256 az = _mm256_loadu_ps(batch->axisZ + i);
+        __m256 s, c;
+        sinCos8(_mm256_loadu_ps(batch->angle + i), &s, &c);
+        __m256 t = _mm256_sub_ps(one, c);
+
+        __m256 tx = _mm256_mul_ps(t, ax);
+        __m256 ty = _mm256_mul_ps(t, ay);
+        __m256 tz = _mm256_mul_ps(t, az);
+        __m256 sx = _mm256_mul_ps(s, ax);
+        __m256 sy = _mm256_mul_ps(s, ay);
+        __m256 sz = _mm256_mul_ps(s, az);
+        __m256 txy = _mm256_mul_ps(tx, ay);
+        __m256 txz = _mm256_mul_ps(tx, az);
+        __m256 tyz = _mm256_mul_ps(ty, az);
+
+        storeColumn8(out + i, 0, _mm256_add_ps(_mm256_mul_ps(tx, ax), c), _mm256_add_ps(txy, sz), _mm256_sub_ps(txz, sy), zero);
+        storeColumn8(out + i, 1, _mm256_sub_ps(txy, sz), _mm256_add_ps(_mm256_mul_ps(ty, ay), c), _mm256_add_ps(tyz, sx), zero);
+        storeColumn8(out + i, 2, _mm256_add_ps(txz, sy), _mm256_sub_ps(tyz, sx), _mm256_add_ps(_mm256_mul_ps(tz, az), c), zero);
+        storeColumn8(out + i, 3, _mm256_loadu_ps(batch->positionX + i), _mm256_loadu_ps(batch->positionY + i), _mm256_loadu_ps(batch->positionZ + i), one);
+    }
+    _mm256_zeroupper();
+    return i;
+}
+
+#endif
+
+void initTransforms() {
+#ifdef TRANSFORM_USE_AVX
+    useAVX = cpuHasAVX();
+#endif
+}
+
+void computeTransformsSIMD(const TransformBatch* batch, unsigned int begin, unsigned int end, mat4* out) {
+    unsigned int i = begin;
+#ifdef TRANSFORM_USE_AVX
+    if (useAVX) {
+        i = computeTransformsAVX(batch, i, end, out);
+    }
+#endif
+#ifdef TRANSFORM_USE_SSE
+    i = computeTransformsSSE(batch, i, end, out);
+#endif
+    computeTransformsScalar(batch, i, end, out);
+}
+
+typedef struct TransformJob {
+    const TransformBatch* batch;
+    mat4* out;
+} TransformJob;
+
+static void transformRange(void* data, unsigned int begin, unsigned int end) {
+    TransformJob* job = (TransformJob*)data;
+    computeTransformsSIMD(job->batch, begin, end, job->out);
+}
+
+void computeTransforms(JobPool* pool, const TransformBatch* batch, mat4* out) {
+    if (pool == NULL || batch->count < TRANSFORM_PARALLEL_THRESHOLD) {
+        computeTransformsSIMD(batch, 0, batch->count, out);
+        return;
+    }
+    TransformJob job = { batch, out };
+    parallelFor(pool, batch->count, TRANSFORM_PARALLEL_THRESHOLD / 2, transformRange, &job);
+}
+
+// BENCHMARK
+
+static unsigned int benchmarkSeed = 12345u;
+
+static float randomFloat(float min, float max) {
+    benchmarkSeed = benchmarkSeed * 1664525u + 1013904223u;
+    return min + (max - min) * (float)(benchmarkSeed >> 8) / 16777216.0f;
+}
+
+void benchmarkTransforms(JobPool* pool) {
+    const unsigned int sizes[] = { 1000, 100000, 1000000 };
+    const unsigned int targetWork = 4000000; // transforms per measurement, so small batches still time reliably
+
+    printf("TRANSFORM BENCHMARK (%u worker threads)\n", pool != NULL ? pool->workerCount : 0);
+    printf("%10s %14s %14s %14s %10s %10s\n", "count", "scalar ms", "simd ms", "simd+pool ms", "speedup", "max error");
+
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        unsigned int count = sizes[s];
+        TransformBatch batch;
+        mat4* reference = (mat4*)alignedAlloc(sizeof(mat4) * count, 64);
+        mat4* out = (mat4*)alignedAlloc(sizeof(mat4) * count, 64);
+        if (!createTransformBatch(&batch, count) || reference == NULL || out == NULL) {
+            printf("ERROR::BENCHMARK::ALLOCATION_FAILED\n");
+            alignedFree(reference);
+            alignedFree(out);
+            return;
+        }
+        for (unsigned int i = 0; i < count; i++) {
+            vec3 position = { randomFloat(-100.0f, 100.0f), randomFloat(-100.0f, 100.0f), randomFloat(-100.0f, 100.0f) };
+            vec3 axis = { randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.1f, 1.0f) };
+            setTransform(&batch, i, position, axis, randomFloat(-2.0f * GLM_PIf, 2.0f * GLM_PIf));
+        }
+
+        unsigned int repeats = targetWork / count > 0 ? targetWork / count : 1;
+        double start = getTimeSeconds();
+        for (unsigned int r = 0; r < repeats; r++) computeTransformsScalar(&batch, 0, count, reference);
+        double scalarTime = (getTimeSeconds() - start) / repeats;
+
+        start = getTimeSeconds();
+        for (unsigned int r = 0; r < repeats; r++) computeTransformsSIMD(&batch, 0, count, out);
+        double simdTime = (getTimeSeconds() - start) / repeats;
+
+        // force the pool path even for the small batch so its overhead shows up
+        TransformJob job = { &batch, out };
+        start = getTimeSeconds();
+        for (unsigned int r = 0; r < repeats; r++) parallelFor(pool, count, 1024, transformRange, &job);
+        double poolTime = (getTimeSeconds() - start) / repeats;
+
+        float maxError = 0.0f;
+        for (unsigned int i = 0; i < count; i++) {
+            const float* a = (const float*)reference[i];
+            const float* b = (const float*)out[i];
+            for (int k = 0; k < 16; k++) {
+                float error = fabsf(a[k] - b[k]);
+                if (error > maxError) maxError = error;
+            }
+        }
+
+        double best = simdTime < poolTime ? simdTime : poolTime;
+        printf("%10u %14.4f %14.4f %14.4f %9.1fx %10.2e\n", count, scalarTime * 1000.0, simdTime * 1000.0, poolTime * 1000.0, scalarTime / best, maxError);
+
+        destroyTransformBatch(&batch);
+        alignedFree(reference);
+        alignedFree(out);
+    }
+}
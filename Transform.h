@@ -0,0 +1,41 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cglm/cglm.h>
+#include "JobPool.h"
+
+// below this many transforms the batch is not worth splitting across the pool
+#define TRANSFORM_PARALLEL_THRESHOLD 16384
+
+// structure-of-arrays input for model matrices of the form translate(position) * rotate(angle, axis)
+// every array is 32-byte aligned so the SIMD kernels can stream through them
+typedef struct TransformBatch {
+    unsigned int count;
+    unsigned int capacity;
+    float* positionX;
+    float* positionY;
+    float* positionZ;
+    float* axisX; // axes are stored normalized
+    float* axisY;
+    float* axisZ;
+    float* angle; // radians, keep within a few turns, the SIMD sine/cosine only reduce the range cheaply
+} TransformBatch;
+
+// picks the widest SIMD kernel the CPU supports, once at startup before any transforms are computed
+void initTransforms();
+
+bool createTransformBatch(TransformBatch* batch, unsigned int capacity);
+void destroyTransformBatch(TransformBatch* batch);
+void setTransform(TransformBatch* batch, unsigned int index, vec3 position, vec3 axis, float angle);
+
+// reference path, the same glm_translate/glm_rotate calls the render loop used per cube
+void computeTransformsScalar(const TransformBatch* batch, unsigned int begin, unsigned int end, mat4* out);
+// AVX when initTransforms found it, otherwise SSE2, scalar for the tail
+void computeTransformsSIMD(const TransformBatch* batch, unsigned int begin, unsigned int end, mat4* out);
+// fill out[0, count) from the whole batch, split across the pool for large batches (pool may be NULL)
+void computeTransforms(JobPool* pool, const TransformBatch* batch, mat4* out);
+
+// prints scalar vs SIMD vs SIMD + pool timings at 1k, 100k and 1M transforms
+void benchmarkTransforms(JobPool* pool);
+
+#endif
@@ -0,0 +1,153 @@
+#include <glad/glad.h>
+#include "VertexFormat.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+unsigned int getEncodingSize(VertexEncoding encoding) {
+    switch (encoding) {
+        case ENCODING_HALF:
+        case ENCODING_UNORM16:
+        case ENCODING_SNORM16:
+            return 2;
+        case ENCODING_UNORM8:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+void initVertexFormat(VertexFormat* format, const char* name, unsigned int sourceStride) {
+    memset(format, 0, sizeof(VertexFormat));
+    format->name = name;
+    format->sourceStride = sourceStride;
+}
+
+bool addVertexAttribute(VertexFormat* format, unsigned int location, unsigned int components, VertexEncoding encoding, unsigned int source, unsigned int sourceComponents) {
+    if (format->attributeCount == MAX_VERTEX_ATTRIBUTES || components == 0 || components > 4
+        || source + sourceComponents > format->sourceStride) {
+        printf("ERROR::VERTEX_FORMAT::INVALID_ATTRIBUTE %s location %u\n", format->name, location);
+        return false;
+    }
+    VertexAttribute* attribute = &format->attributes[format->attributeCount++];
+    attribute->location = location;
+    attribute->components = components;
+    attribute->encoding = encoding;
+    attribute->offset = (format->stride + 3) & ~3u; // fetch stays aligned, a 6 byte half3 takes 8
+    attribute->source = source;
+    attribute->sourceComponents = sourceComponents;
+    format->stride = (attribute->offset + components * getEncodingSize(encoding) + 3) & ~3u;
+    return true;
+}
+
+void applyVertexFormat(const VertexFormat* format) {
+    for (unsigned int i = 0; i < format->attributeCount; i++) {
+        const VertexAttribute* attribute = &format->attributes[i];
+        GLenum type = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        switch (attribute->encoding) {
+            case ENCODING_HALF:
+                type = GL_HALF_FLOAT;
+                break;
+            case ENCODING_UNORM8:
+                type = GL_UNSIGNED_BYTE;
+                normalized = GL_TRUE;
+                break;
+            case ENCODING_UNORM16:
+                type = GL_UNSIGNED_SHORT;
+                normalized = GL_TRUE;
+                break;
+            case ENCODING_SNORM16:
+                type = GL_SHORT;
+                normalized = GL_TRUE;
+                break;
+            default:
+                break;
+        }
+        glVertexAttribPointer(attribute->location, attribute->components, type, normalized, format->stride, (void*)(size_t)attribute->offset);
+        glEnableVertexAttribArray(attribute->location);
+    }
+}
+
+// ENCODING
+
+// round to nearest even, out of range values become infinity and tiny ones denormals or zero
+unsigned short floatToHalf(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits >> 16) & 0x8000u;
+    unsigned int exponent = (bits >> 23) & 0xFFu;
+    unsigned int mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFFu) {
+        return (unsigned short)(sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0u)); // inf or nan
+    }
+    int halfExponent = (int)exponent - 127 + 15;
+    if (halfExponent >= 31) {
+        return (unsigned short)(sign | 0x7C00u);
+    }
+    if (halfExponent <= 0) {
+        if (halfExponent < -10) {
+            return (unsigned short)sign;
+        }
+        // denormal, shift the implicit leading one in
+        mantissa |= 0x800000u;
+        unsigned int shift = (unsigned int)(14 - halfExponent);
+        unsigned int half = mantissa >> shift;
+        unsigned int remainder = mantissa & ((1u << shift) - 1u);
+        unsigned int halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+            half++;
+        }
+        return (unsigned short)(sign | half);
+    }
+    unsigned int half = ((unsigned int)halfExponent << 10) | (mantissa >> 13);
+    unsigned int remainder = mantissa & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        half++; // a carry into the exponent is still the correctly rounded value
+    }
+    return (unsigned short)(sign | half);
+}
+
+static float clamp01(float value) {
+    return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+}
+
+void encodeVertices(const VertexFormat* format, const float* source, unsigned int count, void* destination) {
+    unsigned char* out = (unsigned char*)destination;
+    memset(out, 0, (size_t)count * format->stride); // padding bytes stay deterministic for the caches
+    for (unsigned int v = 0; v < count; v++) {
+        const float* vertex = source + (size_t)v * format->sourceStride;
+        unsigned char* packed = out + (size_t)v * format->stride;
+        for (unsigned int a = 0; a < format->attributeCount; a++) {
+            const VertexAttribute* attribute = &format->attributes[a];
+            unsigned char* field = packed + attribute->offset;
+            for (unsigned int c = 0; c < attribute->components; c++) {
+                float value = c < attribute->sourceComponents ? vertex[attribute->source + c] : 1.0f;
+                switch (attribute->encoding) {
+                    case ENCODING_HALF: {
+                        unsigned short half = floatToHalf(value);
+                        memcpy(field + c * 2, &half, 2);
+                        break;
+                    }
+                    case ENCODING_UNORM8:
+                        field[c] = (unsigned char)lrintf(clamp01(value) * 255.0f);
+                        break;
+                    case ENCODING_UNORM16: {
+                        unsigned short unorm = (unsigned short)lrintf(clamp01(value) * 65535.0f);
+                        memcpy(field + c * 2, &unorm, 2);
+                        break;
+                    }
+                    case ENCODING_SNORM16: {
+                        short snorm = (short)lrintf(fminf(fmaxf(value, -1.0f), 1.0f) * 32767.0f);
+                        memcpy(field + c * 2, &snorm, 2);
+                        break;
+                    }
+                    default:
+                        memcpy(field + c * 4, &value, 4);
+                        break;
+                }
+            }
+        }
+    }
+}
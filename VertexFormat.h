@@ -0,0 +1,47 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <stdbool.h>
+
+// VERTEX FORMAT DESCRIPTORS: WHICH ATTRIBUTES A VERTEX HAS AND HOW EACH IS STORED, THE VAO SETUP AND
+// THE CONVERSION FROM FLOAT SOURCE DATA ARE BOTH GENERATED FROM THE SAME DESCRIPTION
+
+#define MAX_VERTEX_ATTRIBUTES 8
+
+typedef enum VertexEncoding {
+    ENCODING_FLOAT, // 4 bytes per component
+    ENCODING_HALF, // 2 bytes, ~3 significant digits, no bounds needed
+    ENCODING_UNORM8, // 1 byte, [0, 1]
+    ENCODING_UNORM16, // 2 bytes, [0, 1]
+    ENCODING_SNORM16 // 2 bytes, [-1, 1], positions quantized against their mesh bounds
+} VertexEncoding;
+
+typedef struct VertexAttribute {
+    unsigned int location;
+    unsigned int components; // as stored, 1-4
+    VertexEncoding encoding;
+    unsigned int offset; // bytes into the vertex, every attribute starts 4 byte aligned
+    unsigned int source; // first float of this attribute in the source vertex
+    unsigned int sourceComponents; // components past these are filled with 1.0, e.g. an alpha the source has none of
+} VertexAttribute;
+
+typedef struct VertexFormat {
+    const char* name;
+    VertexAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+    unsigned int attributeCount;
+    unsigned int stride; // bytes
+    unsigned int sourceStride; // floats per source vertex
+} VertexFormat;
+
+// bytes per component
+unsigned int getEncodingSize(VertexEncoding encoding);
+void initVertexFormat(VertexFormat* format, const char* name, unsigned int sourceStride);
+bool addVertexAttribute(VertexFormat* format, unsigned int location, unsigned int components, VertexEncoding encoding, unsigned int source, unsigned int sourceComponents);
+// glVertexAttribPointer for every attribute, called with the VAO and the vertex buffer bound
+void applyVertexFormat(const VertexFormat* format);
+// converts count float source vertices into count * format->stride bytes, out of range values are clamped
+void encodeVertices(const VertexFormat* format, const float* source, unsigned int count, void* destination);
+
+unsigned short floatToHalf(float value);
+
+#endif
@@ -0,0 +1,658 @@
+#include "VoxelWorld.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VOLUME_SIDE (CHUNK_SIZE + 2) // one block of each neighbour around the chunk
+#define VOXEL_SOURCE_FLOATS 8 // position, color, uv, as every other mesh is built
+#define TERRAIN_OCTAVES 4
+
+static const float blockColors[BLOCK_TYPE_COUNT][3] = {
+    { 0.0f, 0.0f, 0.0f }, // air, never meshed
+    { 0.55f, 0.55f, 0.58f }, // stone
+    { 0.55f, 0.38f, 0.24f }, // dirt
+    { 0.36f, 0.66f, 0.28f }, // grass
+    { 0.86f, 0.80f, 0.56f }, // sand
+    { 0.95f, 0.96f, 1.0f } // snow
+};
+
+// baked directional light, indexed by axis then negative/positive side
+static const float faceShade[3][2] = {
+    { 0.75f, 0.8f }, // x
+    { 0.5f, 1.0f }, // y, bottom then top
+    { 0.65f, 0.7f } // z
+};
+
+void buildVoxelVertexFormat(VertexFormat* format, bool packed) {
+    initVertexFormat(format, packed ? "voxel" : "float", VOXEL_SOURCE_FLOATS);
+    // chunk local positions are whole numbers up to 256 and uvs count blocks, both exact as halves
+    addVertexAttribute(format, 0, 3, packed ? ENCODING_HALF : ENCODING_FLOAT, 0, 3);
+    addVertexAttribute(format, 1, packed ? 4 : 3, packed ? ENCODING_UNORM8 : ENCODING_FLOAT, 3, 3);
+    addVertexAttribute(format, 2, 2, packed ? ENCODING_HALF : ENCODING_FLOAT, 6, 2);
+}
+
+// TERRAIN
+
+static float hashColumn(int x, int z, unsigned int seed) {
+    unsigned int h = (unsigned int)x * 374761393u + (unsigned int)z * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (float)(h & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+static float valueNoise(float x, float z, unsigned int seed) {
+    float cellX = floorf(x), cellZ = floorf(z);
+    float fx = x - cellX, fz = z - cellZ;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    int ix = (int)cellX, iz = (int)cellZ;
+    float top = hashColumn(ix, iz, seed) + (hashColumn(ix + 1, iz, seed) - hashColumn(ix, iz, seed)) * fx;
+    float bottom = hashColumn(ix, iz + 1, seed) + (hashColumn(ix + 1, iz + 1, seed) - hashColumn(ix, iz + 1, seed)) * fx;
+    return top + (bottom - top) * fz;
+}
+
+int getVoxelTerrainHeight(unsigned int seed, int x, int z) {
+    float height = 0.0f, amplitude = 1.0f, total = 0.0f, frequency = 1.0f / 128.0f;
+    for (unsigned int octave = 0; octave < TERRAIN_OCTAVES; octave++) {
+        height += valueNoise(x * frequency, z * frequency, seed + octave) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    height /= total;
+    return 40 + (int)(height * height * 96.0f); // squared: wide lowlands, fewer tall peaks
+}
+
+static BlockType surfaceBlock(int height) {
+    if (height < 52) return BLOCK_SAND;
+    if (height > 96) return BLOCK_SNOW;
+    return BLOCK_GRASS;
+}
+
+// CHUNK STORAGE
+
+static unsigned int slotIndex(const VoxelWorld* world, int x, int z) {
+    int side = (int)world->slotsPerSide;
+    int slotX = ((x % side) + side) % side;
+    int slotZ = ((z % side) + side) % side;
+    return (unsigned int)(slotZ * side + slotX);
+}
+
+static unsigned int blockIndex(int x, int y, int z) {
+    return (unsigned int)((y % CHUNK_SECTION_HEIGHT) * CHUNK_SIZE * CHUNK_SIZE + z * CHUNK_SIZE + x);
+}
+
+static BlockType chunkBlock(const Chunk* chunk, int x, int y, int z) {
+    const unsigned char* section = chunk->sections[y / CHUNK_SECTION_HEIGHT];
+    return section != NULL ? (BlockType)section[blockIndex(x, y, z)] : BLOCK_AIR;
+}
+
+static bool setChunkBlock(Chunk* chunk, int x, int y, int z, BlockType block) {
+    unsigned char** section = &chunk->sections[y / CHUNK_SECTION_HEIGHT];
+    if (*section == NULL) {
+        if (block == BLOCK_AIR) {
+            return true;
+        }
+        *section = (unsigned char*)calloc(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SECTION_HEIGHT, 1);
+        if (*section == NULL) {
+            return false;
+        }
+    }
+    (*section)[blockIndex(x, y, z)] = (unsigned char)block;
+    if (block != BLOCK_AIR && (unsigned int)y >= chunk->height) {
+        chunk->height = (unsigned int)y + 1; // only ever grows, a stale height just meshes some extra air
+    }
+    return true;
+}
+
+// the chunk currently loaded at (x, z) with blocks that can be read, NULL otherwise
+static Chunk* findChunk(const VoxelWorld* world, int x, int z) {
+    Chunk* chunk = &world->chunks[slotIndex(world, x, z)];
+    if (chunk->x != x || chunk->z != z) {
+        return NULL;
+    }
+    long state = atomicLoad(&chunk->state);
+    return state == CHUNK_READY || state == CHUNK_MESHING || state == CHUNK_MESHED ? chunk : NULL;
+}
+
+static void freeChunkMesh(Chunk* chunk) {
+    free(chunk->volume);
+    free(chunk->meshVertices);
+    free(chunk->meshIndices);
+    chunk->volume = NULL;
+    chunk->meshVertices = NULL;
+    chunk->meshIndices = NULL;
+    chunk->meshVertexCount = chunk->meshIndexCount = 0;
+}
+
+static void unloadChunk(VoxelWorld* world, Chunk* chunk) {
+    for (unsigned int i = 0; i < CHUNK_SECTIONS; i++) {
+        free(chunk->sections[i]);
+        chunk->sections[i] = NULL;
+    }
+    freeChunkMesh(chunk);
+    if (chunk->mesh != INVALID_MESH) {
+        removeMesh(&world->arena, chunk->mesh);
+        chunk->mesh = INVALID_MESH;
+    }
+    chunk->height = 0;
+    chunk->dirty = false;
+    atomicStore(&chunk->state, CHUNK_UNLOADED);
+}
+
+// WORKER SIDE
+
+static void generateChunk(void* data) {
+    Chunk* chunk = (Chunk*)data;
+    unsigned int seed = chunk->world->seed;
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            int height = getVoxelTerrainHeight(seed, chunk->x * CHUNK_SIZE + x, chunk->z * CHUNK_SIZE + z);
+            if (height >= CHUNK_HEIGHT) height = CHUNK_HEIGHT - 1;
+            for (int y = 0; y <= height; y++) {
+                BlockType block = y == height ? surfaceBlock(height) : y > height - 4 ? BLOCK_DIRT : BLOCK_STONE;
+                setChunkBlock(chunk, x, y, z, block);
+            }
+        }
+    }
+    atomicStore(&chunk->state, CHUNK_GENERATED);
+}
+
+typedef struct MeshBuilder {
+    float* vertices;
+    unsigned int* indices;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    unsigned int quadCapacity;
+    bool failed;
+} MeshBuilder;
+
+// one face-aligned rectangle, corner is its lowest corner and size its extent along u and v
+static void emitQuad(MeshBuilder* builder, int axis, int positive, const int corner[3], int width, int height, BlockType block) {
+    if (builder->vertexCount / 4 == builder->quadCapacity) {
+        unsigned int capacity = builder->quadCapacity > 0 ? builder->quadCapacity * 2 : 1024;
+        float* vertices = (float*)realloc(builder->vertices, sizeof(float) * VOXEL_SOURCE_FLOATS * 4 * capacity);
+        if (vertices != NULL) builder->vertices = vertices;
+        unsigned int* indices = (unsigned int*)realloc(builder->indices, sizeof(unsigned int) * 6 * capacity);
+        if (indices != NULL) builder->indices = indices;
+        if (vertices == NULL || indices == NULL) {
+            builder->failed = true;
+            return;
+        }
+        builder->quadCapacity = capacity;
+    }
+    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    const float* color = blockColors[block];
+    float shade = faceShade[axis][positive];
+    unsigned int first = builder->vertexCount;
+
+    for (int i = 0; i < 4; i++) {
+        float position[3] = { (float)corner[0], (float)corner[1], (float)corner[2] };
+        if (i == 1 || i == 2) position[u] += (float)width;
+        if (i == 2 || i == 3) position[v] += (float)height;
+        float* vertex = builder->vertices + (size_t)builder->vertexCount++ * VOXEL_SOURCE_FLOATS;
+        vertex[0] = position[0];
+        vertex[1] = position[1];
+        vertex[2] = position[2];
+        vertex[3] = color[0] * shade;
+        vertex[4] = color[1] * shade;
+        vertex[5] = color[2] * shade;
+        // one texture repeat per block, upright on the sides
+        vertex[6] = axis == 2 ? position[0] : position[2];
+        vertex[7] = axis == 1 ? position[0] : position[1];
+    }
+    // u x v points along +axis, so corners 0-1-2-3 wind counter-clockwise seen from the positive side
+    static const unsigned int front[6] = { 0, 1, 2, 0, 2, 3 };
+    static const unsigned int back[6] = { 0, 2, 1, 0, 3, 2 };
+    const unsigned int* order = positive ? front : back;
+    for (int i = 0; i < 6; i++) {
+        builder->indices[builder->indexCount++] = first + order[i];
+    }
+}
+
+// every visible face of one axis and side, slice by slice, merged into as few rectangles as the block types allow
+static void meshFaces(const Chunk* chunk, MeshBuilder* builder, unsigned char* mask, int axis, int positive) {
+    int dimensions[3] = { CHUNK_SIZE, (int)chunk->volumeHeight, CHUNK_SIZE };
+    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    int width = dimensions[u], height = dimensions[v];
+    static const int strides[3] = { 1, VOLUME_SIDE * VOLUME_SIDE, VOLUME_SIDE }; // x, y, z
+
+    for (int slice = 0; slice < dimensions[axis]; slice++) {
+        // a face is visible where a solid block touches air, walked with strides through the copied volume
+        int neighbourY = axis == 1 ? slice + (positive ? 1 : -1) : 0;
+        if (neighbourY < 0) {
+            continue; // bottom of the world
+        }
+        bool openAbove = neighbourY >= (int)chunk->volumeHeight;
+        int origin[3] = { 0, 0, 0 };
+        origin[axis] = slice;
+        const unsigned char* base = chunk->volume + (origin[1] * VOLUME_SIDE + origin[2] + 1) * VOLUME_SIDE + origin[0] + 1;
+        int neighbourStep = (positive ? 1 : -1) * strides[axis];
+        bool any = false;
+        for (int b = 0; b < height; b++) {
+            const unsigned char* row = base + b * strides[v];
+            for (int a = 0; a < width; a++) {
+                const unsigned char* block = row + a * strides[u];
+                unsigned char face = *block != BLOCK_AIR && (openAbove || block[neighbourStep] == BLOCK_AIR) ? *block : 0;
+                mask[b * width + a] = face;
+                any |= face != 0;
+            }
+        }
+        if (!any) {
+            continue;
+        }
+
+        // grow each rectangle along u first, then along v while whole rows still match
+        for (int b = 0; b < height; b++) {
+            for (int a = 0; a < width; ) {
+                unsigned char block = mask[b * width + a];
+                if (block == 0) {
+                    a++;
+                    continue;
+                }
+                int quadWidth = 1;
+                while (a + quadWidth < width && mask[b * width + a + quadWidth] == block) {
+                    quadWidth++;
+                }
+                int quadHeight = 1;
+                for (; b + quadHeight < height; quadHeight++) {
+                    const unsigned char* row = &mask[(b + quadHeight) * width + a];
+                    int k = 0;
+                    while (k < quadWidth && row[k] == block) k++;
+                    if (k < quadWidth) break;
+                }
+                int corner[3];
+                corner[axis] = slice + (positive ? 1 : 0);
+                corner[u] = a;
+                corner[v] = b;
+                emitQuad(builder, axis, positive, corner, quadWidth, quadHeight, (BlockType)block);
+                for (int y = 0; y < quadHeight; y++) {
+                    memset(&mask[(b + y) * width + a], 0, quadWidth);
+                }
+                a += quadWidth;
+            }
+        }
+    }
+}
+
+static void meshChunk(void* data) {
+    Chunk* chunk = (Chunk*)data;
+    double start = getTimeSeconds();
+    MeshBuilder builder;
+    memset(&builder, 0, sizeof(MeshBuilder));
+    unsigned char* mask = (unsigned char*)malloc(CHUNK_SIZE * CHUNK_HEIGHT);
+    if (mask != NULL) {
+        for (int axis = 0; axis < 3; axis++) {
+            meshFaces(chunk, &builder, mask, axis, 0);
+            meshFaces(chunk, &builder, mask, axis, 1);
+        }
+    }
+
+    const VertexFormat* format = &chunk->world->arena.format;
+    chunk->meshVertices = NULL;
+    if (mask != NULL && !builder.failed && builder.vertexCount > 0) {
+        chunk->meshVertices = malloc((size_t)builder.vertexCount * format->stride);
+    }
+    if (chunk->meshVertices != NULL) {
+        encodeVertices(format, builder.vertices, builder.vertexCount, chunk->meshVertices);
+        chunk->meshIndices = builder.indices;
+        chunk->meshVertexCount = builder.vertexCount;
+        chunk->meshIndexCount = builder.indexCount;
+    }
+    else {
+        if (mask == NULL || builder.failed) printf("ERROR::VOXEL::MESH_ALLOCATION_FAILED %d %d\n", chunk->x, chunk->z);
+        free(builder.indices);
+        chunk->meshIndices = NULL;
+        chunk->meshVertexCount = chunk->meshIndexCount = 0;
+    }
+    free(builder.vertices);
+    free(mask);
+    free(chunk->volume);
+    chunk->volume = NULL;
+    chunk->meshSeconds = getTimeSeconds() - start;
+    atomicStore(&chunk->state, CHUNK_MESHED);
+}
+
+// GL THREAD SIDE
+
+bool createVoxelWorld(VoxelWorld* world, JobPool* pool, const VertexFormat* format, int viewRadius, unsigned int seed, vec3 origin, bool allowMultiDraw) {
+    memset(world, 0, sizeof(VoxelWorld));
+    world->pool = pool;
+    world->viewRadius = viewRadius > 0 ? viewRadius : DEFAULT_VIEW_RADIUS;
+    world->seed = seed;
+    glm_vec3_copy(origin, world->origin);
+    world->uploadBudget = CHUNK_UPLOAD_BUDGET;
+    world->maxJobs = pool != NULL ? (pool->workerCount + 1) * CHUNK_JOBS_PER_WORKER : CHUNK_JOBS_PER_WORKER;
+    // generated one chunk past the view radius so every meshed chunk has all four neighbours,
+    // plus one spare row so a chunk coming into range never shares a slot with one still in range
+    world->slotsPerSide = (unsigned int)(2 * (world->viewRadius + 1) + 2);
+
+    int generateRadius = world->viewRadius + 1;
+    unsigned int slotCount = world->slotsPerSide * world->slotsPerSide;
+    unsigned int offsetCapacity = (unsigned int)((2 * generateRadius + 1) * (2 * generateRadius + 1));
+    world->chunks = (Chunk*)calloc(slotCount, sizeof(Chunk));
+    world->offsets = (int(*)[2])malloc(sizeof(int[2]) * offsetCapacity);
+    if (world->chunks == NULL || world->offsets == NULL || !createMeshDrawList(&world->draws, slotCount)) {
+        printf("ERROR::VOXEL::ALLOCATION_FAILED\n");
+        destroyVoxelWorld(world);
+        return false;
+    }
+    for (unsigned int i = 0; i < slotCount; i++) {
+        world->chunks[i].world = world;
+        world->chunks[i].mesh = INVALID_MESH;
+        world->chunks[i].state = CHUNK_UNLOADED;
+    }
+
+    // circle of offsets sorted by distance, so loading always works outwards from the camera
+    for (int pass = 0; pass < 2; pass++) {
+        int limit = pass == 0 ? world->viewRadius : generateRadius;
+        for (int dz = -generateRadius; dz <= generateRadius; dz++) {
+            for (int dx = -generateRadius; dx <= generateRadius; dx++) {
+                int distance = dx * dx + dz * dz;
+                bool inside = distance <= limit * limit;
+                bool insidePrevious = pass == 1 && distance <= world->viewRadius * world->viewRadius;
+                if (inside && !insidePrevious) {
+                    world->offsets[world->offsetCount][0] = dx;
+                    world->offsets[world->offsetCount][1] = dz;
+                    world->offsetCount++;
+                }
+            }
+        }
+        if (pass == 0) world->meshOffsetCount = world->offsetCount;
+    }
+    for (unsigned int i = 1; i < world->meshOffsetCount; i++) {
+        int dx = world->offsets[i][0], dz = world->offsets[i][1];
+        unsigned int j = i;
+        for (; j > 0 && world->offsets[j - 1][0] * world->offsets[j - 1][0] + world->offsets[j - 1][1] * world->offsets[j - 1][1] > dx * dx + dz * dz; j--) {
+            world->offsets[j][0] = world->offsets[j - 1][0];
+            world->offsets[j][1] = world->offsets[j - 1][1];
+        }
+        world->offsets[j][0] = dx;
+        world->offsets[j][1] = dz;
+    }
+
+    // rough guess of a few hundred quads per chunk, the arena grows if the terrain needs more
+    unsigned int meshedChunks = world->meshOffsetCount;
+    if (!createMeshArena(&world->arena, format, meshedChunks * 1024, meshedChunks * 1536, allowMultiDraw)) {
+        destroyVoxelWorld(world);
+        return false;
+    }
+    world->startTime = world->lastUpdate = getTimeSeconds();
+    return true;
+}
+
+void destroyVoxelWorld(VoxelWorld* world) {
+    if (world->chunks != NULL) {
+        unsigned int slotCount = world->slotsPerSide * world->slotsPerSide;
+        for (unsigned int i = 0; i < slotCount; i++) {
+            Chunk* chunk = &world->chunks[i];
+            // a worker may still be writing into the chunk
+            long state;
+            while ((state = atomicLoad(&chunk->state)) == CHUNK_GENERATING || state == CHUNK_MESHING) {
+                sleepMilliseconds(1);
+            }
+            unloadChunk(world, chunk);
+        }
+    }
+    destroyMeshDrawList(&world->draws);
+    destroyMeshArena(&world->arena);
+    free(world->chunks);
+    free(world->offsets);
+    memset(world, 0, sizeof(VoxelWorld));
+}
+
+static void submitChunkJob(VoxelWorld* world, JobFunction function, Chunk* chunk) {
+    world->jobsInFlight++;
+    if (world->pool == NULL || !submitJob(world->pool, function, chunk)) {
+        function(chunk);
+    }
+}
+
+// copies the chunk and a one block border of its neighbours, the mesh job reads only this copy
+static bool copyMeshVolume(Chunk* chunk, Chunk* neighbours[4]) {
+    unsigned int height = chunk->height;
+    for (int i = 0; i < 4; i++) {
+        if (neighbours[i]->height > height) height = neighbours[i]->height;
+    }
+    height = height < CHUNK_HEIGHT ? height + 1 : CHUNK_HEIGHT; // a layer of air over the top faces
+    chunk->volume = (unsigned char*)calloc((size_t)VOLUME_SIDE * VOLUME_SIDE * height, 1);
+    if (chunk->volume == NULL) {
+        return false;
+    }
+    chunk->volumeHeight = height;
+    for (int y = 0; y < (int)height; y++) {
+        unsigned char* layer = chunk->volume + (size_t)y * VOLUME_SIDE * VOLUME_SIDE;
+        const unsigned char* section = chunk->sections[y / CHUNK_SECTION_HEIGHT];
+        if (section != NULL) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                memcpy(layer + (z + 1) * VOLUME_SIDE + 1, section + blockIndex(0, y, z), CHUNK_SIZE);
+            }
+        }
+        // -x, +x, -z, +z borders
+        for (int k = 0; k < CHUNK_SIZE; k++) {
+            layer[(k + 1) * VOLUME_SIDE] = (unsigned char)chunkBlock(neighbours[0], CHUNK_SIZE - 1, y, k);
+            layer[(k + 1) * VOLUME_SIDE + VOLUME_SIDE - 1] = (unsigned char)chunkBlock(neighbours[1], 0, y, k);
+            layer[k + 1] = (unsigned char)chunkBlock(neighbours[2], k, y, CHUNK_SIZE - 1);
+            layer[(VOLUME_SIDE - 1) * VOLUME_SIDE + k + 1] = (unsigned char)chunkBlock(neighbours[3], k, y, 0);
+        }
+    }
+    return true;
+}
+
+static void uploadChunkMesh(VoxelWorld* world, Chunk* chunk) {
+    if (chunk->mesh != INVALID_MESH) {
+        removeMesh(&world->arena, chunk->mesh);
+        chunk->mesh = INVALID_MESH;
+    }
+    if (chunk->meshVertexCount > 0) {
+        chunk->mesh = addMesh(&world->arena, chunk->meshVertices, chunk->meshVertexCount, chunk->meshIndices, chunk->meshIndexCount);
+    }
+    world->chunksMeshed++;
+    world->meshSeconds += chunk->meshSeconds;
+    freeChunkMesh(chunk);
+    atomicStore(&chunk->state, CHUNK_READY);
+    world->jobsInFlight--;
+}
+
+static bool insideRadius(const VoxelWorld* world, const Chunk* chunk, int radius) {
+    int dx = chunk->x - world->centerX, dz = chunk->z - world->centerZ;
+    return dx * dx + dz * dz <= radius * radius;
+}
+
+void updateVoxelWorld(VoxelWorld* world, vec3 position) {
+    double now = getTimeSeconds();
+    if (world->jobsInFlight > 0) {
+        world->busySeconds += now - world->lastUpdate;
+    }
+    world->lastUpdate = now;
+    world->centerX = (int)floorf((position[0] - world->origin[0]) / CHUNK_SIZE);
+    world->centerZ = (int)floorf((position[2] - world->origin[2]) / CHUNK_SIZE);
+
+    // COLLECT: finished generations, and meshes for chunks that went out of range before their upload
+    unsigned int slotCount = world->slotsPerSide * world->slotsPerSide;
+    for (unsigned int i = 0; i < slotCount; i++) {
+        Chunk* chunk = &world->chunks[i];
+        long state = atomicLoad(&chunk->state);
+        if (state == CHUNK_GENERATED) {
+            atomicStore(&chunk->state, CHUNK_READY);
+            world->chunksGenerated++;
+            world->jobsInFlight--;
+        }
+        else if (state == CHUNK_MESHED && !insideRadius(world, chunk, world->viewRadius)) {
+            freeChunkMesh(chunk);
+            chunk->dirty = true; // meshed again if it comes back into range
+            atomicStore(&chunk->state, CHUNK_READY);
+            world->jobsInFlight--;
+        }
+    }
+
+    // UPLOAD: nearest first, whole meshes only, at least one per frame so a huge chunk cannot block the rest
+    size_t uploaded = 0;
+    for (unsigned int i = 0; i < world->meshOffsetCount && uploaded < world->uploadBudget; i++) {
+        int x = world->centerX + world->offsets[i][0], z = world->centerZ + world->offsets[i][1];
+        Chunk* chunk = &world->chunks[slotIndex(world, x, z)];
+        if (chunk->x == x && chunk->z == z && atomicLoad(&chunk->state) == CHUNK_MESHED) {
+            uploaded += (size_t)chunk->meshVertexCount * world->arena.format.stride + (size_t)chunk->meshIndexCount * sizeof(unsigned int);
+            uploadChunkMesh(world, chunk);
+        }
+    }
+
+    // MESH: dirty chunks in range whose four neighbours have their blocks
+    static const int neighbourOffsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    for (unsigned int i = 0; i < world->meshOffsetCount && world->jobsInFlight < world->maxJobs; i++) {
+        int x = world->centerX + world->offsets[i][0], z = world->centerZ + world->offsets[i][1];
+        Chunk* chunk = &world->chunks[slotIndex(world, x, z)];
+        if (chunk->x != x || chunk->z != z || !chunk->dirty || atomicLoad(&chunk->state) != CHUNK_READY) {
+            continue;
+        }
+        Chunk* neighbours[4];
+        bool complete = true;
+        for (int n = 0; n < 4 && complete; n++) {
+            neighbours[n] = findChunk(world, x + neighbourOffsets[n][0], z + neighbourOffsets[n][1]);
+            complete = neighbours[n] != NULL;
+        }
+        if (!complete || !copyMeshVolume(chunk, neighbours)) {
+            continue;
+        }
+        chunk->dirty = false;
+        atomicStore(&chunk->state, CHUNK_MESHING);
+        submitChunkJob(world, meshChunk, chunk);
+    }
+
+    // GENERATE: claim the slot of every missing chunk, dropping whatever left range there
+    for (unsigned int i = 0; i < world->offsetCount && world->jobsInFlight < world->maxJobs; i++) {
+        int x = world->centerX + world->offsets[i][0], z = world->centerZ + world->offsets[i][1];
+        Chunk* chunk = &world->chunks[slotIndex(world, x, z)];
+        long state = atomicLoad(&chunk->state);
+        if (state != CHUNK_UNLOADED && chunk->x == x && chunk->z == z) {
+            continue;
+        }
+        if (state != CHUNK_UNLOADED) {
+            if (state != CHUNK_READY) {
+                continue; // its job finishes first
+            }
+            unloadChunk(world, chunk);
+        }
+        chunk->x = x;
+        chunk->z = z;
+        chunk->dirty = true;
+        atomicStore(&chunk->state, CHUNK_GENERATING);
+        submitChunkJob(world, generateChunk, chunk);
+    }
+
+    if (!world->loaded) {
+        bool loaded = true;
+        for (unsigned int i = 0; i < world->meshOffsetCount && loaded; i++) {
+            Chunk* chunk = &world->chunks[slotIndex(world, world->centerX + world->offsets[i][0], world->centerZ + world->offsets[i][1])];
+            loaded = chunk->x == world->centerX + world->offsets[i][0] && chunk->z == world->centerZ + world->offsets[i][1]
+                && atomicLoad(&chunk->state) == CHUNK_READY && !chunk->dirty;
+        }
+        if (loaded) {
+            world->loaded = true;
+            printf("VOXEL::LOADED %u chunks within %d after %.1f ms, %.0f chunks/s meshed, %.2f ms per chunk on a worker, %u triangles\n",
+                world->meshOffsetCount, world->viewRadius, (now - world->startTime) * 1000.0, getChunkMeshRate(world),
+                world->chunksMeshed > 0 ? world->meshSeconds * 1000.0 / world->chunksMeshed : 0.0, world->arena.indices.used / 3);
+        }
+    }
+}
+
+unsigned int gatherVisibleChunks(VoxelWorld* world, const Frustum* frustum, mat4* models) {
+    clearMeshDrawList(&world->draws);
+    unsigned int drawn = 0;
+    for (unsigned int i = 0; i < world->meshOffsetCount; i++) {
+        int x = world->centerX + world->offsets[i][0], z = world->centerZ + world->offsets[i][1];
+        const Chunk* chunk = &world->chunks[slotIndex(world, x, z)];
+        if (chunk->x != x || chunk->z != z || chunk->mesh == INVALID_MESH) {
+            continue;
+        }
+        AABB bounds;
+        bounds.min[0] = world->origin[0] + (float)(x * CHUNK_SIZE);
+        bounds.min[1] = world->origin[1];
+        bounds.min[2] = world->origin[2] + (float)(z * CHUNK_SIZE);
+        bounds.max[0] = bounds.min[0] + CHUNK_SIZE;
+        bounds.max[1] = bounds.min[1] + (float)chunk->height;
+        bounds.max[2] = bounds.min[2] + CHUNK_SIZE;
+        if (!boxInFrustum(frustum, &bounds)) {
+            continue;
+        }
+        glm_translate_make(models[drawn], bounds.min);
+        addMeshDraw(&world->draws, &world->arena, chunk->mesh, 1, drawn);
+        drawn++;
+    }
+    world->drawnChunks = drawn;
+    return drawn;
+}
+
+// BLOCK ACCESS
+
+static int floorDivide(int value, int divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+BlockType getVoxelBlock(const VoxelWorld* world, int x, int y, int z) {
+    if (y < 0 || y >= CHUNK_HEIGHT) {
+        return BLOCK_AIR;
+    }
+    int chunkX = floorDivide(x, CHUNK_SIZE), chunkZ = floorDivide(z, CHUNK_SIZE);
+    const Chunk* chunk = findChunk(world, chunkX, chunkZ);
+    return chunk != NULL ? chunkBlock(chunk, x - chunkX * CHUNK_SIZE, y, z - chunkZ * CHUNK_SIZE) : BLOCK_AIR;
+}
+
+bool setVoxelBlock(VoxelWorld* world, int x, int y, int z, BlockType block) {
+    if (y < 0 || y >= CHUNK_HEIGHT) {
+        return false;
+    }
+    int chunkX = floorDivide(x, CHUNK_SIZE), chunkZ = floorDivide(z, CHUNK_SIZE);
+    Chunk* chunk = findChunk(world, chunkX, chunkZ);
+    if (chunk == NULL) {
+        return false;
+    }
+    int localX = x - chunkX * CHUNK_SIZE, localZ = z - chunkZ * CHUNK_SIZE;
+    if (!setChunkBlock(chunk, localX, y, localZ, block)) {
+        return false;
+    }
+    // a running mesh job has its own copy, the chunk is simply meshed again once it lands
+    chunk->dirty = true;
+    Chunk* neighbour = NULL;
+    if (localX == 0) neighbour = findChunk(world, chunkX - 1, chunkZ);
+    if (localX == CHUNK_SIZE - 1) neighbour = findChunk(world, chunkX + 1, chunkZ);
+    if (neighbour != NULL) neighbour->dirty = true;
+    neighbour = NULL;
+    if (localZ == 0) neighbour = findChunk(world, chunkX, chunkZ - 1);
+    if (localZ == CHUNK_SIZE - 1) neighbour = findChunk(world, chunkX, chunkZ + 1);
+    if (neighbour != NULL) neighbour->dirty = true;
+    return true;
+}
+
+// grid traversal, one block boundary at a time along the ray
+bool raycastVoxelWorld(const VoxelWorld* world, vec3 origin, vec3 direction, float maxDistance, int hit[3]) {
+    float start[3], step[3], next[3], delta[3];
+    int block[3];
+    for (int axis = 0; axis < 3; axis++) {
+        start[axis] = origin[axis] - world->origin[axis];
+        block[axis] = (int)floorf(start[axis]);
+        step[axis] = direction[axis] > 0.0f ? 1.0f : -1.0f;
+        delta[axis] = direction[axis] != 0.0f ? fabsf(1.0f / direction[axis]) : INFINITY;
+        float boundary = direction[axis] > 0.0f ? (float)block[axis] + 1.0f - start[axis] : start[axis] - (float)block[axis];
+        next[axis] = direction[axis] != 0.0f ? boundary * delta[axis] : INFINITY;
+    }
+    float distance = 0.0f;
+    while (distance <= maxDistance) {
+        if (getVoxelBlock(world, block[0], block[1], block[2]) != BLOCK_AIR) {
+            hit[0] = block[0];
+            hit[1] = block[1];
+            hit[2] = block[2];
+            return true;
+        }
+        int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+        distance = next[axis];
+        next[axis] += delta[axis];
+        block[axis] += (int)step[axis];
+    }
+    return false;
+}
+
+double getChunkMeshRate(const VoxelWorld* world) {
+    return world->busySeconds > 0.0 ? world->chunksMeshed / world->busySeconds : 0.0;
+}
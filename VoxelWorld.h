@@ -0,0 +1,117 @@
+#ifndef VOXEL_WORLD_H
+#define VOXEL_WORLD_H
+
+#include <cglm/cglm.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "Platform.h"
+#include "JobPool.h"
+#include "MeshArena.h"
+#include "Culling.h"
+
+// CHUNKED BLOCK WORLD: 16x16x256 CHUNKS AROUND THE CAMERA, GENERATED AND GREEDY MESHED ON THE JOB POOL,
+// EDITED ON THE GL THREAD AND RE-MESHED ONLY WHERE BLOCKS CHANGED, ALL CHUNK MESHES DRAWN WITH ONE MULTI-DRAW
+
+#define CHUNK_SIZE 16
+#define CHUNK_HEIGHT 256
+#define CHUNK_SECTION_HEIGHT 16 // blocks are stored in 16 high sections, all-air sections take no memory
+#define CHUNK_SECTIONS (CHUNK_HEIGHT / CHUNK_SECTION_HEIGHT)
+#define DEFAULT_VIEW_RADIUS 32 // chunks
+#define CHUNK_UPLOAD_BUDGET (4 * 1024 * 1024) // mesh bytes moved into the arena per frame
+#define CHUNK_JOBS_PER_WORKER 16 // generate/mesh jobs in flight per thread, bounds how long a texture decode waits behind them
+
+typedef enum BlockType {
+    BLOCK_AIR,
+    BLOCK_STONE,
+    BLOCK_DIRT,
+    BLOCK_GRASS,
+    BLOCK_SAND,
+    BLOCK_SNOW,
+    BLOCK_TYPE_COUNT
+} BlockType;
+
+// a chunk only moves forward through these, the worker owns it while GENERATING or MESHING
+typedef enum ChunkState {
+    CHUNK_UNLOADED, // slot is free
+    CHUNK_GENERATING, // worker filling the blocks
+    CHUNK_GENERATED, // blocks done, the GL thread has not noticed yet
+    CHUNK_READY, // blocks can be read and edited, no job running
+    CHUNK_MESHING, // worker meshing a copy of the blocks, the blocks themselves can still be edited
+    CHUNK_MESHED // mesh waiting for its upload
+} ChunkState;
+
+struct VoxelWorld;
+
+typedef struct Chunk {
+    struct VoxelWorld* world;
+    int x; // chunk coordinates, the first block is at x * CHUNK_SIZE
+    int z;
+    AtomicInt state; // ChunkState
+    unsigned char* sections[CHUNK_SECTIONS]; // BlockType per block, x fastest then z then y, NULL when all air
+    unsigned int height; // one above the highest solid block
+    bool dirty; // blocks changed since the last mesh job copied them
+    unsigned int mesh; // in the world's arena, INVALID_MESH when the chunk has no visible faces yet
+    // handed between the GL thread and a mesh job
+    unsigned char* volume; // padded copy of the blocks and the neighbours' borders, (CHUNK_SIZE + 2)^2 * volumeHeight
+    unsigned int volumeHeight;
+    void* meshVertices; // encoded in the arena's format
+    unsigned int* meshIndices;
+    unsigned int meshVertexCount;
+    unsigned int meshIndexCount;
+    double meshSeconds; // worker time spent on the last mesh
+} Chunk;
+
+typedef struct VoxelWorld {
+    JobPool* pool; // NULL runs the jobs on the GL thread
+    MeshArena arena;
+    MeshDrawList draws;
+    Chunk* chunks; // slotsPerSide^2 ring, chunk (x, z) lives in slot (x mod side, z mod side)
+    unsigned int slotsPerSide;
+    int viewRadius; // chunks are meshed and drawn inside this, generated one chunk further out
+    int (*offsets)[2]; // every chunk offset within viewRadius + 1, nearest first
+    unsigned int offsetCount;
+    unsigned int meshOffsetCount; // the leading offsets that are within viewRadius
+    int centerX; // chunk under the camera
+    int centerZ;
+    unsigned int seed;
+    vec3 origin; // world position of block (0, 0, 0)
+    unsigned int jobsInFlight; // submitted and not collected yet
+    unsigned int maxJobs;
+    size_t uploadBudget;
+    unsigned int drawnChunks; // from the last gatherVisibleChunks
+    // throughput
+    unsigned int chunksGenerated;
+    unsigned int chunksMeshed;
+    double meshSeconds; // summed over workers
+    double busySeconds; // wall time with jobs in flight
+    double lastUpdate;
+    double startTime;
+    bool loaded; // every chunk within the radius has been meshed once
+} VoxelWorld;
+
+// standard position/color/uv vertex with uvs that repeat once per block, so a greedy quad tiles its texture
+void buildVoxelVertexFormat(VertexFormat* format, bool packed);
+
+bool createVoxelWorld(VoxelWorld* world, JobPool* pool, const VertexFormat* format, int viewRadius, unsigned int seed, vec3 origin, bool allowMultiDraw);
+void destroyVoxelWorld(VoxelWorld* world); // waits for the jobs still running
+
+// GL thread, once per frame: collects finished jobs, uploads meshes within the budget, then queues
+// generation and meshing nearest first around position and drops chunks that fell out of range
+void updateVoxelWorld(VoxelWorld* world, vec3 position);
+
+// frustum culls the meshed chunks into world->draws, writes one model matrix per drawn chunk, returns how many.
+// models needs room for world->meshOffsetCount matrices, one per chunk in range
+unsigned int gatherVisibleChunks(VoxelWorld* world, const Frustum* frustum, mat4* models);
+
+// block coordinates, reads outside loaded chunks return BLOCK_AIR and writes there are ignored
+BlockType getVoxelBlock(const VoxelWorld* world, int x, int y, int z);
+bool setVoxelBlock(VoxelWorld* world, int x, int y, int z, BlockType block);
+// first solid block along a world space ray, false when there is none within maxDistance
+bool raycastVoxelWorld(const VoxelWorld* world, vec3 origin, vec3 direction, float maxDistance, int hit[3]);
+// generated surface height at a block column, independent of what is loaded or edited
+int getVoxelTerrainHeight(unsigned int seed, int x, int z);
+
+// average chunks meshed per second of wall time spent with work outstanding
+double getChunkMeshRate(const VoxelWorld* world);
+
+#endif